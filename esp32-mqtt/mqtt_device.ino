@@ -2,6 +2,10 @@
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
 #include <DHT.h>
+#include <TaskWheel.h>
+#include <DeadBand.h>
+#include <JsonArena.h>
+#include <sys/time.h>
 
 // WiFi Configuration
 const char* ssid = "YOUR_WIFI_SSID";
@@ -12,6 +16,9 @@ const char* mqtt_server = "192.168.1.100";  // Change to your MQTT broker IP
 const int mqtt_port = 1883;
 const char* mqtt_client_id = "esp32_device_01";
 
+// Time Configuration: payload timestamps are epoch milliseconds from SNTP
+const char* ntp_server = "pool.ntp.org";
+
 // Device Configuration
 const char* device_id = "lights_hr_dept";
 const char* location = "hr_dept";
@@ -23,23 +30,51 @@ const char* device_type = "lights";
 #define DHT_PIN 5          // DHT sensor pin
 #define DHT_TYPE DHT22     // DHT sensor type
 
+// Payload format: 0 = JSON, 1 = MessagePack on the same topics + "/msgpack".
+// Commands are accepted in either format.
+#define USE_MSGPACK 0
+#define MSGPACK_SUFFIX "/msgpack"
+
 // Objects
 WiFiClient espClient;
 PubSubClient client(espClient);
 DHT dht(DHT_PIN, DHT_TYPE);
 
+// Every JsonDocument lives in this one static arena instead of the heap.
+// Documents here are locals, freed in reverse order, so the arena is empty
+// again after each message. Room for two at once: a command and the status
+// it publishes.
+const size_t json_arena_size = 2 * ARDUINOJSON_POOL_CAPACITY * 2 * sizeof(void*) + 1024;
+StaticJsonArena<json_arena_size> json_arena;
+
+bool publishDoc(const String& topic, JsonDocument& doc, bool retained = false);
+uint64_t timestampMillis();
+
 // Variables
 bool device_status = false;
-unsigned long lastSensorRead = 0;
 const unsigned long sensorInterval = 30000; // Read sensor every 30 seconds
-unsigned long lastHeartbeat = 0;
 const unsigned long heartbeatInterval = 60000; // Send heartbeat every 60 seconds
+const unsigned long mqttServiceInterval = 1000; // client.loop() while connected; broker data wakes it sooner
+const unsigned long mqttRetryInterval = 5000;   // one connect attempt per run while disconnected
+
+// Periodic work runs as scheduler tasks; loop() sleeps in between
+TaskWheel scheduler;
+int mqtt_task = -1;
+
+// Sensor dead-bands: a value is sent only when it moved more than its band
+// since the value last sent, or after sensorMaxSilence without being sent.
+// Due values go out together in one message on sensor_topic.
+const float temperatureBand = 0.2;              // °C
+const float humidityBand = 1.0;                 // %RH
+const unsigned long sensorMaxSilence = 300000;  // 5 minutes
+DeadBand sensor_filter;
+int temperature_channel = -1;
+int humidity_channel = -1;
 
 // MQTT Topics
 String command_topic = "company/devices/" + String(device_type) + "/" + String(location) + "/command";
 String status_topic = "company/devices/" + String(device_type) + "/" + String(location) + "/status";
-String sensor_temp_topic = "company/sensors/temperature/" + String(location);
-String sensor_humidity_topic = "company/sensors/humidity/" + String(location);
+String sensor_topic = "company/sensors/environment/" + String(location);
 
 void setup() {
   Serial.begin(115200);
@@ -50,16 +85,28 @@ void setup() {
   digitalWrite(LED_PIN, LOW);
   digitalWrite(RELAY_PIN, LOW);
   
-  // Initialize DHT sensor
+  // Initialize DHT sensor and its dead-bands
   dht.begin();
+  temperature_channel = sensor_filter.addChannel("temperature", temperatureBand);
+  humidity_channel = sensor_filter.addChannel("humidity", humidityBand);
+  sensor_filter.setMaxSilence(sensorMaxSilence);
   
   // Connect to WiFi
   setupWiFi();
   
+  // Start the core's SNTP client; it keeps resyncing in the background
+  configTime(0, 0, ntp_server);
+  
   // Setup MQTT
   client.setServer(mqtt_server, mqtt_port);
   client.setCallback(onMqttMessage);
   
+  // Tasks: MQTT connection, sensors, heartbeat
+  scheduler.begin();
+  mqtt_task = scheduler.every("mqtt", mqttRetryInterval, serviceMQTT);
+  scheduler.every("sensors", sensorInterval, readAndPublishSensors, sensorInterval);
+  scheduler.every("heartbeat", heartbeatInterval, publishDeviceStatus, heartbeatInterval);
+  
   Serial.println("ESP32 MQTT Device Ready!");
   Serial.println("Device ID: " + String(device_id));
   Serial.println("Command Topic: " + command_topic);
@@ -67,25 +114,13 @@ void setup() {
 }
 
 void loop() {
-  // Maintain MQTT connection
-  if (!client.connected()) {
-    reconnectMQTT();
-  }
-  client.loop();
+  // Run whatever is due: MQTT, sensors, heartbeat
+  scheduler.runDue();
   
-  // Read and publish sensor data
-  if (millis() - lastSensorRead > sensorInterval) {
-    readAndPublishSensors();
-    lastSensorRead = millis();
+  // Sleep until the next task is due or the broker sends something
+  if (scheduler.idle(espClient.fd())) {
+    scheduler.runNow(mqtt_task);
   }
-  
-  // Send heartbeat
-  if (millis() - lastHeartbeat > heartbeatInterval) {
-    publishDeviceStatus();
-    lastHeartbeat = millis();
-  }
-  
-  delay(100);
 }
 
 void setupWiFi() {
@@ -107,46 +142,53 @@ void setupWiFi() {
   Serial.println(WiFi.localIP());
 }
 
-void reconnectMQTT() {
-  while (!client.connected()) {
-    Serial.print("Attempting MQTT connection...");
+// Connected: handles whatever the broker sent. Disconnected: one connect
+// attempt, repeated every mqttRetryInterval, so loop() never blocks on it
+void serviceMQTT() {
+  if (client.connected()) {
+    client.loop();
+    return;
+  }
+  scheduler.setPeriod(mqtt_task, mqttRetryInterval);
+  
+  Serial.print("Attempting MQTT connection...");
+  
+  if (client.connect(mqtt_client_id)) {
+    Serial.println("connected");
+    scheduler.setPeriod(mqtt_task, mqttServiceInterval);
+    
+    // Subscribe to command topic (JSON and MessagePack)
+    client.subscribe(command_topic.c_str());
+    client.subscribe((command_topic + MSGPACK_SUFFIX).c_str());
+    Serial.println("Subscribed to: " + command_topic);
     
-    if (client.connect(mqtt_client_id)) {
-      Serial.println("connected");
-      
-      // Subscribe to command topic
-      client.subscribe(command_topic.c_str());
-      Serial.println("Subscribed to: " + command_topic);
-      
-      // Publish initial status
-      publishDeviceStatus();
-      
-    } else {
-      Serial.print("failed, rc=");
-      Serial.print(client.state());
-      Serial.println(" try again in 5 seconds");
-      delay(5000);
-    }
+    // Publish initial status
+    publishDeviceStatus();
+    
+  } else {
+    Serial.print("failed, rc=");
+    Serial.print(client.state());
+    Serial.println(" try again in 5 seconds");
   }
 }
 
 void onMqttMessage(char* topic, byte* payload, unsigned int length) {
-  String message = "";
-  for (int i = 0; i < length; i++) {
-    message += (char)payload[i];
-  }
+  bool msgpack = String(topic).endsWith(MSGPACK_SUFFIX);
   
   Serial.println("Message received on topic: " + String(topic));
-  Serial.println("Message: " + message);
   
-  // Parse JSON command
-  DynamicJsonDocument doc(1024);
-  DeserializationError error = deserializeJson(doc, message);
+  // Parse the command, JSON or MessagePack by topic
+  JsonDocument doc(&json_arena);
+  DeserializationError error = msgpack ? deserializeMsgPack(doc, payload, length)
+                                       : deserializeJson(doc, payload, length);
   
   if (error) {
-    Serial.println("JSON parsing failed: " + String(error.c_str()));
+    Serial.println("Command parsing failed: " + String(error.c_str()));
     return;
   }
+  Serial.print("Message: ");
+  serializeJson(doc, Serial);
+  Serial.println();
   
   String command = doc["command"];
   String received_device_id = doc["device_id"];
@@ -191,20 +233,21 @@ void executeCommand(String command) {
 }
 
 void publishDeviceStatus() {
-  DynamicJsonDocument doc(1024);
+  JsonDocument doc(&json_arena);
   
   doc["device_id"] = device_id;
   doc["status"] = device_status ? "on" : "off";
-  doc["timestamp"] = WiFi.getTime();
+  doc["timestamp"] = timestampMillis();
   doc["online"] = true;
   doc["wifi_rssi"] = WiFi.RSSI();
   doc["free_heap"] = ESP.getFreeHeap();
+  doc["sensor_readings"] = sensor_filter.stats().readings;
+  doc["sensor_sent"] = sensor_filter.stats().sent;
   
-  String json_string;
-  serializeJson(doc, json_string);
-  
-  if (client.publish(status_topic.c_str(), json_string.c_str(), true)) {
-    Serial.println("Status published: " + json_string);
+  if (publishDoc(status_topic, doc, true)) {
+    Serial.print("Status published: ");
+    serializeJson(doc, Serial);
+    Serial.println();
   } else {
     Serial.println("Failed to publish status");
   }
@@ -218,34 +261,58 @@ void readAndPublishSensors() {
     Serial.println("Failed to read from DHT sensor!");
     return;
   }
+  sensor_filter.update(temperature_channel, temperature);
+  sensor_filter.update(humidity_channel, humidity);
   
-  // Publish temperature
-  DynamicJsonDocument tempDoc(512);
-  tempDoc["sensor_id"] = "temperature_" + String(location);
-  tempDoc["value"] = temperature;
-  tempDoc["unit"] = "°C";
-  tempDoc["timestamp"] = WiFi.getTime();
-  tempDoc["device_id"] = device_id;
-  
-  String tempJson;
-  serializeJson(tempDoc, tempJson);
-  
-  if (client.publish(sensor_temp_topic.c_str(), tempJson.c_str())) {
-    Serial.println("Temperature published: " + tempJson);
+  uint32_t due = sensor_filter.due(millis());
+  if (!due) {
+    return;  // both inside their dead-bands
   }
   
-  // Publish humidity
-  DynamicJsonDocument humidityDoc(512);
-  humidityDoc["sensor_id"] = "humidity_" + String(location);
-  humidityDoc["value"] = humidity;
-  humidityDoc["unit"] = "%";
-  humidityDoc["timestamp"] = WiFi.getTime();
-  humidityDoc["device_id"] = device_id;
-  
-  String humidityJson;
-  serializeJson(humidityDoc, humidityJson);
+  // One message with the values that are due
+  JsonDocument doc(&json_arena);
+  doc["sensor_id"] = "environment_" + String(location);
+  doc["device_id"] = device_id;
+  doc["timestamp"] = timestampMillis();
+  if (due & (1u << temperature_channel)) {
+    doc["temperature"] = temperature;  // °C
+  }
+  if (due & (1u << humidity_channel)) {
+    doc["humidity"] = humidity;        // %
+  }
   
-  if (client.publish(sensor_humidity_topic.c_str(), humidityJson.c_str())) {
-    Serial.println("Humidity published: " + humidityJson);
+  if (publishDoc(sensor_topic, doc)) {
+    sensor_filter.commit(due, millis());
+    Serial.print("Sensors published: ");
+    serializeJson(doc, Serial);
+    Serial.println();
+    sensor_filter.printStats(Serial);
+  }
+}
+
+// Epoch milliseconds once SNTP has set the clock, millis() uptime before
+// that (anything below 10^12 is uptime and gets stamped on arrival)
+uint64_t timestampMillis() {
+  struct timeval now;
+  gettimeofday(&now, nullptr);
+  if (now.tv_sec < 1600000000) {
+    return millis();
+  }
+  return (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+// Publishes doc as JSON on topic, or as MessagePack on topic + "/msgpack"
+bool publishDoc(const String& topic, JsonDocument& doc, bool retained) {
+#if USE_MSGPACK
+  uint8_t buffer[256];
+  size_t length = serializeMsgPack(doc, buffer, sizeof(buffer));
+  return client.publish((topic + MSGPACK_SUFFIX).c_str(), buffer, length, retained);
+#else
+  char json[256];
+  if (measureJson(doc) >= sizeof(json)) {
+    return false;
   }
+  size_t length = serializeJson(doc, json, sizeof(json));
+  return client.publish(topic.c_str(), (const uint8_t*)json, length, retained);
+#endif
 }
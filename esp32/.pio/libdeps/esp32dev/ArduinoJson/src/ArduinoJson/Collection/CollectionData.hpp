@@ -17,6 +17,7 @@ class ResourceManager;
 
 class CollectionIterator {
   friend class CollectionData;
+  friend class ObjectData;
 
  public:
   CollectionIterator() : slot_(nullptr), currentId_(NULL_SLOT) {}
@@ -96,6 +97,10 @@ class CollectionData {
     return head_;
   }
 
+  SlotId tail() const {
+    return tail_;
+  }
+
  protected:
   void appendOne(Slot<VariantData> slot, const ResourceManager* resources);
   void appendPair(Slot<VariantData> key, Slot<VariantData> value,
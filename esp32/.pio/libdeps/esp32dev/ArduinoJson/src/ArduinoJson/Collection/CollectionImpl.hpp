@@ -58,6 +58,11 @@ inline void CollectionData::appendPair(Slot<VariantData> key,
 }
 
 inline void CollectionData::clear(ResourceManager* resources) {
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+  if (head_ != NULL_SLOT)
+    resources->dropObjectIndex(head_);
+#endif
+
   auto next = head_;
   while (next != NULL_SLOT) {
     auto currId = next;
@@ -104,6 +109,10 @@ inline void CollectionData::removePair(ObjectData::iterator it,
   if (it.done())
     return;
 
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+  resources->dropObjectIndex(head_);
+#endif
+
   auto keySlot = it.slot_;
 
   auto valueId = it.nextId_;
@@ -124,6 +124,18 @@
 #  define ARDUINOJSON_INITIAL_POOL_COUNT 4
 #endif
 
+// Index the keys of large objects in a hash table, so that a lookup does not
+// compare every key. An object gets its index from the first lookup that
+// compared ARDUINOJSON_OBJECT_INDEX_THRESHOLD keys or more; the index lives
+// in the document's allocator and is dropped when a member is removed.
+#ifndef ARDUINOJSON_ENABLE_OBJECT_INDEX
+#  define ARDUINOJSON_ENABLE_OBJECT_INDEX 0
+#endif
+
+#ifndef ARDUINOJSON_OBJECT_INDEX_THRESHOLD
+#  define ARDUINOJSON_OBJECT_INDEX_THRESHOLD 16
+#endif
+
 // Automatically call shrinkToFit() from deserializeXxx()
 // Disabled by default on 8-bit platforms because it's not worth the increase in
 // code size
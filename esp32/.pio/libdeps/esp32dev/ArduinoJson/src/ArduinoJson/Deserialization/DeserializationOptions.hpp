@@ -5,6 +5,7 @@
 #pragma once
 
 #include <ArduinoJson/Deserialization/Filter.hpp>
+#include <ArduinoJson/Deserialization/InSitu.hpp>
 #include <ArduinoJson/Deserialization/NestingLimit.hpp>
 
 ARDUINOJSON_BEGIN_PRIVATE_NAMESPACE
@@ -0,0 +1,19 @@
+// ArduinoJson - https://arduinojson.org
+// Copyright © 2014-2025, Benoit BLANCHON
+// MIT License
+
+#pragma once
+
+#include <ArduinoJson/Namespace.hpp>
+
+ARDUINOJSON_BEGIN_PUBLIC_NAMESPACE
+
+namespace DeserializationOption {
+// Parses a writable char buffer in place: deserializeJson() unescapes quoted
+// strings where they are and the document points into the buffer instead of
+// copying them. The buffer is modified, and must outlive the document and any
+// copy of it. Pass it right after the input (and its size).
+class InSitu {};
+}  // namespace DeserializationOption
+
+ARDUINOJSON_END_PUBLIC_NAMESPACE
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <ArduinoJson/Namespace.hpp>
+#include <ArduinoJson/Polyfills/type_traits.hpp>
 #include <ArduinoJson/Polyfills/utility.hpp>
 
 #include <stdlib.h>  // for size_t
@@ -37,9 +38,25 @@ struct BoundedReader {
   // constructor
 };
 
+// Readers over one block of RAM expose it through data() and dataEnd(), so
+// that JsonDeserializer can scan it with pointer arithmetic (see Latch)
+template <typename TReader, typename Enable = void>
+struct IsContiguousReader : false_type {};
+
+template <typename TReader>
+struct IsContiguousReader<TReader,
+                          void_t<decltype(declval<TReader&>().dataEnd())>>
+    : true_type {};
+
+// Readers whose buffer the deserializer may write to
+// (DeserializationOption::InSitu)
+template <typename TReader>
+struct IsInSituReader : false_type {};
+
 ARDUINOJSON_END_PRIVATE_NAMESPACE
 
 #include <ArduinoJson/Deserialization/Readers/IteratorReader.hpp>
+#include <ArduinoJson/Deserialization/Readers/InSituReader.hpp>
 #include <ArduinoJson/Deserialization/Readers/RamReader.hpp>
 #include <ArduinoJson/Deserialization/Readers/VariantReader.hpp>
 
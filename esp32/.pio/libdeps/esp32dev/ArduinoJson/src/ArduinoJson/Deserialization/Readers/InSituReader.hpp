@@ -0,0 +1,29 @@
+// ArduinoJson - https://arduinojson.org
+// Copyright © 2014-2025, Benoit BLANCHON
+// MIT License
+
+#pragma once
+
+#include <ArduinoJson/Polyfills/type_traits.hpp>
+
+ARDUINOJSON_BEGIN_PRIVATE_NAMESPACE
+
+// The writable buffer of DeserializationOption::InSitu
+class InSituReader : public IteratorReader<char*> {
+ public:
+  explicit InSituReader(char* begin, char* end)
+      : IteratorReader<char*>(begin, end) {}
+
+  char* data() const {
+    return position();
+  }
+
+  char* dataEnd() const {
+    return end();
+  }
+};
+
+template <>
+struct IsInSituReader<InSituReader> : true_type {};
+
+ARDUINOJSON_END_PRIVATE_NAMESPACE
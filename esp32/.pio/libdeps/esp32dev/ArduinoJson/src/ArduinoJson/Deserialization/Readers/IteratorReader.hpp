@@ -29,6 +29,15 @@ class IteratorReader {
       buffer[i++] = *ptr_++;
     return i;
   }
+
+ protected:
+  TIterator position() const {
+    return ptr_;
+  }
+
+  TIterator end() const {
+    return end_;
+  }
 };
 
 template <typename TSource>
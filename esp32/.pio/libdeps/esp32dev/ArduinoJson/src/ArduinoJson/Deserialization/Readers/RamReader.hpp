@@ -6,6 +6,8 @@
 
 #include <ArduinoJson/Polyfills/type_traits.hpp>
 
+#include <string.h>  // strlen
+
 ARDUINOJSON_BEGIN_PRIVATE_NAMESPACE
 
 template <typename T>
@@ -35,6 +37,15 @@ struct Reader<TSource*, enable_if_t<IsCharOrVoid<TSource>::value>> {
       buffer[i] = *ptr_++;
     return length;
   }
+
+  const char* data() const {
+    return ptr_;
+  }
+
+  // The terminator ends the input, as read() returning 0 does
+  const char* dataEnd() const {
+    return ptr_ + strlen(ptr_);
+  }
 };
 
 template <typename TSource>
@@ -44,6 +55,14 @@ struct BoundedReader<TSource*, enable_if_t<IsCharOrVoid<TSource>::value>>
   explicit BoundedReader(const void* ptr, size_t len)
       : IteratorReader<const char*>(reinterpret_cast<const char*>(ptr),
                                     reinterpret_cast<const char*>(ptr) + len) {}
+
+  const char* data() const {
+    return position();
+  }
+
+  const char* dataEnd() const {
+    return end();
+  }
 };
 
 ARDUINOJSON_END_PRIVATE_NAMESPACE
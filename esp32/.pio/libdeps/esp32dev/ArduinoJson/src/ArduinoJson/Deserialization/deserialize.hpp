@@ -9,6 +9,8 @@
 #include <ArduinoJson/Deserialization/Reader.hpp>
 #include <ArduinoJson/Polyfills/utility.hpp>
 
+#include <string.h>  // strlen
+
 ARDUINOJSON_BEGIN_PRIVATE_NAMESPACE
 
 // A meta-function that returns the first type of the parameter pack
@@ -55,11 +57,16 @@ DeserializationError doDeserialize(TDestination&& dst, TReader reader,
   return err;
 }
 
+template <typename T>
+using is_in_situ_option = is_same<T, DeserializationOption::InSitu>;
+
 template <
     template <typename> class TDeserializer, typename TDestination,
     typename TStream, typename... Args,
     enable_if_t<  // issue #1897
-        !is_integral<typename first_or_void<Args...>::type>::value, int> = 0>
+        !is_integral<typename first_or_void<Args...>::type>::value &&
+            !is_in_situ_option<typename first_or_void<Args...>::type>::value,
+        int> = 0>
 DeserializationError deserialize(TDestination&& dst, TStream&& input,
                                  Args... args) {
   return doDeserialize<TDeserializer>(
@@ -67,13 +74,46 @@ DeserializationError deserialize(TDestination&& dst, TStream&& input,
       makeDeserializationOptions(args...));
 }
 
-template <template <typename> class TDeserializer, typename TDestination,
-          typename TChar, typename Size, typename... Args,
-          enable_if_t<is_integral<Size>::value, int> = 0>
+template <
+    template <typename> class TDeserializer, typename TDestination,
+    typename TChar, typename Size, typename... Args,
+    enable_if_t<is_integral<Size>::value &&
+                    !is_in_situ_option<typename first_or_void<Args...>::type>::value,
+                int> = 0>
 DeserializationError deserialize(TDestination&& dst, TChar* input,
                                  Size inputSize, Args... args) {
   return doDeserialize<TDeserializer>(dst, makeReader(input, size_t(inputSize)),
                                       makeDeserializationOptions(args...));
 }
 
+// DeserializationOption::InSitu only takes a writable char buffer
+template <typename TChar>
+using is_writable_char =
+    bool_constant<IsCharOrVoid<TChar>::value && !is_const<TChar>::value &&
+                  !is_same<TChar, void>::value>;
+
+template <template <typename> class TDeserializer, typename TDestination,
+          typename TChar, typename Size, typename... Args,
+          enable_if_t<is_integral<Size>::value && is_writable_char<TChar>::value,
+                      int> = 0>
+DeserializationError deserialize(TDestination&& dst, TChar* input,
+                                 Size inputSize, DeserializationOption::InSitu,
+                                 Args... args) {
+  char* begin = reinterpret_cast<char*>(input);
+  return doDeserialize<TDeserializer>(
+      dst, InSituReader(begin, begin ? begin + size_t(inputSize) : begin),
+      makeDeserializationOptions(args...));
+}
+
+template <template <typename> class TDeserializer, typename TDestination,
+          typename TChar, typename... Args,
+          enable_if_t<is_writable_char<TChar>::value, int> = 0>
+DeserializationError deserialize(TDestination&& dst, TChar* input,
+                                 DeserializationOption::InSitu, Args... args) {
+  char* begin = reinterpret_cast<char*>(input);
+  return doDeserialize<TDeserializer>(
+      dst, InSituReader(begin, begin ? begin + strlen(begin) : begin),
+      makeDeserializationOptions(args...));
+}
+
 ARDUINOJSON_END_PRIVATE_NAMESPACE
@@ -0,0 +1,59 @@
+// ArduinoJson - https://arduinojson.org
+// Copyright © 2014-2025, Benoit BLANCHON
+// MIT License
+
+#pragma once
+
+#include <ArduinoJson/Namespace.hpp>
+
+#include <string.h>  // memmove
+
+ARDUINOJSON_BEGIN_PRIVATE_NAMESPACE
+
+// Writes an unescaped string over the quoted string it is read from.
+// An escape sequence is never shorter than what it stands for, so the output
+// never overtakes the input, and the terminator fits in the closing quote.
+class InSituString {
+ public:
+  InSituString(char* begin) : begin_(begin), end_(begin), hasNul_(false) {}
+
+  void append(char c) {
+    if (c == '\0')  // from \u0000
+      hasNul_ = true;
+    *end_++ = c;
+  }
+
+  void append(const char* s, size_t n) {
+    if (s != end_)  // shifted by an earlier escape sequence
+      memmove(end_, s, n);
+    end_ += n;
+  }
+
+  bool isValid() const {
+    return true;
+  }
+
+  // A NUL in the string would cut it short once terminated
+  bool hasNul() const {
+    return hasNul_;
+  }
+
+  const char* data() const {
+    return begin_;
+  }
+
+  size_t size() const {
+    return size_t(end_ - begin_);
+  }
+
+  void terminate() {
+    *end_ = 0;
+  }
+
+ private:
+  char* begin_;
+  char* end_;
+  bool hasNul_;
+};
+
+ARDUINOJSON_END_PRIVATE_NAMESPACE
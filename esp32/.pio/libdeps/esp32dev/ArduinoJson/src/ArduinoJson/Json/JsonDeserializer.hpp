@@ -6,6 +6,7 @@
 
 #include <ArduinoJson/Deserialization/deserialize.hpp>
 #include <ArduinoJson/Json/EscapeSequence.hpp>
+#include <ArduinoJson/Json/InSituString.hpp>
 #include <ArduinoJson/Json/Latch.hpp>
 #include <ArduinoJson/Json/Utf16.hpp>
 #include <ArduinoJson/Json/Utf8.hpp>
@@ -268,7 +269,7 @@ class JsonDeserializer {
       if (!eat(':'))
         return DeserializationError::InvalidInput;
 
-      JsonString key = stringBuilder_.str();
+      JsonString key = lastString();
 
       TFilter memberFilter = filter[key];
 
@@ -279,7 +280,7 @@ class JsonDeserializer {
           if (!keyVariant)
             return DeserializationError::NoMemory;
 
-          stringBuilder_.save(keyVariant);
+          saveString(keyVariant);
         } else {
           member->clear(resources_);
         }
@@ -371,29 +372,70 @@ class JsonDeserializer {
   }
 
   DeserializationError::Code parseKey() {
+    if (isQuote(current()))
+      return parseQuotedString(IsInSituReader<TReader>());
+
+    linkedString_ = JsonString();
     stringBuilder_.startString();
-    if (isQuote(current())) {
-      return parseQuotedString();
-    } else {
-      return parseNonQuotedString();
-    }
+    return parseNonQuotedString();
   }
 
   DeserializationError::Code parseStringValue(VariantData& variant) {
     DeserializationError::Code err;
 
+    err = parseQuotedString(IsInSituReader<TReader>());
+    if (err)
+      return err;
+
+    saveString(&variant);
+
+    return DeserializationError::Ok;
+  }
+
+  DeserializationError::Code parseQuotedString(false_type) {
     stringBuilder_.startString();
+    return parseQuotedString(stringBuilder_);
+  }
 
-    err = parseQuotedString();
+  // DeserializationOption::InSitu: the string is unescaped where it is and
+  // terminated over its closing quote
+  DeserializationError::Code parseQuotedString(true_type) {
+    // the reader hands out a writable buffer
+    InSituString str(const_cast<char*>(latch_.position()) + 1);
+
+    DeserializationError::Code err = parseQuotedString(str);
     if (err)
       return err;
 
-    stringBuilder_.save(&variant);
+    if (str.hasNul()) {
+      // a linked string ends at the first NUL; copy this one
+      linkedString_ = JsonString();
+      stringBuilder_.startString();
+      stringBuilder_.append(str.data(), str.size());
+      if (!stringBuilder_.isValid())
+        return DeserializationError::NoMemory;
+      return DeserializationError::Ok;
+    }
 
+    str.terminate();
+    linkedString_ = JsonString(str.data(), str.size(), true);
     return DeserializationError::Ok;
   }
 
-  DeserializationError::Code parseQuotedString() {
+  // The last string parsed, in the input buffer or in stringBuilder_
+  JsonString lastString() {
+    return linkedString_ ? linkedString_ : stringBuilder_.str();
+  }
+
+  void saveString(VariantData* variant) {
+    if (linkedString_)
+      variant->setLinkedString(linkedString_.c_str());
+    else
+      stringBuilder_.save(variant);
+  }
+
+  template <typename TStringBuilder>
+  DeserializationError::Code parseQuotedString(TStringBuilder& str) {
 #if ARDUINOJSON_DECODE_UNICODE
     Utf16::Codepoint codepoint;
     DeserializationError::Code err;
@@ -402,6 +444,8 @@ class JsonDeserializer {
 
     move();
     for (;;) {
+      appendPlainRun(str, stopChar, IsContiguousReader<TReader>());
+
       char c = current();
       move();
       if (c == stopChar)
@@ -424,9 +468,9 @@ class JsonDeserializer {
           if (err)
             return err;
           if (codepoint.append(codeunit))
-            Utf8::encodeCodepoint(codepoint.value(), stringBuilder_);
+            Utf8::encodeCodepoint(codepoint.value(), str);
 #else
-          stringBuilder_.append('\\');
+          str.append('\\');
 #endif
           continue;
         }
@@ -438,10 +482,10 @@ class JsonDeserializer {
         move();
       }
 
-      stringBuilder_.append(c);
+      str.append(c);
     }
 
-    if (!stringBuilder_.isValid())
+    if (!str.isValid())
       return DeserializationError::NoMemory;
 
     return DeserializationError::Ok;
@@ -480,6 +524,8 @@ class JsonDeserializer {
 
     move();
     for (;;) {
+      skipPlainRun(stopChar, IsContiguousReader<TReader>());
+
       char c = current();
       move();
       if (c == stopChar)
@@ -601,6 +647,31 @@ class JsonDeserializer {
     return uint8_t(c - 'A' + 10);
   }
 
+  // Contiguous input: the unescaped part of a string is copied in one go
+  template <typename TStringBuilder>
+  void appendPlainRun(TStringBuilder& str, char stopChar, true_type) {
+    size_t n = latch_.plainRun(stopChar);
+    if (n) {
+      str.append(latch_.position(), n);
+      latch_.skip(n);
+    }
+  }
+
+  template <typename TStringBuilder>
+  void appendPlainRun(TStringBuilder&, char, false_type) {}
+
+  void skipPlainRun(char stopChar, true_type) {
+    latch_.skip(latch_.plainRun(stopChar));
+  }
+
+  void skipPlainRun(char, false_type) {}
+
+  void skipSpaceRun(true_type) {
+    latch_.skip(latch_.spaceRun());
+  }
+
+  void skipSpaceRun(false_type) {}
+
   DeserializationError::Code skipSpacesAndComments() {
     for (;;) {
       switch (current()) {
@@ -615,6 +686,7 @@ class JsonDeserializer {
         case '\r':
         case '\n':
           move();
+          skipSpaceRun(IsContiguousReader<TReader>());
           continue;
 
 #if ARDUINOJSON_ENABLE_COMMENTS
@@ -681,6 +753,7 @@ class JsonDeserializer {
   }
 
   StringBuilder stringBuilder_;
+  JsonString linkedString_;  // null when the last string is in stringBuilder_
   bool foundSomething_;
   Latch<TReader> latch_;
   ResourceManager* resources_;
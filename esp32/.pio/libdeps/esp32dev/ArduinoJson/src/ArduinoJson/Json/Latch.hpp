@@ -4,11 +4,15 @@
 
 #pragma once
 
+#include <ArduinoJson/Deserialization/Reader.hpp>
 #include <ArduinoJson/Polyfills/assert.hpp>
+#include <ArduinoJson/Polyfills/integer.hpp>
+
+#include <string.h>  // memcpy
 
 ARDUINOJSON_BEGIN_PRIVATE_NAMESPACE
 
-template <typename TReader>
+template <typename TReader, typename Enable = void>
 class Latch {
  public:
   Latch(TReader reader) : reader_(reader), loaded_(false) {
@@ -53,4 +57,95 @@ class Latch {
 #endif
 };
 
+// Input already in RAM (char*, String, JsonVariant): the latch is a cursor
+// over [data(), dataEnd()) and never calls read(). On top of current() and
+// clear(), it measures runs the deserializer can consume in one step,
+// testing a machine word at a time (SWAR) before looking at single bytes.
+template <typename TReader>
+class Latch<TReader, enable_if_t<IsContiguousReader<TReader>::value>> {
+  using word_t = uint_t<ARDUINOJSON_SIZEOF_POINTER * 8>;
+
+ public:
+  Latch(TReader reader) : ptr_(reader.data()), end_(reader.dataEnd()) {}
+
+  void clear() {
+    if (ptr_ < end_)
+      ptr_++;
+  }
+
+  // Only read after current(), which leaves the cursor on the last char seen
+  int last() const {
+    return ptr_ < end_ ? *ptr_ : 0;
+  }
+
+  FORCE_INLINE char current() {
+    return ptr_ < end_ ? *ptr_ : 0;
+  }
+
+  const char* position() const {
+    return ptr_;
+  }
+
+  void skip(size_t n) {
+    ARDUINOJSON_ASSERT(n <= size_t(end_ - ptr_));
+    ptr_ += n;
+  }
+
+  // Length of the run before the next stopChar, backslash or NUL: the part of
+  // a quoted string that needs no unescaping
+  size_t plainRun(char stopChar) const {
+    const word_t quotes = broadcast(stopChar);
+    const word_t backslashes = broadcast('\\');
+    const char* p = ptr_;
+    while (size_t(end_ - p) >= sizeof(word_t)) {
+      word_t w = load(p);
+      if (zeroBytes(w) | zeroBytes(w ^ quotes) | zeroBytes(w ^ backslashes))
+        break;
+      p += sizeof(word_t);
+    }
+    while (p < end_ && *p != stopChar && *p != '\\' && *p != '\0')
+      p++;
+    return size_t(p - ptr_);
+  }
+
+  // Length of the run of spaces, tabs and line breaks at the cursor
+  size_t spaceRun() const {
+    const char* p = ptr_;
+    while (size_t(end_ - p) >= sizeof(word_t)) {
+      word_t w = load(p);
+      word_t spaces = zeroBytes(w ^ broadcast(' ')) |
+                      zeroBytes(w ^ broadcast('\t')) |
+                      zeroBytes(w ^ broadcast('\r')) |
+                      zeroBytes(w ^ broadcast('\n'));
+      if (spaces != broadcast(char(0x80)))
+        break;
+      p += sizeof(word_t);
+    }
+    while (p < end_ && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+      p++;
+    return size_t(p - ptr_);
+  }
+
+ private:
+  static word_t broadcast(char c) {
+    return word_t(~word_t(0) / 0xFF) * static_cast<unsigned char>(c);
+  }
+
+  static word_t load(const char* p) {
+    word_t w;
+    memcpy(&w, p, sizeof(w));  // unaligned and alias-safe; a single load
+    return w;
+  }
+
+  // 0x80 in every byte of w that is zero, 0 in the others (exact, no carries
+  // between bytes)
+  static word_t zeroBytes(word_t w) {
+    const word_t low7 = broadcast(0x7F);
+    return ~(((w & low7) + low7) | w | low7);
+  }
+
+  const char* ptr_;
+  const char* end_;
+};
+
 ARDUINOJSON_END_PRIVATE_NAMESPACE
@@ -0,0 +1,115 @@
+// ArduinoJson - https://arduinojson.org
+// Copyright © 2014-2025, Benoit BLANCHON
+// MIT License
+
+#pragma once
+
+#include <ArduinoJson/Memory/Allocator.hpp>
+#include <ArduinoJson/Memory/MemoryPool.hpp>
+#include <ArduinoJson/Namespace.hpp>
+#include <ArduinoJson/Polyfills/assert.hpp>
+#include <ArduinoJson/Polyfills/utility.hpp>
+
+#include <stddef.h>  // offsetof
+
+ARDUINOJSON_BEGIN_PRIVATE_NAMESPACE
+
+// A hash table of the key slots of one large object, so that findKey() does
+// not compare every key (see ARDUINOJSON_ENABLE_OBJECT_INDEX).
+// Open addressing with linear probing; NULL_SLOT marks an empty bucket.
+struct ObjectIndex {
+  ObjectIndex* next;
+  SlotId object;     // the object's first key slot, which identifies it
+  SlotId lastValue;  // value slot of the last pair indexed
+  size_t count;
+  size_t capacity;  // a power of two
+  SlotId buckets[1];
+
+  static constexpr size_t sizeForCapacity(size_t n) {
+    return offsetof(ObjectIndex, buckets) + n * sizeof(SlotId);
+  }
+
+  static ObjectIndex* create(size_t capacity, Allocator* allocator) {
+    ARDUINOJSON_ASSERT((capacity & (capacity - 1)) == 0);
+    auto index = reinterpret_cast<ObjectIndex*>(
+        allocator->allocate(sizeForCapacity(capacity)));
+    if (index) {
+      index->count = 0;
+      index->capacity = capacity;
+      for (size_t i = 0; i < capacity; i++)
+        index->buckets[i] = NULL_SLOT;
+    }
+    return index;
+  }
+
+  static void destroy(ObjectIndex* index, Allocator* allocator) {
+    allocator->deallocate(index);
+  }
+
+  // Keeps the load factor at or below 1/2
+  bool full() const {
+    return (count + 1) * 2 > capacity;
+  }
+};
+
+class ObjectIndexList {
+ public:
+  ObjectIndexList() = default;
+  ObjectIndexList(const ObjectIndexList&) = delete;
+  void operator=(const ObjectIndexList&) = delete;
+
+  ~ObjectIndexList() {
+    ARDUINOJSON_ASSERT(indexes_ == nullptr);
+  }
+
+  friend void swap(ObjectIndexList& a, ObjectIndexList& b) {
+    swap_(a.indexes_, b.indexes_);
+  }
+
+  ObjectIndex* get(SlotId object) const {
+    for (auto index = indexes_; index; index = index->next) {
+      if (index->object == object)
+        return index;
+    }
+    return nullptr;
+  }
+
+  ObjectIndex* create(SlotId object, size_t capacity, Allocator* allocator) {
+    auto index = ObjectIndex::create(capacity, allocator);
+    if (index) {
+      index->object = object;
+      index->lastValue = NULL_SLOT;
+      index->next = indexes_;
+      indexes_ = index;
+    }
+    return index;
+  }
+
+  void remove(SlotId object, Allocator* allocator) {
+    ObjectIndex* prev = nullptr;
+    for (auto index = indexes_; index; index = index->next) {
+      if (index->object == object) {
+        if (prev)
+          prev->next = index->next;
+        else
+          indexes_ = index->next;
+        ObjectIndex::destroy(index, allocator);
+        return;
+      }
+      prev = index;
+    }
+  }
+
+  void clear(Allocator* allocator) {
+    while (indexes_) {
+      auto index = indexes_;
+      indexes_ = index->next;
+      ObjectIndex::destroy(index, allocator);
+    }
+  }
+
+ private:
+  ObjectIndex* indexes_ = nullptr;
+};
+
+ARDUINOJSON_END_PRIVATE_NAMESPACE
@@ -6,6 +6,7 @@
 
 #include <ArduinoJson/Memory/Allocator.hpp>
 #include <ArduinoJson/Memory/MemoryPoolList.hpp>
+#include <ArduinoJson/Memory/ObjectIndex.hpp>
 #include <ArduinoJson/Memory/StringPool.hpp>
 #include <ArduinoJson/Polyfills/assert.hpp>
 #include <ArduinoJson/Polyfills/utility.hpp>
@@ -32,6 +33,9 @@ class ResourceManager {
       : allocator_(allocator), overflowed_(false) {}
 
   ~ResourceManager() {
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+    objectIndexes_.clear(allocator_);
+#endif
     stringPool_.clear(allocator_);
     variantPools_.clear(allocator_);
   }
@@ -42,6 +46,9 @@ class ResourceManager {
   friend void swap(ResourceManager& a, ResourceManager& b) {
     swap(a.stringPool_, b.stringPool_);
     swap(a.variantPools_, b.variantPools_);
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+    swap(a.objectIndexes_, b.objectIndexes_);
+#endif
     swap_(a.allocator_, b.allocator_);
     swap_(a.overflowed_, b.overflowed_);
   }
@@ -81,7 +88,7 @@ class ResourceManager {
   }
 
   void saveString(StringNode* node) {
-    stringPool_.add(node);
+    stringPool_.add(node, allocator_);
   }
 
   template <typename TAdaptedString>
@@ -107,11 +114,30 @@ class ResourceManager {
     StringNode::destroy(node, allocator_);
   }
 
-  void dereferenceString(const char* s) {
-    stringPool_.dereference(s, allocator_);
+  void dereferenceString(StringNode* node) {
+    stringPool_.dereference(node, allocator_);
+  }
+
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+  // Indexes are a cache kept beside the document: a lookup builds one (from
+  // a const document too), and a failed allocation only means no index
+  ObjectIndex* getObjectIndex(SlotId object) const {
+    return objectIndexes_.get(object);
+  }
+
+  ObjectIndex* createObjectIndex(SlotId object, size_t capacity) const {
+    return objectIndexes_.create(object, capacity, allocator_);
   }
 
+  void dropObjectIndex(SlotId object) const {
+    objectIndexes_.remove(object, allocator_);
+  }
+#endif
+
   void clear() {
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+    objectIndexes_.clear(allocator_);
+#endif
     variantPools_.clear(allocator_);
     overflowed_ = false;
     stringPool_.clear(allocator_);
@@ -126,6 +152,9 @@ class ResourceManager {
   bool overflowed_;
   StringPool stringPool_;
   MemoryPoolList<SlotData> variantPools_;
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+  mutable ObjectIndexList objectIndexes_;
+#endif
 };
 
 ARDUINOJSON_END_PRIVATE_NAMESPACE
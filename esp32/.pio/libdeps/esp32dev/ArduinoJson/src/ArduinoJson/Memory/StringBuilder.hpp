@@ -6,6 +6,8 @@
 
 #include <ArduinoJson/Memory/ResourceManager.hpp>
 
+#include <string.h>  // memcpy
+
 ARDUINOJSON_BEGIN_PRIVATE_NAMESPACE
 
 class StringBuilder {
@@ -54,8 +56,15 @@ class StringBuilder {
   }
 
   void append(const char* s, size_t n) {
-    while (n-- > 0)  // TODO: memcpy
-      append(*s++);
+    if (node_ && size_ + n > node_->length) {
+      size_t capacity = size_ * 2U + 1;
+      node_ = resources_->resizeString(node_, capacity < size_ + n ? size_ + n
+                                                                   : capacity);
+    }
+    if (node_) {
+      memcpy(node_->data + size_, s, n);
+      size_ += n;
+    }
   }
 
   void append(char c) {
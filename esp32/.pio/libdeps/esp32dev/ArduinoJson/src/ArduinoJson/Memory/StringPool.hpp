@@ -12,6 +12,11 @@
 
 ARDUINOJSON_BEGIN_PRIVATE_NAMESPACE
 
+// The strings of a document, each stored once and reference counted.
+// Past a few strings they go in a hash table (open addressing, linear
+// probing, null for an empty bucket) so that add() doesn't compare them all.
+// The others, and any that didn't fit because the table couldn't grow, are
+// in a linked list through StringNode::next.
 class StringPool {
  public:
   StringPool() = default;
@@ -20,10 +25,15 @@ class StringPool {
 
   ~StringPool() {
     ARDUINOJSON_ASSERT(strings_ == nullptr);
+    ARDUINOJSON_ASSERT(table_ == nullptr);
   }
 
   friend void swap(StringPool& a, StringPool& b) {
     swap_(a.strings_, b.strings_);
+    swap_(a.listed_, b.listed_);
+    swap_(a.table_, b.table_);
+    swap_(a.capacity_, b.capacity_);
+    swap_(a.indexed_, b.indexed_);
   }
 
   void clear(Allocator* allocator) {
@@ -32,12 +42,26 @@ class StringPool {
       strings_ = node->next;
       StringNode::destroy(node, allocator);
     }
+    listed_ = 0;
+    for (size_t i = 0; i < capacity_; i++) {
+      if (table_[i])
+        StringNode::destroy(table_[i], allocator);
+    }
+    if (table_)
+      allocator->deallocate(table_);
+    table_ = nullptr;
+    capacity_ = 0;
+    indexed_ = 0;
   }
 
   size_t size() const {
     size_t total = 0;
     for (auto node = strings_; node; node = node->next)
       total += sizeofString(node->length);
+    for (size_t i = 0; i < capacity_; i++) {
+      if (table_[i])
+        total += sizeofString(table_[i]->length);
+    }
     return total;
   }
 
@@ -59,18 +83,33 @@ class StringPool {
 
     stringGetChars(str, node->data, n);
     node->data[n] = 0;  // force NUL terminator
-    add(node);
+    add(node, allocator);
     return node;
   }
 
-  void add(StringNode* node) {
+  void add(StringNode* node, Allocator* allocator) {
     ARDUINOJSON_ASSERT(node != nullptr);
-    node->next = strings_;
-    strings_ = node;
+    if (listed_ >= indexThreshold || (table_ && full()))
+      grow(allocator);  // on failure, the node goes in the list
+    if (table_ && !full()) {
+      insert(node);
+    } else {
+      node->next = strings_;
+      strings_ = node;
+      listed_++;
+    }
   }
 
   template <typename TAdaptedString>
   StringNode* get(const TAdaptedString& str) const {
+    if (table_) {
+      size_t mask = capacity_ - 1;
+      for (size_t i = stringHash(str) & mask; table_[i]; i = (i + 1) & mask) {
+        auto node = table_[i];
+        if (stringEquals(str, adaptString(node->data, node->length)))
+          return node;
+      }
+    }
     for (auto node = strings_; node; node = node->next) {
       if (stringEquals(str, adaptString(node->data, node->length)))
         return node;
@@ -78,25 +117,113 @@ class StringPool {
     return nullptr;
   }
 
-  void dereference(const char* s, Allocator* allocator) {
+  void dereference(StringNode* node, Allocator* allocator) {
+    ARDUINOJSON_ASSERT(node != nullptr);
+    if (--node->references != 0)
+      return;
+    if (!removeFromTable(node))
+      removeFromList(node);
+    StringNode::destroy(node, allocator);
+  }
+
+ private:
+  // Below this many strings, comparing them all is as fast as hashing
+  static const size_t indexThreshold = 8;
+
+  static size_t hashOf(const StringNode* node) {
+    return stringHash(adaptString(node->data, node->length));
+  }
+
+  // Keeps the load factor at or below 3/4
+  bool full() const {
+    return (indexed_ + 1) * 4 > capacity_ * 3;
+  }
+
+  void insert(StringNode* node) {
+    size_t mask = capacity_ - 1;
+    size_t i = hashOf(node) & mask;
+    while (table_[i])
+      i = (i + 1) & mask;
+    table_[i] = node;
+    indexed_++;
+  }
+
+  // Rehashes everything, listed strings included, into a bigger table
+  void grow(Allocator* allocator) {
+    size_t capacity = capacity_ ? capacity_ : 4 * indexThreshold;
+    while ((indexed_ + listed_ + 1) * 4 > capacity * 3)
+      capacity *= 2;
+    auto table = reinterpret_cast<StringNode**>(
+        allocator->allocate(capacity * sizeof(StringNode*)));
+    if (!table)
+      return;
+    for (size_t i = 0; i < capacity; i++)
+      table[i] = nullptr;
+
+    auto oldTable = table_;
+    auto oldCapacity = capacity_;
+    table_ = table;
+    capacity_ = capacity;
+    indexed_ = 0;
+    for (size_t i = 0; i < oldCapacity; i++) {
+      if (oldTable[i])
+        insert(oldTable[i]);
+    }
+    if (oldTable)
+      allocator->deallocate(oldTable);
+    while (strings_) {
+      auto node = strings_;
+      strings_ = node->next;
+      insert(node);
+    }
+    listed_ = 0;
+  }
+
+  bool removeFromTable(StringNode* node) {
+    if (!table_)
+      return false;
+    size_t mask = capacity_ - 1;
+    size_t i = hashOf(node) & mask;
+    while (table_[i] != node) {
+      if (!table_[i])
+        return false;
+      i = (i + 1) & mask;
+    }
+
+    // Shift back the entries that probed past this bucket, so that every
+    // string stays reachable from its home bucket without tombstones
+    for (size_t j = (i + 1) & mask; table_[j]; j = (j + 1) & mask) {
+      size_t home = hashOf(table_[j]) & mask;
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+        table_[i] = table_[j];
+        i = j;
+      }
+    }
+    table_[i] = nullptr;
+    indexed_--;
+    return true;
+  }
+
+  void removeFromList(StringNode* node) {
     StringNode* prev = nullptr;
-    for (auto node = strings_; node; node = node->next) {
-      if (node->data == s) {
-        if (--node->references == 0) {
-          if (prev)
-            prev->next = node->next;
-          else
-            strings_ = node->next;
-          StringNode::destroy(node, allocator);
-        }
+    for (auto it = strings_; it; it = it->next) {
+      if (it == node) {
+        if (prev)
+          prev->next = it->next;
+        else
+          strings_ = it->next;
+        listed_--;
         return;
       }
-      prev = node;
+      prev = it;
     }
   }
 
- private:
-  StringNode* strings_ = nullptr;
+  StringNode* strings_ = nullptr;  // not in the table
+  size_t listed_ = 0;
+  StringNode** table_ = nullptr;
+  size_t capacity_ = 0;  // a power of two, or 0 before the table is needed
+  size_t indexed_ = 0;
 };
 
 ARDUINOJSON_END_PRIVATE_NAMESPACE
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <ArduinoJson/Collection/CollectionData.hpp>
+#include <ArduinoJson/Memory/ObjectIndex.hpp>
 
 ARDUINOJSON_BEGIN_PRIVATE_NAMESPACE
 
@@ -65,6 +66,17 @@ class ObjectData : public CollectionData {
  private:
   template <typename TAdaptedString>
   iterator findKey(TAdaptedString key, const ResourceManager* resources) const;
+
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+  template <typename TAdaptedString>
+  iterator findIndexedKey(ObjectIndex* index, TAdaptedString key,
+                          const ResourceManager* resources) const;
+
+  ObjectIndex* updateIndex(const ResourceManager* resources) const;
+
+  static bool indexKey(ObjectIndex* index, SlotId keyId,
+                       const ResourceManager* resources);
+#endif
 };
 
 ARDUINOJSON_END_PRIVATE_NAMESPACE
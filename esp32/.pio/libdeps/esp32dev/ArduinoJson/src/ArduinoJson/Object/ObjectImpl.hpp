@@ -34,14 +34,100 @@ inline ObjectData::iterator ObjectData::findKey(
     TAdaptedString key, const ResourceManager* resources) const {
   if (key.isNull())
     return iterator();
-  bool isKey = true;
-  for (auto it = createIterator(resources); !it.done(); it.next(resources)) {
-    if (isKey && stringEquals(key, adaptString(it->asString())))
-      return it;
-    isKey = !isKey;
+
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+  if (resources->getObjectIndex(head())) {
+    auto index = updateIndex(resources);
+    if (index)
+      return findIndexedKey(index, key, resources);
+  }
+#endif
+
+  size_t compared = 0;
+  auto it = createIterator(resources);
+  while (!it.done()) {
+    if (stringEquals(key, adaptString(it->asString())))
+      break;
+    compared++;
+    it.next(resources);  // skip the value
+    it.next(resources);
+  }
+
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+  if (compared >= ARDUINOJSON_OBJECT_INDEX_THRESHOLD)
+    updateIndex(resources);  // for the next lookup
+#endif
+  return it;
+}
+
+#if ARDUINOJSON_ENABLE_OBJECT_INDEX
+template <typename TAdaptedString>
+inline ObjectData::iterator ObjectData::findIndexedKey(
+    ObjectIndex* index, TAdaptedString key,
+    const ResourceManager* resources) const {
+  size_t mask = index->capacity - 1;
+  for (size_t i = stringHash(key) & mask;; i = (i + 1) & mask) {
+    SlotId id = index->buckets[i];
+    if (id == NULL_SLOT)
+      return iterator();
+    auto slot = resources->getVariant(id);
+    if (stringEquals(key, adaptString(slot->asString())))
+      return iterator(slot, id);
+  }
+}
+
+// Brings the object's index up to date with the pairs appended since the
+// last lookup, creating or growing it as needed.
+// Returns null if the index can't cover every key (out of memory).
+inline ObjectIndex* ObjectData::updateIndex(
+    const ResourceManager* resources) const {
+  auto index = resources->getObjectIndex(head());
+  SlotId next = head();
+  if (index) {
+    if (index->lastValue == tail())
+      return index;
+    next = resources->getVariant(index->lastValue)->next();
+  }
+
+  while (next != NULL_SLOT) {
+    if (!index || index->full()) {
+      // Start over in a table at most half full, to keep the probes short
+      size_t needed =
+          2 * (size(resources) + ARDUINOJSON_OBJECT_INDEX_THRESHOLD);
+      size_t capacity = index ? index->capacity * 2 : 1;
+      while (capacity < needed)
+        capacity *= 2;
+      if (index)
+        resources->dropObjectIndex(head());
+      index = resources->createObjectIndex(head(), capacity);
+      if (!index)
+        return nullptr;
+      next = head();
+    }
+
+    if (!indexKey(index, next, resources))
+      return nullptr;  // key not set yet (addPair() in the deserializer)
+    index->lastValue = resources->getVariant(next)->next();
+    next = resources->getVariant(index->lastValue)->next();
   }
-  return iterator();
+
+  return index;
+}
+
+inline bool ObjectData::indexKey(ObjectIndex* index, SlotId keyId,
+                                 const ResourceManager* resources) {
+  auto key = resources->getVariant(keyId)->asString();
+  if (key.isNull())
+    return false;
+  size_t mask = index->capacity - 1;
+  size_t i = stringHash(adaptString(key)) & mask;
+  while (index->buckets[i] != NULL_SLOT)
+    i = (i + 1) & mask;
+  index->buckets[i] = keyId;
+  index->count++;
+  return true;
 }
+#endif
 
 template <typename TAdaptedString>
 inline void ObjectData::removeMember(TAdaptedString key,
@@ -8,6 +8,8 @@
 #include <ArduinoJson/Strings/Adapters/RamString.hpp>
 #include <ArduinoJson/Strings/Adapters/StringObject.hpp>
 
+#include <stdint.h>  // uint32_t
+
 #if ARDUINOJSON_ENABLE_PROGMEM
 #  include <ArduinoJson/Strings/Adapters/FlashString.hpp>
 #endif
@@ -69,4 +71,16 @@ static void stringGetChars(TAdaptedString s, char* p, size_t n) {
   }
 }
 
+// FNV-1a over the characters, for hash tables of strings
+template <typename TAdaptedString>
+inline uint32_t stringHash(TAdaptedString s) {
+  uint32_t hash = 2166136261u;
+  size_t n = s.size();
+  for (size_t i = 0; i < n; i++) {
+    hash ^= static_cast<unsigned char>(s[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
 ARDUINOJSON_END_PRIVATE_NAMESPACE
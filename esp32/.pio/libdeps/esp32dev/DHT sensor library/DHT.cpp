@@ -25,6 +25,17 @@
 
 #include "DHT.h"
 
+#ifdef DHT_USE_RMT
+#include <DHTFrame.h>
+#include <driver/rmt.h>
+#include <esp_timer.h>
+
+// Channels are taken from the top so RMT transmitters (LED strips) that
+// start at channel 0 keep theirs.
+static int8_t nextRmtChannel = RMT_CHANNEL_MAX - 1;
+#define CAPTURE_TIMEOUT 50 /**< ms; a frame takes ~5 ms after the start signal */
+#endif
+
 #define MIN_INTERVAL 2000 /**< min interval value */
 #define TIMEOUT                                                                \
   UINT32_MAX /**< Used programmatically for timeout.                           \
@@ -52,6 +63,13 @@ DHT::DHT(uint8_t pin, uint8_t type, uint8_t count) {
                                        // reading pulses from DHT sensor.
   // Note that count is now ignored as the DHT reading algorithm adjusts itself
   // based on the speed of the processor.
+  _lastresult = false;
+#ifdef DHT_USE_RMT
+  _rmtChannel = -1;
+  _capturing = false;
+  _capturestart = 0;
+  _startTimer = nullptr;
+#endif
 }
 
 /*!
@@ -70,6 +88,36 @@ void DHT::begin(uint8_t usec) {
   DEBUG_PRINT("DHT max clock cycles: ");
   DEBUG_PRINTLN(_maxcycles, DEC);
   pullTime = usec;
+
+#ifdef DHT_USE_RMT
+  if (_rmtChannel < 0 && nextRmtChannel >= 0) {
+    rmt_channel_t channel = (rmt_channel_t)nextRmtChannel;
+    rmt_config_t config = RMT_DEFAULT_CONFIG_RX((gpio_num_t)_pin, channel);
+    config.clk_div = 80; // 1 us per tick
+    config.rx_config.filter_en = true;
+    config.rx_config.filter_ticks_thresh = 250; // APB cycles: drop < ~3 us glitches
+    config.rx_config.idle_threshold = 200; // 200 us without an edge ends the frame
+    if (rmt_config(&config) == ESP_OK &&
+        rmt_driver_install(channel, 1024, 0) == ESP_OK) {
+      esp_timer_create_args_t args = {};
+      args.callback = endStartSignal;
+      args.arg = this;
+      args.name = "dht";
+      if (esp_timer_create(&args, (esp_timer_handle_t *)&_startTimer) ==
+          ESP_OK) {
+        _rmtChannel = nextRmtChannel--;
+      }
+    }
+    if (_rmtChannel < 0) {
+      DEBUG_PRINTLN(F("DHT: no RMT channel, using the blocking read"));
+    }
+  }
+  if (_rmtChannel >= 0) {
+    // First frame is ready a few ms from now
+    startCapture();
+    _lastreadtime = millis();
+  }
+#endif
 }
 
 /*!
@@ -229,6 +277,18 @@ float DHT::computeHeatIndex(float temperature, float percentHumidity,
  *	@return float value
  */
 bool DHT::read(bool force) {
+#ifdef DHT_USE_RMT
+  if (_rmtChannel >= 0) {
+    collectCapture();
+    uint32_t now = millis();
+    if (!_capturing && (force || (now - _lastreadtime) >= MIN_INTERVAL)) {
+      _lastreadtime = now;
+      startCapture();
+    }
+    return _lastresult;
+  }
+#endif
+
   // Check if sensor was read less than two seconds ago and return early
   // to use last reading.
   uint32_t currenttime = millis();
@@ -388,3 +448,90 @@ uint32_t DHT::expectPulse(bool level) {
 
   return count;
 }
+
+#ifdef DHT_USE_RMT
+/*!
+ *  @brief  Pull the data line low for the start signal; endStartSignal()
+ *          releases it from a timer and arms the RMT receiver.
+ */
+void DHT::startCapture() {
+  rmt_channel_t channel = (rmt_channel_t)_rmtChannel;
+  RingbufHandle_t ring = nullptr;
+  rmt_get_ringbuf_handle(channel, &ring);
+  size_t size = 0;
+  void *stale;
+  while (ring && (stale = xRingbufferReceive(ring, &size, 0)) != nullptr) {
+    vRingbufferReturnItem(ring, stale); // left over from a timed-out frame
+  }
+
+  pinMode(_pin, OUTPUT);
+  digitalWrite(_pin, LOW);
+  uint64_t startMicros = (_type == DHT22 || _type == DHT21) ? 1100  // "at least 1ms"
+                                                            : 20000; // "at least 18ms"
+  esp_timer_start_once((esp_timer_handle_t)_startTimer, startMicros);
+  _capturing = true;
+  _capturestart = millis();
+}
+
+/*!
+ *  @brief  Timer callback: release the line and start recording edges.
+ *  @param  arg
+ *          the DHT instance
+ */
+void DHT::endStartSignal(void *arg) {
+  DHT *self = (DHT *)arg;
+  gpio_num_t pin = (gpio_num_t)self->_pin;
+  rmt_set_gpio((rmt_channel_t)self->_rmtChannel, RMT_MODE_RX, pin, false);
+  gpio_set_pull_mode(pin, GPIO_PULLUP_ONLY);
+  rmt_rx_start((rmt_channel_t)self->_rmtChannel, true);
+}
+
+/*!
+ *  @brief  Decode the frame if the receiver has finished one. Returns
+ *          immediately while the capture is still in flight.
+ */
+void DHT::collectCapture() {
+  if (!_capturing)
+    return;
+  rmt_channel_t channel = (rmt_channel_t)_rmtChannel;
+  RingbufHandle_t ring = nullptr;
+  rmt_get_ringbuf_handle(channel, &ring);
+  size_t size = 0;
+  rmt_item32_t *items =
+      ring ? (rmt_item32_t *)xRingbufferReceive(ring, &size, 0) : nullptr;
+  if (!items) {
+    if (millis() - _capturestart < CAPTURE_TIMEOUT)
+      return;
+    rmt_rx_stop(channel);
+    _capturing = false;
+    DEBUG_PRINTLN(F("DHT timeout waiting for frame."));
+    _lastresult = false;
+    return;
+  }
+
+  DHTPulse pulses[DHT_FRAME_MAX_PULSES];
+  size_t count = 0;
+  for (size_t i = 0; i < size / sizeof(rmt_item32_t) &&
+                     count + 2 <= DHT_FRAME_MAX_PULSES;
+       i++) {
+    pulses[count++] = DHTPulse{(uint8_t)items[i].level0,
+                               (uint16_t)items[i].duration0};
+    pulses[count++] = DHTPulse{(uint8_t)items[i].level1,
+                               (uint16_t)items[i].duration1};
+  }
+  vRingbufferReturnItem(ring, items);
+  rmt_rx_stop(channel);
+  _capturing = false;
+
+  uint8_t frame[5];
+  DHTFrameStatus status = dhtDecodeFrame(pulses, count, frame);
+  if (status != DHT_FRAME_OK) {
+    DEBUG_PRINT(F("DHT frame error: "));
+    DEBUG_PRINTLN(dhtFrameStatusName(status));
+    _lastresult = false;
+    return;
+  }
+  memcpy(data, frame, sizeof(frame));
+  _lastresult = true;
+}
+#endif
@@ -40,6 +40,13 @@
   {} /**< Debug Print Line Placeholder if Debug is disabled */
 #endif
 
+/* On the ESP32 the frame is captured by the RMT receiver instead of by
+ * spinning on digitalRead() with interrupts off. Define DHT_BLOCKING_READ to
+ * get the original busy-wait driver back. */
+#if defined(ESP32) && !defined(DHT_BLOCKING_READ)
+#define DHT_USE_RMT 1 /**< Asynchronous RMT capture */
+#endif
+
 /* Define types of sensors. */
 static const uint8_t DHT11{11};  /**< DHT TYPE 11 */
 static const uint8_t DHT12{12};  /**< DHY TYPE 12 */
@@ -87,6 +94,20 @@ private:
   uint8_t pullTime; // Time (in usec) to pull up data line before reading
 
   uint32_t expectPulse(bool level);
+
+#ifdef DHT_USE_RMT
+  // read() never blocks: it decodes the frame the RMT receiver captured since
+  // the last call and starts the next capture, so it returns the most recent
+  // completed reading (at most one read interval old).
+  int8_t _rmtChannel;
+  bool _capturing;
+  uint32_t _capturestart;
+  void *_startTimer; // esp_timer_handle_t ending the start signal
+
+  void startCapture();
+  void collectCapture();
+  static void endStartSignal(void *arg);
+#endif
 };
 
 /*!
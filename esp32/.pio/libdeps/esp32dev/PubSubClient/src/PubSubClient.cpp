@@ -17,6 +17,7 @@ PubSubClient::PubSubClient() {
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 
 PubSubClient::PubSubClient(Client& client) {
@@ -27,6 +28,7 @@ PubSubClient::PubSubClient(Client& client) {
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client) {
@@ -38,6 +40,7 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client) {
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
@@ -48,6 +51,7 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client, Stream
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
     this->_state = MQTT_DISCONNECTED;
@@ -59,6 +63,7 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATUR
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
@@ -70,6 +75,7 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATUR
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client) {
@@ -81,6 +87,7 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client) {
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
@@ -91,6 +98,7 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client, Stream& s
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
     this->_state = MQTT_DISCONNECTED;
@@ -102,6 +110,7 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE,
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
@@ -113,6 +122,7 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE,
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 
 PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client) {
@@ -124,6 +134,7 @@ PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client) {
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
@@ -134,6 +145,7 @@ PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client, St
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
     this->_state = MQTT_DISCONNECTED;
@@ -145,6 +157,7 @@ PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGN
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
@@ -156,10 +169,46 @@ PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGN
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    initDefaults();
 }
 
 PubSubClient::~PubSubClient() {
   free(this->buffer);
+  for (int i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+    free(this->inflight[i].packet);
+  }
+  for (int i = 0; i < MQTT_MAX_TOPIC_ALIASES; i++) {
+    free(this->aliases[i].topic);
+  }
+}
+
+void PubSubClient::initDefaults() {
+    for (int i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+        this->inflight[i].packet = NULL;
+        this->inflight[i].capacity = 0;
+        this->inflight[i].msgId = 0;
+        this->inflight[i].alias = 0;
+        this->inflight[i].onAck = NULL;
+    }
+    for (int i = 0; i < MQTT_MAX_TOPIC_ALIASES; i++) {
+        this->aliases[i].topic = NULL;
+        this->aliases[i].announced = false;
+    }
+    this->mqttVersion = MQTT_VERSION;
+    this->receiveMaximum = MQTT_RECEIVE_MAXIMUM;
+    this->serverReceiveMaximum = 0xFFFF;
+    this->serverAliasMaximum = 0;
+    this->serverMaximumPacket = 0;
+    this->streaming = NULL;
+    this->retryInterval = MQTT_RETRY_INTERVAL;
+    memset(&this->qos1, 0, sizeof(this->qos1));
+    this->lastId = 0;
+    this->nextMsgId = 1;
+    this->chunkCallback = NULL;
+    this->vectoredWrite = NULL;
+    this->loopBudget = MQTT_LOOP_BUDGET;
+    this->loopPackets = 0;
+    this->awaitingConnack = false;
 }
 
 boolean PubSubClient::connect(const char *id) {
@@ -179,6 +228,23 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
 }
 
 boolean PubSubClient::connect(const char *id, const char *user, const char *pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage, boolean cleanSession) {
+    if (!beginConnect(id,user,pass,willTopic,willQos,willRetain,willMessage,cleanSession)) {
+        return false;
+    }
+    while (connecting()) {
+        if (pollConnect()) {
+            return true;
+        }
+    }
+    return connected();
+}
+
+boolean PubSubClient::beginConnect(const char *id, const char *user, const char *pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage, boolean cleanSession) {
+    if (this->awaitingConnack) {
+        // Starting over: the broker may still answer the earlier CONNECT
+        this->awaitingConnack = false;
+        _client->stop();
+    }
     if (!connected()) {
         int result = 0;
 
@@ -194,20 +260,34 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
         }
 
         if (result == 1) {
+            // Ids still awaiting PUBACK are skipped by nextPacketId()
             nextMsgId = 1;
+            if (this->streaming) {
+                this->streaming->msgId = 0;  // connection lost mid-message
+                this->streaming = NULL;
+            }
+            // What the last broker allowed does not carry over
+            this->serverReceiveMaximum = 0xFFFF;
+            this->serverAliasMaximum = 0;
+            this->serverMaximumPacket = 0;
+            for (int i = 0; i < MQTT_MAX_TOPIC_ALIASES; i++) {
+                this->aliases[i].announced = false;
+            }
+            boolean v5 = this->mqttVersion == MQTT_VERSION_5;
             // Leave room in the buffer for header and variable length field
             uint16_t length = MQTT_MAX_HEADER_SIZE;
             unsigned int j;
 
-#if MQTT_VERSION == MQTT_VERSION_3_1
-            uint8_t d[9] = {0x00,0x06,'M','Q','I','s','d','p', MQTT_VERSION};
-#define MQTT_HEADER_VERSION_LENGTH 9
-#elif MQTT_VERSION == MQTT_VERSION_3_1_1
-            uint8_t d[7] = {0x00,0x04,'M','Q','T','T',MQTT_VERSION};
-#define MQTT_HEADER_VERSION_LENGTH 7
-#endif
-            for (j = 0;j<MQTT_HEADER_VERSION_LENGTH;j++) {
-                this->buffer[length++] = d[j];
+            if (this->mqttVersion == MQTT_VERSION_3_1) {
+                const uint8_t d[9] = {0x00,0x06,'M','Q','I','s','d','p', MQTT_VERSION_3_1};
+                for (j = 0;j<9;j++) {
+                    this->buffer[length++] = d[j];
+                }
+            } else {
+                const uint8_t d[7] = {0x00,0x04,'M','Q','T','T',this->mqttVersion};
+                for (j = 0;j<7;j++) {
+                    this->buffer[length++] = d[j];
+                }
             }
 
             uint8_t v;
@@ -232,10 +312,33 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
             this->buffer[length++] = ((this->keepAlive) >> 8);
             this->buffer[length++] = ((this->keepAlive) & 0xFF);
 
+            if (v5) {
+                // Receive Maximum and, unless larger packets can be taken
+                // in chunks or streamed, Maximum Packet Size: the broker
+                // drops what would not fit instead of sending it
+                boolean limit = !this->chunkCallback && !this->stream;
+                this->buffer[length++] = limit ? 8 : 3;
+                this->buffer[length++] = 0x21;
+                this->buffer[length++] = (this->receiveMaximum >> 8);
+                this->buffer[length++] = (this->receiveMaximum & 0xFF);
+                if (limit) {
+                    this->buffer[length++] = 0x27;
+                    this->buffer[length++] = 0;
+                    this->buffer[length++] = 0;
+                    this->buffer[length++] = (this->bufferSize >> 8);
+                    this->buffer[length++] = (this->bufferSize & 0xFF);
+                }
+            }
+
             CHECK_STRING_LENGTH(length,id)
             length = writeString(id,this->buffer,length);
             if (willTopic) {
-                CHECK_STRING_LENGTH(length,willTopic)
+                if (v5) {
+                    CHECK_STRING_LENGTH(length+1,willTopic)
+                    this->buffer[length++] = 0;  // no will properties
+                } else {
+                    CHECK_STRING_LENGTH(length,willTopic)
+                }
                 length = writeString(willTopic,this->buffer,length);
                 CHECK_STRING_LENGTH(length,willMessage)
                 length = writeString(willMessage,this->buffer,length);
@@ -250,32 +353,15 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
                 }
             }
 
-            write(MQTTCONNECT,this->buffer,length-MQTT_MAX_HEADER_SIZE);
-
-            lastInActivity = lastOutActivity = millis();
-
-            while (!_client->available()) {
-                unsigned long t = millis();
-                if (t-lastInActivity >= ((int32_t) this->socketTimeout*1000UL)) {
-                    _state = MQTT_CONNECTION_TIMEOUT;
-                    _client->stop();
-                    return false;
-                }
+            if (!write(MQTTCONNECT,this->buffer,length-MQTT_MAX_HEADER_SIZE)) {
+                _state = MQTT_CONNECT_FAILED;
+                _client->stop();
+                return false;
             }
-            uint8_t llen;
-            uint32_t len = readPacket(&llen);
 
-            if (len == 4) {
-                if (buffer[3] == 0) {
-                    lastInActivity = millis();
-                    pingOutstanding = false;
-                    _state = MQTT_CONNECTED;
-                    return true;
-                } else {
-                    _state = buffer[3];
-                }
-            }
-            _client->stop();
+            lastInActivity = lastOutActivity = millis();
+            this->awaitingConnack = true;
+            return true;
         } else {
             _state = MQTT_CONNECT_FAILED;
         }
@@ -284,6 +370,147 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
     return true;
 }
 
+boolean PubSubClient::pollConnect() {
+    if (!this->awaitingConnack) {
+        return connected();
+    }
+    if (!_client->available()) {
+        if (!_client->connected()) {
+            this->awaitingConnack = false;
+            _state = MQTT_CONNECTION_LOST;
+        } else if (millis()-lastInActivity >= ((int32_t) this->socketTimeout*1000UL)) {
+            this->awaitingConnack = false;
+            _state = MQTT_CONNECTION_TIMEOUT;
+            _client->stop();
+        }
+        return false;
+    }
+    this->awaitingConnack = false;
+    uint8_t llen;
+    uint32_t len = readPacket(&llen);
+
+    if (readConnack(len, llen)) {
+        lastInActivity = millis();
+        pingOutstanding = false;
+        _state = MQTT_CONNECTED;
+        // Anything still unacknowledged from the last session
+        retransmitInflight(lastInActivity, true);
+        return true;
+    }
+    _client->stop();
+    return false;
+}
+
+boolean PubSubClient::connecting() {
+    return this->awaitingConnack;
+}
+
+// Size of the value of MQTT 5 property id at p, at most avail bytes; 0 if
+// the id is unknown or the value runs past avail
+static uint32_t propertyValueLength(uint8_t id, const uint8_t* p, uint32_t avail) {
+    uint32_t n = 0;
+    switch (id) {
+        case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+            n = 1;
+            break;
+        case 0x13: case 0x21: case 0x22: case 0x23:
+            n = 2;
+            break;
+        case 0x02: case 0x11: case 0x18: case 0x27:
+            n = 4;
+            break;
+        case 0x0B:
+            // Subscription Identifier, a variable byte integer
+            do {
+                n++;
+            } while (n <= avail && n < 4 && (p[n-1] & 0x80));
+            break;
+        case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F:
+            n = avail < 2 ? avail + 1 : 2 + ((p[0] << 8) | p[1]);
+            break;
+        case 0x26:
+            // User Property: two strings
+            n = avail < 2 ? avail + 1 : 2 + ((p[0] << 8) | p[1]);
+            n = avail < n + 2 ? avail + 1 : n + 2 + ((p[n] << 8) | p[n+1]);
+            break;
+        default:
+            return 0;
+    }
+    return n > avail ? 0 : n;
+}
+
+// Checks the CONNACK in the buffer. At MQTT 5 it also takes the broker's
+// Receive Maximum, Topic Alias Maximum and Maximum Packet Size
+boolean PubSubClient::readConnack(uint32_t len, uint8_t llen) {
+    if ((this->buffer[0]&0xF0) != MQTTCONNACK || len < (uint32_t)llen + 3) {
+        return false;
+    }
+    uint8_t code = this->buffer[llen+2];
+    if (this->mqttVersion != MQTT_VERSION_5 || len == 4) {
+        // A broker without MQTT 5 answers a v5 CONNECT with a 3.1.1
+        // CONNACK refusing the protocol version
+        if (len != 4) {
+            return false;
+        }
+        if (code != 0) {
+            _state = code;
+            return false;
+        }
+        return this->mqttVersion != MQTT_VERSION_5;
+    }
+    if (code != 0) {
+        switch (code) {
+            case 0x84: _state = MQTT_CONNECT_BAD_PROTOCOL; break;
+            case 0x85: _state = MQTT_CONNECT_BAD_CLIENT_ID; break;
+            case 0x86: _state = MQTT_CONNECT_BAD_CREDENTIALS; break;
+            case 0x87: _state = MQTT_CONNECT_UNAUTHORIZED; break;
+            case 0x88: case 0x89: _state = MQTT_CONNECT_UNAVAILABLE; break;
+            default: _state = code; break;  // other v5 reason codes as they are
+        }
+        return false;
+    }
+    uint32_t pos = llen + 3;
+    uint32_t end = pos + skipProperties(this->buffer + pos, len - pos);
+    if (end == pos) {
+        return false;
+    }
+    while (this->buffer[pos] & 0x80) {
+        pos++;
+    }
+    pos++;
+    while (pos < end) {
+        uint8_t id = this->buffer[pos++];
+        const uint8_t* value = this->buffer + pos;
+        uint32_t n = propertyValueLength(id, value, end - pos);
+        if (n == 0) {
+            return false;
+        }
+        if (id == 0x21) {
+            this->serverReceiveMaximum = (value[0] << 8) | value[1];
+        } else if (id == 0x22) {
+            this->serverAliasMaximum = (value[0] << 8) | value[1];
+        } else if (id == 0x27) {
+            this->serverMaximumPacket = ((uint32_t)value[0] << 24) | ((uint32_t)value[1] << 16) | (value[2] << 8) | value[3];
+        }
+        pos += n;
+    }
+    return this->serverReceiveMaximum != 0;
+}
+
+uint32_t PubSubClient::skipProperties(const uint8_t* buf, uint32_t length) {
+    uint32_t value = 0;
+    uint32_t multiplier = 1;
+    uint32_t n = 0;
+    do {
+        if (n == length || n == 4) {
+            return 0;
+        }
+        value += (buf[n] & 127) * multiplier;
+        multiplier <<= 7;
+    } while (buf[n++] & 128);
+    return value > length - n ? 0 : n + value;
+}
+
 // reads a byte into result
 boolean PubSubClient::readByte(uint8_t * result) {
    uint32_t previousMillis = millis();
@@ -316,8 +543,12 @@ uint32_t PubSubClient::readPacket(uint8_t* lengthLength) {
     uint32_t multiplier = 1;
     uint32_t length = 0;
     uint8_t digit = 0;
-    uint16_t skip = 0;
+    uint32_t skip = 0;
     uint32_t start = 0;
+    // v5: the stream is not given the properties ahead of the payload
+    bool properties = isPublish && this->mqttVersion == MQTT_VERSION_5;
+    uint32_t propertyLength = 0;
+    uint32_t propertyMultiplier = 1;
 
     do {
         if (len == 5) {
@@ -338,6 +569,11 @@ uint32_t PubSubClient::readPacket(uint8_t* lengthLength) {
         if(!readByte(this->buffer, &len)) return 0;
         if(!readByte(this->buffer, &len)) return 0;
         skip = (this->buffer[*lengthLength+1]<<8)+this->buffer[*lengthLength+2];
+        if (this->chunkCallback && (uint32_t)len - 2 + length > this->bufferSize) {
+            // Does not fit: hand it over in chunks instead of dropping it
+            readChunked(length - 2, skip);
+            return 0;
+        }
         start = 2;
         if (this->buffer[0]&MQTTQOS1) {
             // skip message id
@@ -350,7 +586,17 @@ uint32_t PubSubClient::readPacket(uint8_t* lengthLength) {
         if(!readByte(&digit)) return 0;
         if (this->stream) {
             if (isPublish && idx-*lengthLength-2>skip) {
-                this->stream->write(digit);
+                if (properties) {
+                    skip++;
+                    propertyLength += (digit & 127) * propertyMultiplier;
+                    propertyMultiplier <<= 7;
+                    if ((digit & 128) == 0) {
+                        skip += propertyLength;
+                        properties = false;
+                    }
+                } else {
+                    this->stream->write(digit);
+                }
             }
         }
 
@@ -367,6 +613,103 @@ uint32_t PubSubClient::readPacket(uint8_t* lengthLength) {
     return len;
 }
 
+// reads size bytes into result, in as few client reads as possible
+boolean PubSubClient::readBytes(uint8_t* result, uint16_t size) {
+    uint32_t previousMillis = millis();
+    while (size) {
+        int avail = _client->available();
+        if (avail <= 0) {
+            yield();
+            if (millis() - previousMillis >= ((int32_t) this->socketTimeout * 1000)) {
+                return false;
+            }
+            continue;
+        }
+        int got = _client->read(result, avail < size ? avail : size);
+        if (got > 0) {
+            result += got;
+            size -= got;
+            previousMillis = millis();
+        }
+    }
+    return true;
+}
+
+// Reads the rest of a PUBLISH that does not fit in the buffer: the topic
+// goes to the front of the buffer as a C string and the payload is passed
+// to chunkCallback through the space left after it, one piece at a time
+void PubSubClient::readChunked(uint32_t remaining, uint16_t topicLength) {
+    boolean qos1 = (this->buffer[0]&0x06) == MQTTQOS1;
+    uint16_t idLength = qos1 ? 2 : 0;
+    uint8_t digit;
+    if (remaining < (uint32_t)topicLength + idLength ||
+        (uint32_t)topicLength + 1 + MQTT_MIN_CHUNK_SIZE > this->bufferSize) {
+        // Topic too long to keep: skip the packet
+        for (uint32_t i = 0; i < remaining; i++) {
+            if (!readByte(&digit)) {
+                break;
+            }
+        }
+        return;
+    }
+
+    char* topic = (char*)this->buffer;
+    uint8_t id[2] = {0, 0};
+    if (!readBytes(this->buffer, topicLength) || (qos1 && !readBytes(id, 2))) {
+        _client->stop();
+        return;
+    }
+    topic[topicLength] = 0;
+    uint32_t total = remaining - topicLength - idLength;
+
+    if (this->mqttVersion == MQTT_VERSION_5) {
+        // Read past the properties; only the payload goes to the callback
+        uint32_t length = 0;
+        uint32_t multiplier = 1;
+        uint8_t n = 0;
+        do {
+            if (n == 4 || n == total || !readByte(&digit)) {
+                _client->stop();
+                return;
+            }
+            length += (digit & 127) * multiplier;
+            multiplier <<= 7;
+            n++;
+        } while (digit & 128);
+        if (length > total - n) {
+            _client->stop();
+            return;
+        }
+        for (uint32_t i = 0; i < length; i++) {
+            if (!readByte(&digit)) {
+                _client->stop();
+                return;
+            }
+        }
+        total -= n + length;
+    }
+
+    uint8_t* chunk = this->buffer + topicLength + 1;
+    uint16_t room = this->bufferSize - topicLength - 1;
+    for (uint32_t offset = 0; offset < total;) {
+        uint16_t n = total - offset < room ? total - offset : room;
+        if (!readBytes(chunk, n)) {
+            // Lost the rest of the message and with it the packet framing
+            _client->stop();
+            return;
+        }
+        chunkCallback(topic, chunk, n, offset, total);
+        offset += n;
+    }
+    lastInActivity = millis();
+
+    if (qos1) {
+        uint8_t puback[4] = {MQTTPUBACK, 2, id[0], id[1]};
+        _client->write(puback, 4);
+        lastOutActivity = lastInActivity;
+    }
+}
+
 boolean PubSubClient::loop() {
     if (connected()) {
         unsigned long t = millis();
@@ -384,9 +727,14 @@ boolean PubSubClient::loop() {
                 pingOutstanding = true;
             }
         }
-        if (_client->available()) {
+        retransmitInflight(t, false);
+        // Handle every packet already buffered, up to the budget, instead of
+        // one per call: a burst of N commands no longer needs N wakeups
+        this->loopPackets = 0;
+        while (this->loopPackets < this->loopBudget && this->_state == MQTT_CONNECTED && _client->available()) {
             uint8_t llen;
             uint16_t len = readPacket(&llen);
+            this->loopPackets++;
             uint16_t msgId = 0;
             uint8_t *payload;
             if (len > 0) {
@@ -398,22 +746,29 @@ boolean PubSubClient::loop() {
                         memmove(this->buffer+llen+2,this->buffer+llen+3,tl); /* move topic inside buffer 1 byte to front */
                         this->buffer[llen+2+tl] = 0; /* end the topic as a 'C' string with \x00 */
                         char *topic = (char*) this->buffer+llen+2;
+                        boolean qos1 = (this->buffer[0]&0x06) == MQTTQOS1;
+                        uint16_t pos = llen+3+tl;
                         // msgId only present for QOS>0
-                        if ((this->buffer[0]&0x06) == MQTTQOS1) {
-                            msgId = (this->buffer[llen+3+tl]<<8)+this->buffer[llen+3+tl+1];
-                            payload = this->buffer+llen+3+tl+2;
-                            callback(topic,payload,len-llen-3-tl-2);
-
+                        if (qos1) {
+                            msgId = (this->buffer[pos]<<8)+this->buffer[pos+1];
+                            pos += 2;
+                        }
+                        if (this->mqttVersion == MQTT_VERSION_5) {
+                            uint32_t skipped = pos < len ? skipProperties(this->buffer+pos, len-pos) : 0;
+                            if (skipped == 0) {
+                                continue;  // malformed: neither delivered nor acknowledged
+                            }
+                            pos += skipped;
+                        }
+                        payload = this->buffer+pos;
+                        callback(topic,payload,len-pos);
+                        if (qos1) {
                             this->buffer[0] = MQTTPUBACK;
                             this->buffer[1] = 2;
                             this->buffer[2] = (msgId >> 8);
                             this->buffer[3] = (msgId & 0xFF);
                             _client->write(this->buffer,4);
                             lastOutActivity = t;
-
-                        } else {
-                            payload = this->buffer+llen+3+tl;
-                            callback(topic,payload,len-llen-3-tl);
                         }
                     }
                 } else if (type == MQTTPINGREQ) {
@@ -422,6 +777,14 @@ boolean PubSubClient::loop() {
                     _client->write(this->buffer,2);
                 } else if (type == MQTTPINGRESP) {
                     pingOutstanding = false;
+                } else if (type == MQTTPUBACK && len >= 4) {
+                    // v5 reason codes from 0x80 up: the broker refused it
+                    completeInflight((this->buffer[2]<<8)+this->buffer[3], len == 4 || this->buffer[4] < 0x80);
+                } else if (type == MQTTDISCONNECT) {
+                    // v5 brokers say why they close the connection
+                    _state = MQTT_CONNECTION_LOST;
+                    _client->stop();
+                    return false;
                 }
             } else if (!connected()) {
                 // readPacket has closed the connection
@@ -430,6 +793,7 @@ boolean PubSubClient::loop() {
         }
         return true;
     }
+    this->loopPackets = 0;
     return false;
 }
 
@@ -446,29 +810,83 @@ boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigne
 }
 
 boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained) {
-    if (connected()) {
-        if (this->bufferSize < MQTT_MAX_HEADER_SIZE + 2+strnlen(topic, this->bufferSize) + plength) {
-            // Too long
+    MqttIovec part = {payload, plength};
+    return publishParts(topic, &part, 1, retained, 0);
+}
+
+boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained, uint8_t qos, MQTT_PUBACK_SIGNATURE, const MqttProperties* properties) {
+    MqttIovec part = {payload, plength};
+    return publishParts(topic, &part, 1, retained, qos, onAck, properties);
+}
+
+boolean PubSubClient::publishParts(const char* topic, const MqttIovec* parts, uint8_t count, boolean retained, uint8_t qos, MQTT_PUBACK_SIGNATURE, const MqttProperties* properties) {
+    if (qos > 1 || count >= MQTT_MAX_IOVEC || !connected()) {
+        return false;
+    }
+    unsigned int plength = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        plength += parts[i].length;
+    }
+    if (qos == 1) {
+        // The slot keeps its own copy for retransmission; send that
+        InFlight* slot = reserveInflight(topic, plength, retained, onAck, properties);
+        if (!slot) {
             return false;
         }
-        // Leave room in the buffer for header and variable length field
-        uint16_t length = MQTT_MAX_HEADER_SIZE;
-        length = writeString(topic,this->buffer,length);
-
-        // Add payload
-        uint16_t i;
-        for (i=0;i<plength;i++) {
-            this->buffer[length++] = payload[i];
+        for (uint8_t i = 0; i < count; i++) {
+            memcpy(slot->packet + slot->fill, parts[i].base, parts[i].length);
+            slot->fill += parts[i].length;
         }
+        boolean sent = sendInflight(slot);
+        commitInflight(slot);
+        // Kept even if the write fell short: it goes again on retry or reconnect
+        return sent;
+    }
+    MqttIovec all[MQTT_MAX_IOVEC];
+    if (!publishHeader(topic, plength, retained, &all[0], properties)) {
+        return false;
+    }
+    memcpy(all + 1, parts, count * sizeof(MqttIovec));
+    return writeParts(all, count + 1);
+}
 
-        // Write the header
-        uint8_t header = MQTTPUBLISH;
-        if (retained) {
-            header |= 1;
-        }
-        return write(header,this->buffer,length-MQTT_MAX_HEADER_SIZE);
+// Bytes in the variable byte integer encoding of value
+static uint8_t variableLength(uint32_t value) {
+    return value < 128 ? 1 : value < 16384 ? 2 : value < 2097152 ? 3 : 4;
+}
+
+boolean PubSubClient::publishHeader(const char* topic, unsigned int plength, boolean retained, MqttIovec* part, const MqttProperties* properties) {
+    size_t tlen = strnlen(topic, this->bufferSize);
+    boolean v5 = this->mqttVersion == MQTT_VERSION_5;
+    uint16_t alias = v5 ? topicAlias(topic) : 0;
+    if (alias && this->aliases[alias-1].announced) {
+        tlen = 0;  // the broker has the topic under the alias already
     }
-    return false;
+    uint32_t plen = v5 ? propertiesLength(properties) + (alias ? 3 : 0) : 0;
+    uint32_t header = 2 + tlen + (v5 ? variableLength(plen) + plen : 0);
+    if (this->bufferSize < MQTT_MAX_HEADER_SIZE + header || header + plength > 0xFFFF) {
+        // Too long
+        return false;
+    }
+    if (this->serverMaximumPacket && 1 + variableLength(header + plength) + header + plength > this->serverMaximumPacket) {
+        return false;
+    }
+    // Leave room in the buffer for header and variable length field
+    uint16_t length = writeString(tlen ? topic : "", this->buffer, MQTT_MAX_HEADER_SIZE);
+    if (v5) {
+        length = writeProperties(properties, alias, this->buffer, length);
+    }
+    if (alias) {
+        this->aliases[alias-1].announced = true;
+    }
+    uint8_t fixed = MQTTPUBLISH;
+    if (retained) {
+        fixed |= 1;
+    }
+    size_t hlen = buildHeader(fixed, this->buffer, length - MQTT_MAX_HEADER_SIZE + plength);
+    part->base = this->buffer + MQTT_MAX_HEADER_SIZE - hlen;
+    part->length = length - MQTT_MAX_HEADER_SIZE + hlen;
+    return true;
 }
 
 boolean PubSubClient::publish_P(const char* topic, const char* payload, boolean retained) {
@@ -476,84 +894,339 @@ boolean PubSubClient::publish_P(const char* topic, const char* payload, boolean
 }
 
 boolean PubSubClient::publish_P(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained) {
-    uint8_t llen = 0;
-    uint8_t digit;
-    unsigned int rc = 0;
-    uint16_t tlen;
-    unsigned int pos = 0;
-    unsigned int i;
-    uint8_t header;
-    unsigned int len;
-    int expectedLength;
-
-    if (!connected()) {
+#ifdef MQTT_PROGMEM_ADDRESSABLE
+    return publish(topic, payload, plength, retained);
+#else
+    MqttIovec header;
+    if (!connected() || !publishHeader(topic, plength, retained, &header)) {
         return false;
     }
-
-    tlen = strnlen(topic, this->bufferSize);
-
-    header = MQTTPUBLISH;
-    if (retained) {
-        header |= 1;
+    if (!writeParts(&header, 1)) {
+        return false;
     }
-    this->buffer[pos++] = header;
-    len = plength + 2 + tlen;
-    do {
-        digit = len  & 127; //digit = len %128
-        len >>= 7; //len = len / 128
-        if (len > 0) {
-            digit |= 0x80;
+    // Copy the payload out of flash a buffer at a time, not byte by byte
+    for (unsigned int pos = 0; pos < plength;) {
+        unsigned int n = plength - pos < this->bufferSize ? plength - pos : this->bufferSize;
+        for (unsigned int i = 0; i < n; i++) {
+            this->buffer[i] = pgm_read_byte_near(payload + pos + i);
         }
-        this->buffer[pos++] = digit;
-        llen++;
-    } while(len>0);
-
-    pos = writeString(topic,this->buffer,pos);
-
-    rc += _client->write(this->buffer,pos);
-
-    for (i=0;i<plength;i++) {
-        rc += _client->write((char)pgm_read_byte_near(payload + i));
+        if (!writeSliced(this->buffer, n)) {
+            return false;
+        }
+        pos += n;
     }
-
     lastOutActivity = millis();
-
-    expectedLength = 1 + llen + 2 + tlen + plength;
-
-    return (rc == expectedLength);
+    return true;
+#endif
 }
 
 boolean PubSubClient::beginPublish(const char* topic, unsigned int plength, boolean retained) {
     if (connected()) {
         // Send the header and variable length field
-        uint16_t length = MQTT_MAX_HEADER_SIZE;
-        length = writeString(topic,this->buffer,length);
-        uint8_t header = MQTTPUBLISH;
-        if (retained) {
-            header |= 1;
-        }
-        size_t hlen = buildHeader(header, this->buffer, plength+length-MQTT_MAX_HEADER_SIZE);
-        uint16_t rc = _client->write(this->buffer+(MQTT_MAX_HEADER_SIZE-hlen),length-(MQTT_MAX_HEADER_SIZE-hlen));
-        lastOutActivity = millis();
-        return (rc == (length-(MQTT_MAX_HEADER_SIZE-hlen)));
+        MqttIovec header;
+        return publishHeader(topic, plength, retained, &header) && writeParts(&header, 1);
     }
     return false;
 }
 
+boolean PubSubClient::beginPublish(const char* topic, unsigned int plength, boolean retained, uint8_t qos, MQTT_PUBACK_SIGNATURE) {
+    if (qos == 0) {
+        return beginPublish(topic, plength, retained);
+    }
+    if (qos > 1 || !connected() || this->streaming) {
+        return false;
+    }
+    InFlight* slot = reserveInflight(topic, plength, retained, onAck);
+    if (!slot) {
+        return false;
+    }
+    boolean sent = sendInflight(slot);
+    this->streaming = slot;
+    return sent;
+}
+
 int PubSubClient::endPublish() {
- return 1;
+    if (this->streaming) {
+        InFlight* slot = this->streaming;
+        this->streaming = NULL;
+        if (slot->fill != slot->start + slot->length) {
+            slot->msgId = 0;  // fewer bytes than announced: nothing to resend
+            return 0;
+        }
+        commitInflight(slot);
+    }
+    return 1;
 }
 
 size_t PubSubClient::write(uint8_t data) {
-    lastOutActivity = millis();
-    return _client->write(data);
+    return write(&data, 1);
 }
 
 size_t PubSubClient::write(const uint8_t *buffer, size_t size) {
+    if (this->streaming) {
+        InFlight* slot = this->streaming;
+        size_t room = slot->start + slot->length - slot->fill;
+        if (size > room) {
+            size = room;
+        }
+        memcpy(slot->packet + slot->fill, buffer, size);
+        slot->fill += size;
+    }
     lastOutActivity = millis();
     return _client->write(buffer,size);
 }
 
+uint16_t PubSubClient::nextPacketId() {
+    do {
+        nextMsgId++;
+        if (nextMsgId == 0) {
+            nextMsgId = 1;
+        }
+    } while (findInflight(nextMsgId));
+    return nextMsgId;
+}
+
+PubSubClient::InFlight* PubSubClient::findInflight(uint16_t msgId) {
+    for (int i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+        if (this->inflight[i].msgId == msgId) {
+            return &this->inflight[i];
+        }
+    }
+    return NULL;
+}
+
+// Claims a free slot and encodes the fixed header, topic, packet id and
+// (v5) properties into it; the caller appends the payload. The topic alias
+// is not stored: sendInflight() adds it.
+PubSubClient::InFlight* PubSubClient::reserveInflight(const char* topic, unsigned int plength, boolean retained, MQTT_PUBACK_SIGNATURE, const MqttProperties* properties) {
+    size_t tlen = strnlen(topic, this->bufferSize);
+    boolean v5 = this->mqttVersion == MQTT_VERSION_5;
+    uint32_t plen = v5 ? propertiesLength(properties) : 0;
+    uint32_t remaining = 2 + tlen + 2 + (v5 ? variableLength(plen) + plen : 0) + plength;
+    if (MQTT_MAX_HEADER_SIZE + remaining > 0xFFFF) {
+        return NULL;
+    }
+    InFlight* slot = findInflight(0);
+    if (!slot || inflightCount() >= this->serverReceiveMaximum) {
+        qos1.windowFull++;
+        return NULL;
+    }
+    uint16_t alias = v5 ? topicAlias(topic) : 0;
+    // Longest form on the wire: the topic and its alias, announced
+    uint32_t wire = alias ? remaining + 3 + variableLength(plen + 3) - variableLength(plen) : remaining;
+    if (wire > 0xFFFF) {
+        alias = 0;
+        wire = remaining;
+    }
+    if (this->serverMaximumPacket && 1 + variableLength(wire) + wire > this->serverMaximumPacket) {
+        return NULL;
+    }
+    uint16_t need = MQTT_MAX_HEADER_SIZE + remaining;
+    if (slot->capacity < need) {
+        uint8_t* grown = (uint8_t*)realloc(slot->packet, need);
+        if (!grown) {
+            return NULL;
+        }
+        slot->packet = grown;
+        slot->capacity = need;
+    }
+    uint16_t msgId = nextPacketId();
+    uint16_t pos = writeString(topic, slot->packet, MQTT_MAX_HEADER_SIZE);
+    slot->packet[pos++] = (msgId >> 8);
+    slot->packet[pos++] = (msgId & 0xFF);
+    if (v5) {
+        slot->properties = pos;
+        pos = writeProperties(properties, 0, slot->packet, pos);
+    }
+    slot->alias = alias;
+    uint8_t header = MQTTPUBLISH | MQTTQOS1;
+    if (retained) {
+        header |= 1;
+    }
+    size_t hlen = buildHeader(header, slot->packet, remaining);
+    slot->start = MQTT_MAX_HEADER_SIZE - hlen;
+    slot->length = hlen + remaining;
+    slot->fill = pos;
+    slot->msgId = msgId;
+    slot->retries = 0;
+    slot->committed = false;
+    slot->onAck = onAck;
+    lastId = msgId;
+    return slot;
+}
+
+void PubSubClient::commitInflight(InFlight* slot) {
+    slot->committed = true;
+    slot->sentAt = millis();
+    qos1.published++;
+}
+
+void PubSubClient::completeInflight(uint16_t msgId, boolean delivered) {
+    InFlight* slot = findInflight(msgId);
+    if (!slot || !slot->committed) {
+        return;  // late PUBACK for a message already given up
+    }
+    // Free the slot before the callback so it can publish again
+    slot->msgId = 0;
+    if (delivered) {
+        qos1.acked++;
+    } else {
+        qos1.expired++;
+    }
+    if (slot->onAck) {
+        slot->onAck(msgId, delivered);
+    }
+}
+
+// Resends unacknowledged publishes with DUP set: those past the retry
+// interval, or all of them right after a reconnect
+void PubSubClient::retransmitInflight(unsigned long now, boolean all) {
+    for (int i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+        InFlight* slot = &this->inflight[i];
+        if (slot->msgId == 0 || !slot->committed) {
+            continue;
+        }
+        if (!all && now - slot->sentAt < this->retryInterval) {
+            continue;
+        }
+        if (slot->retries >= MQTT_MAX_RETRIES) {
+            completeInflight(slot->msgId, false);
+            continue;
+        }
+        slot->packet[slot->start] |= MQTTDUP;
+        sendInflight(slot);
+        lastOutActivity = now;
+        slot->sentAt = now;
+        slot->retries++;
+        qos1.retransmits++;
+    }
+}
+
+boolean PubSubClient::sendInflight(InFlight* slot) {
+    uint8_t* packet = slot->packet;
+    uint16_t alias = slot->alias;
+    if (alias == 0 || alias > this->serverAliasMaximum || this->mqttVersion != MQTT_VERSION_5) {
+        MqttIovec all = {packet + slot->start, (size_t)(slot->fill - slot->start)};
+        return writeParts(&all, 1);
+    }
+    boolean announced = this->aliases[alias-1].announced;
+    uint16_t pos = slot->start + 1;
+    while (packet[pos] & 0x80) {
+        pos++;
+    }
+    pos++;
+    // pos: topic length; slot->properties: the property length
+    uint16_t tlen = (packet[pos] << 8) | packet[pos+1];
+    uint32_t plen = 0;
+    uint32_t multiplier = 1;
+    uint16_t props = slot->properties;
+    do {
+        plen += (packet[props] & 127) * multiplier;
+        multiplier <<= 7;
+    } while (packet[props++] & 128);
+
+    uint8_t id[4] = {0, 0, packet[slot->properties-2], packet[slot->properties-1]};
+    uint8_t property[8];
+    uint16_t alen = writeVariable(plen + 3, property, 0);
+    property[alen++] = 0x23;
+    property[alen++] = (alias >> 8);
+    property[alen++] = (alias & 0xFF);
+    uint32_t remaining = slot->start + slot->length - pos - (props - slot->properties) + alen;
+    if (announced) {
+        remaining -= tlen;
+    }
+    uint8_t fixed[MQTT_MAX_HEADER_SIZE];
+    size_t hlen = buildHeader(packet[slot->start], fixed, remaining);
+
+    MqttIovec parts[4];
+    parts[0].base = fixed + MQTT_MAX_HEADER_SIZE - hlen;
+    parts[0].length = hlen;
+    if (announced) {
+        parts[1].base = id;
+        parts[1].length = 4;
+    } else {
+        parts[1].base = packet + pos;
+        parts[1].length = slot->properties - pos;
+    }
+    parts[2].base = property;
+    parts[2].length = alen;
+    parts[3].base = packet + props;
+    parts[3].length = slot->fill - props;
+    this->aliases[alias-1].announced = true;
+    return writeParts(parts, parts[3].length ? 4 : 3);
+}
+
+uint16_t PubSubClient::topicAlias(const char* topic) {
+    if (this->mqttVersion != MQTT_VERSION_5 || *topic == 0) {
+        return 0;
+    }
+    for (uint16_t i = 0; i < MQTT_MAX_TOPIC_ALIASES && i < this->serverAliasMaximum; i++) {
+        TopicAlias* alias = &this->aliases[i];
+        if (alias->topic == NULL) {
+            size_t length = strlen(topic);
+            alias->topic = (char*)malloc(length + 1);
+            if (!alias->topic) {
+                return 0;
+            }
+            memcpy(alias->topic, topic, length + 1);
+            alias->announced = false;
+            return i + 1;
+        }
+        if (strcmp(alias->topic, topic) == 0) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+uint32_t PubSubClient::propertiesLength(const MqttProperties* properties) {
+    if (!properties) {
+        return 0;
+    }
+    uint32_t length = properties->messageExpiry ? 5 : 0;
+    for (uint8_t i = 0; i < properties->userCount; i++) {
+        length += 5 + strlen(properties->user[i].key) + strlen(properties->user[i].value);
+    }
+    return length;
+}
+
+uint16_t PubSubClient::writeProperties(const MqttProperties* properties, uint16_t alias, uint8_t* buf, uint16_t pos) {
+    pos = writeVariable(propertiesLength(properties) + (alias ? 3 : 0), buf, pos);
+    if (alias) {
+        buf[pos++] = 0x23;
+        buf[pos++] = (alias >> 8);
+        buf[pos++] = (alias & 0xFF);
+    }
+    if (!properties) {
+        return pos;
+    }
+    if (properties->messageExpiry) {
+        buf[pos++] = 0x02;
+        buf[pos++] = (properties->messageExpiry >> 24);
+        buf[pos++] = (properties->messageExpiry >> 16) & 0xFF;
+        buf[pos++] = (properties->messageExpiry >> 8) & 0xFF;
+        buf[pos++] = (properties->messageExpiry & 0xFF);
+    }
+    for (uint8_t i = 0; i < properties->userCount; i++) {
+        buf[pos++] = 0x26;
+        pos = writeString(properties->user[i].key, buf, pos);
+        pos = writeString(properties->user[i].value, buf, pos);
+    }
+    return pos;
+}
+
+uint16_t PubSubClient::writeVariable(uint32_t value, uint8_t* buf, uint16_t pos) {
+    do {
+        uint8_t digit = value & 127;
+        value >>= 7;
+        if (value > 0) {
+            digit |= 0x80;
+        }
+        buf[pos++] = digit;
+    } while (value > 0);
+    return pos;
+}
+
 size_t PubSubClient::buildHeader(uint8_t header, uint8_t* buf, uint16_t length) {
     uint8_t lenBuf[4];
     uint8_t llen = 0;
@@ -602,11 +1275,73 @@ boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
 #endif
 }
 
+boolean PubSubClient::writeSliced(const uint8_t* buf, size_t length) {
+#ifdef MQTT_MAX_TRANSFER_SIZE
+    while (length > 0) {
+        size_t bytesToWrite = (length > MQTT_MAX_TRANSFER_SIZE)?MQTT_MAX_TRANSFER_SIZE:length;
+        if (_client->write(buf,bytesToWrite) != bytesToWrite) {
+            return false;
+        }
+        length -= bytesToWrite;
+        buf += bytesToWrite;
+    }
+    return true;
+#else
+    return _client->write(buf,length) == length;
+#endif
+}
+
+// Sends the parts back to back: as one vectored write when setWritev() was
+// given one, gathered into a single client write when they fit the buffer,
+// otherwise one client write per part
+boolean PubSubClient::writeParts(MqttIovec* parts, uint8_t count) {
+    size_t total = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        total += parts[i].length;
+    }
+    size_t sent = 0;
+    MqttIovec gathered;
+#ifndef MQTT_MAX_TRANSFER_SIZE
+    if (this->vectoredWrite) {
+        sent = this->vectoredWrite(parts, count);
+        if (sent > total) {
+            sent = total;
+        }
+    } else if (count > 1 && total <= this->bufferSize) {
+        size_t pos = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            memmove(this->buffer + pos, parts[i].base, parts[i].length);
+            pos += parts[i].length;
+        }
+        gathered.base = this->buffer;
+        gathered.length = total;
+        parts = &gathered;
+        count = 1;
+    }
+#endif
+    // Whatever the vectored write did not take
+    boolean result = true;
+    for (uint8_t i = 0; i < count && result; i++) {
+        if (sent >= parts[i].length) {
+            sent -= parts[i].length;
+            continue;
+        }
+        result = writeSliced(parts[i].base + sent, parts[i].length - sent);
+        sent = 0;
+    }
+    lastOutActivity = millis();
+    return result;
+}
+
 boolean PubSubClient::subscribe(const char* topic) {
     return subscribe(topic, 0);
 }
 
 boolean PubSubClient::subscribe(const char* topic, uint8_t qos) {
+    return subscribe(topic, qos, 0);
+}
+
+boolean PubSubClient::subscribe(const char* topic, uint8_t qos, uint8_t options) {
     size_t topicLength = strnlen(topic, this->bufferSize);
     if (topic == 0) {
         return false;
@@ -614,20 +1349,28 @@ boolean PubSubClient::subscribe(const char* topic, uint8_t qos) {
     if (qos > 1) {
         return false;
     }
-    if (this->bufferSize < 9 + topicLength) {
+    boolean v5 = this->mqttVersion == MQTT_VERSION_5;
+    if (v5 && (options & MQTT_SUB_NO_LOCAL) && strncmp(topic, "$share/", 7) == 0) {
+        // A protocol error: the broker would close the connection
+        return false;
+    }
+    if (this->bufferSize < 9 + topicLength + (v5 ? 1 : 0)) {
         // Too long
         return false;
     }
     if (connected()) {
         // Leave room in the buffer for header and variable length field
         uint16_t length = MQTT_MAX_HEADER_SIZE;
-        nextMsgId++;
-        if (nextMsgId == 0) {
-            nextMsgId = 1;
-        }
+        nextPacketId();
         this->buffer[length++] = (nextMsgId >> 8);
         this->buffer[length++] = (nextMsgId & 0xFF);
+        if (v5) {
+            this->buffer[length++] = 0;  // no properties
+        }
         length = writeString((char*)topic, this->buffer,length);
+        if (v5) {
+            qos |= options & (MQTT_SUB_NO_LOCAL | MQTT_SUB_RETAIN_AS_PUBLISHED);
+        }
         this->buffer[length++] = qos;
         return write(MQTTSUBSCRIBE|MQTTQOS1,this->buffer,length-MQTT_MAX_HEADER_SIZE);
     }
@@ -639,18 +1382,19 @@ boolean PubSubClient::unsubscribe(const char* topic) {
     if (topic == 0) {
         return false;
     }
-    if (this->bufferSize < 9 + topicLength) {
+    boolean v5 = this->mqttVersion == MQTT_VERSION_5;
+    if (this->bufferSize < 9 + topicLength + (v5 ? 1 : 0)) {
         // Too long
         return false;
     }
     if (connected()) {
         uint16_t length = MQTT_MAX_HEADER_SIZE;
-        nextMsgId++;
-        if (nextMsgId == 0) {
-            nextMsgId = 1;
-        }
+        nextPacketId();
         this->buffer[length++] = (nextMsgId >> 8);
         this->buffer[length++] = (nextMsgId & 0xFF);
+        if (v5) {
+            this->buffer[length++] = 0;  // no properties
+        }
         length = writeString(topic, this->buffer,length);
         return write(MQTTUNSUBSCRIBE|MQTTQOS1,this->buffer,length-MQTT_MAX_HEADER_SIZE);
     }
@@ -662,6 +1406,7 @@ void PubSubClient::disconnect() {
     this->buffer[1] = 0;
     _client->write(this->buffer,2);
     _state = MQTT_DISCONNECTED;
+    this->awaitingConnack = false;
     _client->flush();
     _client->stop();
     lastInActivity = lastOutActivity = millis();
@@ -723,6 +1468,16 @@ PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
     return *this;
 }
 
+PubSubClient& PubSubClient::setChunkCallback(MQTT_CHUNK_SIGNATURE) {
+    this->chunkCallback = chunkCallback;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setWritev(MQTT_WRITEV_SIGNATURE) {
+    this->vectoredWrite = vectoredWrite;
+    return *this;
+}
+
 PubSubClient& PubSubClient::setClient(Client& client){
     this->_client = &client;
     return *this;
@@ -767,3 +1522,52 @@ PubSubClient& PubSubClient::setSocketTimeout(uint16_t timeout) {
     this->socketTimeout = timeout;
     return *this;
 }
+PubSubClient& PubSubClient::setRetryInterval(uint16_t ms) {
+    this->retryInterval = ms;
+    return *this;
+}
+PubSubClient& PubSubClient::setLoopBudget(uint16_t packets) {
+    this->loopBudget = packets ? packets : 1;
+    return *this;
+}
+PubSubClient& PubSubClient::setProtocolVersion(uint8_t version) {
+    if (version != this->mqttVersion) {
+        // Held packets are encoded for the old version: give them up
+        for (int i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+            if (this->inflight[i].msgId != 0 && this->inflight[i].committed) {
+                completeInflight(this->inflight[i].msgId, false);
+            }
+        }
+        this->mqttVersion = version;
+    }
+    return *this;
+}
+PubSubClient& PubSubClient::setReceiveMaximum(uint16_t messages) {
+    this->receiveMaximum = messages ? messages : 1;
+    return *this;
+}
+uint8_t PubSubClient::getProtocolVersion() {
+    return this->mqttVersion;
+}
+
+uint16_t PubSubClient::lastLoopPackets() {
+    return this->loopPackets;
+}
+
+uint16_t PubSubClient::lastPublishId() {
+    return this->lastId;
+}
+
+uint8_t PubSubClient::inflightCount() {
+    uint8_t count = 0;
+    for (int i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+        if (this->inflight[i].msgId != 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+const MqttQos1Stats& PubSubClient::qos1Stats() {
+    return this->qos1;
+}
@@ -14,8 +14,9 @@
 
 #define MQTT_VERSION_3_1      3
 #define MQTT_VERSION_3_1_1    4
+#define MQTT_VERSION_5        5
 
-// MQTT_VERSION : Pick the version
+// MQTT_VERSION : Pick the version. Override with setProtocolVersion()
 //#define MQTT_VERSION MQTT_VERSION_3_1
 #ifndef MQTT_VERSION
 #define MQTT_VERSION MQTT_VERSION_3_1_1
@@ -41,6 +42,62 @@
 //  pass the entire MQTT packet in each write call.
 //#define MQTT_MAX_TRANSFER_SIZE 80
 
+// MQTT_MAX_IOVEC : most pieces one publish hands to the network at once:
+//  the fixed header and topic plus up to MQTT_MAX_IOVEC - 1 payload parts
+#ifndef MQTT_MAX_IOVEC
+#define MQTT_MAX_IOVEC 8
+#endif
+
+// MQTT_PROGMEM_ADDRESSABLE : PROGMEM data can be read like RAM, so publish_P()
+//  passes it to the network without copying. True on the ESP32, which maps
+//  flash into the data address space.
+#if defined(ESP32) && !defined(MQTT_PROGMEM_ADDRESSABLE)
+#define MQTT_PROGMEM_ADDRESSABLE
+#endif
+
+// MQTT_MIN_CHUNK_SIZE : buffer space that must be left after the topic for a
+//  message that does not fit in the buffer to be passed to the chunk callback
+#ifndef MQTT_MIN_CHUNK_SIZE
+#define MQTT_MIN_CHUNK_SIZE 32
+#endif
+
+// MQTT_LOOP_BUDGET : most packets one loop() call handles when several are
+//  already buffered. Override with setLoopBudget()
+#ifndef MQTT_LOOP_BUDGET
+#define MQTT_LOOP_BUDGET 16
+#endif
+
+// MQTT_MAX_INFLIGHT : QoS 1 publishes that may await their PUBACK at once.
+//  publish(..., qos = 1) returns false while the window is full.
+#ifndef MQTT_MAX_INFLIGHT
+#define MQTT_MAX_INFLIGHT 8
+#endif
+
+// MQTT_RETRY_INTERVAL : ms before an unacknowledged QoS 1 publish is sent
+//  again with the DUP flag. Override with setRetryInterval()
+#ifndef MQTT_RETRY_INTERVAL
+#define MQTT_RETRY_INTERVAL 2000
+#endif
+
+// MQTT_MAX_RETRIES : retransmissions before a QoS 1 publish is given up and
+//  its callback told it was not delivered
+#ifndef MQTT_MAX_RETRIES
+#define MQTT_MAX_RETRIES 4
+#endif
+
+// MQTT_MAX_TOPIC_ALIASES : MQTT 5 only. Topics that get an alias, in the
+//  order they are first published; later ones always go in full. The broker's
+//  Topic Alias Maximum can lower it.
+#ifndef MQTT_MAX_TOPIC_ALIASES
+#define MQTT_MAX_TOPIC_ALIASES 8
+#endif
+
+// MQTT_RECEIVE_MAXIMUM : MQTT 5 only. QoS 1 messages the broker may send
+//  before it has our PUBACK for them. Override with setReceiveMaximum()
+#ifndef MQTT_RECEIVE_MAXIMUM
+#define MQTT_RECEIVE_MAXIMUM 8
+#endif
+
 // Possible values for client.state()
 #define MQTT_CONNECTION_TIMEOUT     -4
 #define MQTT_CONNECTION_LOST        -3
@@ -69,9 +126,14 @@
 #define MQTTDISCONNECT  14 << 4 // Client is Disconnecting
 #define MQTTReserved    15 << 4 // Reserved
 
+// MQTT 5 subscription options, for subscribe(topic, qos, options)
+#define MQTT_SUB_NO_LOCAL            0x04  // not sent our own publishes
+#define MQTT_SUB_RETAIN_AS_PUBLISHED 0x08  // keep the retain flag as published
+
 #define MQTTQOS0        (0 << 1)
 #define MQTTQOS1        (1 << 1)
 #define MQTTQOS2        (2 << 1)
+#define MQTTDUP         (1 << 3)
 
 // Maximum size of fixed header and variable length size header
 #define MQTT_MAX_HEADER_SIZE 5
@@ -83,6 +145,58 @@
 #define MQTT_CALLBACK_SIGNATURE void (*callback)(char*, uint8_t*, unsigned int)
 #endif
 
+// Called once per QoS 1 publish: delivered is true when its PUBACK arrived,
+// false when it was given up after MQTT_MAX_RETRIES retransmissions
+#if defined(ESP8266) || defined(ESP32)
+#define MQTT_PUBACK_SIGNATURE std::function<void(uint16_t msgId, boolean delivered)> onAck
+#else
+#define MQTT_PUBACK_SIGNATURE void (*onAck)(uint16_t msgId, boolean delivered)
+#endif
+
+// Receives a PUBLISH too large for the buffer piece by piece: length bytes
+// at offset of a total-byte payload, in order, the last one ending at total.
+// topic and chunk point into the client's buffer, so publishing from the
+// callback overwrites them.
+#if defined(ESP8266) || defined(ESP32)
+#define MQTT_CHUNK_SIGNATURE std::function<void(char* topic, uint8_t* chunk, unsigned int length, uint32_t offset, uint32_t total)> chunkCallback
+#else
+#define MQTT_CHUNK_SIGNATURE void (*chunkCallback)(char* topic, uint8_t* chunk, unsigned int length, uint32_t offset, uint32_t total)
+#endif
+
+// One piece of an outgoing packet, in the order it goes on the wire
+struct MqttIovec {
+    const uint8_t* base;
+    size_t length;
+};
+
+// Sends count parts as one submission to the socket (writev) and returns the
+// bytes taken; the client writes whatever is left the ordinary way
+#if defined(ESP8266) || defined(ESP32)
+#define MQTT_WRITEV_SIGNATURE std::function<size_t(const MqttIovec* parts, uint8_t count)> vectoredWrite
+#else
+#define MQTT_WRITEV_SIGNATURE size_t (*vectoredWrite)(const MqttIovec* parts, uint8_t count)
+#endif
+
+// MQTT 5 publish properties. Ignored at 3.1 / 3.1.1.
+struct MqttUserProperty {
+    const char* key;
+    const char* value;
+};
+
+struct MqttProperties {
+    uint32_t messageExpiry;          // seconds the broker keeps it; 0 = no expiry
+    const MqttUserProperty* user;
+    uint8_t userCount;
+};
+
+struct MqttQos1Stats {
+   uint32_t published;    // QoS 1 publishes sent the first time
+   uint32_t acked;
+   uint32_t retransmits;  // sent again with DUP (timeout or reconnect)
+   uint32_t expired;      // given up after MQTT_MAX_RETRIES
+   uint32_t windowFull;   // publishes refused because the window was full
+};
+
 #define CHECK_STRING_LENGTH(l,s) if (l+2+strnlen(s, this->bufferSize) > this->bufferSize) {_client->stop();return false;}
 
 class PubSubClient : public Print {
@@ -97,11 +211,20 @@ private:
    unsigned long lastInActivity;
    bool pingOutstanding;
    MQTT_CALLBACK_SIGNATURE;
+   MQTT_CHUNK_SIGNATURE;
+   MQTT_WRITEV_SIGNATURE;
    uint32_t readPacket(uint8_t*);
+   boolean readBytes(uint8_t* result, uint16_t size);
+   void readChunked(uint32_t remaining, uint16_t topicLength);
    boolean readByte(uint8_t * result);
    boolean readByte(uint8_t * result, uint16_t * index);
    boolean write(uint8_t header, uint8_t* buf, uint16_t length);
    uint16_t writeString(const char* string, uint8_t* buf, uint16_t pos);
+   boolean writeSliced(const uint8_t* buf, size_t length);
+   boolean writeParts(MqttIovec* parts, uint8_t count);
+   // Encodes the PUBLISH fixed header and topic into the buffer and points
+   // part at them; the payload is sent from where it is
+   boolean publishHeader(const char* topic, unsigned int plength, boolean retained, MqttIovec* part, const MqttProperties* properties = NULL);
    // Build up the header ready to send
    // Returns the size of the header
    // Note: the header is built at the end of the first MQTT_MAX_HEADER_SIZE bytes, so will start
@@ -112,6 +235,68 @@ private:
    uint16_t port;
    Stream* stream;
    int _state;
+
+   // QoS 1 publishes awaiting PUBACK. Each slot keeps the encoded packet so
+   // it can be resent as is; the buffers grow to the largest message sent
+   // through the slot and are reused, so steady state does not allocate.
+   struct InFlight {
+      uint8_t* packet;
+      uint16_t capacity;
+      uint16_t start;       // fixed header offset in packet
+      uint16_t length;      // bytes from start
+      uint16_t fill;        // end of the bytes written so far
+      uint16_t msgId;       // 0 = slot free
+      uint16_t properties;  // v5: offset of the property length in packet
+      uint16_t alias;       // v5: topic alias to send it with; 0 = none
+      uint8_t retries;
+      boolean committed;    // false while a beginPublish() is being written
+      unsigned long sentAt;
+      MQTT_PUBACK_SIGNATURE;
+   };
+   InFlight inflight[MQTT_MAX_INFLIGHT];
+   InFlight* streaming;    // QoS 1 beginPublish() in progress
+   uint16_t retryInterval;
+   MqttQos1Stats qos1;
+   uint16_t lastId;
+   uint16_t loopBudget;
+   uint16_t loopPackets;
+   boolean awaitingConnack;  // CONNECT sent by beginConnect(), no answer yet
+
+   // MQTT 5. Aliases keep their topic across reconnects and are announced
+   // again (sent with the topic) the first time they are used on each new
+   // connection.
+   struct TopicAlias {
+      char* topic;          // NULL = unused
+      boolean announced;    // broker knows it on this connection
+   };
+   uint8_t mqttVersion;
+   uint16_t receiveMaximum;
+   uint16_t serverReceiveMaximum;
+   uint16_t serverAliasMaximum;
+   uint32_t serverMaximumPacket;  // 0 = no limit
+   TopicAlias aliases[MQTT_MAX_TOPIC_ALIASES];
+   boolean readConnack(uint32_t len, uint8_t llen);
+   // Alias for topic (assigned on first use while any are left), 0 = none
+   uint16_t topicAlias(const char* topic);
+   // Bytes of the properties, not counting the property length
+   uint32_t propertiesLength(const MqttProperties* properties);
+   // Writes the property length and properties, plus a Topic Alias if alias
+   uint16_t writeProperties(const MqttProperties* properties, uint16_t alias, uint8_t* buf, uint16_t pos);
+   uint16_t writeVariable(uint32_t value, uint8_t* buf, uint16_t pos);
+   // Bytes in the property length and properties of a v5 packet at buf;
+   // 0 if they run past length
+   uint32_t skipProperties(const uint8_t* buf, uint32_t length);
+   // Writes what the slot holds so far; at v5 with the topic alias added,
+   // and the topic left out once the broker knows the alias
+   boolean sendInflight(InFlight* slot);
+
+   void initDefaults();
+   uint16_t nextPacketId();
+   InFlight* findInflight(uint16_t msgId);
+   InFlight* reserveInflight(const char* topic, unsigned int plength, boolean retained, MQTT_PUBACK_SIGNATURE, const MqttProperties* properties = NULL);
+   void commitInflight(InFlight* slot);
+   void completeInflight(uint16_t msgId, boolean delivered);
+   void retransmitInflight(unsigned long now, boolean all);
 public:
    PubSubClient();
    PubSubClient(Client& client);
@@ -134,19 +319,46 @@ public:
    PubSubClient& setServer(uint8_t * ip, uint16_t port);
    PubSubClient& setServer(const char * domain, uint16_t port);
    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+   // Messages larger than the buffer go here in buffer-sized chunks instead
+   // of being dropped; smaller ones still go to the regular callback
+   PubSubClient& setChunkCallback(MQTT_CHUNK_SIGNATURE);
+   // Publishes go out as one vectored write through this instead of being
+   // gathered in the buffer first. Only for a plain TCP client: the bytes
+   // bypass the Client object.
+   PubSubClient& setWritev(MQTT_WRITEV_SIGNATURE);
    PubSubClient& setClient(Client& client);
    PubSubClient& setStream(Stream& stream);
    PubSubClient& setKeepAlive(uint16_t keepAlive);
    PubSubClient& setSocketTimeout(uint16_t timeout);
+   PubSubClient& setRetryInterval(uint16_t ms);
+   PubSubClient& setLoopBudget(uint16_t packets);
+   // MQTT_VERSION_3_1, MQTT_VERSION_3_1_1 or MQTT_VERSION_5; used from the
+   // next connect(). A broker without MQTT 5 refuses the connect with
+   // state() MQTT_CONNECT_BAD_PROTOCOL. Changing it gives up the QoS 1
+   // messages still in flight (onAck gets delivered = false).
+   PubSubClient& setProtocolVersion(uint8_t version);
+   // MQTT 5: QoS 1 messages the broker may have unacknowledged towards us
+   PubSubClient& setReceiveMaximum(uint16_t messages);
 
    boolean setBufferSize(uint16_t size);
    uint16_t getBufferSize();
+   uint8_t getProtocolVersion();
 
    boolean connect(const char* id);
    boolean connect(const char* id, const char* user, const char* pass);
    boolean connect(const char* id, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage);
    boolean connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage);
    boolean connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage, boolean cleanSession);
+   // connect() in two steps that do not wait for the broker. beginConnect()
+   // opens the socket (taking as long as the Client's connect does) and
+   // sends CONNECT; false if either failed. pollConnect() then checks for
+   // the CONNACK without blocking: true once the broker has accepted, false
+   // while it has not answered yet or if the connect failed. connecting()
+   // tells the two apart; after the socket timeout the attempt fails with
+   // state() MQTT_CONNECTION_TIMEOUT.
+   boolean beginConnect(const char* id, const char* user, const char* pass, const char* willTopic = NULL, uint8_t willQos = 0, boolean willRetain = 0, const char* willMessage = NULL, boolean cleanSession = 1);
+   boolean pollConnect();
+   boolean connecting();
    void disconnect();
    boolean publish(const char* topic, const char* payload);
    boolean publish(const char* topic, const char* payload, boolean retained);
@@ -154,6 +366,17 @@ public:
    boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained);
    boolean publish_P(const char* topic, const char* payload, boolean retained);
    boolean publish_P(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained);
+   // QoS 0 or 1. A QoS 1 message is kept until its PUBACK arrives and resent
+   // with the DUP flag every retry interval (and right after a reconnect);
+   // onAck, if given, reports the outcome. Returns false if not connected,
+   // the window is full or the packet does not fit in 64 KB (or the broker's
+   // Maximum Packet Size). At MQTT 5 the window is also capped by the
+   // broker's Receive Maximum, and properties go with the message.
+   boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained, uint8_t qos, MQTT_PUBACK_SIGNATURE = NULL, const MqttProperties* properties = NULL);
+   // As above with the payload in count parts (fewer than MQTT_MAX_IOVEC),
+   // sent back to back without being joined first. Only the topic and
+   // properties have to fit in the buffer.
+   boolean publishParts(const char* topic, const MqttIovec* parts, uint8_t count, boolean retained, uint8_t qos = 0, MQTT_PUBACK_SIGNATURE = NULL, const MqttProperties* properties = NULL);
    // Start to publish a message.
    // This API:
    //   beginPublish(...)
@@ -163,6 +386,9 @@ public:
    // a new buffer and held in memory at one time
    // Returns 1 if the message was started successfully, 0 if there was an error
    boolean beginPublish(const char* topic, unsigned int plength, boolean retained);
+   // As above at QoS 0 or 1. Payload bytes written for a QoS 1 message are
+   // also copied into its in-flight slot for retransmission.
+   boolean beginPublish(const char* topic, unsigned int plength, boolean retained, uint8_t qos, MQTT_PUBACK_SIGNATURE = NULL);
    // Finish off this publish message (started with beginPublish)
    // Returns 1 if the packet was sent successfully, 0 if there was an error
    int endPublish();
@@ -173,11 +399,25 @@ public:
    virtual size_t write(const uint8_t *buffer, size_t size);
    boolean subscribe(const char* topic);
    boolean subscribe(const char* topic, uint8_t qos);
+   // With MQTT_SUB_* options (MQTT 5 only; ignored at 3.1 / 3.1.1). A topic
+   // of the form $share/<group>/<filter> is a shared subscription: the
+   // broker hands each message to one member of the group. No Local is not
+   // allowed on those.
+   boolean subscribe(const char* topic, uint8_t qos, uint8_t options);
    boolean unsubscribe(const char* topic);
    boolean loop();
+   // Packets the last loop() call took off the socket (at most the budget;
+   // when it equals the budget more may be waiting)
+   uint16_t lastLoopPackets();
    boolean connected();
    int state();
 
+   // Packet id of the last QoS 1 publish, for matching onAck calls
+   uint16_t lastPublishId();
+   // QoS 1 publishes awaiting PUBACK
+   uint8_t inflightCount();
+   const MqttQos1Stats& qos1Stats();
+
 };
 
 
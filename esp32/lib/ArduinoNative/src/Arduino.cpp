@@ -0,0 +1,338 @@
+/*
+  Arduino.cpp - host stand-in for the Arduino-ESP32 core.
+*/
+
+#include "Arduino.h"
+#include "NativeSim.h"
+
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+uint64_t clock_us = 0;
+uint64_t wake_at_us = UINT64_MAX;
+
+uint32_t cpu_scale = 0;
+bool cpu_charging = false;
+bool cpu_in_charge = false;  // chargeCpu() is moving the clock
+uint64_t cpu_mark_ns = 0;    // thread CPU time charged up to
+
+int pin_levels[64];
+uint8_t pin_modes[64];
+uint32_t pin_writes[64];
+uint64_t pin_changed_at[64];
+bool pins_initialised = false;
+
+struct PinIsr {
+  void (*fn)(void*);
+  void* arg;
+  int mode;
+};
+PinIsr pin_isrs[64];
+
+// Harness edges queued for a future virtual time, oldest first
+struct PinEdge {
+  uint64_t at;
+  uint8_t pin;
+  int level;
+};
+std::vector<PinEdge> pin_edges;
+
+uint8_t mac_address[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+
+float sensor_temperature = 25.0f;
+float sensor_humidity = 60.0f;
+bool sensor_failed = false;
+
+bool serial_echo = false;
+std::string serial_input;
+
+void (*restart_handler)() = nullptr;
+
+unsigned long random_state = 1;
+
+void initPins() {
+  if (pins_initialised) return;
+  for (int i = 0; i < 64; i++) pin_levels[i] = HIGH;
+  pins_initialised = true;
+}
+
+// A level change on a pin with an attached handler runs it right away, the
+// way the GPIO interrupt preempts whatever the firmware was doing.
+void setLevel(uint8_t pin, int level) {
+  initPins();
+  if (pin >= 64) return;
+  int old = pin_levels[pin];
+  pin_levels[pin] = level ? HIGH : LOW;
+  const PinIsr& isr = pin_isrs[pin];
+  if (!isr.fn || old == pin_levels[pin]) return;
+  bool rising = pin_levels[pin] == HIGH;
+  if (isr.mode == CHANGE || (isr.mode == RISING && rising) || (isr.mode == FALLING && !rising)) {
+    isr.fn(isr.arg);
+  }
+}
+
+// Every clock move goes through here so queued edges fire at their own time,
+// even in the middle of a delay() or a blocking network call.
+void advanceTo(uint64_t until) {
+  while (!pin_edges.empty() && pin_edges.front().at <= until) {
+    PinEdge edge = pin_edges.front();
+    pin_edges.erase(pin_edges.begin());
+    if (edge.at > clock_us) clock_us = edge.at;
+    setLevel(edge.pin, edge.level);
+  }
+  if (until > clock_us) clock_us = until;
+}
+
+uint64_t threadCpuNanos() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Adds the CPU time used since the last charge. Whole microseconds only;
+// the remainder is kept for the next call. An interrupt handler run by
+// advanceTo() reads the clock without charging again.
+void chargeCpu() {
+  if (!cpu_charging || cpu_in_charge) return;
+  uint64_t used_us = (threadCpuNanos() - cpu_mark_ns) / 1000ULL;
+  if (used_us == 0) return;
+  cpu_mark_ns += used_us * 1000ULL;
+  cpu_in_charge = true;
+  advanceTo(clock_us + used_us * cpu_scale);
+  cpu_in_charge = false;
+}
+
+void callPlainIsr(void* fn) { ((void (*)(void))fn)(); }
+
+}  // namespace
+
+namespace nativesim {
+
+uint64_t nowMicros() {
+  chargeCpu();
+  return clock_us;
+}
+void advanceMicros(uint64_t us) {
+  chargeCpu();
+  advanceTo(clock_us + us);
+}
+void resetClock() {
+  clock_us = 0;
+  pin_edges.clear();
+}
+
+void setCpuScale(uint32_t virtualMicrosPerHostMicro) { cpu_scale = virtualMicrosPerHostMicro; }
+
+void beginCpuCharge() {
+  if (cpu_scale == 0) return;
+  cpu_mark_ns = threadCpuNanos();
+  cpu_charging = true;
+}
+
+void endCpuCharge() {
+  chargeCpu();
+  cpu_charging = false;
+}
+
+void setWakeAt(uint64_t atMicros) { wake_at_us = atMicros; }
+
+bool idleMicros(uint64_t us) {
+  chargeCpu();
+  uint64_t until = clock_us + us;
+  uint64_t edge_at = pin_edges.empty() ? UINT64_MAX : pin_edges.front().at;
+  if (edge_at < until && edge_at <= wake_at_us) {
+    advanceTo(edge_at);  // a GPIO edge ends the sleep like an interrupt would
+    return true;
+  }
+  if (wake_at_us < until) {
+    advanceTo(wake_at_us);
+    wake_at_us = UINT64_MAX;
+    return true;
+  }
+  advanceTo(until);
+  return false;
+}
+
+void setPinLevel(uint8_t pin, int level) { setLevel(pin, level); }
+
+void schedulePinLevel(uint8_t pin, int level, uint64_t atMicros) {
+  if (atMicros <= clock_us) {
+    setLevel(pin, level);
+    return;
+  }
+  auto pos = pin_edges.end();
+  while (pos != pin_edges.begin() && (pos - 1)->at > atMicros) --pos;
+  pin_edges.insert(pos, PinEdge{atMicros, pin, level});
+}
+
+int pinLevel(uint8_t pin) {
+  initPins();
+  return pin < 64 ? pin_levels[pin] : LOW;
+}
+
+uint32_t pinWriteCount(uint8_t pin) {
+  return pin < 64 ? pin_writes[pin] : 0;
+}
+
+uint64_t pinChangedAt(uint8_t pin) {
+  return pin < 64 ? pin_changed_at[pin] : 0;
+}
+
+void setMacAddress(const uint8_t mac[6]) { memcpy(mac_address, mac, 6); }
+const uint8_t* macAddress() { return mac_address; }
+
+void setSensorReading(float temperature, float humidity) {
+  sensor_temperature = temperature;
+  sensor_humidity = humidity;
+}
+void setSensorFailed(bool failed) { sensor_failed = failed; }
+float sensorTemperature() { return sensor_temperature; }
+float sensorHumidity() { return sensor_humidity; }
+bool sensorFailed() { return sensor_failed; }
+
+void setSerialEcho(bool echo) { serial_echo = echo; }
+void feedSerial(const char* text) { serial_input += text; }
+
+void setRestartHandler(void (*handler)()) { restart_handler = handler; }
+
+}  // namespace nativesim
+
+unsigned long millis() {
+  chargeCpu();
+  return (unsigned long)(clock_us / 1000ULL);
+}
+unsigned long micros() {
+  chargeCpu();
+  return (unsigned long)clock_us;
+}
+void delay(unsigned long ms) {
+  chargeCpu();
+  advanceTo(clock_us + (uint64_t)ms * 1000ULL);
+}
+void delayMicroseconds(unsigned int us) {
+  chargeCpu();
+  advanceTo(clock_us + us);
+}
+
+// Busy-wait loops in the libraries spin on yield() until millis() moves, so
+// each call stands for one scheduler tick.
+void yield() {
+  chargeCpu();
+  advanceTo(clock_us + 1000ULL);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  initPins();
+  if (pin < 64) pin_modes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  initPins();
+  if (pin >= 64) return;
+  int level = val ? HIGH : LOW;
+  chargeCpu();
+  if (level != pin_levels[pin]) pin_changed_at[pin] = clock_us;
+  pin_levels[pin] = level;
+  pin_writes[pin]++;
+}
+
+int digitalRead(uint8_t pin) {
+  initPins();
+  return pin < 64 ? pin_levels[pin] : LOW;
+}
+
+uint16_t analogRead(uint8_t pin) {
+  (void)pin;
+  return 0;
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode) {
+  if (pin < 64) pin_isrs[pin] = PinIsr{handler, arg, mode};
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+  attachInterruptArg(pin, callPlainIsr, (void*)handler, mode);
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin < 64) pin_isrs[pin] = PinIsr{nullptr, nullptr, 0};
+}
+
+void noInterrupts() {}
+void interrupts() {}
+
+long random(long howbig) {
+  if (howbig <= 0) return 0;
+  // Park-Miller minimal standard generator, deterministic per seed.
+  random_state = (random_state * 48271UL) % 2147483647UL;
+  return (long)(random_state % (unsigned long)howbig);
+}
+
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) return howsmall;
+  return random(howbig - howsmall) + howsmall;
+}
+
+void randomSeed(unsigned long seed) {
+  random_state = seed % 2147483647UL;
+  if (random_state == 0) random_state = 1;
+}
+
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long baud) { (void)baud; }
+void HardwareSerial::end() {}
+void HardwareSerial::setTxBufferSize(size_t size) { (void)size; }
+void HardwareSerial::setRxBufferSize(size_t size) { (void)size; }
+
+int HardwareSerial::available() { return (int)serial_input.size(); }
+
+int HardwareSerial::read() {
+  if (serial_input.empty()) return -1;
+  int c = (unsigned char)serial_input[0];
+  serial_input.erase(0, 1);
+  return c;
+}
+
+int HardwareSerial::peek() {
+  return serial_input.empty() ? -1 : (unsigned char)serial_input[0];
+}
+
+void HardwareSerial::flush() {
+  if (serial_echo) fflush(stdout);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (serial_echo) fputc(c, stdout);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  if (serial_echo) fwrite(buffer, 1, size, stdout);
+  return size;
+}
+
+EspClass ESP;
+
+void EspClass::restart() {
+  if (restart_handler) restart_handler();
+  exit(3);
+}
+
+uint32_t EspClass::getFreeHeap() { return 200000; }
+uint32_t EspClass::getMinFreeHeap() { return 180000; }
+const char* EspClass::getChipModel() { return "ESP32-native"; }
+uint8_t EspClass::getChipRevision() { return 3; }
+uint32_t EspClass::getCpuFreqMHz() { return 240; }
+bool setCpuFrequencyMhz(uint32_t cpu_freq_mhz) { return cpu_freq_mhz > 0; }
+uint32_t EspClass::getFlashChipSize() { return 4 * 1024 * 1024; }
+
+uint64_t EspClass::getEfuseMac() {
+  uint64_t v = 0;
+  for (int i = 5; i >= 0; i--) v = (v << 8) | mac_address[i];
+  return v;
+}
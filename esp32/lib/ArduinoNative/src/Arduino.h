@@ -0,0 +1,124 @@
+/*
+  Arduino.h - host stand-in for the Arduino-ESP32 core.
+
+  Only the subset the firmware and its libraries actually call is provided.
+  Time is virtual: millis()/micros() read the simulation clock and delay()
+  advances it, so a loop() that ends in delay(10) costs 10 ms of simulated
+  time and no wall-clock time. GPIO levels live in a table the harness can
+  drive (see NativeSim.h).
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <algorithm>
+
+// Arduino-ESP32 exposes the std versions instead of the classic macros.
+using std::min;
+using std::max;
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef unsigned int word;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define PULLUP       0x04
+#define INPUT_PULLUP 0x05
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define IRAM_ATTR
+#define digitalPinToInterrupt(p) (p)
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PROGMEM
+#define PGM_P const char*
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_byte_near(addr) pgm_read_byte(addr)
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+
+// Handlers run synchronously inside the level change that triggers them
+// (NativeSim::setPinLevel() or a scheduled edge), so they see the clock at
+// the edge.
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+
+void noInterrupts();
+void interrupts();
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud);
+  void end();
+  void setTxBufferSize(size_t size);
+  void setRxBufferSize(size_t size);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  void flush() override;
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+  [[noreturn]] void restart();
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  const char* getChipModel();
+  uint8_t getChipRevision();
+  uint32_t getCpuFreqMHz();
+  uint32_t getFlashChipSize();
+  uint64_t getEfuseMac();
+};
+
+extern EspClass ESP;
+
+bool setCpuFrequencyMhz(uint32_t cpu_freq_mhz);
+
+#endif
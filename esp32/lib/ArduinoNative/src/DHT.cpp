@@ -0,0 +1,112 @@
+/*
+  DHT.cpp - host stand-in for the Adafruit DHT sensor library.
+*/
+
+#include "DHT.h"
+#include "NativeSim.h"
+
+#include <DHTFrame.h>
+
+#define MIN_INTERVAL 2000
+
+DHT::DHT(uint8_t pin, uint8_t type, uint8_t count)
+    : _pin(pin), _type(type), _reads(0), _lastreadtime(0), _lastresult(false) {
+  (void)count;
+  memset(data, 0, sizeof(data));
+}
+
+void DHT::begin(uint8_t usec) {
+  (void)usec;
+  pinMode(_pin, INPUT_PULLUP);
+  _lastreadtime = millis() - MIN_INTERVAL;
+}
+
+bool DHT::read(bool force) {
+  uint32_t currenttime = millis();
+  if (!force && (currenttime - _lastreadtime) < MIN_INTERVAL) return _lastresult;
+  _lastreadtime = currenttime;
+  _reads++;
+
+  DHTPulse pulses[DHT_FRAME_MAX_PULSES];
+  size_t count = 0;
+  if (!nativesim::sensorFailed()) {
+    uint8_t frame[5];
+    bool dht11 = _type == DHT11 || _type == DHT12;
+    float h = nativesim::sensorHumidity();
+    float t = nativesim::sensorTemperature();
+    float mag = fabsf(t);
+    if (dht11) {
+      frame[0] = (uint8_t)h;
+      frame[1] = (uint8_t)lroundf((h - frame[0]) * 10);
+      frame[2] = (uint8_t)mag;
+      frame[3] = (uint8_t)(lroundf((mag - frame[2]) * 10) | (t < 0 ? 0x80 : 0));
+    } else {
+      uint16_t hw = (uint16_t)lroundf(h * 10);
+      uint16_t tw = (uint16_t)(lroundf(mag * 10) | (t < 0 ? 0x8000 : 0));
+      frame[0] = (uint8_t)(hw >> 8);
+      frame[1] = (uint8_t)hw;
+      frame[2] = (uint8_t)(tw >> 8);
+      frame[3] = (uint8_t)tw;
+    }
+    frame[4] = (uint8_t)(frame[0] + frame[1] + frame[2] + frame[3]);
+    count = dhtEncodeFrame(frame, pulses, DHT_FRAME_MAX_PULSES);
+  }
+
+  uint8_t decoded[5];
+  _lastresult = dhtDecodeFrame(pulses, count, decoded) == DHT_FRAME_OK;
+  if (_lastresult) memcpy(data, decoded, sizeof(data));
+  return _lastresult;
+}
+
+float DHT::readTemperature(bool S, bool force) {
+  if (!read(force)) return NAN;
+  float f;
+  if (_type == DHT11 || _type == DHT12) {
+    f = data[2] + (data[3] & 0x0f) * 0.1f;
+    if (data[3] & 0x80) f = -f;
+  } else {
+    f = ((uint16_t)(data[2] & 0x7F) << 8 | data[3]) * 0.1f;
+    if (data[2] & 0x80) f = -f;
+  }
+  return S ? convertCtoF(f) : f;
+}
+
+float DHT::readHumidity(bool force) {
+  if (!read(force)) return NAN;
+  if (_type == DHT11 || _type == DHT12) return data[0] + data[1] * 0.1f;
+  return ((uint16_t)data[0] << 8 | data[1]) * 0.1f;
+}
+
+float DHT::convertCtoF(float c) { return c * 1.8f + 32; }
+float DHT::convertFtoC(float f) { return (f - 32) * 0.55555f; }
+
+float DHT::computeHeatIndex(bool isFahrenheit) {
+  float hi = computeHeatIndex(readTemperature(isFahrenheit), readHumidity(), isFahrenheit);
+  return hi;
+}
+
+// Same Rothfusz/Steadman formula as the Adafruit driver.
+float DHT::computeHeatIndex(float temperature, float percentHumidity, bool isFahrenheit) {
+  float hi;
+
+  if (!isFahrenheit) temperature = convertCtoF(temperature);
+
+  hi = 0.5f * (temperature + 61.0f + ((temperature - 68.0f) * 1.2f) + (percentHumidity * 0.094f));
+
+  if (hi > 79) {
+    hi = -42.379f + 2.04901523f * temperature + 10.14333127f * percentHumidity +
+         -0.22475541f * temperature * percentHumidity +
+         -0.00683783f * powf(temperature, 2) +
+         -0.05481717f * powf(percentHumidity, 2) +
+         0.00122874f * powf(temperature, 2) * percentHumidity +
+         0.00085282f * temperature * powf(percentHumidity, 2) +
+         -0.00000199f * powf(temperature, 2) * powf(percentHumidity, 2);
+
+    if ((percentHumidity < 13) && (temperature >= 80.0f) && (temperature <= 112.0f))
+      hi -= ((13.0f - percentHumidity) * 0.25f) * sqrtf((17.0f - fabsf(temperature - 95.0f)) * 0.05882f);
+    else if ((percentHumidity > 85.0f) && (temperature >= 80.0f) && (temperature <= 87.0f))
+      hi += ((percentHumidity - 85.0f) * 0.1f) * ((87.0f - temperature) * 0.2f);
+  }
+
+  return isFahrenheit ? hi : convertFtoC(hi);
+}
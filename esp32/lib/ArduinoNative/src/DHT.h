@@ -0,0 +1,42 @@
+/*
+  DHT.h - host stand-in for the Adafruit DHT sensor library.
+
+  Readings come from nativesim::setSensorReading(). read() encodes them as
+  the pulse train a DHT22 would send and decodes that with lib/DHTFrame, the
+  same decoder the ESP32 RMT capture uses, then converts the bytes exactly
+  like the Adafruit driver (0.1 resolution, 2 s cache). A sensor marked
+  failed sends no response and reads NaN.
+*/
+
+#ifndef DHT_H
+#define DHT_H
+
+#include "Arduino.h"
+
+static const uint8_t DHT11{11};
+static const uint8_t DHT12{12};
+static const uint8_t DHT21{21};
+static const uint8_t DHT22{22};
+static const uint8_t AM2301{21};
+
+class DHT {
+public:
+  DHT(uint8_t pin, uint8_t type, uint8_t count = 6);
+  void begin(uint8_t usec = 55);
+  float readTemperature(bool S = false, bool force = false);
+  float convertCtoF(float);
+  float convertFtoC(float);
+  float computeHeatIndex(bool isFahrenheit = true);
+  float computeHeatIndex(float temperature, float percentHumidity, bool isFahrenheit = true);
+  float readHumidity(bool force = false);
+  bool read(bool force = false);
+
+private:
+  uint8_t data[5];
+  uint8_t _pin, _type;
+  uint32_t _reads;
+  uint32_t _lastreadtime;
+  bool _lastresult;
+};
+
+#endif
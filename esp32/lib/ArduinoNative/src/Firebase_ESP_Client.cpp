@@ -0,0 +1,300 @@
+/*
+  Firebase_ESP_Client.cpp - host stand-in for mobizt/Firebase-ESP-Client.
+*/
+
+#include "Firebase_ESP_Client.h"
+
+#include "LoopbackRTDB.h"
+
+Firebase_ESP_Client Firebase;
+
+// --- FirebaseJson ---
+
+JsonVariant FirebaseJson::slot(const String& path) {
+  JsonVariant node = doc_.as<JsonVariant>();
+  int start = 0;
+  int len = path.length();
+  while (start <= len) {
+    int end = path.indexOf('/', start);
+    if (end < 0) end = len;
+    if (end > start) {
+      if (!node.is<JsonObject>()) node.to<JsonObject>();
+      node = node.as<JsonObject>()[path.substring(start, end)];
+    }
+    start = end + 1;
+  }
+  return node;
+}
+
+FirebaseJson& FirebaseJson::set(const String& path, bool value) { slot(path).set(value); return *this; }
+FirebaseJson& FirebaseJson::set(const String& path, int value) { slot(path).set(value); return *this; }
+FirebaseJson& FirebaseJson::set(const String& path, unsigned long value) { slot(path).set(value); return *this; }
+FirebaseJson& FirebaseJson::set(const String& path, float value) { slot(path).set(value); return *this; }
+FirebaseJson& FirebaseJson::set(const String& path, double value) { slot(path).set(value); return *this; }
+FirebaseJson& FirebaseJson::set(const String& path, const char* value) { slot(path).set(value); return *this; }
+FirebaseJson& FirebaseJson::set(const String& path, const String& value) { slot(path).set(value); return *this; }
+FirebaseJson& FirebaseJson::set(const String& path, FirebaseJson& value) { slot(path).set(value.doc_); return *this; }
+
+bool FirebaseJson::get(FirebaseJsonData& result, const String& path) {
+  JsonVariantConst node = doc_.as<JsonVariantConst>();
+  int start = 0;
+  int len = path.length();
+  while (start <= len && !node.isNull()) {
+    int end = path.indexOf('/', start);
+    if (end < 0) end = len;
+    if (end > start) node = node[path.substring(start, end)];
+    start = end + 1;
+  }
+  result = FirebaseJsonData();
+  if (node.isUnbound() || node.isNull()) return false;
+  result.success = true;
+  result.typeNum = typeOf(node);
+  result.boolValue = node.as<bool>();
+  result.intValue = node.as<int>();
+  result.floatValue = node.as<float>();
+  result.doubleValue = node.as<double>();
+  if (node.is<const char*>()) {
+    result.stringValue = node.as<const char*>();
+  } else {
+    serializeJson(node, result.stringValue);
+  }
+  return true;
+}
+
+bool FirebaseJson::remove(const String& path) {
+  int slash = path.lastIndexOf('/');
+  if (slash < 0) {
+    doc_.remove(path);
+    return true;
+  }
+  JsonVariant parent = slot(path.substring(0, slash));
+  parent.as<JsonObject>().remove(path.substring(slash + 1));
+  return true;
+}
+
+void FirebaseJson::clear() {
+  doc_.clear();
+  iterator_.clear();
+}
+
+bool FirebaseJson::setJsonData(const String& json) {
+  return !deserializeJson(doc_, json);
+}
+
+void FirebaseJson::toString(String& out, bool prettify) const {
+  out = "";
+  if (prettify) {
+    serializeJsonPretty(doc_, out);
+  } else {
+    serializeJson(doc_, out);
+  }
+}
+
+size_t FirebaseJson::iteratorBegin() {
+  iterator_.clear();
+  JsonObjectConst root = doc_.as<JsonObjectConst>();
+  for (JsonPairConst kv : root) flatten(kv.value(), kv.key().c_str(), 0);
+  return iterator_.size();
+}
+
+FirebaseJson::IteratorValue FirebaseJson::valueAt(size_t index) const {
+  if (index >= iterator_.size()) return IteratorValue{JSON_UNDEFINED, 0, String(), String()};
+  return iterator_[index];
+}
+
+void FirebaseJson::iteratorEnd() {
+  iterator_.clear();
+}
+
+void FirebaseJson::flatten(JsonVariantConst node, const char* key, int depth) {
+  IteratorValue item;
+  item.type = typeOf(node);
+  item.depth = depth;
+  item.key = key;
+  serializeJson(node, item.value);
+  iterator_.push_back(item);
+  if (node.is<JsonObjectConst>()) {
+    for (JsonPairConst kv : node.as<JsonObjectConst>()) flatten(kv.value(), kv.key().c_str(), depth + 1);
+  }
+}
+
+int FirebaseJson::typeOf(JsonVariantConst value) {
+  if (value.is<JsonObjectConst>()) return JSON_OBJECT;
+  if (value.is<JsonArrayConst>()) return JSON_ARRAY;
+  if (value.is<bool>()) return JSON_BOOL;
+  if (value.is<long long>()) return JSON_INT;
+  if (value.is<double>()) return JSON_DOUBLE;
+  if (value.is<const char*>()) return JSON_STRING;
+  if (value.isNull()) return JSON_NULL;
+  return JSON_UNDEFINED;
+}
+
+// --- FirebaseData ---
+
+FirebaseData::~FirebaseData() {
+  if (streamId_ >= 0) LoopbackRTDB::instance().closeStream(streamId_);
+}
+
+String FirebaseData::stringData() {
+  JsonVariantConst value = result_.doc().as<JsonVariantConst>();
+  if (value.is<const char*>()) return String(value.as<const char*>());
+  String out;
+  serializeJson(value, out);
+  return out;
+}
+
+String FirebaseData::dataType() {
+  JsonVariantConst value = result_.doc().as<JsonVariantConst>();
+  if (value.is<JsonObjectConst>()) return "json";
+  if (value.is<JsonArrayConst>()) return "array";
+  if (value.is<bool>()) return "boolean";
+  if (value.is<long long>()) return "int";
+  if (value.is<double>()) return "double";
+  if (value.is<const char*>()) return "string";
+  return "null";
+}
+
+// --- RTDB ---
+
+bool FB_RTDB::finish(FirebaseData* fbdo, bool ok, const String& path) {
+  fbdo->dataPath_ = path;
+  fbdo->httpConnected_ = ok;
+  fbdo->errorReason_ = ok ? "" : "connection refused";
+  return ok;
+}
+
+bool FB_RTDB::getBool(FirebaseData* fbdo, const String& path) {
+  bool ok = LoopbackRTDB::instance().get(path.c_str(), fbdo->result_.doc());
+  if (ok && !fbdo->result_.doc().is<bool>()) {
+    finish(fbdo, true, path);
+    fbdo->errorReason_ = "data type mismatch";
+    return false;
+  }
+  return finish(fbdo, ok, path);
+}
+
+bool FB_RTDB::getJSON(FirebaseData* fbdo, const String& path) {
+  bool ok = LoopbackRTDB::instance().get(path.c_str(), fbdo->result_.doc());
+  return finish(fbdo, ok, path);
+}
+
+bool FB_RTDB::setVariant(FirebaseData* fbdo, const String& path, JsonVariantConst value) {
+  bool ok = LoopbackRTDB::instance().set(path.c_str(), value);
+  if (ok) fbdo->result_.doc().set(value);
+  return finish(fbdo, ok, path);
+}
+
+bool FB_RTDB::setBool(FirebaseData* fbdo, const String& path, bool value) {
+  JsonDocument doc;
+  doc.set(value);
+  return setVariant(fbdo, path, doc.as<JsonVariantConst>());
+}
+
+bool FB_RTDB::setInt(FirebaseData* fbdo, const String& path, int value) {
+  JsonDocument doc;
+  doc.set(value);
+  return setVariant(fbdo, path, doc.as<JsonVariantConst>());
+}
+
+bool FB_RTDB::setFloat(FirebaseData* fbdo, const String& path, float value) {
+  JsonDocument doc;
+  doc.set(value);
+  return setVariant(fbdo, path, doc.as<JsonVariantConst>());
+}
+
+bool FB_RTDB::setString(FirebaseData* fbdo, const String& path, const String& value) {
+  JsonDocument doc;
+  doc.set(value);
+  return setVariant(fbdo, path, doc.as<JsonVariantConst>());
+}
+
+bool FB_RTDB::setJSON(FirebaseData* fbdo, const String& path, FirebaseJson* json) {
+  return setVariant(fbdo, path, json->doc().as<JsonVariantConst>());
+}
+
+bool FB_RTDB::setTimestamp(FirebaseData* fbdo, const String& path) {
+  JsonDocument doc;
+  doc[".sv"] = "timestamp";
+  return setVariant(fbdo, path, doc.as<JsonVariantConst>());
+}
+
+bool FB_RTDB::updateNode(FirebaseData* fbdo, const String& path, FirebaseJson* json) {
+  bool ok = LoopbackRTDB::instance().update(path.c_str(), json->doc().as<JsonObjectConst>());
+  if (ok) fbdo->result_.doc().set(json->doc());
+  return finish(fbdo, ok, path);
+}
+
+bool FB_RTDB::updateNodeSilent(FirebaseData* fbdo, const String& path, FirebaseJson* json) {
+  bool ok = LoopbackRTDB::instance().update(path.c_str(), json->doc().as<JsonObjectConst>());
+  return finish(fbdo, ok, path);
+}
+
+bool FB_RTDB::beginStream(FirebaseData* fbdo, const String& path) {
+  LoopbackRTDB& rtdb = LoopbackRTDB::instance();
+  if (fbdo->streamId_ >= 0) rtdb.closeStream(fbdo->streamId_);
+  fbdo->streamId_ = rtdb.openStream(path.c_str());
+  fbdo->streamPath_ = path;
+  fbdo->streamAvailable_ = false;
+  fbdo->streamTimeout_ = fbdo->streamId_ < 0;
+  return finish(fbdo, fbdo->streamId_ >= 0, path);
+}
+
+// Returns false once the connection is gone; streamAvailable() is true when
+// this call delivered an event.
+bool FB_RTDB::readStream(FirebaseData* fbdo) {
+  LoopbackRTDB& rtdb = LoopbackRTDB::instance();
+  fbdo->streamAvailable_ = false;
+  if (fbdo->streamId_ < 0 || !rtdb.streamAlive(fbdo->streamId_)) {
+    fbdo->streamTimeout_ = true;
+    fbdo->httpConnected_ = false;
+    fbdo->errorReason_ = "stream connection lost";
+    return false;
+  }
+  fbdo->streamTimeout_ = false;
+  fbdo->httpConnected_ = true;
+
+  LoopbackRTDB::Event event;
+  if (!rtdb.nextEvent(fbdo->streamId_, &event)) return true;
+  fbdo->eventType_ = event.type.c_str();
+  fbdo->dataPath_ = event.path.c_str();
+  deserializeJson(fbdo->result_.doc(), event.data);
+  fbdo->streamAvailable_ = true;
+  return true;
+}
+
+bool FB_RTDB::endStream(FirebaseData* fbdo) {
+  if (fbdo->streamId_ >= 0) LoopbackRTDB::instance().closeStream(fbdo->streamId_);
+  fbdo->streamId_ = -1;
+  fbdo->streamAvailable_ = false;
+  return true;
+}
+
+// --- Firebase ---
+
+bool Firebase_ESP_Client::signUp(FirebaseConfig* config, FirebaseAuth* auth, const char* email, const char* password) {
+  (void)config;
+  (void)auth;
+  (void)email;
+  (void)password;
+  signedUp_ = WiFi.status() == WL_CONNECTED && LoopbackRTDB::instance().online();
+  return signedUp_;
+}
+
+void Firebase_ESP_Client::begin(FirebaseConfig* config, FirebaseAuth* auth) {
+  (void)auth;
+  config_ = config;
+  begun_ = true;
+  tokenReported_ = false;
+}
+
+// The token is cached once issued, so ready() only needs the station up.
+bool Firebase_ESP_Client::ready() {
+  bool isReady = begun_ && signedUp_ && WiFi.status() == WL_CONNECTED;
+  if (isReady && !tokenReported_ && config_ && config_->token_status_callback) {
+    tokenReported_ = true;
+    TokenInfo info;
+    info.status = token_status_ready;
+    config_->token_status_callback(info);
+  }
+  return isReady;
+}
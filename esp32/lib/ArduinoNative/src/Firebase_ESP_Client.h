@@ -0,0 +1,193 @@
+/*
+  Firebase_ESP_Client.h - host stand-in for mobizt/Firebase-ESP-Client.
+
+  Covers the RTDB calls main.cpp makes. Every get/set/update is one blocking
+  round-trip to the in-process LoopbackRTDB; streams read its event queue
+  without blocking, the way readStream() polls an already open socket.
+  FirebaseJson is a thin ArduinoJson wrapper with the same iterator API.
+*/
+
+#ifndef Firebase_ESP_Client_h
+#define Firebase_ESP_Client_h
+
+#include "Arduino.h"
+#include "WiFi.h"
+
+#include <ArduinoJson.h>
+
+#include <vector>
+
+class FirebaseJsonData {
+public:
+  bool success = false;
+  int typeNum = 0;
+  String type;
+  bool boolValue = false;
+  int intValue = 0;
+  float floatValue = 0;
+  double doubleValue = 0;
+  String stringValue;
+};
+
+class FirebaseJson {
+public:
+  enum {
+    JSON_UNDEFINED,
+    JSON_OBJECT,
+    JSON_ARRAY,
+    JSON_STRING,
+    JSON_INT,
+    JSON_FLOAT,
+    JSON_DOUBLE,
+    JSON_BOOL,
+    JSON_NULL
+  };
+
+  struct IteratorValue {
+    int type;
+    int depth;
+    String key;    // local key, not the full path
+    String value;  // serialized JSON of the element
+  };
+
+  // Nested paths ("a/b") create intermediate objects.
+  FirebaseJson& set(const String& path, bool value);
+  FirebaseJson& set(const String& path, int value);
+  FirebaseJson& set(const String& path, unsigned long value);
+  FirebaseJson& set(const String& path, float value);
+  FirebaseJson& set(const String& path, double value);
+  FirebaseJson& set(const String& path, const char* value);
+  FirebaseJson& set(const String& path, const String& value);
+  FirebaseJson& set(const String& path, FirebaseJson& value);
+  // add() takes the key as-is, '/' included: that is how a multi-path
+  // update names its locations.
+  template <typename T>
+  FirebaseJson& add(const String& key, T value) {
+    doc_[key].set(value);
+    return *this;
+  }
+  FirebaseJson& add(const String& key, FirebaseJson& value) {
+    doc_[key].set(value.doc_);
+    return *this;
+  }
+  bool get(FirebaseJsonData& result, const String& path);
+  bool remove(const String& path);
+  void clear();
+  bool setJsonData(const String& json);
+  void toString(String& out, bool prettify = false) const;
+
+  // Depth-first, parents before children.
+  size_t iteratorBegin();
+  IteratorValue valueAt(size_t index) const;
+  void iteratorEnd();
+
+  JsonDocument& doc() { return doc_; }
+  const JsonDocument& doc() const { return doc_; }
+
+private:
+  JsonVariant slot(const String& path);
+  void flatten(JsonVariantConst node, const char* key, int depth);
+  static int typeOf(JsonVariantConst value);
+
+  JsonDocument doc_;
+  std::vector<IteratorValue> iterator_;
+};
+
+class FirebaseData {
+public:
+  ~FirebaseData();
+
+  bool boolData() { return result_.doc().as<bool>(); }
+  int intData() { return result_.doc().as<int>(); }
+  float floatData() { return result_.doc().as<float>(); }
+  String stringData();
+  FirebaseJson& jsonObject() { return result_; }
+  FirebaseJson* jsonObjectPtr() { return &result_; }
+  String dataType();
+  String dataPath() { return dataPath_; }
+  String eventType() { return eventType_; }
+  String streamPath() { return streamPath_; }
+  String errorReason() { return errorReason_; }
+  bool httpConnected() { return httpConnected_; }
+  bool streamAvailable() { return streamAvailable_; }
+  bool streamTimeout() { return streamTimeout_; }
+
+private:
+  friend class FB_RTDB;
+
+  FirebaseJson result_;
+  String dataPath_;
+  String eventType_;
+  String streamPath_;
+  String errorReason_;
+  bool httpConnected_ = false;
+  bool streamAvailable_ = false;
+  bool streamTimeout_ = false;
+  int streamId_ = -1;
+};
+
+struct FirebaseAuth {
+  struct {
+    String email;
+    String password;
+  } user;
+};
+
+struct TokenInfo {
+  int type = 0;
+  int status = 0;
+  struct {
+    int code = 0;
+    String message;
+  } error;
+};
+
+enum { token_status_uninitialized, token_status_on_signing, token_status_on_request, token_status_on_refresh, token_status_ready, token_status_error };
+
+struct FirebaseConfig {
+  String api_key;
+  String database_url;
+  void (*token_status_callback)(TokenInfo) = nullptr;
+};
+
+class FB_RTDB {
+public:
+  bool getBool(FirebaseData* fbdo, const String& path);
+  bool getJSON(FirebaseData* fbdo, const String& path);
+  bool setBool(FirebaseData* fbdo, const String& path, bool value);
+  bool setInt(FirebaseData* fbdo, const String& path, int value);
+  bool setFloat(FirebaseData* fbdo, const String& path, float value);
+  bool setString(FirebaseData* fbdo, const String& path, const String& value);
+  bool setJSON(FirebaseData* fbdo, const String& path, FirebaseJson* json);
+  bool setTimestamp(FirebaseData* fbdo, const String& path);
+  bool updateNode(FirebaseData* fbdo, const String& path, FirebaseJson* json);
+  bool updateNodeSilent(FirebaseData* fbdo, const String& path, FirebaseJson* json);
+
+  bool beginStream(FirebaseData* fbdo, const String& path);
+  bool readStream(FirebaseData* fbdo);
+  bool endStream(FirebaseData* fbdo);
+
+private:
+  bool setVariant(FirebaseData* fbdo, const String& path, JsonVariantConst value);
+  bool finish(FirebaseData* fbdo, bool ok, const String& path);
+};
+
+class Firebase_ESP_Client {
+public:
+  bool signUp(FirebaseConfig* config, FirebaseAuth* auth, const char* email, const char* password);
+  void begin(FirebaseConfig* config, FirebaseAuth* auth);
+  void reconnectWiFi(bool reconnect) { (void)reconnect; }
+  bool ready();
+
+  FB_RTDB RTDB;
+
+private:
+  FirebaseConfig* config_ = nullptr;
+  bool signedUp_ = false;
+  bool begun_ = false;
+  bool tokenReported_ = false;
+};
+
+extern Firebase_ESP_Client Firebase;
+
+#endif
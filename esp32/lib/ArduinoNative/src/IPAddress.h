@@ -0,0 +1,47 @@
+/*
+  IPAddress.h - host stand-in for Arduino's IPAddress class.
+*/
+
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include <stdint.h>
+
+#include "Print.h"
+#include "Printable.h"
+#include "WString.h"
+
+class IPAddress : public Printable {
+public:
+  IPAddress() : IPAddress(0, 0, 0, 0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    bytes_[0] = a;
+    bytes_[1] = b;
+    bytes_[2] = c;
+    bytes_[3] = d;
+  }
+
+  uint8_t operator[](int index) const { return bytes_[index]; }
+  bool operator==(const IPAddress& rhs) const {
+    return bytes_[0] == rhs.bytes_[0] && bytes_[1] == rhs.bytes_[1] &&
+           bytes_[2] == rhs.bytes_[2] && bytes_[3] == rhs.bytes_[3];
+  }
+
+  size_t printTo(Print& p) const override {
+    size_t n = 0;
+    for (int i = 0; i < 4; i++) {
+      if (i) n += p.print('.');
+      n += p.print(bytes_[i], 10);
+    }
+    return n;
+  }
+
+  String toString() const {
+    return String(bytes_[0]) + "." + String(bytes_[1]) + "." + String(bytes_[2]) + "." + String(bytes_[3]);
+  }
+
+private:
+  uint8_t bytes_[4];
+};
+
+#endif
@@ -0,0 +1,542 @@
+/*
+  LoopbackBroker.cpp - in-process MQTT 3.1.1 / 5 broker stand-in.
+*/
+
+#include "LoopbackBroker.h"
+
+#include <string.h>
+
+LoopbackBroker& LoopbackBroker::instance() {
+  static LoopbackBroker broker;
+  return broker;
+}
+
+LoopbackBroker::LoopbackBroker()
+    : online_(true), mqtt5_(true), v5_(false), aliasMaximum_(10), receiveMaximum_(0), deviceReceiveMaximum_(0),
+      deviceMaximumPacket_(0), unacked_(0), session_(false), loopback_(true), nextPacketId_(1), pubackLossEvery_(0),
+      pubacksDue_(0), connackHeld_(false), readPos_(0) {
+  resetStats();
+}
+
+void LoopbackBroker::resetStats() {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+void LoopbackBroker::setOnline(bool online) {
+  online_ = online;
+  if (!online_ && session_) dropSession();
+}
+
+void LoopbackBroker::dropSession() {
+  if (!session_) return;
+  stats_.dropped++;
+  close();
+}
+
+int LoopbackBroker::accept() {
+  if (!online_) {
+    stats_.refusedConnects++;
+    return 0;
+  }
+  session_ = true;
+  inbound_.clear();
+  outbound_.clear();
+  readPos_ = 0;
+  return 1;
+}
+
+void LoopbackBroker::close() {
+  session_ = false;
+  v5_ = false;
+  unacked_ = 0;
+  aliases_.clear();
+  held_.clear();
+  inbound_.clear();
+  outbound_.clear();
+  readPos_ = 0;
+}
+
+size_t LoopbackBroker::receive(const uint8_t* data, size_t length) {
+  if (!session_) return 0;
+  stats_.writeCalls++;
+  stats_.bytesIn += length;
+  inbound_.insert(inbound_.end(), data, data + length);
+  takeInbound();
+  return length;
+}
+
+size_t LoopbackBroker::receive(const struct iovec* parts, int count) {
+  if (!session_) return 0;
+  stats_.writeCalls++;
+  size_t length = 0;
+  for (int i = 0; i < count; i++) {
+    const uint8_t* base = (const uint8_t*)parts[i].iov_base;
+    inbound_.insert(inbound_.end(), base, base + parts[i].iov_len);
+    length += parts[i].iov_len;
+  }
+  stats_.bytesIn += length;
+  takeInbound();
+  return length;
+}
+
+// Handles every complete packet in inbound_
+void LoopbackBroker::takeInbound() {
+  size_t pos = 0;
+  while (session_ && inbound_.size() - pos >= 2) {
+    size_t remaining = 0;
+    size_t multiplier = 1;
+    size_t idx = pos + 1;
+    bool complete = false;
+    for (int i = 0; i < 4 && idx < inbound_.size(); i++) {
+      uint8_t digit = inbound_[idx++];
+      remaining += (digit & 127) * multiplier;
+      multiplier <<= 7;
+      if ((digit & 128) == 0) {
+        complete = true;
+        break;
+      }
+    }
+    if (!complete) {
+      if (idx - pos > 4) {
+        stats_.malformed++;
+        close();
+        return;
+      }
+      break;
+    }
+    if (inbound_.size() - idx < remaining) break;
+    handlePacket(&inbound_[pos], idx - pos + remaining);
+    if (!session_) return;
+    pos = idx + remaining;
+  }
+  inbound_.erase(inbound_.begin(), inbound_.begin() + pos);
+}
+
+int LoopbackBroker::available() const {
+  return session_ ? (int)(outbound_.size() - readPos_) : 0;
+}
+
+int LoopbackBroker::read() {
+  if (available() <= 0) return -1;
+  int c = outbound_[readPos_++];
+  if (readPos_ == outbound_.size()) {
+    outbound_.clear();
+    readPos_ = 0;
+  }
+  return c;
+}
+
+int LoopbackBroker::read(uint8_t* buf, size_t size) {
+  int avail = available();
+  if (avail <= 0) return -1;
+  size_t n = size < (size_t)avail ? size : (size_t)avail;
+  memcpy(buf, &outbound_[readPos_], n);
+  readPos_ += n;
+  if (readPos_ == outbound_.size()) {
+    outbound_.clear();
+    readPos_ = 0;
+  }
+  return (int)n;
+}
+
+int LoopbackBroker::peek() const {
+  return available() > 0 ? outbound_[readPos_] : -1;
+}
+
+void LoopbackBroker::send(const uint8_t* data, size_t length) {
+  stats_.bytesOut += length;
+  outbound_.insert(outbound_.end(), data, data + length);
+}
+
+void LoopbackBroker::sendPacket(uint8_t header, const uint8_t* body, size_t length) {
+  uint8_t fixed[5];
+  size_t pos = 0;
+  fixed[pos++] = header;
+  size_t len = length;
+  do {
+    uint8_t digit = len & 127;
+    len >>= 7;
+    if (len > 0) digit |= 0x80;
+    fixed[pos++] = digit;
+  } while (len > 0);
+  send(fixed, pos);
+  if (length) send(body, length);
+}
+
+void LoopbackBroker::handlePacket(const uint8_t* packet, size_t length) {
+  uint8_t header = packet[0];
+  size_t idx = 1;
+  while (packet[idx] & 0x80) idx++;
+  idx++;
+  const uint8_t* body = packet + idx;
+  size_t bodyLength = length - idx;
+
+  switch (header & 0xF0) {
+    case 0x10:
+      handleConnect(body, bodyLength);
+      break;
+    case 0x30:
+      handlePublish(header, body, bodyLength);
+      break;
+    case 0x40:
+      handlePuback();
+      break;
+    case 0x80:
+      handleSubscribe(body, bodyLength);
+      break;
+    case 0xA0:
+      handleUnsubscribe(body, bodyLength);
+      break;
+    case 0xC0: {
+      stats_.pings++;
+      sendPacket(0xD0, nullptr, 0);
+      break;
+    }
+    case 0xE0:
+      stats_.disconnects++;
+      close();
+      break;
+    default:
+      stats_.malformed++;
+      break;
+  }
+}
+
+void LoopbackBroker::handleConnect(const uint8_t* body, size_t length) {
+  if (length < 10) {
+    stats_.malformed++;
+    close();
+    return;
+  }
+  if (connackHeld_) return;
+  size_t nameLength = (body[0] << 8) | body[1];
+  size_t levelPos = 2 + nameLength;
+  size_t flagsPos = levelPos + 1;
+  uint8_t level = levelPos < length ? body[levelPos] : 0;
+  if (level == 5 && !mqtt5_) {
+    // What a 3.1.1 broker answers: unacceptable protocol version
+    stats_.refusedConnects++;
+    const uint8_t connack[2] = {0x00, 0x01};
+    sendPacket(0x20, connack, sizeof(connack));
+    return;
+  }
+  v5_ = level == 5;
+  deviceReceiveMaximum_ = 0;
+  deviceMaximumPacket_ = 0;
+  if (v5_) {
+    size_t pos = flagsPos + 3;  // flags, keep alive
+    properties_ = PublishProperties();
+    if (!readProperties(body, length, &pos)) {
+      stats_.malformed++;
+      close();
+      return;
+    }
+  }
+  bool cleanSession = flagsPos < length && (body[flagsPos] & 0x02);
+  if (cleanSession) subscriptions_.clear();
+  stats_.connects++;
+  if (!v5_) {
+    const uint8_t connack[2] = {0x00, 0x00};
+    sendPacket(0x20, connack, sizeof(connack));
+    return;
+  }
+  uint8_t connack[9] = {0x00, 0x00, 3, 0x22, (uint8_t)(aliasMaximum_ >> 8), (uint8_t)(aliasMaximum_ & 0xFF)};
+  size_t connackLength = 6;
+  if (receiveMaximum_) {
+    connack[2] += 3;
+    connack[connackLength++] = 0x21;
+    connack[connackLength++] = (uint8_t)(receiveMaximum_ >> 8);
+    connack[connackLength++] = (uint8_t)(receiveMaximum_ & 0xFF);
+  }
+  sendPacket(0x20, connack, connackLength);
+}
+
+// Reads the property length and properties at *pos, keeping what the
+// tests look at: a CONNECT's Receive Maximum and Maximum Packet Size, a
+// PUBLISH's expiry, topic alias and user properties
+bool LoopbackBroker::readProperties(const uint8_t* body, size_t length, size_t* pos) {
+  size_t idx = *pos;
+  size_t propertyLength = 0;
+  size_t multiplier = 1;
+  for (int i = 0;; i++) {
+    if (i == 4 || idx >= length) return false;
+    uint8_t digit = body[idx++];
+    propertyLength += (digit & 127) * multiplier;
+    multiplier <<= 7;
+    if ((digit & 128) == 0) break;
+  }
+  size_t end = idx + propertyLength;
+  if (end > length) return false;
+  auto u16 = [&](size_t at) { return (uint16_t)((body[at] << 8) | body[at + 1]); };
+  auto str = [&](size_t* at, std::string* out) {
+    if (*at + 2 > end) return false;
+    size_t n = u16(*at);
+    if (*at + 2 + n > end) return false;
+    out->assign((const char*)body + *at + 2, n);
+    *at += 2 + n;
+    return true;
+  };
+  while (idx < end) {
+    uint8_t id = body[idx++];
+    size_t need = id == 0x02 || id == 0x11 || id == 0x27 ? 4 : id == 0x21 || id == 0x22 || id == 0x23 ? 2 : 0;
+    if (idx + need > end) return false;
+    switch (id) {
+      case 0x02:
+        properties_.messageExpiry = ((uint32_t)body[idx] << 24) | ((uint32_t)body[idx + 1] << 16) | (u16(idx + 2));
+        break;
+      case 0x11:
+      case 0x22:
+        break;
+      case 0x21:
+        deviceReceiveMaximum_ = u16(idx);
+        break;
+      case 0x23:
+        properties_.topicAlias = u16(idx);
+        break;
+      case 0x27:
+        deviceMaximumPacket_ = ((uint32_t)body[idx] << 24) | ((uint32_t)body[idx + 1] << 16) | (u16(idx + 2));
+        break;
+      case 0x26: {
+        std::pair<std::string, std::string> user;
+        if (!str(&idx, &user.first) || !str(&idx, &user.second)) return false;
+        properties_.user.push_back(user);
+        continue;
+      }
+      default:
+        return false;  // not one the device sends
+    }
+    idx += need;
+  }
+  *pos = end;
+  return true;
+}
+
+void LoopbackBroker::handlePuback() {
+  stats_.pubacksReceived++;
+  if (unacked_ > 0) unacked_--;
+  // Deliver what waited for the device's Receive Maximum
+  while (!held_.empty() && session_ && (!deviceReceiveMaximum_ || unacked_ < deviceReceiveMaximum_)) {
+    Held next = held_.front();
+    held_.erase(held_.begin());
+    deliver(next.topic.c_str(), next.topic.size(), next.payload.data(), next.payload.size(), 1, next.retain);
+  }
+}
+
+void LoopbackBroker::handlePublish(uint8_t header, const uint8_t* body, size_t length) {
+  if (length < 2) {
+    stats_.malformed++;
+    return;
+  }
+  uint8_t qos = (header >> 1) & 0x03;
+  size_t topicLength = (body[0] << 8) | body[1];
+  size_t pos = 2 + topicLength;
+  uint16_t packetId = 0;
+  if (qos > 0) {
+    packetId = (uint16_t)((body[pos] << 8) | body[pos + 1]);
+    pos += 2;
+  }
+  if (pos > length) {
+    stats_.malformed++;
+    return;
+  }
+  if (v5_) {
+    properties_.messageExpiry = 0;
+    properties_.topicAlias = 0;
+    properties_.user.clear();
+    if (!readProperties(body, length, &pos) || properties_.topicAlias > aliasMaximum_) {
+      stats_.malformed++;
+      close();
+      return;
+    }
+  }
+
+  // Reuse one buffer so the broker does not show up in allocation counts.
+  topic_.assign((const char*)body + 2, topicLength);
+  uint16_t alias = properties_.topicAlias;
+  if (v5_ && alias) {
+    if (aliases_.size() < alias) aliases_.resize(alias);
+    if (topicLength) {
+      aliases_[alias - 1] = topic_;
+    } else if (aliases_[alias - 1].empty()) {
+      stats_.malformed++;  // alias the broker was never told about
+      close();
+      return;
+    } else {
+      topic_ = aliases_[alias - 1];
+      topicLength = topic_.size();
+      stats_.aliased++;
+    }
+  } else if (topicLength == 0) {
+    stats_.malformed++;
+    close();
+    return;
+  }
+  const std::string& topic = topic_;
+  const uint8_t* payload = body + pos;
+  size_t payloadLength = length - pos;
+
+  stats_.publishes++;
+  stats_.publishBytes += (uint32_t)payloadLength;
+  if (header & 0x08) stats_.duplicates++;
+
+  if (qos == 1) {
+    if (pubackLossEvery_ && ++pubacksDue_ % pubackLossEvery_ == 0) {
+      stats_.pubacksLost++;
+    } else {
+      const uint8_t puback[2] = {(uint8_t)(packetId >> 8), (uint8_t)(packetId & 0xFF)};
+      sendPacket(0x40, puback, sizeof(puback));
+      stats_.pubacksSent++;
+    }
+  }
+
+  if (observer_) observer_(topic.c_str(), payload, payloadLength, header);
+
+  if (loopback_ && session_) {
+    for (const std::string& filter : subscriptions_) {
+      if (topicMatches(filter.c_str(), topic.c_str())) {
+        deliver(topic.c_str(), topicLength, payload, payloadLength, 0, false);
+        break;
+      }
+    }
+  }
+}
+
+void LoopbackBroker::handleSubscribe(const uint8_t* body, size_t length) {
+  if (length < 5) {
+    stats_.malformed++;
+    return;
+  }
+  std::vector<uint8_t> suback;
+  suback.push_back(body[0]);
+  suback.push_back(body[1]);
+  size_t pos = 2;
+  if (v5_) {
+    if (!readProperties(body, length, &pos)) {
+      stats_.malformed++;
+      close();
+      return;
+    }
+    suback.push_back(0);
+  }
+  while (pos + 2 < length) {
+    size_t topicLength = (body[pos] << 8) | body[pos + 1];
+    pos += 2;
+    if (pos + topicLength >= length) break;
+    std::string filter((const char*)body + pos, topicLength);
+    pos += topicLength;
+    uint8_t qos = body[pos++] & 0x03;
+    if (filter.compare(0, 7, "$share/") == 0) {
+      // Shared subscription: this broker has one session, so the group
+      // always hands the message to it
+      size_t slash = filter.find('/', 7);
+      if (slash == std::string::npos) {
+        stats_.malformed++;
+        continue;
+      }
+      filter.erase(0, slash + 1);
+    }
+    bool known = false;
+    for (const std::string& existing : subscriptions_) {
+      if (existing == filter) known = true;
+    }
+    if (!known) subscriptions_.push_back(filter);
+    suback.push_back(qos > 1 ? 1 : qos);
+    stats_.subscribes++;
+  }
+  sendPacket(0x90, suback.data(), suback.size());
+}
+
+void LoopbackBroker::handleUnsubscribe(const uint8_t* body, size_t length) {
+  if (length < 4) {
+    stats_.malformed++;
+    return;
+  }
+  size_t pos = 2;
+  std::vector<uint8_t> unsuback;
+  unsuback.push_back(body[0]);
+  unsuback.push_back(body[1]);
+  if (v5_) {
+    if (!readProperties(body, length, &pos)) {
+      stats_.malformed++;
+      close();
+      return;
+    }
+    unsuback.push_back(0);
+  }
+  while (pos + 1 < length) {
+    size_t topicLength = (body[pos] << 8) | body[pos + 1];
+    pos += 2;
+    std::string filter((const char*)body + pos, topicLength);
+    pos += topicLength;
+    for (size_t i = 0; i < subscriptions_.size(); i++) {
+      if (subscriptions_[i] == filter) {
+        subscriptions_.erase(subscriptions_.begin() + i);
+        break;
+      }
+    }
+    if (v5_) unsuback.push_back(0);
+  }
+  sendPacket(0xB0, unsuback.data(), unsuback.size());
+}
+
+void LoopbackBroker::deliver(const char* topic, size_t topicLength, const uint8_t* payload, size_t length, uint8_t qos, bool retain) {
+  if (qos > 0 && deviceReceiveMaximum_ && unacked_ >= deviceReceiveMaximum_) {
+    Held held;
+    held.topic.assign(topic, topicLength);
+    held.payload.assign(payload, payload + length);
+    held.retain = retain;
+    held_.push_back(held);
+    stats_.held++;
+    return;
+  }
+  std::vector<uint8_t> body;
+  body.reserve(2 + topicLength + 2 + 1 + length);
+  body.push_back((uint8_t)(topicLength >> 8));
+  body.push_back((uint8_t)(topicLength & 0xFF));
+  body.insert(body.end(), topic, topic + topicLength);
+  if (qos > 0) {
+    body.push_back((uint8_t)(nextPacketId_ >> 8));
+    body.push_back((uint8_t)(nextPacketId_ & 0xFF));
+    if (++nextPacketId_ == 0) nextPacketId_ = 1;
+  }
+  if (v5_) body.push_back(0);  // no properties
+  body.insert(body.end(), payload, payload + length);
+  size_t fixed = 2 + (body.size() >= 128) + (body.size() >= 16384);
+  if (deviceMaximumPacket_ && fixed + body.size() > deviceMaximumPacket_) {
+    stats_.oversized++;  // an MQTT 5 broker drops it instead of sending it
+    return;
+  }
+  sendPacket((uint8_t)(0x30 | (qos << 1) | (retain ? 1 : 0)), body.data(), body.size());
+  if (qos > 0) unacked_++;
+  stats_.delivered++;
+}
+
+bool LoopbackBroker::inject(const char* topic, const uint8_t* payload, size_t length, uint8_t qos, bool retain) {
+  if (!session_) return false;
+  for (const std::string& filter : subscriptions_) {
+    if (topicMatches(filter.c_str(), topic)) {
+      deliver(topic, strlen(topic), payload, length, qos > 1 ? 1 : qos, retain);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LoopbackBroker::inject(const char* topic, const char* payload) {
+  return inject(topic, (const uint8_t*)payload, strlen(payload));
+}
+
+bool LoopbackBroker::topicMatches(const char* filter, const char* topic) {
+  while (*filter) {
+    if (*filter == '#') return true;
+    if (*filter == '+') {
+      while (*topic && *topic != '/') topic++;
+      filter++;
+      continue;
+    }
+    if (*filter != *topic) return false;
+    filter++;
+    topic++;
+  }
+  return *topic == 0;
+}
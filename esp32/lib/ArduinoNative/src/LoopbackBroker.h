@@ -0,0 +1,153 @@
+/*
+  LoopbackBroker.h - in-process MQTT 3.1.1 / 5 broker stand-in.
+
+  WiFiClient on the native build connects here instead of opening a socket.
+  Bytes the device writes are framed into MQTT packets and answered
+  synchronously (CONNACK, SUBACK, UNSUBACK, PUBACK, PINGRESP), so
+  PubSubClient never has to wait on the network. Publishes that match one of
+  the session's own subscriptions are looped back to it, and the harness can
+  inject commands, take the broker down or drop the session at any time.
+
+  An MQTT 5 session gets topic aliases (up to setTopicAliasMaximum()),
+  publish properties are decoded into lastProperties(), and QoS 1 messages
+  to the device are held back while its Receive Maximum is used up.
+*/
+
+#ifndef LoopbackBroker_h
+#define LoopbackBroker_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/uio.h>
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+class LoopbackBroker {
+public:
+  struct Stats {
+    uint32_t connects;
+    uint32_t refusedConnects;
+    uint32_t disconnects;
+    uint32_t dropped;
+    uint32_t publishes;
+    uint32_t publishBytes;
+    uint32_t subscribes;
+    uint32_t pings;
+    uint32_t pubacksSent;
+    uint32_t pubacksReceived;
+    uint32_t pubacksLost;      // withheld by setPubackLoss()
+    uint32_t duplicates;       // publishes with the DUP flag
+    uint32_t delivered;
+    uint32_t writeCalls;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint32_t malformed;
+    uint32_t aliased;          // v5 publishes that named the topic by alias only
+    uint32_t held;             // QoS 1 deliveries that waited for the Receive Maximum
+    uint32_t oversized;        // deliveries over the device's Maximum Packet Size
+  };
+
+  // MQTT 5 properties of the last PUBLISH the device sent
+  struct PublishProperties {
+    uint32_t messageExpiry;
+    uint16_t topicAlias;
+    std::vector<std::pair<std::string, std::string>> user;
+  };
+
+  // Called for every PUBLISH the device sends, after it has been counted.
+  typedef std::function<void(const char* topic, const uint8_t* payload, size_t length, uint8_t header)> PublishObserver;
+
+  static LoopbackBroker& instance();
+
+  // --- harness side ---
+  void setOnline(bool online);
+  bool online() const { return online_; }
+  void dropSession();
+  bool inject(const char* topic, const uint8_t* payload, size_t length, uint8_t qos = 0, bool retain = false);
+  bool inject(const char* topic, const char* payload);
+  void setPublishObserver(PublishObserver observer) { observer_ = observer; }
+  void setLoopback(bool loopback) { loopback_ = loopback; }
+  // Withhold every Nth PUBACK for the device's QoS 1 publishes, as if it
+  // was lost on the way (0 = none); the message itself still counts.
+  void setPubackLoss(uint32_t everyN) { pubackLossEvery_ = everyN; }
+  // Leave CONNECTs unanswered, like a broker that accepts connections but
+  // is not serving them yet
+  void setConnackHeld(bool held) { connackHeld_ = held; }
+  // MQTT 5: refused (as a 3.1.1 broker would) when off; the CONNACK limits
+  // when on. A receive maximum of 0 leaves it out of the CONNACK.
+  void setMqtt5(bool enabled) { mqtt5_ = enabled; }
+  void setTopicAliasMaximum(uint16_t aliases) { aliasMaximum_ = aliases; }
+  void setReceiveMaximum(uint16_t messages) { receiveMaximum_ = messages; }
+  bool sessionV5() const { return v5_; }
+  // What the device asked for in its CONNECT (v5; 0 = not given)
+  uint16_t deviceReceiveMaximum() const { return deviceReceiveMaximum_; }
+  uint32_t deviceMaximumPacket() const { return deviceMaximumPacket_; }
+  const PublishProperties& lastProperties() const { return properties_; }
+  const Stats& stats() const { return stats_; }
+  void resetStats();
+  size_t pendingToDevice() const { return outbound_.size() - readPos_; }
+  static bool topicMatches(const char* filter, const char* topic);
+
+  // --- device side, used by WiFiClient ---
+  int accept();
+  void close();
+  bool sessionOpen() const { return session_; }
+  size_t receive(const uint8_t* data, size_t length);
+  size_t receive(const struct iovec* parts, int count);  // one write call
+  int available() const;
+  int read();
+  int read(uint8_t* buf, size_t size);
+  int peek() const;
+
+private:
+  LoopbackBroker();
+
+  void takeInbound();
+  void handlePacket(const uint8_t* packet, size_t length);
+  void handleConnect(const uint8_t* body, size_t length);
+  void handlePublish(uint8_t header, const uint8_t* body, size_t length);
+  void handleSubscribe(const uint8_t* body, size_t length);
+  void handleUnsubscribe(const uint8_t* body, size_t length);
+  void handlePuback();
+  bool readProperties(const uint8_t* body, size_t length, size_t* pos);
+  void send(const uint8_t* data, size_t length);
+  void sendPacket(uint8_t header, const uint8_t* body, size_t length);
+  void deliver(const char* topic, size_t topicLength, const uint8_t* payload, size_t length, uint8_t qos, bool retain);
+
+  struct Held {
+    std::string topic;
+    std::vector<uint8_t> payload;
+    bool retain;
+  };
+
+  bool online_;
+  bool mqtt5_;
+  bool v5_;
+  uint16_t aliasMaximum_;
+  uint16_t receiveMaximum_;
+  uint16_t deviceReceiveMaximum_;
+  uint32_t deviceMaximumPacket_;
+  uint16_t unacked_;  // QoS 1 deliveries the device has not acknowledged
+  std::vector<std::string> aliases_;
+  std::vector<Held> held_;
+  PublishProperties properties_;
+  bool session_;
+  bool loopback_;
+  uint16_t nextPacketId_;
+  uint32_t pubackLossEvery_;
+  uint32_t pubacksDue_;
+  bool connackHeld_;
+  std::vector<std::string> subscriptions_;
+  std::string topic_;
+  std::vector<uint8_t> inbound_;
+  std::vector<uint8_t> outbound_;
+  size_t readPos_;
+  Stats stats_;
+  PublishObserver observer_;
+};
+
+#endif
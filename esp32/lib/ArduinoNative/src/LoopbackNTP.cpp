@@ -0,0 +1,93 @@
+/*
+  LoopbackNTP.cpp - in-process SNTP server stand-in.
+*/
+
+#include "LoopbackNTP.h"
+
+#include <string.h>
+
+#include "NativeSim.h"
+
+namespace {
+
+const uint64_t kEpochAtBootMillis = 1700000000000ULL;  // as LoopbackRTDB
+const uint64_t kNtpUnixOffset = 2208988800ULL;         // 1900-01-01 to 1970-01-01, seconds
+
+}  // namespace
+
+LoopbackNTP& LoopbackNTP::instance() {
+  static LoopbackNTP ntp;
+  return ntp;
+}
+
+LoopbackNTP::LoopbackNTP() {
+  reset();
+}
+
+void LoopbackNTP::reset() {
+  online_ = true;
+  unsynchronized_ = false;
+  delayMicros_ = 20000;
+  lossEvery_ = 0;
+  stepMillis_ = 0;
+  replies_.clear();
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+uint64_t LoopbackNTP::serverTime() const {
+  return serverTimeAt(nativesim::nowMicros());
+}
+
+uint64_t LoopbackNTP::serverTimeAt(uint64_t micros) const {
+  return kEpochAtBootMillis + micros / 1000ULL + stepMillis_;
+}
+
+// 32.32 fixed point seconds since 1900, big-endian
+void LoopbackNTP::putTimestamp(uint8_t* at, uint64_t epochMillis) {
+  uint32_t seconds = (uint32_t)(epochMillis / 1000 + kNtpUnixOffset);
+  uint32_t fraction = (uint32_t)(((epochMillis % 1000) << 32) / 1000);
+  for (int i = 0; i < 4; i++) {
+    at[i] = seconds >> (24 - 8 * i);
+    at[4 + i] = fraction >> (24 - 8 * i);
+  }
+}
+
+void LoopbackNTP::receive(const uint8_t* data, size_t length) {
+  if (length < kPacketSize || (data[0] & 0x07) != 3) {
+    stats_.malformed++;
+    return;
+  }
+  stats_.requests++;
+  if (!online_ || (lossEvery_ && stats_.requests % lossEvery_ == 0)) {
+    stats_.lost++;
+    return;
+  }
+
+  uint64_t now = nativesim::nowMicros();
+  uint64_t stamped = serverTimeAt(now + delayMicros_ / 2);
+  Reply reply;
+  reply.atMicros = now + delayMicros_;
+  reply.packet.assign(kPacketSize, 0);
+  uint8_t* p = reply.packet.data();
+  uint8_t version = (data[0] >> 3) & 0x07;
+  p[0] = (unsynchronized_ ? 0xC0 : 0x00) | (version << 3) | 4;  // LI, VN, mode 4 (server)
+  p[1] = unsynchronized_ ? 0 : 1;                                // stratum
+  p[2] = data[2];                                                // poll
+  p[3] = 0xEC;                                                   // precision ~2^-20 s
+  memcpy(p + 12, "GPS", 3);                                      // reference id
+  putTimestamp(p + 16, stamped - 16000);                         // reference
+  memcpy(p + 24, data + 40, 8);                                  // originate = client transmit
+  putTimestamp(p + 32, stamped);                                 // receive
+  putTimestamp(p + 40, stamped);                                 // transmit
+  replies_.push_back(reply);
+}
+
+bool LoopbackNTP::nextReply(std::vector<uint8_t>* packet) {
+  if (replies_.empty() || replies_.front().atMicros > nativesim::nowMicros()) {
+    return false;
+  }
+  *packet = replies_.front().packet;
+  replies_.pop_front();
+  stats_.replies++;
+  return true;
+}
@@ -0,0 +1,72 @@
+/*
+  LoopbackNTP.h - in-process SNTP server stand-in.
+
+  WiFiUDP on the native build sends its datagrams here. A well-formed client
+  request (48 bytes, mode 3) is answered with a stratum 1 server reply whose
+  receive and transmit timestamps come from the server clock: the same
+  epoch as LoopbackRTDB::serverTime() plus whatever step the harness has
+  applied. Each reply is delivered `delay` of virtual time after the
+  request, half of it spent on the way out. The harness can take the server
+  down, lose every Nth reply or make it answer as unsynchronized.
+*/
+
+#ifndef LoopbackNTP_h
+#define LoopbackNTP_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
+class LoopbackNTP {
+public:
+  struct Stats {
+    uint32_t requests;
+    uint32_t replies;    // delivered to the device
+    uint32_t lost;       // withheld by setReplyLoss() or sent while down
+    uint32_t malformed;  // datagrams that were not a client request
+  };
+
+  static const size_t kPacketSize = 48;
+
+  static LoopbackNTP& instance();
+
+  // --- harness side ---
+  void setOnline(bool online) { online_ = online; }
+  bool online() const { return online_; }
+  void setDelayMicros(uint32_t us) { delayMicros_ = us; }
+  void setReplyLoss(uint32_t everyN) { lossEvery_ = everyN; }
+  // Leap indicator 3 / stratum 0: a server that has lost its own reference
+  void setUnsynchronized(bool unsynchronized) { unsynchronized_ = unsynchronized; }
+  // Moves the server clock, as an upstream correction would
+  void step(int64_t ms) { stepMillis_ += ms; }
+  uint64_t serverTime() const;  // epoch milliseconds
+  const Stats& stats() const { return stats_; }
+  void reset();
+
+  // --- device side, used by the WiFiUDP stand-in ---
+  void receive(const uint8_t* data, size_t length);
+  bool nextReply(std::vector<uint8_t>* packet);
+
+private:
+  struct Reply {
+    uint64_t atMicros;
+    std::vector<uint8_t> packet;
+  };
+
+  LoopbackNTP();
+
+  uint64_t serverTimeAt(uint64_t micros) const;
+  static void putTimestamp(uint8_t* at, uint64_t epochMillis);
+
+  bool online_;
+  bool unsynchronized_;
+  uint32_t delayMicros_;
+  uint32_t lossEvery_;
+  int64_t stepMillis_;
+  std::deque<Reply> replies_;
+  Stats stats_;
+};
+
+#endif
@@ -0,0 +1,294 @@
+/*
+  LoopbackRTDB.cpp - in-process Firebase Realtime Database stand-in.
+*/
+
+#include "LoopbackRTDB.h"
+
+#include <string.h>
+
+#include "NativeSim.h"
+
+namespace {
+
+const uint64_t kEpochAtBootMillis = 1700000000000ULL;
+
+bool isPrefix(const std::vector<std::string>& prefix, const std::vector<std::string>& path) {
+  if (prefix.size() > path.size()) return false;
+  for (size_t i = 0; i < prefix.size(); i++) {
+    if (prefix[i] != path[i]) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+LoopbackRTDB& LoopbackRTDB::instance() {
+  static LoopbackRTDB rtdb;
+  return rtdb;
+}
+
+LoopbackRTDB::LoopbackRTDB() : online_(true), latencyMicros_(80000), nextStreamId_(1) {
+  resetStats();
+}
+
+void LoopbackRTDB::resetStats() {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+uint64_t LoopbackRTDB::serverTime() const {
+  return kEpochAtBootMillis + nativesim::nowMicros() / 1000ULL;
+}
+
+void LoopbackRTDB::setOnline(bool online) {
+  online_ = online;
+  if (!online_) dropStreams();
+}
+
+void LoopbackRTDB::dropStreams() {
+  for (StreamState& stream : streams_) {
+    stream.alive = false;
+    stream.events.clear();
+  }
+}
+
+size_t LoopbackRTDB::openStreams() const {
+  size_t n = 0;
+  for (const StreamState& stream : streams_) {
+    if (stream.alive) n++;
+  }
+  return n;
+}
+
+void LoopbackRTDB::dashboardSet(const char* path, JsonVariantConst value) {
+  write(split(path), value);
+}
+
+JsonVariantConst LoopbackRTDB::peek(const char* path) const {
+  return find(split(path));
+}
+
+bool LoopbackRTDB::roundTrip(const char* path) {
+  nativesim::advanceMicros(latencyMicros_);
+  if (!online_) {
+    stats_.refused++;
+    return false;
+  }
+  stats_.requests++;
+  stats_.bytesUp += strlen(path);
+  return true;
+}
+
+bool LoopbackRTDB::get(const char* path, JsonDocument& out) {
+  if (!roundTrip(path)) return false;
+  stats_.reads++;
+  out.set(find(split(path)));
+  stats_.bytesDown += measureJson(out);
+  return true;
+}
+
+bool LoopbackRTDB::set(const char* path, JsonVariantConst value) {
+  if (!roundTrip(path)) return false;
+  stats_.writes++;
+  stats_.bytesUp += measureJson(value);
+  write(split(path), value);
+  return true;
+}
+
+bool LoopbackRTDB::update(const char* path, JsonObjectConst patch) {
+  if (!roundTrip(path)) return false;
+  stats_.writes++;
+  stats_.bytesUp += measureJson(patch);
+
+  JsonDocument resolved;
+  resolved.set(patch);
+  resolveServerValues(resolved.as<JsonVariant>());
+
+  std::vector<std::string> base = split(path);
+  std::vector<std::vector<std::string> > targets;
+  for (JsonPairConst kv : resolved.as<JsonObjectConst>()) {
+    std::vector<std::string> target = base;
+    for (const std::string& segment : split(kv.key().c_str())) target.push_back(segment);
+    JsonVariant parent = locate(std::vector<std::string>(target.begin(), target.end() - 1), true);
+    if (kv.value().isNull()) {
+      parent.as<JsonObject>().remove(target.back());
+    } else {
+      parent.as<JsonObject>()[target.back()].set(kv.value());
+    }
+    targets.push_back(target);
+  }
+  notifyPatch(targets, resolved.as<JsonObjectConst>());
+  return true;
+}
+
+int LoopbackRTDB::openStream(const char* path) {
+  if (!roundTrip(path)) return -1;
+  stats_.streamOpens++;
+  StreamState stream;
+  stream.id = nextStreamId_++;
+  stream.path = split(path);
+  stream.alive = true;
+  Event initial;
+  initial.type = "put";
+  initial.path = "/";
+  serializeJson(find(stream.path), initial.data);
+  stream.events.push_back(initial);
+  streams_.push_back(stream);
+  return stream.id;
+}
+
+void LoopbackRTDB::closeStream(int id) {
+  for (size_t i = 0; i < streams_.size(); i++) {
+    if (streams_[i].id == id) {
+      streams_.erase(streams_.begin() + i);
+      return;
+    }
+  }
+}
+
+bool LoopbackRTDB::streamAlive(int id) const {
+  for (const StreamState& stream : streams_) {
+    if (stream.id == id) return stream.alive && online_;
+  }
+  return false;
+}
+
+bool LoopbackRTDB::nextEvent(int id, Event* event) {
+  for (StreamState& stream : streams_) {
+    if (stream.id != id) continue;
+    if (!stream.alive || stream.events.empty()) return false;
+    *event = stream.events.front();
+    stream.events.pop_front();
+    stats_.streamEvents++;
+    stats_.bytesDown += event->data.size();
+    return true;
+  }
+  return false;
+}
+
+void LoopbackRTDB::write(const std::vector<std::string>& path, JsonVariantConst value) {
+  JsonDocument resolved;
+  resolved.set(value);
+  resolveServerValues(resolved.as<JsonVariant>());
+
+  if (path.empty()) {
+    tree_.set(resolved);
+  } else {
+    JsonVariant parent = locate(std::vector<std::string>(path.begin(), path.end() - 1), true);
+    if (resolved.isNull()) {
+      parent.as<JsonObject>().remove(path.back());
+    } else {
+      parent.as<JsonObject>()[path.back()].set(resolved);
+    }
+  }
+  notify(path, "put", resolved.as<JsonVariantConst>());
+}
+
+// Streams at or above the written path get the change itself; streams below
+// it get their whole (replaced) subtree, like the real server.
+void LoopbackRTDB::notify(const std::vector<std::string>& path, const char* type, JsonVariantConst value) {
+  for (StreamState& stream : streams_) {
+    if (!stream.alive) continue;
+    Event event;
+    if (isPrefix(stream.path, path)) {
+      event.type = type;
+      event.path = join(path, stream.path.size());
+      serializeJson(value, event.data);
+    } else if (isPrefix(path, stream.path)) {
+      event.type = "put";
+      event.path = "/";
+      serializeJson(find(stream.path), event.data);
+    } else {
+      continue;
+    }
+    stream.events.push_back(event);
+  }
+}
+
+// A multi-path update reaches each stream as one patch holding only the
+// locations under it, keyed relative to the stream; a location at or above
+// the stream replaces its subtree and becomes a put instead.
+void LoopbackRTDB::notifyPatch(const std::vector<std::vector<std::string> >& targets, JsonObjectConst values) {
+  for (StreamState& stream : streams_) {
+    if (!stream.alive) continue;
+    JsonDocument patch;
+    bool replaced = false;
+    size_t i = 0;
+    for (JsonPairConst kv : values) {
+      const std::vector<std::string>& target = targets[i++];
+      if (isPrefix(target, stream.path)) {
+        replaced = true;
+      } else if (isPrefix(stream.path, target)) {
+        patch[join(target, stream.path.size()).substr(1)] = kv.value();
+      }
+    }
+    Event event;
+    event.path = "/";
+    if (replaced) {
+      event.type = "put";
+      serializeJson(find(stream.path), event.data);
+    } else if (patch.size()) {
+      event.type = "patch";
+      serializeJson(patch, event.data);
+    } else {
+      continue;
+    }
+    stream.events.push_back(event);
+  }
+}
+
+JsonVariant LoopbackRTDB::locate(const std::vector<std::string>& path, bool create) {
+  JsonVariant node = tree_.as<JsonVariant>();
+  for (const std::string& segment : path) {
+    if (!node.is<JsonObject>()) {
+      if (!create) return JsonVariant();
+      node.to<JsonObject>();
+    }
+    JsonObject object = node.as<JsonObject>();
+    if (create && !object[segment].is<JsonObject>()) object[segment].to<JsonObject>();
+    node = object[segment];
+  }
+  if (create && !node.is<JsonObject>()) node.to<JsonObject>();
+  return node;
+}
+
+JsonVariantConst LoopbackRTDB::find(const std::vector<std::string>& path) const {
+  JsonVariantConst node = tree_.as<JsonVariantConst>();
+  for (const std::string& segment : path) {
+    if (!node.is<JsonObjectConst>()) return JsonVariantConst();
+    node = node[segment];
+  }
+  return node;
+}
+
+// {".sv": "timestamp"} placeholders become the server's clock.
+void LoopbackRTDB::resolveServerValues(JsonVariant value) {
+  if (!value.is<JsonObject>()) return;
+  JsonObject object = value.as<JsonObject>();
+  if (object.size() == 1 && object[".sv"] == "timestamp") {
+    value.set(serverTime());
+    return;
+  }
+  for (JsonPair kv : object) resolveServerValues(kv.value());
+}
+
+std::vector<std::string> LoopbackRTDB::split(const char* path) {
+  std::vector<std::string> segments;
+  const char* p = path;
+  while (*p) {
+    while (*p == '/') p++;
+    const char* start = p;
+    while (*p && *p != '/') p++;
+    if (p > start) segments.push_back(std::string(start, p - start));
+  }
+  return segments;
+}
+
+std::string LoopbackRTDB::join(const std::vector<std::string>& path, size_t from) {
+  if (from >= path.size()) return "/";
+  std::string joined;
+  for (size_t i = from; i < path.size(); i++) {
+    joined += "/";
+    joined += path[i];
+  }
+  return joined;
+}
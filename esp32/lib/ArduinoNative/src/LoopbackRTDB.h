@@ -0,0 +1,94 @@
+/*
+  LoopbackRTDB.h - in-process Firebase Realtime Database stand-in.
+
+  The Firebase_ESP_Client stand-in talks to this instead of the REST API.
+  Every get/set/update the device makes counts as one HTTPS round-trip and
+  costs `latencyMicros` of virtual time, so blocking calls show up in loop
+  timing. Streams receive the same put/patch events the real server sends,
+  starting with a put of the whole subtree. The harness plays the dashboard
+  with dashboardSet(), and can take the server down or cut open streams.
+*/
+
+#ifndef LoopbackRTDB_h
+#define LoopbackRTDB_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ArduinoJson.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+class LoopbackRTDB {
+public:
+  struct Stats {
+    uint32_t requests;      // REST round-trips: reads + writes + stream opens
+    uint32_t reads;
+    uint32_t writes;        // set and multi-path update requests
+    uint32_t streamOpens;
+    uint32_t streamEvents;  // events delivered to device streams
+    uint32_t refused;       // requests made while the server was down
+    uint64_t bytesUp;       // request paths and bodies
+    uint64_t bytesDown;     // response bodies and stream events
+  };
+
+  struct Event {
+    std::string type;  // "put" or "patch"
+    std::string path;  // relative to the stream path, "/" for the root
+    std::string data;  // serialized JSON
+  };
+
+  static LoopbackRTDB& instance();
+
+  // --- harness side ---
+  void setOnline(bool online);
+  bool online() const { return online_; }
+  void setLatencyMicros(uint32_t us) { latencyMicros_ = us; }
+  void dashboardSet(const char* path, JsonVariantConst value);
+  JsonVariantConst peek(const char* path) const;
+  void dropStreams();
+  size_t openStreams() const;
+  const Stats& stats() const { return stats_; }
+  void resetStats();
+  uint64_t serverTime() const;  // epoch milliseconds, follows the virtual clock
+
+  // --- device side, used by the Firebase_ESP_Client stand-in ---
+  bool get(const char* path, JsonDocument& out);
+  bool set(const char* path, JsonVariantConst value);
+  bool update(const char* path, JsonObjectConst patch);
+  int openStream(const char* path);
+  void closeStream(int id);
+  bool streamAlive(int id) const;
+  bool nextEvent(int id, Event* event);
+
+private:
+  struct StreamState {
+    int id;
+    std::vector<std::string> path;
+    bool alive;
+    std::deque<Event> events;
+  };
+
+  LoopbackRTDB();
+
+  bool roundTrip(const char* path);
+  void write(const std::vector<std::string>& path, JsonVariantConst value);
+  void notify(const std::vector<std::string>& path, const char* type, JsonVariantConst value);
+  void notifyPatch(const std::vector<std::vector<std::string> >& targets, JsonObjectConst values);
+  JsonVariant locate(const std::vector<std::string>& path, bool create);
+  JsonVariantConst find(const std::vector<std::string>& path) const;
+  void resolveServerValues(JsonVariant value);
+  static std::vector<std::string> split(const char* path);
+  static std::string join(const std::vector<std::string>& path, size_t from);
+
+  bool online_;
+  uint32_t latencyMicros_;
+  int nextStreamId_;
+  JsonDocument tree_;
+  std::vector<StreamState> streams_;
+  Stats stats_;
+};
+
+#endif
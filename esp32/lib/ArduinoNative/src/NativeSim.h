@@ -0,0 +1,77 @@
+/*
+  NativeSim.h - harness-side controls for the host stand-ins.
+
+  The firmware only sees the Arduino API; the simulation driver uses these
+  functions to move the virtual clock, drive input pins, pick the MAC the
+  device boots with and feed the DHT stand-in.
+*/
+
+#ifndef NativeSim_h
+#define NativeSim_h
+
+#include <stdint.h>
+
+namespace nativesim {
+
+// Virtual clock. millis()/micros() read it, delay() and yield() advance it.
+uint64_t nowMicros();
+void advanceMicros(uint64_t us);
+inline void advanceMillis(uint64_t ms) { advanceMicros(ms * 1000ULL); }
+void resetClock();
+
+// CPU charging. Firmware code normally runs in zero virtual time, so a
+// press handled right after its edge shows 0 us latency. With a scale set,
+// the host CPU time the calling thread spends between beginCpuCharge() and
+// endCpuCharge(), times the scale, is added to the clock whenever the
+// firmware reads or moves it, so handler and scheduler work shows up in
+// the timestamps. Timings then depend on the host and differ between runs.
+void setCpuScale(uint32_t virtualMicrosPerHostMicro);  // 0 turns it off
+void beginCpuCharge();
+void endCpuCharge();
+
+// Idle waits. TaskWheel::idle() sleeps through idleMicros(); the harness
+// calls setWakeAt() with the time of its next scheduled event (a command, a
+// button edge) so the sleep ends there, the way a socket or GPIO wakeup ends
+// it on the board. A wake time that is already due (data was just injected)
+// ends the sleep at once. idleMicros() returns true when it was cut short.
+void setWakeAt(uint64_t atMicros);
+bool idleMicros(uint64_t us);
+
+// GPIO. Inputs read back whatever the harness last set; outputs read back the
+// last digitalWrite(). Pins default to HIGH (idle pulled-up buttons). A level
+// change runs the pin's attachInterrupt() handler. schedulePinLevel() queues
+// the change for a later virtual time: it lands while the clock passes that
+// time, inside delay() or a blocking call, and ends an idle sleep early.
+void setPinLevel(uint8_t pin, int level);
+void schedulePinLevel(uint8_t pin, int level, uint64_t atMicros);
+int pinLevel(uint8_t pin);
+uint32_t pinWriteCount(uint8_t pin);
+uint64_t pinChangedAt(uint8_t pin);  // virtual time of the last digitalWrite() that changed the level
+
+// Identity returned by WiFi.macAddress() and ESP.getEfuseMac().
+void setMacAddress(const uint8_t mac[6]);
+const uint8_t* macAddress();
+
+// DHT stand-in readings. A failed sensor returns NaN like the real driver.
+void setSensorReading(float temperature, float humidity);
+void setSensorFailed(bool failed);
+float sensorTemperature();
+float sensorHumidity();
+bool sensorFailed();
+
+// Serial output is swallowed unless echo is enabled.
+void setSerialEcho(bool echo);
+
+// Text fed to Serial.read() / Serial.available().
+void feedSerial(const char* text);
+
+// ESP.restart() calls this handler; without one the process exits.
+void setRestartHandler(void (*handler)());
+
+// Flash partitions (esp_partition.h) keep their contents across restarts;
+// this sets every byte back to the erased 0xFF.
+void eraseFlash();
+
+}  // namespace nativesim
+
+#endif
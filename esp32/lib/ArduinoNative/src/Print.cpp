@@ -0,0 +1,81 @@
+/*
+  Print.cpp - host stand-in for Arduino's Print class.
+*/
+
+#include "Print.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (!write(*buffer++)) break;
+    n++;
+  }
+  return n;
+}
+
+size_t Print::write(const char* str) {
+  return str ? write((const uint8_t*)str, strlen(str)) : 0;
+}
+
+size_t Print::printf(const char* format, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (len < 0) return 0;
+  if ((size_t)len >= sizeof(buf)) len = sizeof(buf) - 1;
+  return write((const uint8_t*)buf, (size_t)len);
+}
+
+size_t Print::print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+size_t Print::print(const char* str) { return write(str); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+// Numbers are formatted on the stack like the real core does, so printing
+// them never shows up in the simulator's allocation counts.
+size_t Print::print(unsigned char n, int base) { return printNumber(n, base); }
+size_t Print::print(int n, int base) { return print((long)n, base); }
+size_t Print::print(unsigned int n, int base) { return printNumber(n, base); }
+size_t Print::print(unsigned long n, int base) { return printNumber(n, base); }
+
+size_t Print::print(long n, int base) {
+  if (base == 10 && n < 0) return write('-') + printNumber(0UL - (unsigned long)n, 10);
+  return printNumber((unsigned long)n, base);
+}
+
+size_t Print::print(double n, int digits) {
+  char buf[48];
+  int len = snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  if (len < 0) return 0;
+  if ((size_t)len >= sizeof(buf)) len = sizeof(buf) - 1;
+  return write((const uint8_t*)buf, (size_t)len);
+}
+
+size_t Print::printNumber(unsigned long n, int base) {
+  char buf[8 * sizeof(long) + 1];
+  char* p = buf + sizeof(buf);
+  if (base < 2) base = 10;
+  do {
+    unsigned long digit = n % base;
+    n /= base;
+    *--p = (char)(digit < 10 ? '0' + digit : 'A' + digit - 10);
+  } while (n);
+  return write((const uint8_t*)p, (size_t)(buf + sizeof(buf) - p));
+}
+size_t Print::print(const Printable& p) { return p.printTo(*this); }
+
+size_t Print::println() { return write("\r\n"); }
+size_t Print::println(const String& s) { return print(s) + println(); }
+size_t Print::println(const char* str) { return print(str) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char n, int base) { return print(n, base) + println(); }
+size_t Print::println(int n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned int n, int base) { return print(n, base) + println(); }
+size_t Print::println(long n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned long n, int base) { return print(n, base) + println(); }
+size_t Print::println(double n, int digits) { return print(n, digits) + println(); }
+size_t Print::println(const Printable& p) { return print(p) + println(); }
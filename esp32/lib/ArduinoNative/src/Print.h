@@ -0,0 +1,55 @@
+/*
+  Print.h - host stand-in for Arduino's Print class.
+*/
+
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "WString.h"
+#include "Printable.h"
+
+class Print {
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* str);
+  size_t write(const char* buffer, size_t size) {
+    return write((const uint8_t*)buffer, size);
+  }
+  virtual void flush() {}
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+  size_t print(const String& s);
+  size_t print(const char* str);
+  size_t print(char c);
+  size_t print(unsigned char n, int base = 10);
+  size_t print(int n, int base = 10);
+  size_t print(unsigned int n, int base = 10);
+  size_t print(long n, int base = 10);
+  size_t print(unsigned long n, int base = 10);
+  size_t print(double n, int digits = 2);
+  size_t print(const Printable& p);
+
+  size_t println();
+  size_t println(const String& s);
+  size_t println(const char* str);
+  size_t println(char c);
+  size_t println(unsigned char n, int base = 10);
+  size_t println(int n, int base = 10);
+  size_t println(unsigned int n, int base = 10);
+  size_t println(long n, int base = 10);
+  size_t println(unsigned long n, int base = 10);
+  size_t println(double n, int digits = 2);
+  size_t println(const Printable& p);
+
+private:
+  size_t printNumber(unsigned long n, int base);
+};
+
+#endif
@@ -0,0 +1,18 @@
+/*
+  Printable.h - host stand-in for Arduino's Printable interface.
+*/
+
+#ifndef Printable_h
+#define Printable_h
+
+#include <stddef.h>
+
+class Print;
+
+class Printable {
+public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print& p) const = 0;
+};
+
+#endif
@@ -0,0 +1,30 @@
+/*
+  Stream.h - host stand-in for Arduino's Stream class.
+*/
+
+#ifndef Stream_h
+#define Stream_h
+
+#include "Print.h"
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { timeout_ = timeout; }
+  unsigned long getTimeout() const { return timeout_; }
+
+  virtual size_t readBytes(char* buffer, size_t length);
+  size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+  String readString();
+  String readStringUntil(char terminator);
+
+protected:
+  int timedRead();
+
+  unsigned long timeout_ = 1000;
+};
+
+#endif
@@ -0,0 +1,312 @@
+/*
+  WString.cpp - host stand-in for Arduino's String class.
+*/
+
+#include "WString.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void formatInteger(char* buf, size_t size, unsigned long long value, bool negative, unsigned char base) {
+  char tmp[66];
+  int pos = 0;
+  if (base < 2 || base > 36) base = 10;
+  do {
+    unsigned digit = (unsigned)(value % base);
+    tmp[pos++] = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+    value /= base;
+  } while (value);
+  size_t out = 0;
+  if (negative && out + 1 < size) buf[out++] = '-';
+  while (pos > 0 && out + 1 < size) buf[out++] = tmp[--pos];
+  buf[out] = 0;
+}
+
+String::String(const char* cstr) : buffer_(nullptr), capacity_(0), len_(0) {
+  if (cstr) copy(cstr, strlen(cstr));
+}
+
+String::String(const char* cstr, unsigned int length) : buffer_(nullptr), capacity_(0), len_(0) {
+  if (cstr) copy(cstr, length);
+}
+
+String::String(const String& str) : buffer_(nullptr), capacity_(0), len_(0) {
+  *this = str;
+}
+
+String::String(String&& rval) : buffer_(nullptr), capacity_(0), len_(0) {
+  move(rval);
+}
+
+String::String(char c) : buffer_(nullptr), capacity_(0), len_(0) {
+  char buf[2] = {c, 0};
+  *this = buf;
+}
+
+String::String(unsigned char value, unsigned char base) : String((unsigned long long)value, base) {}
+String::String(int value, unsigned char base) : String((long long)value, base) {}
+String::String(unsigned int value, unsigned char base) : String((unsigned long long)value, base) {}
+String::String(long value, unsigned char base) : String((long long)value, base) {}
+String::String(unsigned long value, unsigned char base) : String((unsigned long long)value, base) {}
+
+String::String(long long value, unsigned char base) : buffer_(nullptr), capacity_(0), len_(0) {
+  char buf[68];
+  bool negative = value < 0 && base == 10;
+  unsigned long long magnitude = negative ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+  formatInteger(buf, sizeof(buf), magnitude, negative, base);
+  *this = buf;
+}
+
+String::String(unsigned long long value, unsigned char base) : buffer_(nullptr), capacity_(0), len_(0) {
+  char buf[68];
+  formatInteger(buf, sizeof(buf), value, false, base);
+  *this = buf;
+}
+
+String::String(float value, unsigned int decimalPlaces) : String((double)value, decimalPlaces) {}
+
+String::String(double value, unsigned int decimalPlaces) : buffer_(nullptr), capacity_(0), len_(0) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, value);
+  *this = buf;
+}
+
+String::~String() {
+  free(buffer_);
+}
+
+void String::invalidate() {
+  free(buffer_);
+  buffer_ = nullptr;
+  capacity_ = len_ = 0;
+}
+
+bool String::reserve(unsigned int size) {
+  if (buffer_ && capacity_ >= size) return true;
+  if (changeBuffer(size)) {
+    if (len_ == 0) buffer_[0] = 0;
+    return true;
+  }
+  return false;
+}
+
+bool String::changeBuffer(unsigned int maxStrLen) {
+  char* newbuffer = (char*)realloc(buffer_, maxStrLen + 1);
+  if (!newbuffer) return false;
+  buffer_ = newbuffer;
+  capacity_ = maxStrLen;
+  return true;
+}
+
+String& String::copy(const char* cstr, unsigned int length) {
+  if (!reserve(length)) {
+    invalidate();
+    return *this;
+  }
+  len_ = length;
+  memmove(buffer_, cstr, length);
+  buffer_[len_] = 0;
+  return *this;
+}
+
+void String::move(String& rhs) {
+  if (this == &rhs) return;
+  free(buffer_);
+  buffer_ = rhs.buffer_;
+  capacity_ = rhs.capacity_;
+  len_ = rhs.len_;
+  rhs.buffer_ = nullptr;
+  rhs.capacity_ = rhs.len_ = 0;
+}
+
+String& String::operator=(const String& rhs) {
+  if (this == &rhs) return *this;
+  if (rhs.buffer_) copy(rhs.buffer_, rhs.len_);
+  else invalidate();
+  return *this;
+}
+
+String& String::operator=(String&& rval) {
+  move(rval);
+  return *this;
+}
+
+String& String::operator=(const char* cstr) {
+  if (cstr) copy(cstr, strlen(cstr));
+  else invalidate();
+  return *this;
+}
+
+bool String::concat(const char* cstr, unsigned int length) {
+  if (!cstr) return false;
+  if (length == 0) return true;
+  unsigned int newlen = len_ + length;
+  if (!reserve(newlen)) return false;
+  memmove(buffer_ + len_, cstr, length);
+  len_ = newlen;
+  buffer_[len_] = 0;
+  return true;
+}
+
+bool String::concat(const String& s) { return concat(s.c_str(), s.len_); }
+bool String::concat(const char* cstr) { return cstr ? concat(cstr, strlen(cstr)) : false; }
+bool String::concat(char c) { return concat(&c, 1); }
+bool String::concat(int num) { return concat(String(num)); }
+bool String::concat(unsigned int num) { return concat(String(num)); }
+bool String::concat(long num) { return concat(String(num)); }
+bool String::concat(unsigned long num) { return concat(String(num)); }
+bool String::concat(float num) { return concat(String(num)); }
+bool String::concat(double num) { return concat(String(num)); }
+
+int String::compareTo(const String& s) const {
+  return strcmp(c_str(), s.c_str());
+}
+
+bool String::equals(const String& s) const {
+  return len_ == s.len_ && compareTo(s) == 0;
+}
+
+bool String::equals(const char* cstr) const {
+  return strcmp(c_str(), cstr ? cstr : "") == 0;
+}
+
+bool String::equalsIgnoreCase(const String& s) const {
+  if (len_ != s.len_) return false;
+  for (unsigned int i = 0; i < len_; i++) {
+    if (tolower((unsigned char)buffer_[i]) != tolower((unsigned char)s.buffer_[i])) return false;
+  }
+  return true;
+}
+
+bool String::startsWith(const String& prefix) const {
+  return prefix.len_ <= len_ && strncmp(c_str(), prefix.c_str(), prefix.len_) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+  return suffix.len_ <= len_ && strcmp(c_str() + len_ - suffix.len_, suffix.c_str()) == 0;
+}
+
+char String::charAt(unsigned int index) const {
+  return index < len_ ? buffer_[index] : 0;
+}
+
+char& String::operator[](unsigned int index) {
+  static char dummy;
+  if (index >= len_) {
+    dummy = 0;
+    return dummy;
+  }
+  return buffer_[index];
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+  if (fromIndex >= len_) return -1;
+  const char* p = strchr(buffer_ + fromIndex, ch);
+  return p ? (int)(p - buffer_) : -1;
+}
+
+int String::indexOf(const String& str, unsigned int fromIndex) const {
+  if (fromIndex >= len_) return -1;
+  const char* p = strstr(buffer_ + fromIndex, str.c_str());
+  return p ? (int)(p - buffer_) : -1;
+}
+
+int String::lastIndexOf(char ch) const {
+  if (!buffer_) return -1;
+  const char* p = strrchr(buffer_, ch);
+  return p ? (int)(p - buffer_) : -1;
+}
+
+String String::substring(unsigned int left, unsigned int right) const {
+  if (left > right) {
+    unsigned int tmp = left;
+    left = right;
+    right = tmp;
+  }
+  if (left >= len_) return String();
+  if (right > len_) right = len_;
+  return String(buffer_ + left, right - left);
+}
+
+void String::replace(const String& find, const String& replace) {
+  if (len_ == 0 || find.len_ == 0) return;
+  String out;
+  out.reserve(len_);
+  const char* readFrom = buffer_;
+  const char* found;
+  while ((found = strstr(readFrom, find.c_str())) != nullptr) {
+    out.concat(readFrom, (unsigned int)(found - readFrom));
+    out.concat(replace);
+    readFrom = found + find.len_;
+  }
+  out.concat(readFrom);
+  move(out);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index >= len_) return;
+  if (count > len_ - index) count = len_ - index;
+  memmove(buffer_ + index, buffer_ + index + count, len_ - index - count + 1);
+  len_ -= count;
+}
+
+void String::toLowerCase() {
+  for (unsigned int i = 0; i < len_; i++) buffer_[i] = (char)tolower((unsigned char)buffer_[i]);
+}
+
+void String::toUpperCase() {
+  for (unsigned int i = 0; i < len_; i++) buffer_[i] = (char)toupper((unsigned char)buffer_[i]);
+}
+
+void String::trim() {
+  if (len_ == 0) return;
+  unsigned int begin = 0;
+  while (begin < len_ && isspace((unsigned char)buffer_[begin])) begin++;
+  unsigned int end = len_;
+  while (end > begin && isspace((unsigned char)buffer_[end - 1])) end--;
+  len_ = end - begin;
+  if (begin > 0) memmove(buffer_, buffer_ + begin, len_);
+  buffer_[len_] = 0;
+}
+
+long String::toInt() const {
+  return buffer_ ? atol(buffer_) : 0;
+}
+
+float String::toFloat() const {
+  return buffer_ ? (float)atof(buffer_) : 0;
+}
+
+String operator+(const String& lhs, const String& rhs) {
+  String s(lhs);
+  s.concat(rhs);
+  return s;
+}
+
+String operator+(const String& lhs, const char* rhs) {
+  String s(lhs);
+  s.concat(rhs);
+  return s;
+}
+
+String operator+(const char* lhs, const String& rhs) {
+  String s(lhs);
+  s.concat(rhs);
+  return s;
+}
+
+String operator+(const String& lhs, char rhs) {
+  String s(lhs);
+  s.concat(rhs);
+  return s;
+}
+
+bool operator==(const char* lhs, const String& rhs) {
+  return rhs.equals(lhs);
+}
+
+bool operator!=(const char* lhs, const String& rhs) {
+  return !rhs.equals(lhs);
+}
@@ -0,0 +1,110 @@
+/*
+  WString.h - host stand-in for Arduino's String class.
+
+  Storage is malloc/realloc based like the real core, so allocation counts
+  measured on the host track what the firmware does to the ESP32 heap.
+*/
+
+#ifndef String_class_h
+#define String_class_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+class __FlashStringHelper;
+
+class String {
+public:
+  String(const char* cstr = "");
+  String(const char* cstr, unsigned int length);
+  String(const String& str);
+  String(String&& rval);
+  explicit String(char c);
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(float value, unsigned int decimalPlaces = 2);
+  explicit String(double value, unsigned int decimalPlaces = 2);
+  ~String();
+
+  bool reserve(unsigned int size);
+  unsigned int length() const { return len_; }
+  bool isEmpty() const { return len_ == 0; }
+
+  String& operator=(const String& rhs);
+  String& operator=(String&& rval);
+  String& operator=(const char* cstr);
+
+  bool concat(const String& str);
+  bool concat(const char* cstr);
+  bool concat(const char* cstr, unsigned int length);
+  bool concat(char c);
+  bool concat(int num);
+  bool concat(unsigned int num);
+  bool concat(long num);
+  bool concat(unsigned long num);
+  bool concat(float num);
+  bool concat(double num);
+
+  String& operator+=(const String& rhs) { concat(rhs); return *this; }
+  String& operator+=(const char* cstr) { concat(cstr); return *this; }
+  String& operator+=(char c) { concat(c); return *this; }
+  String& operator+=(int num) { concat(num); return *this; }
+  String& operator+=(unsigned int num) { concat(num); return *this; }
+  String& operator+=(long num) { concat(num); return *this; }
+  String& operator+=(unsigned long num) { concat(num); return *this; }
+
+  int compareTo(const String& s) const;
+  bool equals(const String& s) const;
+  bool equals(const char* cstr) const;
+  bool equalsIgnoreCase(const String& s) const;
+  bool operator==(const String& rhs) const { return equals(rhs); }
+  bool operator==(const char* cstr) const { return equals(cstr); }
+  bool operator!=(const String& rhs) const { return !equals(rhs); }
+  bool operator!=(const char* cstr) const { return !equals(cstr); }
+  bool startsWith(const String& prefix) const;
+  bool endsWith(const String& suffix) const;
+
+  char charAt(unsigned int index) const;
+  char operator[](unsigned int index) const { return charAt(index); }
+  char& operator[](unsigned int index);
+  const char* c_str() const { return buffer_ ? buffer_ : ""; }
+
+  int indexOf(char ch, unsigned int fromIndex = 0) const;
+  int indexOf(const String& str, unsigned int fromIndex = 0) const;
+  int lastIndexOf(char ch) const;
+  String substring(unsigned int beginIndex) const { return substring(beginIndex, len_); }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+  void replace(const String& find, const String& replace);
+  void remove(unsigned int index, unsigned int count = (unsigned int)-1);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long toInt() const;
+  float toFloat() const;
+
+private:
+  bool changeBuffer(unsigned int maxStrLen);
+  String& copy(const char* cstr, unsigned int length);
+  void move(String& rhs);
+  void invalidate();
+
+  char* buffer_;
+  unsigned int capacity_;
+  unsigned int len_;
+};
+
+String operator+(const String& lhs, const String& rhs);
+String operator+(const String& lhs, const char* rhs);
+String operator+(const char* lhs, const String& rhs);
+String operator+(const String& lhs, char rhs);
+bool operator==(const char* lhs, const String& rhs);
+bool operator!=(const char* lhs, const String& rhs);
+
+#endif
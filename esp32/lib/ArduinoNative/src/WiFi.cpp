@@ -0,0 +1,132 @@
+/*
+  WiFi.cpp - host stand-in for the Arduino-ESP32 WiFi library.
+*/
+
+#include "WiFi.h"
+#include "LoopbackBroker.h"
+#include "NativeSim.h"
+#include "lwip/sockets.h"
+
+WiFiClass WiFi;
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  (void)ip;
+  (void)port;
+  if (WiFi.status() != WL_CONNECTED) return 0;
+  open_ = LoopbackBroker::instance().accept() == 1;
+  return open_ ? 1 : 0;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  (void)host;
+  return connect(IPAddress(), port);
+}
+
+size_t WiFiClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t size) {
+  if (!connected()) return 0;
+  return LoopbackBroker::instance().receive(buf, size);
+}
+
+int WiFiClient::available() {
+  return connected() ? LoopbackBroker::instance().available() : 0;
+}
+
+int WiFiClient::read() {
+  return connected() ? LoopbackBroker::instance().read() : -1;
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size) {
+  return connected() ? LoopbackBroker::instance().read(buf, size) : -1;
+}
+
+int WiFiClient::peek() {
+  return connected() ? LoopbackBroker::instance().peek() : -1;
+}
+
+void WiFiClient::stop() {
+  if (open_ && LoopbackBroker::instance().sessionOpen()) {
+    LoopbackBroker::instance().close();
+  }
+  open_ = false;
+}
+
+uint8_t WiFiClient::connected() {
+  if (open_ && !LoopbackBroker::instance().sessionOpen()) open_ = false;
+  return open_ ? 1 : 0;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase) {
+  (void)ssid;
+  (void)passphrase;
+  status_ = WL_CONNECTED;
+  return status_;
+}
+
+wl_status_t WiFiClass::status() { return status_; }
+
+bool WiFiClass::disconnect(bool wifioff) {
+  (void)wifioff;
+  setStatus(WL_DISCONNECTED);
+  return true;
+}
+
+bool WiFiClass::reconnect() {
+  setStatus(WL_CONNECTED);
+  return true;
+}
+
+bool WiFiClass::setSleep(bool enabled) { (void)enabled; return true; }
+bool WiFiClass::setAutoReconnect(bool autoReconnect) { (void)autoReconnect; return true; }
+bool WiFiClass::persistent(bool persistent) { (void)persistent; return true; }
+bool WiFiClass::setTxPower(wifi_power_t power) { (void)power; return true; }
+
+int WiFiClass::onEvent(WiFiEventFuncCb callback, WiFiEvent_t event) {
+  handlers_.push_back({callback, event});
+  return (int)handlers_.size();
+}
+
+void WiFiClass::setStatus(wl_status_t status) {
+  bool was = status_ == WL_CONNECTED;
+  status_ = status;
+  bool is = status_ == WL_CONNECTED;
+  if (was && !is) fire(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+  if (!was && is) fire(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+}
+
+void WiFiClass::fire(WiFiEvent_t event) {
+  WiFiEventInfo_t info = {0};
+  for (const EventHandler& handler : handlers_) {
+    if (handler.event == event) handler.callback(event, info);
+  }
+}
+
+String WiFiClass::macAddress() {
+  const uint8_t* mac = nativesim::macAddress();
+  char buf[18];
+  snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  return String(buf);
+}
+
+uint8_t* WiFiClass::macAddress(uint8_t* mac) {
+  memcpy(mac, nativesim::macAddress(), 6);
+  return mac;
+}
+
+IPAddress WiFiClass::localIP() {
+  const uint8_t* mac = nativesim::macAddress();
+  return IPAddress(10, mac[3], mac[4], mac[5]);
+}
+
+String WiFiClass::SSID() { return String("native-sim"); }
+
+int8_t WiFiClass::RSSI() { return status_ == WL_CONNECTED ? -55 : 0; }
+
+ssize_t lwip_writev(int s, const struct iovec* iov, int iovcnt) {
+  (void)s;
+  if (!LoopbackBroker::instance().sessionOpen()) return -1;
+  return (ssize_t)LoopbackBroker::instance().receive(iov, iovcnt);
+}
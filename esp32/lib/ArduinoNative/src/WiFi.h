@@ -0,0 +1,119 @@
+/*
+  WiFi.h - host stand-in for the Arduino-ESP32 WiFi library.
+
+  The station is always associated. WiFiClient is wired to the in-process
+  LoopbackBroker, whatever host and port it is asked to connect to.
+*/
+
+#ifndef WiFi_h
+#define WiFi_h
+
+#include "Arduino.h"
+#include "Client.h"
+#include "IPAddress.h"
+
+#include <functional>
+#include <vector>
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+  WIFI_POWER_19_5dBm = 78,
+  WIFI_POWER_11dBm = 44,
+  WIFI_POWER_2dBm = 8
+} wifi_power_t;
+
+typedef enum {
+  ARDUINO_EVENT_WIFI_STA_CONNECTED = 4,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP = 7
+} arduino_event_id_t;
+typedef arduino_event_id_t WiFiEvent_t;
+
+typedef struct {
+  uint8_t reason;
+} WiFiEventInfo_t;
+
+typedef std::function<void(WiFiEvent_t event, WiFiEventInfo_t info)> WiFiEventFuncCb;
+
+typedef enum {
+  WIFI_PS_NONE,
+  WIFI_PS_MIN_MODEM,
+  WIFI_PS_MAX_MODEM
+} wifi_ps_type_t;
+
+inline int esp_wifi_set_ps(wifi_ps_type_t type) {
+  (void)type;
+  return 0;
+}
+
+class WiFiClient : public Client {
+public:
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+  void setNoDelay(bool nodelay) { (void)nodelay; }
+  int setTimeout(uint32_t seconds) { (void)seconds; return 0; }  // connects either succeed or fail at once
+  int fd() const { return -1; }  // no real socket: idle waits end at harness events
+
+  using Print::write;
+
+private:
+  bool open_ = false;
+};
+
+class WiFiClass {
+public:
+  wl_status_t begin(const char* ssid, const char* passphrase = nullptr);
+  wl_status_t status();
+  bool disconnect(bool wifioff = false);
+  bool reconnect();
+  bool setSleep(bool enabled);
+  bool setAutoReconnect(bool autoReconnect);
+  bool persistent(bool persistent);
+  bool setTxPower(wifi_power_t power);
+  int onEvent(WiFiEventFuncCb callback, WiFiEvent_t event);
+
+  String macAddress();
+  uint8_t* macAddress(uint8_t* mac);
+  IPAddress localIP();
+  String SSID();
+  int8_t RSSI();
+
+  // Test hook: force the station state seen by the firmware. Moving in or
+  // out of WL_CONNECTED fires the registered STA_CONNECTED/DISCONNECTED
+  // event handlers, like the real driver does.
+  void setStatus(wl_status_t status);
+
+private:
+  struct EventHandler {
+    WiFiEventFuncCb callback;
+    WiFiEvent_t event;
+  };
+
+  void fire(WiFiEvent_t event);
+
+  wl_status_t status_ = WL_CONNECTED;
+  std::vector<EventHandler> handlers_;
+};
+
+extern WiFiClass WiFi;
+
+#endif
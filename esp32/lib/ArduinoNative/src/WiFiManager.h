@@ -0,0 +1,33 @@
+/*
+  WiFiManager.h - host stand-in for tzapu/WiFiManager.
+
+  autoConnect() succeeds immediately: the simulated station is always
+  provisioned, so the config portal never opens.
+*/
+
+#ifndef WiFiManager_h
+#define WiFiManager_h
+
+#include "WiFi.h"
+
+class WiFiManager {
+public:
+  bool autoConnect() { return WiFi.begin("native-sim") == WL_CONNECTED; }
+  bool autoConnect(const char* apName, const char* apPassword = nullptr) {
+    (void)apName;
+    (void)apPassword;
+    return autoConnect();
+  }
+  void setConfigPortalTimeout(unsigned long seconds) { (void)seconds; }
+  void setConfigPortalBlocking(bool shouldBlock) { (void)shouldBlock; }
+  void setDebugOutput(bool debug) { (void)debug; }
+  void setAPStaticIPConfig(IPAddress ip, IPAddress gw, IPAddress sn) {
+    (void)ip;
+    (void)gw;
+    (void)sn;
+  }
+  void resetSettings() {}
+  bool process() { return true; }
+};
+
+#endif
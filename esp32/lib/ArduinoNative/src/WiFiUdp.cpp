@@ -0,0 +1,85 @@
+/*
+  WiFiUdp.cpp - host stand-in for the Arduino-ESP32 WiFiUDP class.
+*/
+
+#include "WiFiUdp.h"
+#include "LoopbackNTP.h"
+#include "WiFi.h"
+
+#include <string.h>
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+  (void)port;
+  open_ = true;
+  return 1;
+}
+
+void WiFiUDP::stop() {
+  open_ = false;
+  sending_ = false;
+  out_.clear();
+  in_.clear();
+  inPos_ = 0;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+  (void)ip;
+  if (WiFi.status() != WL_CONNECTED) return 0;
+  remotePort_ = port;
+  sending_ = true;
+  out_.clear();
+  return 1;
+}
+
+int WiFiUDP::beginPacket(const char* host, uint16_t port) {
+  (void)host;
+  return beginPacket(IPAddress(), port);
+}
+
+int WiFiUDP::endPacket() {
+  if (!sending_) return 0;
+  sending_ = false;
+  if (WiFi.status() != WL_CONNECTED) return 0;
+  LoopbackNTP::instance().receive(out_.data(), out_.size());
+  out_.clear();
+  return 1;
+}
+
+size_t WiFiUDP::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t WiFiUDP::write(const uint8_t* buf, size_t size) {
+  if (!sending_) return 0;
+  out_.insert(out_.end(), buf, buf + size);
+  return size;
+}
+
+// Like lwIP, a new datagram replaces whatever was left of the previous one
+int WiFiUDP::parsePacket() {
+  in_.clear();
+  inPos_ = 0;
+  if (!open_ || WiFi.status() != WL_CONNECTED) return 0;
+  if (!LoopbackNTP::instance().nextReply(&in_)) return 0;
+  return (int)in_.size();
+}
+
+int WiFiUDP::available() {
+  return (int)(in_.size() - inPos_);
+}
+
+int WiFiUDP::read() {
+  return inPos_ < in_.size() ? in_[inPos_++] : -1;
+}
+
+int WiFiUDP::read(uint8_t* buf, size_t size) {
+  size_t n = in_.size() - inPos_;
+  if (n > size) n = size;
+  memcpy(buf, in_.data() + inPos_, n);
+  inPos_ += n;
+  return (int)n;
+}
+
+int WiFiUDP::peek() {
+  return inPos_ < in_.size() ? in_[inPos_] : -1;
+}
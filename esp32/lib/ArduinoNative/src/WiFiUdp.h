@@ -0,0 +1,46 @@
+/*
+  WiFiUdp.h - host stand-in for the Arduino-ESP32 WiFiUDP class.
+
+  Every datagram the device sends goes to the in-process LoopbackNTP server,
+  whatever host and port it is addressed to; parsePacket() picks up its
+  replies once their virtual delivery time has come.
+*/
+
+#ifndef WiFiUdp_h
+#define WiFiUdp_h
+
+#include "Udp.h"
+
+#include <vector>
+
+class WiFiUDP : public UDP {
+public:
+  uint8_t begin(uint16_t port) override;
+  void stop() override;
+  int beginPacket(IPAddress ip, uint16_t port) override;
+  int beginPacket(const char* host, uint16_t port) override;
+  int endPacket() override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int parsePacket() override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int read(char* buf, size_t size) override { return read((uint8_t*)buf, size); }
+  int peek() override;
+  void flush() override {}
+  IPAddress remoteIP() override { return IPAddress(); }
+  uint16_t remotePort() override { return remotePort_; }
+
+  using Print::write;
+
+private:
+  bool open_ = false;
+  bool sending_ = false;
+  uint16_t remotePort_ = 0;
+  std::vector<uint8_t> out_;
+  std::vector<uint8_t> in_;
+  size_t inPos_ = 0;
+};
+
+#endif
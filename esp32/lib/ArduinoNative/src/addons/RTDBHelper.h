@@ -0,0 +1,14 @@
+/*
+  addons/RTDBHelper.h - host stand-in for the Firebase-ESP-Client helper.
+*/
+
+#ifndef RTDB_HELPER_H
+#define RTDB_HELPER_H
+
+#include "Firebase_ESP_Client.h"
+
+inline void printResult(FirebaseData& data) {
+  Serial.printf("%s: %s\n", data.dataPath().c_str(), data.stringData().c_str());
+}
+
+#endif
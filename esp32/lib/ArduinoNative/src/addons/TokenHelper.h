@@ -0,0 +1,16 @@
+/*
+  addons/TokenHelper.h - host stand-in for the Firebase-ESP-Client helper.
+*/
+
+#ifndef TOKEN_HELPER_H
+#define TOKEN_HELPER_H
+
+#include "Firebase_ESP_Client.h"
+
+inline void tokenStatusCallback(TokenInfo info) {
+  if (info.status == token_status_error) {
+    Serial.printf("Token error: %s\n", info.error.message.c_str());
+  }
+}
+
+#endif
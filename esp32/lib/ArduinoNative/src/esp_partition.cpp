@@ -0,0 +1,67 @@
+/*
+  esp_partition.cpp - host stand-in for the ESP-IDF partition API.
+*/
+
+#include "esp_partition.h"
+
+#include <string.h>
+
+#include "NativeSim.h"
+
+namespace {
+
+// huge_app.csv gives spiffs 896 KB; 256 KB is plenty for the host
+const uint32_t kSpiffsSize = 256 * 1024;
+
+const esp_partition_t spiffs = {
+  ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, 0x310000, kSpiffsSize, "spiffs", false,
+};
+
+uint8_t* flash() {
+  static uint8_t* bytes = nullptr;
+  if (!bytes) {
+    bytes = new uint8_t[kSpiffsSize];
+    memset(bytes, 0xFF, kSpiffsSize);
+  }
+  return bytes;
+}
+
+bool inRange(const esp_partition_t* partition, size_t offset, size_t size) {
+  return partition == &spiffs && offset <= kSpiffsSize && size <= kSpiffsSize - offset;
+}
+
+}  // namespace
+
+namespace nativesim {
+
+void eraseFlash() { memset(flash(), 0xFF, kSpiffsSize); }
+
+}  // namespace nativesim
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label) {
+  if (type != ESP_PARTITION_TYPE_DATA) return nullptr;
+  if (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != spiffs.subtype) return nullptr;
+  if (label && strcmp(label, spiffs.label) != 0) return nullptr;
+  return &spiffs;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+  if (!inRange(partition, src_offset, size)) return ESP_ERR_INVALID_SIZE;
+  memcpy(dst, flash() + src_offset, size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size) {
+  if (!inRange(partition, dst_offset, size)) return ESP_ERR_INVALID_SIZE;
+  const uint8_t* bytes = (const uint8_t*)src;
+  for (size_t i = 0; i < size; i++) flash()[dst_offset + i] &= bytes[i];  // program clears bits only
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+  if (offset % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE) return ESP_ERR_INVALID_ARG;
+  if (!inRange(partition, offset, size)) return ESP_ERR_INVALID_SIZE;
+  memset(flash() + offset, 0xFF, size);
+  return ESP_OK;
+}
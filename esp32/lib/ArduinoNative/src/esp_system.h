@@ -0,0 +1,17 @@
+/*
+  esp_system.h - host stand-in for the ESP-IDF system API.
+*/
+
+#ifndef ESP_SYSTEM_H
+#define ESP_SYSTEM_H
+
+typedef enum {
+  ESP_RST_UNKNOWN,
+  ESP_RST_POWERON,
+  ESP_RST_SW,
+  ESP_RST_PANIC
+} esp_reset_reason_t;
+
+inline esp_reset_reason_t esp_reset_reason() { return ESP_RST_POWERON; }
+
+#endif
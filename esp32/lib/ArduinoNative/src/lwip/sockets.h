@@ -0,0 +1,17 @@
+/*
+  lwip/sockets.h - host stand-in for the lwIP socket calls the firmware uses.
+
+  There is only the one connection, to the LoopbackBroker: the socket
+  argument is ignored.
+*/
+
+#ifndef LWIP_HDR_SOCKETS_H
+#define LWIP_HDR_SOCKETS_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// The whole gather list reaches the broker in one write call
+ssize_t lwip_writev(int s, const struct iovec* iov, int iovcnt);
+
+#endif
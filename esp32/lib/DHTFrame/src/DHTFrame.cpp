@@ -0,0 +1,108 @@
+/*
+  DHTFrame.cpp - decode a DHT11/DHT22 frame from captured pulse durations.
+*/
+
+#include "DHTFrame.h"
+
+namespace {
+
+// Datasheet nominals with generous margins: the sensor's own oscillator
+// drifts with temperature and supply voltage.
+const uint16_t kResponseMin = 40;
+const uint16_t kResponseMax = 120;
+const uint16_t kBitLowMin = 20;
+const uint16_t kBitLowMax = 110;
+const uint16_t kBitHighMin = 8;
+const uint16_t kBitHighMax = 110;
+
+// Reads merged pulses one at a time
+struct PulseReader {
+  const DHTPulse* pulses;
+  size_t count;
+  size_t pos;
+
+  bool next(uint8_t* level, uint32_t* micros) {
+    while (pos < count && pulses[pos].micros == 0) pos++;
+    if (pos >= count) return false;
+    *level = pulses[pos].level ? 1 : 0;
+    *micros = pulses[pos].micros;
+    pos++;
+    while (pos < count && pulses[pos].micros != 0 && (pulses[pos].level ? 1 : 0) == *level) {
+      *micros += pulses[pos].micros;
+      pos++;
+    }
+    return true;
+  }
+};
+
+bool within(uint32_t value, uint16_t low, uint16_t high) {
+  return value >= low && value <= high;
+}
+
+}  // namespace
+
+DHTFrameStatus dhtDecodeFrame(const DHTPulse* pulses, size_t count, uint8_t data[5]) {
+  PulseReader reader = {pulses, count, 0};
+  uint8_t level;
+  uint32_t micros;
+
+  // Skip the idle HIGH after the start signal (and any tail of the start
+  // signal itself) until the LOW/HIGH response
+  uint8_t prevLevel = 1;
+  uint32_t prevMicros = 0;
+  bool answered = false;
+  while (reader.next(&level, &micros)) {
+    if (level == 1 && prevLevel == 0 && within(prevMicros, kResponseMin, kResponseMax) &&
+        within(micros, kResponseMin, kResponseMax)) {
+      answered = true;
+      break;
+    }
+    prevLevel = level;
+    prevMicros = micros;
+  }
+  if (!answered) return DHT_FRAME_NO_RESPONSE;
+
+  uint8_t bytes[5] = {0, 0, 0, 0, 0};
+  for (int bit = 0; bit < 40; bit++) {
+    uint32_t lowMicros, highMicros;
+    if (!reader.next(&level, &lowMicros)) return DHT_FRAME_TRUNCATED;
+    if (level != 0 || !within(lowMicros, kBitLowMin, kBitLowMax)) return DHT_FRAME_BAD_PULSE;
+    if (!reader.next(&level, &highMicros)) return DHT_FRAME_TRUNCATED;
+    if (level != 1 || !within(highMicros, kBitHighMin, kBitHighMax)) return DHT_FRAME_BAD_PULSE;
+    // Same rule as the busy-wait driver: a HIGH longer than the 50us LOW
+    // before it is a 1
+    bytes[bit / 8] = (uint8_t)((bytes[bit / 8] << 1) | (highMicros > lowMicros ? 1 : 0));
+  }
+
+  for (int i = 0; i < 5; i++) data[i] = bytes[i];
+  if (bytes[4] != (uint8_t)(bytes[0] + bytes[1] + bytes[2] + bytes[3])) return DHT_FRAME_CHECKSUM;
+  return DHT_FRAME_OK;
+}
+
+size_t dhtEncodeFrame(const uint8_t data[5], DHTPulse* out, size_t capacity) {
+  size_t n = 0;
+  auto put = [&](uint8_t level, uint16_t micros) {
+    if (n < capacity) out[n++] = DHTPulse{level, micros};
+  };
+  put(1, 30);  // line released, sensor about to answer
+  put(0, 80);
+  put(1, 80);
+  for (int bit = 0; bit < 40; bit++) {
+    put(0, 50);
+    put(1, (data[bit / 8] >> (7 - bit % 8)) & 1 ? 70 : 27);
+  }
+  put(0, 50);
+  put(1, 0);  // idle: the capture ends here
+  return n;
+}
+
+const char* dhtFrameStatusName(DHTFrameStatus status) {
+  switch (status) {
+    case DHT_FRAME_OK: return "ok";
+    case DHT_FRAME_NO_RESPONSE: return "no response";
+    case DHT_FRAME_TRUNCATED: return "truncated";
+    case DHT_FRAME_BAD_PULSE: return "bad pulse";
+    case DHT_FRAME_CHECKSUM: return "checksum";
+  }
+  return "?";
+}
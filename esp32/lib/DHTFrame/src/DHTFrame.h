@@ -0,0 +1,53 @@
+/*
+  DHTFrame.h - decode a DHT11/DHT22 frame from captured pulse durations.
+
+  A pulse-capture peripheral (the ESP32 RMT receiver) records the data line
+  as alternating levels with their length in microseconds. The sensor's
+  answer to a start signal is:
+
+    LOW ~80us, HIGH ~80us                     response
+    40 x (LOW ~50us, HIGH ~27us | ~70us)      bits, MSB first, 0 | 1
+    LOW ~50us, then the line idles HIGH       end of frame
+
+  followed by no more edges, which ends the capture. Bytes are humidity
+  high/low, temperature high/low and a checksum of the first four.
+
+  Decoding is plain arithmetic on the durations, so it runs in task context
+  after the capture completes and can be tested on the host with recorded
+  or synthesized pulse trains.
+*/
+
+#ifndef DHTFrame_h
+#define DHTFrame_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct DHTPulse {
+  uint8_t level;    // 0 = LOW, 1 = HIGH
+  uint16_t micros;  // 0 marks the end of a capture
+};
+
+enum DHTFrameStatus : uint8_t {
+  DHT_FRAME_OK,
+  DHT_FRAME_NO_RESPONSE,  // no 80us LOW/HIGH answer: sensor missing or start signal lost
+  DHT_FRAME_TRUNCATED,    // fewer than 40 bits captured
+  DHT_FRAME_BAD_PULSE,    // a bit pulse outside the datasheet timing
+  DHT_FRAME_CHECKSUM,
+};
+
+// Maximum pulses a full frame produces (leading idle, response, 40 bits,
+// trailing LOW), plus room for glitches the capture filter let through.
+static const size_t DHT_FRAME_MAX_PULSES = 96;
+
+// Decodes the 5 frame bytes into data. Adjacent pulses of the same level
+// are merged first, since a capture may split one level across entries.
+DHTFrameStatus dhtDecodeFrame(const DHTPulse* pulses, size_t count, uint8_t data[5]);
+
+// The pulse train a healthy sensor sends for data (nominal timings);
+// returns the number of pulses written. Used by the host stand-in and tests.
+size_t dhtEncodeFrame(const uint8_t data[5], DHTPulse* out, size_t capacity);
+
+const char* dhtFrameStatusName(DHTFrameStatus status);
+
+#endif
@@ -0,0 +1,79 @@
+/*
+  DeadBand.cpp - per-channel dead-band filter for sensor telemetry.
+*/
+
+#include "DeadBand.h"
+
+#include <math.h>
+
+DeadBand::DeadBand() : count_(0), maxSilenceMs_(0), forcedMask_(0) {
+  memset(channels_, 0, sizeof(channels_));
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+int DeadBand::addChannel(const char* name, float band) {
+  if (count_ >= kMaxChannels) return -1;
+  Channel& c = channels_[count_];
+  c.name = name;
+  c.band = band;
+  return count_++;
+}
+
+void DeadBand::update(int channel, float value) {
+  if (channel < 0 || channel >= count_ || isnan(value)) return;
+  channels_[channel].value = value;
+  channels_[channel].hasValue = true;
+  stats_.readings++;
+}
+
+uint32_t DeadBand::due(uint32_t now) {
+  uint32_t mask = 0;
+  forcedMask_ = 0;
+  for (int i = 0; i < count_; i++) {
+    const Channel& c = channels_[i];
+    if (!c.hasValue) continue;
+    if (!c.hasSent || fabsf(c.value - c.sent) > c.band) {
+      mask |= 1u << i;
+    } else if (maxSilenceMs_ && now - c.sentAt >= maxSilenceMs_) {
+      mask |= 1u << i;
+      forcedMask_ |= 1u << i;
+    }
+  }
+  if (!mask) stats_.empty++;
+  return mask;
+}
+
+uint32_t DeadBand::all() const {
+  uint32_t mask = 0;
+  for (int i = 0; i < count_; i++) {
+    if (channels_[i].hasValue) mask |= 1u << i;
+  }
+  return mask;
+}
+
+void DeadBand::commit(uint32_t mask, uint32_t now) {
+  if (!mask) return;
+  for (int i = 0; i < count_; i++) {
+    if (!(mask & (1u << i))) continue;
+    Channel& c = channels_[i];
+    c.sent = c.value;
+    c.sentAt = now;
+    c.hasSent = true;
+    stats_.sent++;
+    if (forcedMask_ & (1u << i)) stats_.forced++;
+  }
+  forcedMask_ = 0;
+  stats_.messages++;
+}
+
+float DeadBand::suppressionRatio() const {
+  if (stats_.readings == 0) return 0;
+  uint32_t sent = stats_.sent < stats_.readings ? stats_.sent : stats_.readings;
+  return (float)(stats_.readings - sent) / stats_.readings;
+}
+
+void DeadBand::printStats(Print& out) {
+  out.printf("   readings=%lu sent=%lu (forced %lu) messages=%lu quiet=%lu suppressed=%.1f%%\n",
+             (unsigned long)stats_.readings, (unsigned long)stats_.sent, (unsigned long)stats_.forced,
+             (unsigned long)stats_.messages, (unsigned long)stats_.empty, suppressionRatio() * 100);
+}
@@ -0,0 +1,79 @@
+/*
+  DeadBand.h - per-channel dead-band filter for sensor telemetry.
+
+  Each channel (temperature, humidity, ...) has a band: a new reading is
+  only worth sending when it differs from the last value sent by more than
+  that. A channel that stayed inside its band for maxSilence is sent anyway,
+  so subscribers that missed earlier messages catch up and a quiet sensor is
+  told apart from a dead board. The first reading of a channel is always due.
+
+    int t = filter.addChannel("temperature", 0.2f);
+    ...
+    filter.update(t, dht.readTemperature());
+    uint32_t due = filter.due(millis());  // bit per channel, 0 = nothing to send
+    if (due && publish(only the channels in due)) filter.commit(due, millis());
+
+  Statistics count readings offered and channel values sent, so the
+  suppression ratio is the share of readings that never reached the broker.
+*/
+
+#ifndef DeadBand_h
+#define DeadBand_h
+
+#include <Arduino.h>
+
+class DeadBand {
+public:
+  static const int kMaxChannels = 8;
+
+  struct Stats {
+    uint32_t readings;  // update() calls
+    uint32_t sent;      // channel values committed
+    uint32_t forced;    // of which only for maxSilence
+    uint32_t messages;  // commit() calls
+    uint32_t empty;     // due() calls with nothing to send
+  };
+
+  DeadBand();
+
+  // Returns the channel index, or -1 when the table is full.
+  int addChannel(const char* name, float band);
+  // 0 = channels inside their band are never sent again
+  void setMaxSilence(uint32_t ms) { maxSilenceMs_ = ms; }
+
+  void update(int channel, float value);
+  // Channels to send now, bit i for channel i
+  uint32_t due(uint32_t now);
+  // All channels with a reading, for an explicit full snapshot
+  uint32_t all() const;
+  // The channels in mask were sent: their current values become the reference
+  void commit(uint32_t mask, uint32_t now);
+
+  int channelCount() const { return count_; }
+  const char* name(int channel) const { return channels_[channel].name; }
+  float value(int channel) const { return channels_[channel].value; }
+
+  const Stats& stats() const { return stats_; }
+  // Share of readings never sent, 0..1
+  float suppressionRatio() const;
+  void printStats(Print& out);
+
+private:
+  struct Channel {
+    const char* name;
+    float band;
+    float value;     // latest reading
+    float sent;      // last value sent
+    uint32_t sentAt;
+    bool hasValue;
+    bool hasSent;
+  };
+
+  Channel channels_[kMaxChannels];
+  int count_;
+  uint32_t maxSilenceMs_;
+  uint32_t forcedMask_;  // channels due() chose only for silence
+  Stats stats_;
+};
+
+#endif
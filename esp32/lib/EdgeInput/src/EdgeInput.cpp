@@ -0,0 +1,141 @@
+/*
+  EdgeInput.cpp - interrupt-driven, timestamp-debounced push buttons.
+*/
+
+#include "EdgeInput.h"
+
+EdgeInput::EdgeInput()
+    : count_(0), debounceMicros_(0), onPress_(nullptr), wakeHook_(nullptr),
+      head_(0), tail_(0), overflow_(false), latencyCount_(0), latencyMax_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+  memset(latency_, 0, sizeof(latency_));
+}
+
+void EdgeInput::begin(const uint8_t* pins, int count, uint32_t debounceMs, PressFn onPress) {
+  if (count > kMaxPins) count = kMaxPins;
+  debounceMicros_ = debounceMs * 1000UL;
+  onPress_ = onPress;
+  uint32_t now = micros();
+  for (int i = 0; i < count; i++) {
+    Pin& p = pins_[i];
+    p.owner = this;
+    p.pin = pins[i];
+    p.index = (uint8_t)i;
+    p.stable = p.raw = (uint8_t)digitalRead(p.pin);
+    // Backdated so the very first edge is not taken for a bounce
+    p.stableSince = p.rawAt = now - debounceMicros_;
+  }
+  count_ = count;
+  for (int i = 0; i < count; i++) {
+    attachInterruptArg(digitalPinToInterrupt(pins_[i].pin), onEdge, &pins_[i], CHANGE);
+  }
+}
+
+void IRAM_ATTR EdgeInput::onEdge(void* arg) {
+  Pin* p = (Pin*)arg;
+  EdgeInput* self = p->owner;
+  uint32_t head = self->head_;
+  if (head - self->tail_ >= (uint32_t)kRingSize) {
+    self->overflow_ = true;  // poll() re-reads every pin
+  } else {
+    Edge& e = self->ring_[head & (kRingSize - 1)];
+    e.micros = micros();
+    e.index = p->index;
+    e.level = (uint8_t)digitalRead(p->pin);
+    self->head_ = head + 1;
+  }
+  if (self->wakeHook_) self->wakeHook_();
+}
+
+bool EdgeInput::pending() const {
+  if (head_ != tail_ || overflow_) return true;
+  for (int i = 0; i < count_; i++) {
+    if (pins_[i].raw != pins_[i].stable) return true;
+  }
+  return false;
+}
+
+uint32_t EdgeInput::poll() {
+  while (tail_ != head_) {
+    Edge e = ring_[tail_ & (kRingSize - 1)];
+    tail_ = tail_ + 1;
+    stats_.edges++;
+    apply(e.index, e.level, e.micros);
+  }
+  if (overflow_) {
+    overflow_ = false;
+    stats_.overflows++;
+    uint32_t now = micros();
+    for (int i = 0; i < count_; i++) apply(i, (uint8_t)digitalRead(pins_[i].pin), now);
+  }
+
+  // Pins whose last edge landed inside the window settle once it closes
+  uint32_t now = micros();
+  uint32_t wait = 0;
+  for (int i = 0; i < count_; i++) {
+    Pin& p = pins_[i];
+    if (p.raw == p.stable) continue;
+    uint32_t elapsed = now - p.stableSince;
+    if (elapsed >= debounceMicros_) {
+      accept(i, p.raw, p.rawAt);
+      p.stableSince = now;
+    } else {
+      uint32_t left = (debounceMicros_ - elapsed + 999) / 1000;
+      if (wait == 0 || left < wait) wait = left;
+    }
+  }
+  return wait;
+}
+
+void EdgeInput::apply(int index, uint8_t level, uint32_t at) {
+  Pin& p = pins_[index];
+  p.raw = level;
+  p.rawAt = at;
+  if (at - p.stableSince < debounceMicros_) {
+    stats_.bounces++;
+    return;
+  }
+  if (level != p.stable) accept(index, level, at);
+}
+
+void EdgeInput::accept(int index, uint8_t level, uint32_t at) {
+  Pin& p = pins_[index];
+  p.stable = level;
+  p.stableSince = at;
+  if (level != LOW) {
+    stats_.releases++;
+    return;
+  }
+  stats_.presses++;
+  if (onPress_) onPress_(index);
+
+  uint32_t latency = micros() - at;
+  int bucket = 0;
+  while (bucket < kLatencyBuckets - 1 && (latency >> (bucket + 1)) != 0) bucket++;
+  latency_[bucket]++;
+  latencyCount_++;
+  if (latency > latencyMax_) latencyMax_ = latency;
+}
+
+uint32_t EdgeInput::latencyPercentile(double p) const {
+  if (latencyCount_ == 0) return 0;
+  uint32_t rank = (uint32_t)(p / 100.0 * latencyCount_);
+  if (rank >= latencyCount_) rank = latencyCount_ - 1;
+  uint32_t seen = 0;
+  for (int bucket = 0; bucket < kLatencyBuckets; bucket++) {
+    seen += latency_[bucket];
+    if (seen > rank) {
+      uint32_t bound = (2UL << bucket) - 1;  // bucket upper bound
+      return bound < latencyMax_ ? bound : latencyMax_;
+    }
+  }
+  return latencyMax_;
+}
+
+void EdgeInput::printStats(Print& out) {
+  out.printf("   edges=%lu presses=%lu releases=%lu bounces=%lu overflows=%lu\n",
+             (unsigned long)stats_.edges, (unsigned long)stats_.presses, (unsigned long)stats_.releases,
+             (unsigned long)stats_.bounces, (unsigned long)stats_.overflows);
+  out.printf("   press_to_relay_us p50<=%lu p99<=%lu max=%lu\n", (unsigned long)latencyPercentile(50),
+             (unsigned long)latencyPercentile(99), (unsigned long)latencyMax_);
+}
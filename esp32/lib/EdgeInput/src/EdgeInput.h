@@ -0,0 +1,108 @@
+/*
+  EdgeInput.h - interrupt-driven, timestamp-debounced push buttons.
+
+  A CHANGE interrupt on every input pin stores {pin, level, micros()} in a
+  lock-free ring; nothing else happens in the ISR. poll() runs in task
+  context, drains the ring and debounces from the edge timestamps:
+
+    - an edge is accepted the moment it arrives if the pin had been stable
+      for the debounce window before it, so a press acts on its first edge
+      instead of after 50 ms of quiet;
+    - edges inside the window after an accepted one are bounces and ignored;
+    - if the line ended the window at a different level, that level is
+      accepted when the window closes.
+
+  Because edges are captured by the ISR, a press made while loop() is stuck
+  in a blocking MQTT/Firebase call is applied as soon as loop() gets back,
+  with its real timestamp. Buttons are active low (pressed = LOW).
+
+  The time from an accepted press edge to the return of the press handler
+  (which drives the relay) is kept in a log2 histogram; printStats() dumps
+  it with the edge counters.
+*/
+
+#ifndef EdgeInput_h
+#define EdgeInput_h
+
+#include <Arduino.h>
+
+class EdgeInput {
+public:
+  typedef void (*PressFn)(int index);
+
+  static const int kMaxPins = 8;
+  static const int kRingSize = 32;        // power of two
+  static const int kLatencyBuckets = 24;  // [2^k, 2^(k+1)) us, up to ~16 s
+
+  struct Stats {
+    uint32_t edges;      // taken from the ring
+    uint32_t presses;
+    uint32_t releases;
+    uint32_t bounces;    // edges inside a debounce window
+    uint32_t overflows;  // ring full; levels were re-read from the pins
+  };
+
+  EdgeInput();
+
+  // Attaches a CHANGE interrupt to each pin (configure pinMode() first) and
+  // calls onPress(index) for every debounced press.
+  void begin(const uint8_t* pins, int count, uint32_t debounceMs, PressFn onPress);
+  // Called from the ISR after an edge is queued, e.g. to end an idle sleep.
+  void setWakeHook(void (*hook)()) { wakeHook_ = hook; }
+
+  // Edges queued, or a pin waiting for its debounce window to close.
+  bool pending() const;
+  // Handles queued edges. Returns ms until the next debounce window closes
+  // (poll again then), 0 when no pin is waiting.
+  uint32_t poll();
+
+  bool pressed(int index) const { return pins_[index].stable == LOW; }
+  const Stats& stats() const { return stats_; }
+  uint32_t latencyPercentile(double p) const;  // press edge -> handler done, us
+  uint32_t latencyMax() const { return latencyMax_; }
+  // Presses whose latency fell in [2^bucket, 2^(bucket+1)) us; bucket 0
+  // also holds 0, the last one everything longer
+  uint32_t latencyCount(int bucket) const { return latency_[bucket]; }
+  void printStats(Print& out);
+
+private:
+  struct Edge {
+    uint32_t micros;
+    uint8_t index;
+    uint8_t level;
+  };
+
+  struct Pin {
+    EdgeInput* owner;
+    uint8_t pin;
+    uint8_t index;
+    uint8_t stable;        // debounced level
+    uint8_t raw;           // level of the last edge seen
+    uint32_t stableSince;  // us, when the debounced level last changed
+    uint32_t rawAt;        // us, last edge
+  };
+
+  static void IRAM_ATTR onEdge(void* arg);
+  void apply(int index, uint8_t level, uint32_t at);
+  void accept(int index, uint8_t level, uint32_t at);
+
+  Pin pins_[kMaxPins];
+  int count_;
+  uint32_t debounceMicros_;
+  PressFn onPress_;
+  void (*wakeHook_)();
+
+  // Single producer (the ISR, all pins share one core) and single consumer
+  // (poll()): the ISR only writes head_, poll() only writes tail_.
+  Edge ring_[kRingSize];
+  volatile uint32_t head_;
+  volatile uint32_t tail_;
+  volatile bool overflow_;
+
+  Stats stats_;
+  uint32_t latency_[kLatencyBuckets];
+  uint32_t latencyCount_;
+  uint32_t latencyMax_;
+};
+
+#endif
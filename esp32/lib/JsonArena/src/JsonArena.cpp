@@ -0,0 +1,114 @@
+/*
+  JsonArena.cpp - bump-pointer ArduinoJson allocator over one fixed buffer.
+*/
+
+#include "JsonArena.h"
+
+#include <string.h>
+
+JsonArena::JsonArena(void* buffer, size_t size) : used_(0), top_(kNone), live_(0), liveBytes_(0) {
+  // Start on an 8-byte boundary; offsets are 32-bit
+  uintptr_t start = ((uintptr_t)buffer + 7) & ~(uintptr_t)7;
+  size_t skipped = start - (uintptr_t)buffer;
+  size = size > skipped ? size - skipped : 0;
+  if (size > kNone - 8) {
+    size = kNone - 8;
+  }
+  buffer_ = (uint8_t*)start;
+  size_ = size & ~(size_t)7;
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+void* JsonArena::allocate(size_t size) {
+  if (size > size_ || sizeof(Header) + roundUp(size) > size_ - used_) {
+    stats_.failures++;
+    return nullptr;  // deserializeJson() reports NoMemory
+  }
+  Header* header = headerAt(used_);
+  header->size = roundUp(size);
+  header->below = top_;
+  top_ = used_;
+  used_ += sizeof(Header) + header->size;
+  live_++;
+  liveBytes_ += sizeof(Header) + header->size;
+  stats_.allocations++;
+  noteUsage();
+  return header + 1;
+}
+
+void JsonArena::deallocate(void* ptr) {
+  if (ptr) {
+    release(headerOf(ptr));
+    noteUsage();
+  }
+}
+
+void* JsonArena::reallocate(void* ptr, size_t new_size) {
+  if (!ptr) {
+    return allocate(new_size);
+  }
+  Header* header = headerOf(ptr);
+  uint32_t offset = (uint8_t*)header - buffer_;
+  if (offset == top_) {
+    // Most recent block: grow or shrink in place
+    if (new_size > size_ - offset - sizeof(Header)) {
+      stats_.failures++;
+      return nullptr;
+    }
+    liveBytes_ -= header->size;
+    header->size = roundUp(new_size);
+    liveBytes_ += header->size;
+    used_ = offset + sizeof(Header) + header->size;
+    noteUsage();
+    return ptr;
+  }
+  if (new_size <= header->size) {
+    return ptr;  // the tail stays with the block
+  }
+  void* moved = allocate(new_size);
+  if (moved) {
+    memcpy(moved, ptr, header->size);
+    release(header);
+    noteUsage();
+  }
+  return moved;
+}
+
+void JsonArena::reset() {
+  used_ = 0;
+  top_ = kNone;
+  live_ = 0;
+  liveBytes_ = 0;
+  stats_.resets++;
+}
+
+void JsonArena::release(Header* header) {
+  live_--;
+  liveBytes_ -= sizeof(Header) + header->size;
+  if (live_ == 0) {
+    reset();
+    return;
+  }
+  header->size |= kFreed;
+  // The top and whatever freed blocks lie right under it
+  while (top_ != kNone && (headerAt(top_)->size & kFreed)) {
+    used_ = top_;
+    top_ = headerAt(top_)->below;
+  }
+}
+
+void JsonArena::noteUsage() {
+  if (used_ > stats_.highWater) {
+    stats_.highWater = used_;
+  }
+  if (stranded() > stats_.mostStranded) {
+    stats_.mostStranded = stranded();
+  }
+}
+
+void JsonArena::printStats(Print& out) {
+  out.printf("   used=%u/%u high=%u live=%u blocks stranded=%u (most %u) allocations=%lu failures=%lu resets=%lu\n",
+             (unsigned)used_, (unsigned)size_, (unsigned)stats_.highWater, (unsigned)live_,
+             (unsigned)stranded(), (unsigned)stats_.mostStranded, (unsigned long)stats_.allocations,
+             (unsigned long)stats_.failures, (unsigned long)stats_.resets);
+}
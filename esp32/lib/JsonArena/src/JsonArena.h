@@ -0,0 +1,100 @@
+/*
+  JsonArena.h - bump-pointer ArduinoJson allocator over one fixed buffer.
+
+  Blocks are carved off the front of the buffer, each behind an 8-byte
+  header. Nothing is ever searched or coalesced: freeing the most recent
+  block moves the top back down (past any freed blocks right under it, the
+  header says where the block below starts), freeing any other block only
+  marks it, and once the last live block is gone the arena is empty again.
+  reset() empties it at once, in O(1). So a JsonDocument used for one
+  message at a time and then cleared costs no malloc/free at all, and
+  several documents can share one static arena as long as each is cleared
+  when its message is done:
+
+    StaticJsonArena<4096> arena;
+    JsonDocument command(&arena);
+    JsonDocument batch(&arena);
+
+    deserializeJson(command, payload, length);
+    ... handle it, build and serialize batch ...
+    batch.clear();
+    command.clear();  // the arena is empty again
+
+  A request that doesn't fit returns null, which ArduinoJson reports as
+  NoMemory / overflowed(). Freed blocks under a live one are stranded until
+  it goes too or the arena empties; stats() reports how much.
+*/
+
+#ifndef JsonArena_h
+#define JsonArena_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+class JsonArena : public ArduinoJson::Allocator {
+public:
+  struct Stats {
+    uint32_t allocations;  // blocks handed out, moves by reallocate() included
+    uint32_t failures;     // requests refused for lack of room
+    uint32_t resets;       // times the arena went back to empty
+    size_t highWater;      // most bytes in use at once, headers included
+    size_t mostStranded;   // most bytes of freed blocks below the top at once
+  };
+
+  // buffer must stay valid for as long as the arena is used
+  JsonArena(void* buffer, size_t size);
+
+  void* allocate(size_t size) override;
+  void deallocate(void* ptr) override;
+  void* reallocate(void* ptr, size_t new_size) override;
+
+  // Forgets every block. Only once no document holds memory from the
+  // arena: cleared, destroyed, or never used.
+  void reset();
+
+  size_t capacity() const { return size_; }
+  size_t used() const { return used_; }  // up to the top, headers included
+  size_t available() const { return size_ - used_; }
+  size_t liveBlocks() const { return live_; }
+  size_t liveBytes() const { return liveBytes_; }  // headers included
+  // Bytes of freed blocks below the top, which only come back with it
+  size_t stranded() const { return used_ - liveBytes_; }
+
+  const Stats& stats() const { return stats_; }
+  void printStats(Print& out);
+
+private:
+  // 8 bytes, so every block stays aligned for doubles and 64-bit integers
+  struct Header {
+    uint32_t size;   // bytes after the header, a multiple of 8; bit 0 = freed
+    uint32_t below;  // offset of the block below, kNone for the first one
+  };
+  static const uint32_t kNone = 0xFFFFFFFF;
+  static const uint32_t kFreed = 1;
+
+  static size_t roundUp(size_t n) { return (n + 7) & ~(size_t)7; }
+  static Header* headerOf(void* ptr) { return (Header*)ptr - 1; }
+  Header* headerAt(uint32_t offset) { return (Header*)(buffer_ + offset); }
+  void release(Header* header);
+  void noteUsage();
+
+  uint8_t* buffer_;
+  size_t size_;
+  size_t used_;
+  uint32_t top_;  // offset of the most recent block, kNone when empty
+  size_t live_;
+  size_t liveBytes_;
+  Stats stats_;
+};
+
+// A JsonArena with its own N-byte buffer, for a static or global arena
+template <size_t N>
+class StaticJsonArena : public JsonArena {
+public:
+  StaticJsonArena() : JsonArena(storage_, N) {}
+
+private:
+  alignas(8) uint8_t storage_[N];
+};
+
+#endif
@@ -0,0 +1,473 @@
+/*
+  Outbox.cpp - bounded queue for MQTT publishes made while offline.
+*/
+
+#include "Outbox.h"
+
+namespace {
+
+const uint8_t kStateErased = 0xFF;     // flash: not written (or torn before commit)
+const uint8_t kStateCommitted = 0x7F;  // waiting to be sent
+const uint8_t kStatePad = 0x3F;        // RAM: rest of the ring unused, wrap to 0
+const uint8_t kStateDone = 0x00;       // sent or superseded
+
+const uint8_t kFlagQosMask = 0x03;
+const uint8_t kFlagRetained = 0x04;
+const uint8_t kFlagSupersede = 0x08;
+
+const uint32_t kSectorMagic = 0x3158424F;  // "OBX1"
+
+}  // namespace
+
+Outbox::Outbox()
+    : head_(0), tail_(0), records_(0), count_(0),
+      partition_(nullptr), sectors_(0), readSector_(0), writeSector_(0), readOffset_(0), writeOffset_(0),
+      sequence_(0), flashCount_(0), drainIntervalMs_(0), nextSendAt_(0) {
+  memset(supersedeIndex_, 0, sizeof(supersedeIndex_));
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+size_t Outbox::recordSize(const Header& h) {
+  return (sizeof(Header) + h.topicLength + h.payloadLength + 3) & ~(size_t)3;
+}
+
+bool Outbox::sameTopic(const Header& h, const uint8_t* record, const char* topic, size_t topicLength) {
+  return h.topicLength == topicLength && memcmp(record + sizeof(Header), topic, topicLength) == 0;
+}
+
+uint32_t Outbox::topicHash(const char* topic) {
+  uint32_t hash = 2166136261u;  // FNV-1a
+  while (*topic) {
+    hash = (hash ^ (uint8_t)*topic++) * 16777619u;
+  }
+  return hash;
+}
+
+void Outbox::setDrainRate(uint16_t perSecond) {
+  drainIntervalMs_ = perSecond ? 1000 / perSecond : 0;
+}
+
+bool Outbox::push(const char* topic, const uint8_t* payload, size_t length, uint8_t qos, bool retained,
+                  bool supersede) {
+  size_t topicLength = strlen(topic) + 1;
+  if (topicLength > 0xFF || length > 0xFFFF) {
+    return false;
+  }
+  Header h = {kStateCommitted, (uint8_t)(qos & kFlagQosMask), (uint8_t)topicLength, 0xFF, (uint16_t)length};
+  if (retained) h.flags |= kFlagRetained | kFlagSupersede;
+  if (supersede) h.flags |= kFlagSupersede;
+  size_t size = recordSize(h);
+  if (size > OUTBOX_MAX_RECORD) {
+    return false;
+  }
+
+  if (h.flags & kFlagSupersede) {
+    ramSupersede(topic, topicLength);
+    if (partition_) flashSupersede(topic, topicLength);
+  }
+
+  uint32_t at;
+  while (!ramFits(size, &at)) {
+    if (!evictOldest()) return false;
+  }
+  uint8_t* record = ram_ + at;
+  memcpy(record, &h, sizeof(h));
+  memcpy(record + sizeof(h), topic, topicLength);
+  memcpy(record + sizeof(h) + topicLength, payload, length);
+  tail_ = at + size;
+  records_++;
+  count_++;
+  stats_.queued++;
+  return true;
+}
+
+uint32_t Outbox::drain(uint32_t now, SendFn send) {
+  while (!empty()) {
+    if (drainIntervalMs_ && (int32_t)(nextSendAt_ - now) > 0) {
+      return nextSendAt_ - now;
+    }
+    OutboxMessage message;
+    Location at;
+    if (!peek(&message, &at)) {
+      break;
+    }
+    if (!send(message)) {
+      stats_.refused++;
+      return kRetryMs;
+    }
+    consume(at);
+    stats_.sent++;
+    nextSendAt_ = now + drainIntervalMs_;
+  }
+  return 0;
+}
+
+void Outbox::spillAll() {
+  if (!partition_) {
+    return;
+  }
+  while (records_ > 0) {
+    evictOldest();
+  }
+}
+
+// Oldest first: flash holds only messages older than anything in RAM
+bool Outbox::peek(OutboxMessage* message, Location* at) {
+  while (flashCount_ > 0) {
+    uint32_t offset;
+    Header h;
+    if (!flashFindOldest(&offset, &h)) {
+      flashCount_ = 0;  // counted something the scan no longer finds
+      break;
+    }
+    size_t size = recordSize(h);
+    if (size > sizeof(scratch_) || h.topicLength == 0 ||
+        esp_partition_read(partition_, offset, scratch_, size) != ESP_OK) {
+      flashMarkDone(offset);  // unreadable: skip rather than stall the queue
+      flashCount_--;
+      stats_.dropped++;
+      continue;
+    }
+    scratch_[sizeof(Header) + h.topicLength - 1] = 0;
+    message->topic = (const char*)scratch_ + sizeof(Header);
+    message->payload = scratch_ + sizeof(Header) + h.topicLength;
+    message->length = h.payloadLength;
+    message->qos = h.flags & kFlagQosMask;
+    message->retained = h.flags & kFlagRetained;
+    at->flash = true;
+    at->offset = offset;
+    return true;
+  }
+  while (records_ > 0) {
+    uint32_t pos = ramHead();
+    Header h;
+    memcpy(&h, ram_ + pos, sizeof(h));
+    if (h.state != kStateCommitted) {
+      ramDropHead();  // superseded
+      continue;
+    }
+    message->topic = (const char*)ram_ + pos + sizeof(Header);
+    message->payload = ram_ + pos + sizeof(Header) + h.topicLength;
+    message->length = h.payloadLength;
+    message->qos = h.flags & kFlagQosMask;
+    message->retained = h.flags & kFlagRetained;
+    at->flash = false;
+    at->offset = pos;
+    return true;
+  }
+  return false;
+}
+
+void Outbox::consume(const Location& at) {
+  if (at.flash) {
+    flashMarkDone(at.offset);
+    flashCount_--;
+  } else {
+    ramDropHead();
+  }
+}
+
+// Frees the oldest RAM record, into flash when there is some
+bool Outbox::evictOldest() {
+  if (records_ == 0) {
+    return false;
+  }
+  uint32_t pos = ramHead();
+  Header h;
+  memcpy(&h, ram_ + pos, sizeof(h));
+  if (h.state == kStateCommitted) {
+    if (partition_ && flashAppend(ram_ + pos, recordSize(h))) {
+      stats_.spilled++;
+    } else {
+      stats_.dropped++;
+    }
+  }
+  ramDropHead();
+  return true;
+}
+
+// --- RAM ring ---
+
+uint32_t Outbox::ramHead() {
+  if (OUTBOX_RAM_BYTES - head_ < sizeof(Header) || ram_[head_] == kStatePad) {
+    head_ = 0;
+  }
+  return head_;
+}
+
+// Finds room for size contiguous bytes, wrapping to the start of the ring
+// (behind a pad marker) when the end is too short
+bool Outbox::ramFits(size_t size, uint32_t* at) {
+  if (records_ == 0) {
+    head_ = tail_ = 0;
+    *at = 0;
+    return size <= OUTBOX_RAM_BYTES;
+  }
+  if (tail_ > head_) {
+    if (OUTBOX_RAM_BYTES - tail_ >= size) {
+      *at = tail_;
+      return true;
+    }
+    if (head_ >= size) {
+      if (OUTBOX_RAM_BYTES - tail_ >= sizeof(Header)) {
+        ram_[tail_] = kStatePad;
+      }
+      *at = 0;
+      return true;
+    }
+    return false;
+  }
+  if (tail_ < head_ && head_ - tail_ >= size) {
+    *at = tail_;
+    return true;
+  }
+  return false;  // tail_ == head_: full
+}
+
+void Outbox::ramDropHead() {
+  uint32_t pos = ramHead();
+  Header h;
+  memcpy(&h, ram_ + pos, sizeof(h));
+  if (h.state == kStateCommitted) {
+    count_--;
+  }
+  head_ = pos + recordSize(h);
+  if (--records_ == 0) {
+    head_ = tail_ = 0;
+  }
+}
+
+void Outbox::ramSupersede(const char* topic, size_t topicLength) {
+  uint32_t pos = head_;
+  for (uint32_t i = 0; i < records_; i++) {
+    if (OUTBOX_RAM_BYTES - pos < sizeof(Header) || ram_[pos] == kStatePad) {
+      pos = 0;
+    }
+    Header h;
+    memcpy(&h, ram_ + pos, sizeof(h));
+    if (h.state == kStateCommitted && (h.flags & kFlagSupersede) && sameTopic(h, ram_ + pos, topic, topicLength)) {
+      ram_[pos] = kStateDone;
+      count_--;
+      stats_.superseded++;
+    }
+    pos += recordSize(h);
+  }
+}
+
+// --- flash ring ---
+
+bool Outbox::attachFlash(const char* label, uint16_t sectors) {
+  partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  if (!partition_ || sectors < 2 || partition_->size < (uint32_t)sectors * kSectorSize) {
+    partition_ = nullptr;
+    return false;
+  }
+  sectors_ = sectors;
+  flashCount_ = 0;
+  memset(supersedeIndex_, 0, sizeof(supersedeIndex_));
+
+  // Sequence numbers grow around the ring: the smallest in use is the
+  // oldest sector, the largest the one being written
+  bool found = false;
+  uint32_t oldest = 0;
+  for (uint16_t s = 0; s < sectors_; s++) {
+    SectorHeader sh;
+    if (esp_partition_read(partition_, sectorBase(s), &sh, sizeof(sh)) != ESP_OK || sh.magic != kSectorMagic) {
+      continue;
+    }
+    if (!found || (int32_t)(sh.sequence - oldest) < 0) {
+      oldest = sh.sequence;
+      readSector_ = s;
+    }
+    if (!found || (int32_t)(sh.sequence - sequence_) > 0) {
+      sequence_ = sh.sequence;
+      writeSector_ = s;
+    }
+    found = true;
+  }
+  if (!found) {
+    writeSector_ = sectors_ - 1;
+    sequence_ = 0;
+    if (!openNextSector()) {
+      partition_ = nullptr;
+      return false;
+    }
+    readSector_ = writeSector_;
+    readOffset_ = sizeof(SectorHeader);
+    return true;
+  }
+
+  readOffset_ = sizeof(SectorHeader);
+  for (uint16_t s = readSector_;; s = (s + 1) % sectors_) {
+    uint32_t live = 0;
+    uint32_t end = scanSector(s, &live, true);
+    flashCount_ += live;
+    if (s == writeSector_) {
+      writeOffset_ = end;
+      break;
+    }
+  }
+  stats_.restored = flashCount_;
+  return true;
+}
+
+uint32_t Outbox::scanSector(uint16_t sector, uint32_t* live, bool index) {
+  uint32_t base = sectorBase(sector);
+  uint32_t offset = sizeof(SectorHeader);
+  while (offset + sizeof(Header) <= kSectorSize) {
+    Header h;
+    esp_partition_read(partition_, base + offset, &h, sizeof(h));
+    if (h.topicLength == 0xFF && h.payloadLength == 0xFFFF) {
+      return offset;  // erased: end of data
+    }
+    size_t size = recordSize(h);
+    if (h.topicLength == 0 || size > kSectorSize - offset) {
+      return kSectorSize;  // torn header: write in the next sector
+    }
+    if (h.state == kStateCommitted) {
+      (*live)++;
+      if (index && (h.flags & kFlagSupersede)) {
+        char topic[0x100];
+        esp_partition_read(partition_, base + offset + sizeof(Header), topic, h.topicLength);
+        topic[h.topicLength - 1] = 0;
+        indexSupersede(topic, base + offset);
+      }
+    }
+    offset += size;
+  }
+  return offset;
+}
+
+bool Outbox::openNextSector() {
+  uint16_t next = (writeSector_ + 1) % sectors_;
+  if (sequence_ && next == readSector_) {
+    // Ring full: the oldest sector goes, with whatever it still held
+    uint32_t live = 0;
+    scanSector(next, &live, false);
+    flashCount_ -= live;
+    stats_.dropped += live;
+    for (int i = 0; i < kSupersedeSlots; i++) {
+      uint32_t at = supersedeIndex_[i].offset;
+      if (at >= sectorBase(next) && at < sectorBase(next) + kSectorSize) {
+        supersedeIndex_[i].offset = 0;
+      }
+    }
+    readSector_ = (next + 1) % sectors_;
+    readOffset_ = sizeof(SectorHeader);
+  }
+  if (esp_partition_erase_range(partition_, sectorBase(next), kSectorSize) != ESP_OK) {
+    return false;
+  }
+  SectorHeader sh = {kSectorMagic, sequence_ + 1};
+  if (esp_partition_write(partition_, sectorBase(next), &sh, sizeof(sh)) != ESP_OK) {
+    return false;
+  }
+  sequence_++;
+  writeSector_ = next;
+  writeOffset_ = sizeof(SectorHeader);
+  return true;
+}
+
+bool Outbox::flashAppend(const uint8_t* record, size_t size) {
+  if (writeOffset_ + size > kSectorSize && !openNextSector()) {
+    return false;
+  }
+  uint32_t offset = sectorBase(writeSector_) + writeOffset_;
+  writeOffset_ += size;
+  // Everything but the state byte first: a reset in between leaves a record
+  // that reads back uncommitted and is skipped
+  if (esp_partition_write(partition_, offset + 1, record + 1, size - 1) != ESP_OK) {
+    return false;
+  }
+  uint8_t state = kStateCommitted;
+  if (esp_partition_write(partition_, offset, &state, 1) != ESP_OK) {
+    return false;
+  }
+  flashCount_++;
+  Header h;
+  memcpy(&h, record, sizeof(h));
+  if (h.flags & kFlagSupersede) {
+    indexSupersede((const char*)record + sizeof(Header), offset);
+  }
+  return true;
+}
+
+bool Outbox::flashFindOldest(uint32_t* offset, Header* h) {
+  for (;;) {
+    uint32_t base = sectorBase(readSector_);
+    while (readOffset_ + sizeof(Header) <= kSectorSize) {
+      esp_partition_read(partition_, base + readOffset_, h, sizeof(*h));
+      if (h->topicLength == 0xFF && h->payloadLength == 0xFFFF) {
+        break;
+      }
+      size_t size = recordSize(*h);
+      if (h->topicLength == 0 || size > kSectorSize - readOffset_) {
+        break;
+      }
+      if (h->state == kStateCommitted) {
+        *offset = base + readOffset_;
+        return true;
+      }
+      readOffset_ += size;  // sent, superseded or torn
+    }
+    if (readSector_ == writeSector_) {
+      return false;
+    }
+    readSector_ = (readSector_ + 1) % sectors_;
+    readOffset_ = sizeof(SectorHeader);
+  }
+}
+
+void Outbox::flashMarkDone(uint32_t offset) {
+  uint8_t state = kStateDone;
+  esp_partition_write(partition_, offset, &state, 1);
+  for (int i = 0; i < kSupersedeSlots; i++) {
+    if (supersedeIndex_[i].offset == offset) {
+      supersedeIndex_[i].offset = 0;
+    }
+  }
+}
+
+// Only superseding records are indexed, by topic hash, so a push does not
+// have to read the whole ring
+void Outbox::indexSupersede(const char* topic, uint32_t offset) {
+  uint32_t hash = topicHash(topic);
+  int slot = hash % kSupersedeSlots;
+  for (int i = 0; i < kSupersedeSlots; i++) {
+    if (supersedeIndex_[i].offset && supersedeIndex_[i].hash == hash) {
+      slot = i;
+      break;
+    }
+    if (!supersedeIndex_[i].offset) {
+      slot = i;
+    }
+  }
+  supersedeIndex_[slot].hash = hash;
+  supersedeIndex_[slot].offset = offset;
+}
+
+void Outbox::flashSupersede(const char* topic, size_t topicLength) {
+  uint32_t hash = topicHash(topic);
+  for (int i = 0; i < kSupersedeSlots; i++) {
+    uint32_t offset = supersedeIndex_[i].offset;
+    if (!offset || supersedeIndex_[i].hash != hash) {
+      continue;
+    }
+    Header h;
+    esp_partition_read(partition_, offset, scratch_, sizeof(Header) + topicLength);
+    memcpy(&h, scratch_, sizeof(h));
+    if (h.state == kStateCommitted && sameTopic(h, scratch_, topic, topicLength)) {
+      flashMarkDone(offset);
+      flashCount_--;
+      stats_.superseded++;
+    }
+    supersedeIndex_[i].offset = 0;
+  }
+}
+
+void Outbox::printStats(Print& out) {
+  out.printf("   queued=%lu (flash %lu) sent=%lu superseded=%lu spilled=%lu restored=%lu dropped=%lu refused=%lu\n",
+             (unsigned long)size(), (unsigned long)flashCount_, (unsigned long)stats_.sent,
+             (unsigned long)stats_.superseded, (unsigned long)stats_.spilled, (unsigned long)stats_.restored,
+             (unsigned long)stats_.dropped, (unsigned long)stats_.refused);
+}
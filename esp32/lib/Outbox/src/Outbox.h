@@ -0,0 +1,164 @@
+/*
+  Outbox.h - bounded queue for MQTT publishes made while the broker is
+  unreachable.
+
+  Messages are kept in a RAM ring of OUTBOX_RAM_BYTES. With attachFlash()
+  the oldest ones spill into a ring of flash sectors when RAM fills up, and
+  spillAll() moves the rest there before a planned restart; whatever is in
+  flash at boot is queued again. drain() hands messages back oldest first,
+  flash before RAM, at most setDrainRate() per second, so a reconnect does
+  not flood the broker or the QoS 1 window.
+
+  A message pushed with supersede set (retained messages always are)
+  replaces the queued superseding message for the same topic: only the
+  latest relay status or heartbeat is worth sending late, while every
+  sensor sample is kept.
+
+  Flash layout: each sector starts with {magic, sequence}; records follow
+  back to back. A record's state byte is programmed last (committed) and
+  cleared to 0 once sent or superseded, so the queue is tracked without
+  erasing and a write torn by a reset is never replayed. The sector after
+  the newest is erased when the ring wraps, dropping its unsent records.
+*/
+
+#ifndef Outbox_h
+#define Outbox_h
+
+#include <Arduino.h>
+#include <esp_partition.h>
+
+// OUTBOX_RAM_BYTES : RAM ring size. ~20 sensor messages at 4 KB.
+#ifndef OUTBOX_RAM_BYTES
+#define OUTBOX_RAM_BYTES 4096
+#endif
+
+// OUTBOX_MAX_RECORD : largest topic + payload + header accepted by push()
+#ifndef OUTBOX_MAX_RECORD
+#define OUTBOX_MAX_RECORD 512
+#endif
+
+struct OutboxMessage {
+  const char* topic;
+  const uint8_t* payload;
+  uint16_t length;
+  uint8_t qos;
+  bool retained;
+};
+
+class Outbox {
+public:
+  // Publishes one message; false leaves it queued (QoS 1 window full,
+  // connection lost) and drain() tries again later.
+  typedef bool (*SendFn)(const OutboxMessage& message);
+
+  static const uint32_t kRetryMs = 100;       // after a refused send
+  static const uint32_t kSectorSize = SPI_FLASH_SEC_SIZE;
+
+  struct Stats {
+    uint32_t queued;
+    uint32_t sent;
+    uint32_t superseded;  // replaced by a newer message for the same topic
+    uint32_t spilled;     // moved from RAM to flash
+    uint32_t restored;    // found in flash at boot
+    uint32_t dropped;     // oldest discarded for lack of space
+    uint32_t refused;     // sends that returned false
+  };
+
+  Outbox();
+
+  // Uses the first sectors (at least 2) of the data partition label as the
+  // flash ring and queues the messages left there. False if the partition
+  // is missing or too small; the outbox then stays RAM-only.
+  bool attachFlash(const char* label, uint16_t sectors);
+  // Messages per second drain() sends; 0 means no limit.
+  void setDrainRate(uint16_t perSecond);
+
+  // False if the message is larger than OUTBOX_MAX_RECORD.
+  bool push(const char* topic, const uint8_t* payload, size_t length, uint8_t qos = 0, bool retained = false,
+            bool supersede = false);
+  // Sends due messages in order. Returns ms until it should run again, 0
+  // once the queue is empty.
+  uint32_t drain(uint32_t now, SendFn send);
+  // Moves everything in RAM to flash (no-op without flash).
+  void spillAll();
+
+  bool empty() const { return count_ == 0 && flashCount_ == 0; }
+  uint32_t size() const { return count_ + flashCount_; }
+  uint32_t flashSize() const { return flashCount_; }
+  const Stats& stats() const { return stats_; }
+  void printStats(Print& out);
+
+private:
+  struct Header {
+    uint8_t state;
+    uint8_t flags;
+    uint8_t topicLength;  // including the terminating 0
+    uint8_t reserved;
+    uint16_t payloadLength;
+  };
+
+  struct SectorHeader {
+    uint32_t magic;
+    uint32_t sequence;
+  };
+
+  // Where a peeked message lives, for consume()
+  struct Location {
+    bool flash;
+    uint32_t offset;
+  };
+
+  static const int kSupersedeSlots = 8;
+
+  static size_t recordSize(const Header& h);
+  static bool sameTopic(const Header& h, const uint8_t* record, const char* topic, size_t topicLength);
+  static uint32_t topicHash(const char* topic);
+
+  bool peek(OutboxMessage* message, Location* at);
+  void consume(const Location& at);
+  bool evictOldest();
+
+  // RAM ring
+  uint32_t ramHead();  // skips a wrap pad
+  bool ramFits(size_t size, uint32_t* at);
+  void ramDropHead();
+  void ramSupersede(const char* topic, size_t topicLength);
+
+  // Flash ring
+  uint32_t sectorBase(uint16_t sector) const { return (uint32_t)sector * kSectorSize; }
+  bool flashAppend(const uint8_t* record, size_t size);
+  bool openNextSector();
+  bool flashFindOldest(uint32_t* offset, Header* h);
+  void flashMarkDone(uint32_t offset);
+  void flashSupersede(const char* topic, size_t topicLength);
+  // Walks a sector's records; returns where the next one would go and
+  // counts the unsent ones in live
+  uint32_t scanSector(uint16_t sector, uint32_t* live, bool index);
+  void indexSupersede(const char* topic, uint32_t offset);
+
+  uint8_t ram_[OUTBOX_RAM_BYTES];
+  uint32_t head_;
+  uint32_t tail_;
+  uint32_t records_;  // records in RAM, including superseded ones
+  uint32_t count_;    // live records in RAM
+
+  const esp_partition_t* partition_;
+  uint16_t sectors_;
+  uint16_t readSector_;
+  uint16_t writeSector_;
+  uint32_t readOffset_;   // within readSector_
+  uint32_t writeOffset_;  // within writeSector_
+  uint32_t sequence_;     // of writeSector_
+  uint32_t flashCount_;   // live records in flash
+  struct {
+    uint32_t hash;
+    uint32_t offset;  // absolute in the partition; 0 = unused
+  } supersedeIndex_[kSupersedeSlots];
+
+  uint8_t scratch_[OUTBOX_MAX_RECORD];
+  uint32_t drainIntervalMs_;
+  uint32_t nextSendAt_;
+  Stats stats_;
+};
+
+#endif
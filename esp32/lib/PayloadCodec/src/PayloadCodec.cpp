@@ -0,0 +1,136 @@
+/*
+  PayloadCodec.cpp - JSON or MessagePack payloads for the firmware's MQTT topics.
+*/
+
+#include "PayloadCodec.h"
+
+#include <string.h>
+
+PayloadFormat payloadFormatOf(const char* topic) {
+  size_t length = strlen(topic);
+  size_t suffix = sizeof(PAYLOAD_MSGPACK_SUFFIX) - 1;
+  if (length >= suffix && memcmp(topic + length - suffix, PAYLOAD_MSGPACK_SUFFIX, suffix) == 0) {
+    return PAYLOAD_MSGPACK;
+  }
+  return PAYLOAD_JSON;
+}
+
+const char* payloadTopicSuffix(PayloadFormat format) {
+  return format == PAYLOAD_MSGPACK ? PAYLOAD_MSGPACK_SUFFIX : "";
+}
+
+const char* payloadFormatName(PayloadFormat format) {
+  return format == PAYLOAD_MSGPACK ? "MessagePack" : "JSON";
+}
+
+size_t msgPackMapHeaderSize(const uint8_t* data, size_t length) {
+  if (length < 1) return 0;
+  if ((data[0] & 0xF0) == 0x80) return 1;  // fixmap
+  if (data[0] == 0xDE) return length >= 3 ? 3 : 0;
+  if (data[0] == 0xDF) return length >= 5 ? 5 : 0;
+  return 0;
+}
+
+MsgPackWriter::MsgPackWriter(char* buffer, size_t capacity)
+    : buffer_((uint8_t*)buffer), capacity_(capacity), length_(0), overflowed_(false) {}
+
+bool MsgPackWriter::reserve(size_t bytes) {
+  if (overflowed_ || length_ + bytes > capacity_) {
+    overflowed_ = true;
+    return false;
+  }
+  return true;
+}
+
+void MsgPackWriter::put(uint8_t byte) {
+  buffer_[length_++] = byte;
+}
+
+void MsgPackWriter::putBigEndian(uint32_t value, uint8_t bytes) {
+  while (bytes--) {
+    put((uint8_t)(value >> (8 * bytes)));
+  }
+}
+
+MsgPackWriter& MsgPackWriter::map(uint32_t entries) {
+  if (entries < 16) {
+    if (reserve(1)) put(0x80 | entries);
+  } else if (entries < 0x10000) {
+    if (reserve(3)) { put(0xDE); putBigEndian(entries, 2); }
+  } else {
+    if (reserve(5)) { put(0xDF); putBigEndian(entries, 4); }
+  }
+  return *this;
+}
+
+MsgPackWriter& MsgPackWriter::str(const char* s) {
+  return str(s, strlen(s));
+}
+
+MsgPackWriter& MsgPackWriter::str(const char* s, size_t length) {
+  size_t header = length < 32 ? 1 : length < 0x100 ? 2 : length < 0x10000 ? 3 : 5;
+  if (!reserve(header + length)) return *this;
+  if (header == 1) {
+    put(0xA0 | length);
+  } else if (header == 2) {
+    put(0xD9); put(length);
+  } else if (header == 3) {
+    put(0xDA); putBigEndian(length, 2);
+  } else {
+    put(0xDB); putBigEndian(length, 4);
+  }
+  memcpy(buffer_ + length_, s, length);
+  length_ += length;
+  return *this;
+}
+
+// Smallest encoding that holds the value, as ArduinoJson's serializer does
+MsgPackWriter& MsgPackWriter::uint32(uint32_t value) {
+  if (value < 0x80) {
+    if (reserve(1)) put(value);
+  } else if (value < 0x100) {
+    if (reserve(2)) { put(0xCC); put(value); }
+  } else if (value < 0x10000) {
+    if (reserve(3)) { put(0xCD); putBigEndian(value, 2); }
+  } else {
+    if (reserve(5)) { put(0xCE); putBigEndian(value, 4); }
+  }
+  return *this;
+}
+
+MsgPackWriter& MsgPackWriter::uint64(uint64_t value) {
+  if (value <= 0xFFFFFFFFULL) return uint32((uint32_t)value);
+  if (reserve(9)) { put(0xCF); putBigEndian((uint32_t)(value >> 32), 4); putBigEndian((uint32_t)value, 4); }
+  return *this;
+}
+
+MsgPackWriter& MsgPackWriter::int32(int32_t value) {
+  if (value >= 0) return uint32((uint32_t)value);
+  if (value >= -32) {
+    if (reserve(1)) put((uint8_t)value);
+  } else if (value >= -128) {
+    if (reserve(2)) { put(0xD0); put((uint8_t)value); }
+  } else if (value >= -32768) {
+    if (reserve(3)) { put(0xD1); putBigEndian((uint32_t)value, 2); }
+  } else {
+    if (reserve(5)) { put(0xD2); putBigEndian((uint32_t)value, 4); }
+  }
+  return *this;
+}
+
+MsgPackWriter& MsgPackWriter::float32(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  if (reserve(5)) { put(0xCA); putBigEndian(bits, 4); }
+  return *this;
+}
+
+MsgPackWriter& MsgPackWriter::boolean(bool value) {
+  if (reserve(1)) put(value ? 0xC3 : 0xC2);
+  return *this;
+}
+
+MsgPackWriter& MsgPackWriter::nil() {
+  if (reserve(1)) put(0xC0);
+  return *this;
+}
@@ -0,0 +1,70 @@
+/*
+  PayloadCodec.h - JSON or MessagePack payloads for the firmware's MQTT topics.
+
+  A MessagePack message carries PAYLOAD_MSGPACK_SUFFIX at the end of its
+  topic (esp32/<id>/status/msgpack), so a subscriber knows how to decode it
+  without sniffing the bytes and JSON consumers of the plain topics never
+  see binary data. payloadFormatOf() reads the marker back on the receiving
+  side; decoding itself is ArduinoJson's deserializeMsgPack().
+
+  MsgPackWriter encodes the changing part of a pre-rendered message into a
+  fixed buffer, the MessagePack counterpart of the snprintf() bodies:
+
+    char body[64];
+    MsgPackWriter w(body, sizeof(body));
+    w.str("timestamp").uint32(millis());
+    publish(..., body, w.length());  // -1 when the buffer was too small
+*/
+
+#ifndef PayloadCodec_h
+#define PayloadCodec_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum PayloadFormat {
+  PAYLOAD_JSON,
+  PAYLOAD_MSGPACK
+};
+
+#define PAYLOAD_MSGPACK_SUFFIX "/msgpack"
+
+// Format of a message on topic, from its content-type marker
+PayloadFormat payloadFormatOf(const char* topic);
+// Topic suffix for format: "" or PAYLOAD_MSGPACK_SUFFIX
+const char* payloadTopicSuffix(PayloadFormat format);
+const char* payloadFormatName(PayloadFormat format);
+
+// Size of the map header at the start of a serialized MessagePack map, 0 if
+// data does not start with one
+size_t msgPackMapHeaderSize(const uint8_t* data, size_t length);
+
+class MsgPackWriter {
+public:
+  MsgPackWriter(char* buffer, size_t capacity);
+
+  MsgPackWriter& map(uint32_t entries);
+  MsgPackWriter& str(const char* s);
+  MsgPackWriter& str(const char* s, size_t length);
+  MsgPackWriter& uint32(uint32_t value);
+  MsgPackWriter& uint64(uint64_t value);  // epoch milliseconds need the 8-byte form
+  MsgPackWriter& int32(int32_t value);
+  MsgPackWriter& float32(float value);
+  MsgPackWriter& boolean(bool value);
+  MsgPackWriter& nil();
+
+  // Bytes written, or -1 once something did not fit
+  int length() const { return overflowed_ ? -1 : (int)length_; }
+
+private:
+  void put(uint8_t byte);
+  void putBigEndian(uint32_t value, uint8_t bytes);
+  bool reserve(size_t bytes);
+
+  uint8_t* buffer_;
+  size_t capacity_;
+  size_t length_;
+  bool overflowed_;
+};
+
+#endif
@@ -0,0 +1,79 @@
+/*
+  SampleBatch.cpp - timestamped sensor samples sent many to a message.
+*/
+
+#include "SampleBatch.h"
+
+SampleBatch::SampleBatch()
+    : channelCount_(0), maxSamples_(kMaxSamples), maxAgeMs_(0), count_(0), base_(0) {
+  memset(channels_, 0, sizeof(channels_));
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+int SampleBatch::addChannel(const char* name) {
+  if (channelCount_ >= kMaxChannels) return -1;
+  channels_[channelCount_].name = name;
+  return channelCount_++;
+}
+
+void SampleBatch::setLimits(uint8_t maxSamples, uint32_t maxAgeMs) {
+  maxSamples_ = maxSamples == 0 || maxSamples > kMaxSamples ? kMaxSamples : maxSamples;
+  maxAgeMs_ = maxAgeMs;
+}
+
+bool SampleBatch::add(int channel, uint32_t at, float value) {
+  if (channel < 0 || channel >= channelCount_) return false;
+  Channel& c = channels_[channel];
+  if (c.count >= maxSamples_) {
+    stats_.refused++;
+    return false;
+  }
+  if (count_ == 0) base_ = at;
+  c.at[c.count] = at;
+  c.value[c.count] = value;
+  c.count++;
+  count_++;
+  stats_.samples++;
+  return true;
+}
+
+bool SampleBatch::full(int channel) const {
+  return channel >= 0 && channel < channelCount_ && channels_[channel].count >= maxSamples_;
+}
+
+bool SampleBatch::due(uint32_t now) const {
+  if (count_ == 0) return false;
+  if (maxAgeMs_ && now - base_ >= maxAgeMs_) return true;
+  for (int i = 0; i < channelCount_; i++) {
+    if (channels_[i].count >= maxSamples_) return true;
+  }
+  return false;
+}
+
+void SampleBatch::serialize(JsonObject data) const {
+  for (int i = 0; i < channelCount_; i++) {
+    const Channel& c = channels_[i];
+    if (!c.count) continue;
+    JsonObject channel = data[c.name].to<JsonObject>();
+    JsonArray times = channel["t"].to<JsonArray>();
+    JsonArray values = channel["v"].to<JsonArray>();
+    for (uint8_t k = 0; k < c.count; k++) {
+      times.add(c.at[k] - base_);
+      values.add(c.value[k]);
+    }
+  }
+}
+
+void SampleBatch::clear() {
+  if (count_ == 0) return;
+  for (int i = 0; i < channelCount_; i++) channels_[i].count = 0;
+  count_ = 0;
+  stats_.batches++;
+}
+
+void SampleBatch::printStats(Print& out) {
+  out.printf("   samples=%lu batches=%lu (%.1f samples each) refused=%lu held=%lu\n",
+             (unsigned long)stats_.samples, (unsigned long)stats_.batches,
+             stats_.batches ? (double)(stats_.samples - count_) / stats_.batches : 0.0,
+             (unsigned long)stats_.refused, (unsigned long)count_);
+}
@@ -0,0 +1,81 @@
+/*
+  SampleBatch.h - timestamped sensor samples sent many to a message.
+
+  Samples are kept per channel in arrival order. A batch is due once any
+  channel holds maxSamples, or its oldest sample is maxAge old; serialize()
+  then writes each channel that has samples as two packed arrays, times
+  relative to the batch base (the oldest sample) and values:
+
+    "temperature":{"t":[0,2000,6000],"v":[25.1,25.3,25.6]}
+
+  ArduinoJson does the encoding, so the same JsonObject becomes JSON or
+  MessagePack.
+
+    batch.add(t, millis(), temperature);
+    if (batch.due(millis())) {
+      doc["timestamp"] = batch.base();
+      batch.serialize(doc["data"].to<JsonObject>());
+      ... publish ...
+      batch.clear();
+    }
+*/
+
+#ifndef SampleBatch_h
+#define SampleBatch_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+class SampleBatch {
+public:
+  static const int kMaxChannels = 8;
+  static const int kMaxSamples = 32;  // per channel
+
+  struct Stats {
+    uint32_t samples;  // add() calls that were kept
+    uint32_t batches;  // clear() calls on a non-empty batch
+    uint32_t refused;  // add() calls on a full channel
+  };
+
+  SampleBatch();
+
+  // Returns the channel index, or -1 when the table is full.
+  int addChannel(const char* name);
+  // maxSamples per channel (at most kMaxSamples); maxAgeMs 0 = no age limit
+  void setLimits(uint8_t maxSamples, uint32_t maxAgeMs);
+
+  // False when the channel already holds maxSamples: flush first.
+  bool add(int channel, uint32_t at, float value);
+  bool full(int channel) const;
+  // A channel is full, or the oldest sample is maxAge old
+  bool due(uint32_t now) const;
+  bool empty() const { return count_ == 0; }
+  size_t size() const { return count_; }  // samples held, all channels
+  uint32_t base() const { return base_; }  // time of the oldest sample
+
+  // Writes name: {"t": [...], "v": [...]} for every channel with samples,
+  // in channel order, samples in the order they were added.
+  void serialize(JsonObject data) const;
+  void clear();
+
+  const Stats& stats() const { return stats_; }
+  void printStats(Print& out);
+
+private:
+  struct Channel {
+    const char* name;
+    uint8_t count;
+    uint32_t at[kMaxSamples];
+    float value[kMaxSamples];
+  };
+
+  Channel channels_[kMaxChannels];
+  int channelCount_;
+  uint8_t maxSamples_;
+  uint32_t maxAgeMs_;
+  size_t count_;
+  uint32_t base_;
+  Stats stats_;
+};
+
+#endif
@@ -0,0 +1,304 @@
+/*
+  TaskWheel.cpp - cooperative timer-wheel scheduler for loop().
+*/
+
+#include "TaskWheel.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <esp_timer.h>
+#include <esp_vfs_eventfd.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+namespace {
+
+int wake_fd = -1;
+
+// select() on the eventfd and the caller's socket: whichever is readable
+// first, or the timeout, ends the sleep.
+bool waitMicros(uint64_t us, int fd) {
+  if (wake_fd < 0) {
+    delay(us / 1000);
+    return false;
+  }
+  fd_set readable;
+  FD_ZERO(&readable);
+  FD_SET(wake_fd, &readable);
+  int max_fd = wake_fd;
+  if (fd >= 0) {
+    FD_SET(fd, &readable);
+    if (fd > max_fd) max_fd = fd;
+  }
+  struct timeval timeout;
+  timeout.tv_sec = us / 1000000ULL;
+  timeout.tv_usec = us % 1000000ULL;
+  int ready = select(max_fd + 1, &readable, nullptr, nullptr, &timeout);
+  if (ready > 0 && FD_ISSET(wake_fd, &readable)) {
+    uint64_t count;
+    read(wake_fd, &count, sizeof(count));
+  }
+  return ready > 0;
+}
+
+// eventfd writes are ISR-safe when the fd was created with EFD_SUPPORT_ISR.
+void IRAM_ATTR signalWake() {
+  if (wake_fd < 0) return;
+  uint64_t one = 1;
+  write(wake_fd, &one, sizeof(one));
+}
+
+}  // namespace
+
+uint64_t TaskWheel::nowMicros() { return (uint64_t)esp_timer_get_time(); }
+
+void TaskWheel::begin() {
+  if (wake_fd >= 0) return;
+  esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+  esp_vfs_eventfd_register(&config);
+  wake_fd = eventfd(0, EFD_SUPPORT_ISR);
+}
+
+#else  // host build on the ArduinoNative virtual clock
+
+#include <NativeSim.h>
+
+namespace {
+
+bool waitMicros(uint64_t us, int fd) {
+  (void)fd;
+  return nativesim::idleMicros(us);
+}
+
+void signalWake() {}
+
+}  // namespace
+
+uint64_t TaskWheel::nowMicros() { return nativesim::nowMicros(); }
+
+void TaskWheel::begin() {}
+
+#endif
+
+TaskWheel::TaskWheel()
+    : count_(0), cursor_(0), passes_(0), earlyWakes_(0), idleMicros_(0), wakePending_(false) {
+  for (int i = 0; i < kSlots; i++) slots_[i] = -1;
+}
+
+int TaskWheel::add(const char* name, uint32_t periodMs, TaskFn fn) {
+  if (count_ >= kMaxTasks) return -1;
+  if (count_ == 0) cursor_ = nowTicks();
+  int id = count_++;
+  Task& task = tasks_[id];
+  memset(&task.stats, 0, sizeof(task.stats));
+  task.fn = fn;
+  task.deadline = 0;
+  task.next = -1;
+  task.armed = false;
+  task.stopped = false;
+  task.stats.name = name;
+  task.stats.period = periodMs;
+  return id;
+}
+
+int TaskWheel::every(const char* name, uint32_t periodMs, TaskFn fn, uint32_t firstDelayMs) {
+  int id = add(name, periodMs, fn);
+  if (id >= 0) link(id, nowTicks() + firstDelayMs);
+  return id;
+}
+
+int TaskWheel::once(const char* name, TaskFn fn) {
+  return add(name, 0, fn);
+}
+
+void TaskWheel::runIn(int id, uint32_t delayMs) {
+  if (id < 0 || id >= count_) return;
+  unlink(id);
+  tasks_[id].stopped = false;
+  link(id, nowTicks() + delayMs);
+}
+
+void TaskWheel::setPeriod(int id, uint32_t periodMs) {
+  if (id < 0 || id >= count_) return;
+  tasks_[id].stats.period = periodMs;
+}
+
+void TaskWheel::cancel(int id) {
+  if (id < 0 || id >= count_) return;
+  unlink(id);
+  tasks_[id].stopped = true;
+}
+
+bool TaskWheel::armed(int id) const {
+  return id >= 0 && id < count_ && tasks_[id].armed;
+}
+
+// A deadline the sweep has already passed goes in the next slot to be
+// swept, so it runs on the next runDue() instead of a rotation later.
+void TaskWheel::link(int id, uint32_t deadline) {
+  Task& task = tasks_[id];
+  task.deadline = deadline;
+  uint32_t tick = before(deadline, cursor_) ? cursor_ : deadline;
+  int slot = (int)(tick & (kSlots - 1));
+  task.next = slots_[slot];
+  slots_[slot] = (int8_t)id;
+  task.armed = true;
+}
+
+void TaskWheel::unlink(int id) {
+  Task& task = tasks_[id];
+  if (!task.armed) return;
+  for (int slot = 0; slot < kSlots; slot++) {
+    int8_t* link = &slots_[slot];
+    while (*link >= 0) {
+      if (*link == id) {
+        *link = task.next;
+        task.armed = false;
+        task.next = -1;
+        return;
+      }
+      link = &tasks_[*link].next;
+    }
+  }
+}
+
+void TaskWheel::runDue() {
+  passes_++;
+  uint32_t now = nowTicks();
+
+  // Sweep the slot of every tick since the last call (the whole wheel once
+  // after a long gap). The slot at cursor_ is always swept: runNow() and
+  // late re-arms land there.
+  uint32_t ticks = before(now, cursor_) ? 1 : now - cursor_ + 1;
+  if (ticks > (uint32_t)kSlots) ticks = kSlots;
+
+  int8_t due[kMaxTasks];
+  int dueCount = 0;
+  for (uint32_t i = 0; i < ticks; i++) {
+    int8_t* link = &slots_[(cursor_ + i) & (kSlots - 1)];
+    while (*link >= 0) {
+      Task& task = tasks_[*link];
+      if (before(now, task.deadline)) {
+        link = &task.next;
+        continue;
+      }
+      int8_t id = *link;
+      *link = task.next;
+      task.next = -1;
+      task.armed = false;
+      // Earliest deadline first; ties keep registration order
+      int at = dueCount++;
+      while (at > 0 && (before(task.deadline, tasks_[due[at - 1]].deadline) ||
+                        (task.deadline == tasks_[due[at - 1]].deadline && id < due[at - 1]))) {
+        due[at] = due[at - 1];
+        at--;
+      }
+      due[at] = id;
+    }
+  }
+  if (!before(now, cursor_)) cursor_ = now + 1;
+
+  for (int i = 0; i < dueCount; i++) run(due[i], now);
+}
+
+void TaskWheel::run(int id, uint32_t now) {
+  Task& task = tasks_[id];
+  TaskStats& stats = task.stats;
+
+  uint64_t start = nowMicros();
+  uint32_t late = (now - task.deadline) * 1000U + (uint32_t)(start % 1000ULL);
+  if (late > stats.maxLateMicros) stats.maxLateMicros = late;
+
+  task.fn();
+
+  uint32_t took = (uint32_t)(nowMicros() - start);
+  stats.runs++;
+  stats.totalRunMicros += took;
+  if (took > stats.maxRunMicros) stats.maxRunMicros = took;
+  if (stats.period && took > stats.period * 1000U) stats.overruns++;
+
+  // Periodic tasks keep their phase; periods that already went by while the
+  // task was late (or running) are skipped rather than run back to back.
+  if (stats.period && !task.armed && !task.stopped) {
+    uint32_t end = nowTicks();
+    uint32_t next = task.deadline + stats.period;
+    if (!before(end, next)) {
+      uint32_t missed = (end - task.deadline) / stats.period;
+      stats.skipped += missed;
+      next = task.deadline + (missed + 1) * stats.period;
+    }
+    link(id, next);
+  }
+}
+
+uint32_t TaskWheel::msUntilNext() {
+  uint32_t now = nowTicks();
+  // Scan one rotation from the sweep position: the first slot holding a
+  // deadline inside this rotation has the earliest one.
+  for (int i = 0; i < kSlots; i++) {
+    int8_t id = slots_[(cursor_ + i) & (kSlots - 1)];
+    bool found = false;
+    uint32_t best = 0;
+    for (; id >= 0; id = tasks_[id].next) {
+      uint32_t deadline = tasks_[id].deadline;
+      if (!before(deadline, cursor_ + kSlots)) continue;  // a later rotation
+      if (!found || before(deadline, best)) best = deadline;
+      found = true;
+    }
+    if (found) return before(now, best) ? best - now : 0;
+  }
+  // Nothing within a rotation: fall back to the earliest armed deadline.
+  bool found = false;
+  uint32_t best = 0;
+  for (int id = 0; id < count_; id++) {
+    if (!tasks_[id].armed) continue;
+    if (!found || before(tasks_[id].deadline, best)) best = tasks_[id].deadline;
+    found = true;
+  }
+  if (!found) return UINT32_MAX;
+  return before(now, best) ? best - now : 0;
+}
+
+bool TaskWheel::idle(int fd) {
+  if (wakePending_) {
+    wakePending_ = false;
+    earlyWakes_++;
+    return true;
+  }
+  uint32_t wait = msUntilNext();
+  if (wait == 0) return false;
+  if (wait > kMaxIdleMs) wait = kMaxIdleMs;
+
+  // Wake on the tick boundary the deadline names, not wait ms from mid-tick
+  uint64_t start = nowMicros();
+  uint64_t us = (uint64_t)wait * 1000ULL - start % 1000ULL;
+  bool early = waitMicros(us, fd);
+  idleMicros_ += nowMicros() - start;
+  wakePending_ = false;
+  if (early) earlyWakes_++;
+  return early;
+}
+
+void TaskWheel::wake() {
+  wakePending_ = true;
+  signalWake();
+}
+
+void IRAM_ATTR TaskWheel::wakeFromISR() {
+  wakePending_ = true;
+  signalWake();
+}
+
+void TaskWheel::printStats(Print& out) {
+  out.printf("   %-10s %7s %8s %6s %6s %9s %9s %8s\n",
+             "task", "period", "runs", "over", "skip", "late_max", "run_max", "run_avg");
+  for (int id = 0; id < count_; id++) {
+    const TaskStats& s = tasks_[id].stats;
+    out.printf("   %-10s %7lu %8lu %6lu %6lu %9lu %9lu %8lu\n", s.name,
+               (unsigned long)s.period, (unsigned long)s.runs, (unsigned long)s.overruns,
+               (unsigned long)s.skipped, (unsigned long)s.maxLateMicros, (unsigned long)s.maxRunMicros,
+               (unsigned long)(s.runs ? s.totalRunMicros / s.runs : 0));
+  }
+  out.printf("   passes=%lu early_wakes=%lu idle_ms=%lu\n", (unsigned long)passes_,
+             (unsigned long)earlyWakes_, (unsigned long)(idleMicros_ / 1000ULL));
+}
@@ -0,0 +1,106 @@
+/*
+  TaskWheel.h - cooperative timer-wheel scheduler for loop().
+
+  Tasks are plain functions with a period (every()) or a one-shot deadline
+  armed with runIn(). Deadlines live in a hashed timing wheel of 1 ms ticks,
+  so finding what is due costs the ticks that elapsed, not the task count.
+  loop() becomes:
+
+    scheduler.runDue();
+    scheduler.idle(client.fd());  // until the next deadline, wake() or socket data
+
+  On the ESP32 idle() blocks in select() on an ISR-capable eventfd (plus the
+  optional socket), so the CPU sleeps instead of spinning through delay(10).
+  Host builds sleep on the ArduinoNative virtual clock.
+
+  Every task keeps run-time and lateness statistics; printStats() dumps them.
+*/
+
+#ifndef TaskWheel_h
+#define TaskWheel_h
+
+#include <Arduino.h>
+
+class TaskWheel {
+public:
+  typedef void (*TaskFn)();
+
+  static const int kMaxTasks = 16;
+  static const int kSlots = 256;            // one rotation = 256 ms
+  static const uint32_t kMaxIdleMs = 1000;  // idle() never sleeps longer
+
+  struct TaskStats {
+    const char* name;
+    uint32_t period;         // ms, 0 for one-shot tasks
+    uint32_t runs;
+    uint32_t overruns;       // runs that took longer than the period
+    uint32_t skipped;        // periods dropped because the task started a period late
+    uint32_t maxLateMicros;  // start time past the deadline
+    uint32_t maxRunMicros;
+    uint64_t totalRunMicros;
+  };
+
+  TaskWheel();
+
+  // Sets up the wakeup channel; call once from setup().
+  void begin();
+
+  // Periodic task, first run after firstDelayMs. Returns the task id, or -1
+  // when the table is full.
+  int every(const char* name, uint32_t periodMs, TaskFn fn, uint32_t firstDelayMs = 0);
+  // One-shot task, registered idle; runIn() arms it.
+  int once(const char* name, TaskFn fn);
+
+  void runIn(int id, uint32_t delayMs);  // (re)arm: next run delayMs from now
+  void runNow(int id) { runIn(id, 0); }
+  void setPeriod(int id, uint32_t periodMs);  // takes effect from the next run
+  void cancel(int id);
+  bool armed(int id) const;
+
+  // Runs every task whose deadline has passed, earliest first.
+  void runDue();
+  // Milliseconds until the next deadline, or UINT32_MAX with nothing armed.
+  uint32_t msUntilNext();
+  // Sleeps until the next deadline (at most kMaxIdleMs), a wake() or, if fd
+  // is a socket, data on it. Returns true when woken before the deadline.
+  bool idle(int fd = -1);
+  void wake();
+  void wakeFromISR();  // same as wake(), safe in an interrupt handler
+
+  int taskCount() const { return count_; }
+  const TaskStats& stats(int id) const { return tasks_[id].stats; }
+  uint32_t passes() const { return passes_; }          // runDue() calls
+  uint32_t earlyWakes() const { return earlyWakes_; }  // idle() returns before the deadline
+  uint64_t idleMicros() const { return idleMicros_; }  // time spent in idle()
+  void printStats(Print& out);
+
+private:
+  struct Task {
+    TaskFn fn;
+    uint32_t deadline;  // tick (ms) of the next run
+    int8_t next;        // next task in the same wheel slot, -1 ends the list
+    bool armed;         // linked into the wheel
+    bool stopped;       // cancel()ed; runIn() restarts it
+    TaskStats stats;
+  };
+
+  static uint64_t nowMicros();
+  static uint32_t nowTicks() { return (uint32_t)(nowMicros() / 1000ULL); }
+  static bool before(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+
+  int add(const char* name, uint32_t periodMs, TaskFn fn);
+  void link(int id, uint32_t deadline);
+  void unlink(int id);
+  void run(int id, uint32_t now);
+
+  Task tasks_[kMaxTasks];
+  int8_t slots_[kSlots];
+  int count_;
+  uint32_t cursor_;  // last tick whose slot has been swept
+  uint32_t passes_;
+  uint32_t earlyWakes_;
+  uint64_t idleMicros_;
+  volatile bool wakePending_;
+};
+
+#endif
@@ -0,0 +1,218 @@
+/*
+  WallClock.cpp - epoch milliseconds for payload timestamps, kept by SNTP.
+*/
+
+#include "WallClock.h"
+
+#include <string.h>
+
+namespace {
+
+const size_t kPacketSize = 48;
+const uint16_t kLocalPort = 2390;
+const uint64_t kNtpUnixOffset = 2208988800ULL;  // 1900-01-01 to 1970-01-01, seconds
+
+uint32_t readBigEndian(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+void writeBigEndian(uint8_t* p, uint32_t value) {
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+
+// NTP 32.32 timestamp to epoch ms. Seconds with the top bit clear are in
+// era 1 (after 2036-02-07), as RFC 4330 section 3 suggests.
+int64_t toEpochMillis(const uint8_t* p) {
+  uint64_t seconds = readBigEndian(p);
+  if (!(seconds & 0x80000000ULL)) {
+    seconds += 0x100000000ULL;
+  }
+  uint64_t fraction = readBigEndian(p + 4);
+  return (int64_t)((seconds - kNtpUnixOffset) * 1000 + ((fraction * 1000) >> 32));
+}
+
+}  // namespace
+
+WallClock::WallClock()
+    : udp_(nullptr), server_(nullptr), port_(kNtpPort), syncIntervalMs_(kSyncIntervalMs),
+      retryMs_(kRetryMinMs), lastMillis_(0), wraps_(0), waiting_(false), sentAt_(0),
+      nextSyncAt_(0), synced_(false), offset_(0), floor_(0) {
+  memset(cookie_, 0, sizeof(cookie_));
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+void WallClock::begin(UDP& udp, const char* server, uint16_t port) {
+  udp_ = &udp;
+  server_ = server;
+  port_ = port;
+  udp_->begin(kLocalPort);
+  resync();
+}
+
+void WallClock::resync() {
+  if (!waiting_) {
+    nextSyncAt_ = uptime();
+  }
+  retryMs_ = kRetryMinMs;
+}
+
+// 64-bit millis(): counts the 49-day wraps it sees between calls, and
+// poll() runs far more often than that
+uint64_t WallClock::uptime() {
+  uint32_t ms = millis();
+  if (ms < lastMillis_) {
+    wraps_++;
+  }
+  lastMillis_ = ms;
+  return ((uint64_t)wraps_ << 32) | ms;
+}
+
+uint32_t WallClock::poll() {
+  if (!udp_) {
+    return syncIntervalMs_;
+  }
+  uint64_t at = uptime();
+
+  uint8_t packet[kPacketSize];
+  while (udp_->parsePacket() > 0) {
+    int length = udp_->read(packet, sizeof(packet));
+    if (waiting_ && length == (int)kPacketSize && memcmp(packet + 24, cookie_, sizeof(cookie_)) == 0) {
+      waiting_ = false;
+      if (acceptReply(packet, kPacketSize, at)) {
+        retryMs_ = kRetryMinMs;
+        nextSyncAt_ = at + syncIntervalMs_;
+      } else {
+        stats_.rejected++;
+        retryLater(at);
+      }
+    } else {
+      stats_.rejected++;  // late, spoofed or truncated
+    }
+  }
+
+  if (waiting_ && at - sentAt_ >= kTimeoutMs) {
+    waiting_ = false;
+    stats_.timeouts++;
+    retryLater(at);
+  }
+  if (!waiting_ && at >= nextSyncAt_) {
+    if (sendRequest(at)) {
+      waiting_ = true;
+    } else {
+      stats_.sendErrors++;
+      retryLater(at);
+    }
+  }
+
+  if (waiting_) {
+    return kReplyPollMs;
+  }
+  uint64_t wait = nextSyncAt_ - at;
+  return wait > syncIntervalMs_ ? syncIntervalMs_ : (uint32_t)wait;
+}
+
+// Retries double from kRetryMinMs up to kRetryMaxMs, never past the
+// regular sync interval
+void WallClock::retryLater(uint64_t at) {
+  nextSyncAt_ = at + retryMs_;
+  retryMs_ = retryMs_ * 2 > kRetryMaxMs ? kRetryMaxMs : retryMs_ * 2;
+  if (retryMs_ > syncIntervalMs_) {
+    retryMs_ = syncIntervalMs_;
+  }
+}
+
+bool WallClock::sendRequest(uint64_t at) {
+  uint8_t packet[kPacketSize];
+  memset(packet, 0, sizeof(packet));
+  packet[0] = 0x23;  // LI 0, version 4, mode 3 (client)
+  // The transmit timestamp only has to come back unchanged; the send time in
+  // uptime ms makes it unique per request
+  writeBigEndian(cookie_, (uint32_t)(at / 1000));
+  writeBigEndian(cookie_ + 4, (uint32_t)(((at % 1000) << 32) / 1000));
+  memcpy(packet + 40, cookie_, sizeof(cookie_));
+
+  stats_.requests++;
+  sentAt_ = at;
+  if (!udp_->beginPacket(server_, port_)) {
+    return false;
+  }
+  udp_->write(packet, sizeof(packet));
+  return udp_->endPacket() == 1;
+}
+
+bool WallClock::acceptReply(const uint8_t* packet, size_t length, uint64_t at) {
+  uint8_t leap = packet[0] >> 6;
+  uint8_t mode = packet[0] & 0x07;
+  uint8_t stratum = packet[1];
+  if (length < kPacketSize || mode != 4 || leap == 3 || stratum == 0 || stratum > 15) {
+    return false;  // not a server, or one without a reference (stratum 0 is a kiss-o'-death)
+  }
+  static const uint8_t zero[8] = {0};
+  if (memcmp(packet + 40, zero, sizeof(zero)) == 0) {
+    return false;
+  }
+
+  // T1/T4 in uptime ms, T2/T3 in epoch ms
+  int64_t t1 = (int64_t)sentAt_;
+  int64_t t2 = toEpochMillis(packet + 32);
+  int64_t t3 = toEpochMillis(packet + 40);
+  int64_t t4 = (int64_t)at;
+  int64_t rtt = (t4 - t1) - (t3 - t2);
+  if (rtt < 0) {
+    rtt = 0;
+  }
+  if (rtt >= kTimeoutMs) {
+    return false;
+  }
+  int64_t offset = ((t2 - t1) + (t3 - t4)) / 2;
+
+  if (synced_) {
+    int64_t step = offset - offset_;
+    stats_.lastStepMs = (int32_t)step;
+    if (step < 0) {
+      stats_.heldMs += (uint32_t)-step;
+    }
+  }
+  offset_ = offset;
+  synced_ = true;
+  stats_.syncs++;
+  stats_.rttMs = (uint32_t)rtt;
+  return true;
+}
+
+uint64_t WallClock::now() {
+  if (!synced_) {
+    return 0;
+  }
+  uint64_t t = uptime() + offset_;
+  if (t < floor_) {
+    t = floor_;  // a backwards correction: hold until real time catches up
+  }
+  floor_ = t;
+  return t;
+}
+
+uint64_t WallClock::toEpoch(uint32_t stamp) {
+  if (!synced_) {
+    return 0;
+  }
+  uint64_t up = uptime();
+  uint64_t t = up - (uint32_t)((uint32_t)up - stamp) + offset_;
+  uint64_t current = now();
+  return t < current ? t : current;
+}
+
+uint64_t WallClock::stamp(uint32_t stamp) {
+  return synced_ ? toEpoch(stamp) : stamp;
+}
+
+void WallClock::printStats(Print& out) {
+  out.printf("   synced=%s requests=%lu syncs=%lu timeouts=%lu rejected=%lu send errors=%lu\n",
+             synced_ ? "yes" : "no", (unsigned long)stats_.requests, (unsigned long)stats_.syncs,
+             (unsigned long)stats_.timeouts, (unsigned long)stats_.rejected, (unsigned long)stats_.sendErrors);
+  out.printf("   rtt=%lu ms last step=%ld ms held=%lu ms\n", (unsigned long)stats_.rttMs, (long)stats_.lastStepMs,
+             (unsigned long)stats_.heldMs);
+}
@@ -0,0 +1,102 @@
+/*
+  WallClock.h - epoch milliseconds for payload timestamps, kept by SNTP.
+
+  The clock is millis() plus an offset learned from an SNTP server
+  (RFC 4330). poll() is non-blocking: it sends one 48-byte request, picks the
+  reply up on a later call and retries with backoff when none arrives, so it
+  can run as a scheduler task next to the MQTT client. The offset belongs to
+  the clock, not to the network link: it survives WiFi and broker
+  reconnects and only changes when a new reply is accepted.
+
+    WiFiUDP udp;
+    WallClock clock;
+    clock.begin(udp, "pool.ntp.org");
+    ...
+    uint32_t wait = clock.poll();        // ms until it wants to run again
+    uint64_t t = clock.stamp(millis());  // epoch ms once synced, uptime ms before
+
+  now() never goes backwards. A correction that would move it back is
+  absorbed by holding the clock at the last value handed out until real
+  time catches up; forward corrections apply at once. toEpoch() converts an
+  earlier millis() reading (a queued sample) with the current offset, so
+  readings taken before the first sync still get a wall-clock time.
+
+  Replies are checked before they are used: server mode, a synchronized
+  stratum 1-15 source, our own transmit time echoed back, and a round trip
+  shorter than the timeout.
+*/
+
+#ifndef WallClock_h
+#define WallClock_h
+
+#include <Arduino.h>
+#include <Udp.h>
+
+class WallClock {
+public:
+  static const uint16_t kNtpPort = 123;
+  static const uint32_t kSyncIntervalMs = 3600000;  // resync hourly; the crystal drifts ~1 s a day
+  static const uint32_t kTimeoutMs = 2000;
+  static const uint32_t kRetryMinMs = 2000;
+  static const uint32_t kRetryMaxMs = 64000;
+  static const uint32_t kReplyPollMs = 10;         // poll() cadence while a reply is due: it is timed on pickup
+
+  struct Stats {
+    uint32_t requests;
+    uint32_t syncs;      // replies accepted
+    uint32_t timeouts;
+    uint32_t rejected;   // replies that failed validation
+    uint32_t sendErrors;
+    uint32_t rttMs;      // round trip of the last accepted reply
+    int32_t lastStepMs;  // correction applied by the last accepted reply
+    uint32_t heldMs;     // backwards corrections absorbed by holding the clock
+  };
+
+  WallClock();
+
+  void begin(UDP& udp, const char* server, uint16_t port = kNtpPort);
+  void setSyncInterval(uint32_t ms) { syncIntervalMs_ = ms; }
+  // Sync at the next poll(), e.g. once the network is back after a long outage
+  void resync();
+
+  // Sends, receives and times out requests; returns ms until the next call
+  uint32_t poll();
+
+  bool synced() const { return synced_; }
+  // Epoch milliseconds, 0 before the first sync
+  uint64_t now();
+  // Epoch milliseconds at an earlier millis() reading, 0 before the first sync
+  uint64_t toEpoch(uint32_t stamp);
+  // toEpoch() once synced, the uptime stamp itself before
+  uint64_t stamp(uint32_t stamp);
+
+  const Stats& stats() const { return stats_; }
+  void printStats(Print& out);
+
+private:
+  uint64_t uptime();
+  bool sendRequest(uint64_t at);
+  bool acceptReply(const uint8_t* packet, size_t length, uint64_t at);
+  void retryLater(uint64_t at);
+
+  UDP* udp_;
+  const char* server_;
+  uint16_t port_;
+  uint32_t syncIntervalMs_;
+  uint32_t retryMs_;
+
+  uint32_t lastMillis_;
+  uint32_t wraps_;
+
+  bool waiting_;
+  uint64_t sentAt_;     // uptime of the outstanding request
+  uint8_t cookie_[8];   // its transmit timestamp, echoed back as originate
+  uint64_t nextSyncAt_;
+
+  bool synced_;
+  int64_t offset_;      // epoch ms - uptime ms
+  uint64_t floor_;      // last value now() returned
+  Stats stats_;
+};
+
+#endif
@@ -1,6 +1,9 @@
 #include <WiFi.h>
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
+#include <TaskWheel.h>
+#include <JsonArena.h>
+#include <sys/time.h>
 
 // WiFi credentials
 const char* ssid = "YOUR_WIFI_SSID";        // ⚠️ แก้เป็นชื่อ WiFi ของคุณ
@@ -12,12 +15,20 @@ const int mqtt_port = 1883;
 const char* mqtt_username = "";  // ถ้าไม่มี username ให้เว้นว่าง
 const char* mqtt_password = "";  // ถ้าไม่มี password ให้เว้นว่าง
 
+// เวลาใน payload เป็น epoch milliseconds จาก SNTP
+const char* ntp_server = "pool.ntp.org";
+
 // Device settings
 const char* device_id = "ESP32_001";
 String command_topic = "esp32/" + String(device_id) + "/command";
 String status_topic = "esp32/" + String(device_id) + "/status";
 String sensor_topic = "esp32/" + String(device_id) + "/sensor";
 
+// รูปแบบ payload: 0 = JSON, 1 = MessagePack (ส่งไปที่ topic เดิม + "/msgpack")
+// คำสั่งรับได้ทั้งสองแบบ
+#define USE_MSGPACK 0
+#define MSGPACK_SUFFIX "/msgpack"
+
 // Pin definitions
 #define LED1_PIN 2
 #define LED2_PIN 4
@@ -32,6 +43,13 @@ String sensor_topic = "esp32/" + String(device_id) + "/sensor";
 WiFiClient espClient;
 PubSubClient client(espClient);
 
+// Every JsonDocument lives in this one static arena instead of the heap.
+// Documents here are locals, freed in reverse order, so the arena is empty
+// again after each message. Room for two at once: a command and the status
+// it publishes.
+const size_t json_arena_size = 2 * ARDUINOJSON_POOL_CAPACITY * 2 * sizeof(void*) + 1024;
+StaticJsonArena<json_arena_size> json_arena;
+
 // Variables
 bool led1_state = false;
 bool led2_state = false;
@@ -39,8 +57,13 @@ bool led3_state = false;
 bool relay1_state = false;
 bool relay2_state = false;
 
-unsigned long lastSensorRead = 0;
 const unsigned long sensorInterval = 5000; // อ่านเซ็นเซอร์ทุก 5 วินาที
+const unsigned long mqttServiceInterval = 1000; // client.loop() ตอนเชื่อมต่ออยู่ ถ้ามีข้อมูลเข้ามาจะตื่นเร็วกว่านั้น
+const unsigned long mqttRetryInterval = 5000;   // ตอนหลุด ลองเชื่อมต่อครั้งเดียวต่อรอบ
+
+// งานที่ทำเป็นระยะรันเป็น task ของ scheduler; loop() หลับระหว่างนั้น
+TaskWheel scheduler;
+int mqtt_task = -1;
 
 void setup() {
   Serial.begin(115200);
@@ -62,10 +85,18 @@ void setup() {
   // Connect to WiFi
   setupWiFi();
   
+  // เริ่ม SNTP ของ core; sync ซ้ำเองเป็นระยะ
+  configTime(0, 0, ntp_server);
+  
   // Setup MQTT
   client.setServer(mqtt_server, mqtt_port);
   client.setCallback(onMqttMessage);
   
+  // Tasks: MQTT connection, sensors
+  scheduler.begin();
+  mqtt_task = scheduler.every("mqtt", mqttRetryInterval, serviceMQTT);
+  scheduler.every("sensors", sensorInterval, readAndPublishSensors, sensorInterval);
+  
   Serial.println("ESP32 MQTT Controller Ready!");
   Serial.println("Device ID: " + String(device_id));
   Serial.println("Command Topic: " + command_topic);
@@ -73,19 +104,13 @@ void setup() {
 }
 
 void loop() {
-  // Maintain MQTT connection
-  if (!client.connected()) {
-    reconnectMQTT();
-  }
-  client.loop();
+  // รันงานที่ถึงกำหนด: MQTT, Sensor
+  scheduler.runDue();
   
-  // Read sensors periodically
-  if (millis() - lastSensorRead > sensorInterval) {
-    readAndPublishSensors();
-    lastSensorRead = millis();
+  // หลับจนกว่างานถัดไปถึงกำหนด หรือมีข้อมูลเข้ามาจาก broker
+  if (scheduler.idle(espClient.fd())) {
+    scheduler.runNow(mqtt_task);
   }
-  
-  delay(100);
 }
 
 void setupWiFi() {
@@ -107,49 +132,55 @@ void setupWiFi() {
   Serial.println(WiFi.localIP());
 }
 
-void reconnectMQTT() {
-  while (!client.connected()) {
-    Serial.print("Attempting MQTT connection...");
+// Connected: handles whatever the broker sent. Disconnected: one connect
+// attempt, repeated every mqttRetryInterval, so loop() never blocks on it
+void serviceMQTT() {
+  if (client.connected()) {
+    client.loop();
+    return;
+  }
+  scheduler.setPeriod(mqtt_task, mqttRetryInterval);
+  
+  Serial.print("Attempting MQTT connection...");
+  
+  String clientId = "ESP32Client-" + String(device_id);
+  
+  if (client.connect(clientId.c_str(), mqtt_username, mqtt_password)) {
+    Serial.println("connected");
+    scheduler.setPeriod(mqtt_task, mqttServiceInterval);
     
-    String clientId = "ESP32Client-" + String(device_id);
+    // Subscribe to command topic (JSON and MessagePack)
+    client.subscribe(command_topic.c_str());
+    client.subscribe((command_topic + MSGPACK_SUFFIX).c_str());
+    Serial.println("Subscribed to: " + command_topic);
     
-    if (client.connect(clientId.c_str(), mqtt_username, mqtt_password)) {
-      Serial.println("connected");
-      
-      // Subscribe to command topic
-      client.subscribe(command_topic.c_str());
-      Serial.println("Subscribed to: " + command_topic);
-      
-      // Publish online status
-      publishStatus("online");
-      
-    } else {
-      Serial.print("failed, rc=");
-      Serial.print(client.state());
-      Serial.println(" try again in 5 seconds");
-      delay(5000);
-    }
+    // Publish online status
+    publishStatus("online");
+    
+  } else {
+    Serial.print("failed, rc=");
+    Serial.print(client.state());
+    Serial.println(" try again in 5 seconds");
   }
 }
 
 void onMqttMessage(char* topic, byte* payload, unsigned int length) {
-  // Convert payload to string
-  String message = "";
-  for (int i = 0; i < length; i++) {
-    message += (char)payload[i];
-  }
-  
-  Serial.println("Message received: " + String(topic) + " - " + message);
+  bool msgpack = String(topic).endsWith(MSGPACK_SUFFIX);
   
-  // Parse JSON command
-  DynamicJsonDocument doc(1024);
-  DeserializationError error = deserializeJson(doc, message);
+  // Parse the command, JSON or MessagePack by topic
+  JsonDocument doc(&json_arena);
+  DeserializationError error = msgpack ? deserializeMsgPack(doc, payload, length)
+                                       : deserializeJson(doc, payload, length);
   
   if (error) {
-    Serial.println("Failed to parse JSON");
+    Serial.println(msgpack ? "Failed to parse MessagePack" : "Failed to parse JSON");
     return;
   }
   
+  Serial.print("Message received: " + String(topic) + " - ");
+  serializeJson(doc, Serial);
+  Serial.println();
+  
   String command = doc["command"];
   
   if (command == "led") {
@@ -163,7 +194,7 @@ void onMqttMessage(char* topic, byte* payload, unsigned int length) {
   }
 }
 
-void handleLEDCommand(DynamicJsonDocument& doc) {
+void handleLEDCommand(JsonDocument& doc) {
   int pin = doc["value"]["pin"];
   String state = doc["value"]["state"];
   
@@ -192,7 +223,7 @@ void handleLEDCommand(DynamicJsonDocument& doc) {
   Serial.println("LED " + String(pin) + " set to " + state);
 }
 
-void handleRelayCommand(DynamicJsonDocument& doc) {
+void handleRelayCommand(JsonDocument& doc) {
   int relay = doc["value"]["relay"];
   String state = doc["value"]["state"];
   
@@ -217,29 +248,25 @@ void handleRelayCommand(DynamicJsonDocument& doc) {
 }
 
 void publishPinStatus(int pin, bool state) {
-  DynamicJsonDocument doc(200);
+  JsonDocument doc(&json_arena);
   doc["pin"] = pin;
   doc["state"] = state ? "on" : "off";
-  doc["timestamp"] = millis();
+  doc["timestamp"] = timestampMillis();
   
-  String message;
-  serializeJson(doc, message);
-  
-  client.publish(status_topic.c_str(), message.c_str());
-  Serial.println("Status published: " + message);
+  publishDoc(status_topic, doc);
+  Serial.print("Status published: ");
+  serializeJson(doc, Serial);
+  Serial.println();
 }
 
 void publishStatus(String status) {
-  DynamicJsonDocument doc(200);
+  JsonDocument doc(&json_arena);
   doc["device_id"] = device_id;
   doc["status"] = status;
-  doc["timestamp"] = millis();
+  doc["timestamp"] = timestampMillis();
   doc["ip"] = WiFi.localIP().toString();
   
-  String message;
-  serializeJson(doc, message);
-  
-  client.publish(status_topic.c_str(), message.c_str());
+  publishDoc(status_topic, doc);
   Serial.println("Device status: " + status);
 }
 
@@ -249,17 +276,43 @@ void readAndPublishSensors() {
   float humidity = random(400, 800) / 10.0;    // Simulate 40-80%
   int light = random(100, 1000);               // Simulate 100-1000 lux
   
-  // Create JSON message
-  DynamicJsonDocument doc(300);
+  // Create the message
+  JsonDocument doc(&json_arena);
   doc["device_id"] = device_id;
   doc["temp"] = temperature;
   doc["humidity"] = humidity;
   doc["light"] = light;
-  doc["timestamp"] = millis();
-  
-  String message;
-  serializeJson(doc, message);
+  doc["timestamp"] = timestampMillis();
   
-  client.publish(sensor_topic.c_str(), message.c_str());
-  Serial.println("Sensors published: " + message);
+  publishDoc(sensor_topic, doc);
+  Serial.print("Sensors published: ");
+  serializeJson(doc, Serial);
+  Serial.println();
+}
+
+// epoch milliseconds เมื่อ SNTP ตั้งเวลาแล้ว ก่อนหน้านั้นเป็น millis()
+// (ค่าต่ำกว่า 10^12 คือ uptime ฝั่งรับจะใส่เวลาให้ตอนได้รับ)
+uint64_t timestampMillis() {
+  struct timeval now;
+  gettimeofday(&now, nullptr);
+  if (now.tv_sec < 1600000000) {
+    return millis();
+  }
+  return (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+// ส่ง doc เป็น JSON ที่ topic หรือเป็น MessagePack ที่ topic + "/msgpack"
+bool publishDoc(const String& topic, JsonDocument& doc) {
+#if USE_MSGPACK
+  uint8_t buffer[256];
+  size_t length = serializeMsgPack(doc, buffer, sizeof(buffer));
+  return client.publish((topic + MSGPACK_SUFFIX).c_str(), buffer, length);
+#else
+  char message[256];
+  if (measureJson(doc) >= sizeof(message)) {
+    return false;
+  }
+  size_t length = serializeJson(doc, message, sizeof(message));
+  return client.publish(topic.c_str(), (const uint8_t*)message, length, false);
+#endif
 }
@@ -0,0 +1,49 @@
+/*
+  alloc_count.cpp - heap call counters for the simulator.
+*/
+
+#include "alloc_count.h"
+
+#include <stddef.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace {
+
+AllocCount counts;
+
+}  // namespace
+
+AllocCount allocCount() { return counts; }
+
+extern "C" {
+
+void* malloc(size_t size) {
+  counts.allocations++;
+  counts.bytes += size;
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  counts.allocations++;
+  counts.bytes += count * size;
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  counts.allocations++;
+  counts.bytes += size;
+  return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+  if (ptr) counts.frees++;
+  __libc_free(ptr);
+}
+
+}  // extern "C"
@@ -0,0 +1,23 @@
+/*
+  alloc_count.h - heap call counters for the simulator.
+
+  alloc_count.cpp wraps malloc/calloc/realloc/free (glibc only), so every
+  allocation the firmware makes, whether through String, ArduinoJson or
+  operator new, is counted. Benchmarks read the counters before and after
+  the code they measure.
+*/
+
+#ifndef SIM_ALLOC_COUNT_H
+#define SIM_ALLOC_COUNT_H
+
+#include <stdint.h>
+
+struct AllocCount {
+  uint64_t allocations;  // malloc, calloc and realloc calls
+  uint64_t frees;
+  uint64_t bytes;        // bytes requested by those calls
+};
+
+AllocCount allocCount();
+
+#endif
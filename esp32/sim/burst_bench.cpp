@@ -0,0 +1,144 @@
+/*
+  burst_bench.cpp - how fast PubSubClient::loop() drains a burst of commands.
+*/
+
+#include "burst_bench.h"
+
+#include <Arduino.h>
+#include <NativeSim.h>
+#include <PubSubClient.h>
+
+#include <chrono>
+#include <vector>
+
+namespace {
+
+// Serves queued bytes to PubSubClient and swallows what it writes
+class BurstClient : public Client {
+public:
+  int connect(IPAddress ip, uint16_t port) override {
+    (void)ip;
+    (void)port;
+    return open();
+  }
+  int connect(const char* host, uint16_t port) override {
+    (void)host;
+    (void)port;
+    return open();
+  }
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* buf, size_t size) override {
+    (void)buf;
+    return open_ ? size : 0;
+  }
+  int available() override { return open_ ? (int)(rx_.size() - pos_) : 0; }
+  int read() override { return available() > 0 ? rx_[pos_++] : -1; }
+  int read(uint8_t* buf, size_t size) override {
+    size_t n = std::min(size, (size_t)available());
+    memcpy(buf, rx_.data() + pos_, n);
+    pos_ += n;
+    return (int)n;
+  }
+  int peek() override { return available() > 0 ? rx_[pos_] : -1; }
+  void flush() override {}
+  void stop() override { open_ = false; }
+  uint8_t connected() override { return open_; }
+  operator bool() override { return open_; }
+
+  void queue(const uint8_t* data, size_t length) {
+    if (pos_ == rx_.size()) {
+      rx_.clear();
+      pos_ = 0;
+    }
+    rx_.insert(rx_.end(), data, data + length);
+  }
+
+  using Print::write;
+
+private:
+  int open() {
+    open_ = true;
+    rx_.clear();
+    pos_ = 0;
+    const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+    queue(connack, sizeof(connack));
+    return 1;
+  }
+
+  bool open_ = false;
+  std::vector<uint8_t> rx_;
+  size_t pos_ = 0;
+};
+
+const uint16_t kBudgets[] = {1, 16, 64};  // 1 = one packet per call, as before
+const uint32_t kBursts[] = {1, 8, 32, 128};
+const uint32_t kWakeMillis = 10;
+
+uint32_t handled;
+
+void onMessage(char* topic, uint8_t* payload, unsigned int length) {
+  (void)topic;
+  (void)payload;
+  (void)length;
+  handled++;
+}
+
+std::vector<uint8_t> encodeCommand(const char* topic, const char* payload) {
+  size_t topicLength = strlen(topic);
+  size_t payloadLength = strlen(payload);
+  size_t remaining = 2 + topicLength + payloadLength;
+  std::vector<uint8_t> packet = {0x30};
+  do {
+    uint8_t digit = remaining & 127;
+    remaining >>= 7;
+    packet.push_back(remaining ? digit | 0x80 : digit);
+  } while (remaining);
+  packet.push_back((uint8_t)(topicLength >> 8));
+  packet.push_back((uint8_t)topicLength);
+  packet.insert(packet.end(), topic, topic + topicLength);
+  packet.insert(packet.end(), payload, payload + payloadLength);
+  return packet;
+}
+
+}  // namespace
+
+void runBurstBench(uint32_t rounds) {
+  if (rounds == 0) return;
+  std::vector<uint8_t> command = encodeCommand(
+      "esp32/ESP32_BENCH0/command", "{\"command\":\"relay\",\"value\":{\"pin\":25,\"state\":\"on\"}}");
+
+  printf("budget  burst  loop_calls  drain_ms  host_ns/packet\n");
+  for (uint16_t budget : kBudgets) {
+    for (uint32_t burst : kBursts) {
+      BurstClient net;
+      PubSubClient client(net);
+      client.setServer("broker", 1883).setCallback(onMessage).setLoopBudget(budget);
+      client.setKeepAlive(3600);
+      if (!client.connect("burst_bench")) {
+        fprintf(stderr, "connect failed\n");
+        return;
+      }
+
+      uint64_t calls = 0;
+      uint64_t drainMicros = 0;
+      std::chrono::duration<double, std::nano> host(0);
+      for (uint32_t r = 0; r < rounds; r++) {
+        handled = 0;
+        for (uint32_t i = 0; i < burst; i++) net.queue(command.data(), command.size());
+        uint64_t arrived = nativesim::nowMicros();
+        while (true) {
+          auto t0 = std::chrono::steady_clock::now();
+          client.loop();
+          host += std::chrono::steady_clock::now() - t0;
+          calls++;
+          if (handled == burst) break;
+          nativesim::advanceMillis(kWakeMillis);
+        }
+        drainMicros += nativesim::nowMicros() - arrived;
+        nativesim::advanceMillis(kWakeMillis);
+      }
+      printf("%6u %6u %11.1f %9.1f %15.0f\n", budget, burst, (double)calls / rounds,
+             drainMicros / 1000.0 / rounds, host.count() / ((double)rounds * burst));
+    }
+  }
+}
@@ -0,0 +1,21 @@
+/*
+  burst_bench.h - how fast PubSubClient::loop() drains a burst of commands.
+
+  Feeds bursts of dashboard commands, already sitting in the receive
+  buffer, to a bare PubSubClient through an in-memory Client and calls
+  loop() once per wakeup with 10 ms of virtual time between wakeups (the
+  old firmware's delay(10)), for several per-call packet budgets. Reports
+  the loop() calls and virtual time until the last command was handled and
+  the host cost per packet.
+*/
+
+#ifndef SIM_BURST_BENCH_H
+#define SIM_BURST_BENCH_H
+
+#include <stdint.h>
+
+// Replays each burst size `rounds` times per budget and prints one line per
+// budget and burst size.
+void runBurstBench(uint32_t rounds);
+
+#endif
@@ -0,0 +1,125 @@
+/*
+  codec_bench.cpp - JSON vs MessagePack payloads, per message kind.
+*/
+
+#include "codec_bench.h"
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LoopbackBroker.h>
+#include <PayloadCodec.h>
+#include <PubSubClient.h>
+
+#include <chrono>
+#include <vector>
+
+// Firmware entry points (src/main_mqtt.cpp).
+void setup();
+void loop();
+void setupTopics();
+void setupPayloadTemplates();
+void publishStatus();
+void publishSensorSnapshot();
+void readSensors();
+void publishHeartbeat();
+extern PubSubClient mqtt_client;
+extern PayloadFormat payload_format;
+
+namespace {
+
+struct BenchCase {
+  const char* name;
+  void (*publish)();
+};
+
+const BenchCase kCases[] = {
+  {"status", publishStatus},
+  {"sensor", publishSensorSnapshot},
+  {"heartbeat", publishHeartbeat},
+};
+
+std::vector<uint8_t> last_payload;
+
+double parseMicros(PayloadFormat format, const uint8_t* data, size_t length, uint32_t iterations) {
+  JsonDocument doc;
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    DeserializationError error = format == PAYLOAD_MSGPACK ? deserializeMsgPack(doc, data, length)
+                                                           : deserializeJson(doc, data, length);
+    if (error) {
+      fprintf(stderr, "%s parse failed: %s\n", payloadFormatName(format), error.c_str());
+      return 0;
+    }
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(t1 - t0).count() / iterations;
+}
+
+void printRow(PayloadFormat format, const char* name, double payloadBytes, double wireBytes, double encodeMicros,
+              double parseMicros) {
+  printf("%-12s %-10s %10.1f %7.1f %10.3f %9.3f\n", payloadFormatName(format), name, payloadBytes, wireBytes,
+         encodeMicros, parseMicros);
+}
+
+}  // namespace
+
+void runCodecBench(uint32_t iterations) {
+  if (iterations == 0) return;
+  setup();
+  LoopbackBroker& broker = LoopbackBroker::instance();
+  for (int i = 0; i < 100 && broker.stats().subscribes == 0; i++) loop();
+  readSensors();  // a reading for every sensor channel, so snapshots are complete
+  while (broker.pendingToDevice()) mqtt_client.loop();
+  broker.setPublishObserver([](const char*, const uint8_t* payload, size_t length, uint8_t) {
+    last_payload.assign(payload, payload + length);
+  });
+
+  printf("format       message     payload_B  wire_B  encode_us  parse_us\n");
+  for (PayloadFormat format : {PAYLOAD_JSON, PAYLOAD_MSGPACK}) {
+    payload_format = format;
+    setupTopics();
+    setupPayloadTemplates();
+
+    for (const BenchCase& c : kCases) {
+      c.publish();  // first publish on a topic names it; the rest go by alias
+      mqtt_client.loop();
+      uint32_t publishesBefore = broker.stats().publishes;
+      uint32_t payloadBefore = broker.stats().publishBytes;
+      uint64_t wireBefore = broker.stats().bytesIn;
+      auto t0 = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < iterations; i++) {
+        c.publish();
+        mqtt_client.loop();  // take the PUBACK of a QoS 1 status
+      }
+      auto t1 = std::chrono::steady_clock::now();
+      uint32_t sent = broker.stats().publishes - publishesBefore;
+      if (sent != iterations) fprintf(stderr, "%s: %u of %u publishes reached the broker\n", c.name, sent, iterations);
+      // bytesIn is what the device wrote: the PUBLISH packets only, the
+      // status PUBACKs come from the broker
+      printRow(format, c.name, sent ? (double)(broker.stats().publishBytes - payloadBefore) / sent : 0.0,
+               sent ? (double)(broker.stats().bytesIn - wireBefore) / sent : 0.0,
+               std::chrono::duration<double, std::micro>(t1 - t0).count() / iterations,
+               parseMicros(format, last_payload.data(), last_payload.size(), iterations));
+    }
+
+    // Dashboard -> board: the command is serialized by the sender
+    JsonDocument command;
+    command["command"] = "relay";
+    command["value"]["pin"] = 26;
+    command["value"]["state"] = "on";
+    uint8_t encoded[128];
+    size_t length = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+      length = format == PAYLOAD_MSGPACK ? serializeMsgPack(command, encoded, sizeof(encoded))
+                                         : serializeJson(command, encoded, sizeof(encoded));
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    // QoS 0 PUBLISH with the full topic: 2 bytes fixed header, 2 topic length
+    size_t topicLength = strlen("esp32/ESP32_000001/command") + strlen(payloadTopicSuffix(format));
+    printRow(format, "command", (double)length, (double)(length + topicLength + 4),
+             std::chrono::duration<double, std::micro>(t1 - t0).count() / iterations,
+             parseMicros(format, encoded, length, iterations));
+  }
+  broker.setPublishObserver(nullptr);
+}
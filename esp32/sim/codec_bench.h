@@ -0,0 +1,22 @@
+/*
+  codec_bench.h - JSON vs MessagePack payloads, per message kind.
+
+  Boots one board and publishes each telemetry message with the firmware's
+  own publish functions, first as JSON and then as MessagePack (switching
+  payload_format and rebuilding the topics and templates in between), and
+  parses the captured payload back the way a subscriber would. A relay
+  command is encoded and parsed the same way in the other direction.
+  Reports payload and wire bytes per message (wire = the whole PUBLISH
+  packet, topic alias included) and host microseconds to produce and to
+  parse one message.
+*/
+
+#ifndef SIM_CODEC_BENCH_H
+#define SIM_CODEC_BENCH_H
+
+#include <stdint.h>
+
+// Runs `iterations` messages per kind and format, one line per pair.
+void runCodecBench(uint32_t iterations);
+
+#endif
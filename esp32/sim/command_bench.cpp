@@ -0,0 +1,65 @@
+/*
+  command_bench.cpp - per-command cost of the firmware's MQTT callback.
+*/
+
+#include "command_bench.h"
+
+#include <Arduino.h>
+#include <LoopbackBroker.h>
+#include <NativeSim.h>
+
+#include <chrono>
+
+#include "alloc_count.h"
+
+// Firmware entry points (src/main_mqtt.cpp).
+void setup();
+void loop();
+void mqttCallback(char* topic, byte* payload, unsigned int length);
+
+namespace {
+
+struct BenchCase {
+  const char* name;
+  const char* payload;
+};
+
+const BenchCase kCases[] = {
+  {"relay", "{\"command\":\"relay\",\"value\":{\"pin\":26,\"state\":\"on\"}}"},
+  {"relays", "{\"command\":\"relays\",\"value\":{\"relay1\":\"on\",\"relay2\":\"off\",\"relay3\":\"on\",\"relay4\":\"off\"}}"},
+  {"status", "{\"command\":\"status\"}"},
+  {"read_sensors", "{\"command\":\"read_sensors\"}"},
+  {"unknown", "{\"command\":\"self_destruct\"}"},
+};
+
+}  // namespace
+
+void runCommandBench(uint32_t iterations) {
+  if (iterations == 0) return;
+  setup();
+  // Let the board connect and subscribe so publishes go out for real.
+  for (int i = 0; i < 100 && LoopbackBroker::instance().stats().subscribes == 0; i++) loop();
+
+  char topic[] = "esp32/ESP32_000001/command";
+  uint8_t payload[256];
+
+  printf("command          allocs/cmd  bytes/cmd  us/cmd\n");
+  for (const BenchCase& c : kCases) {
+    size_t length = strlen(c.payload);
+    uint64_t nanos = 0;
+    AllocCount before = allocCount();
+    for (uint32_t i = 0; i < iterations; i++) {
+      // PubSubClient hands over its own buffer; refill it outside the timing.
+      memcpy(payload, c.payload, length);
+      auto t0 = std::chrono::steady_clock::now();
+      mqttCallback(topic, payload, (unsigned int)length);
+      auto t1 = std::chrono::steady_clock::now();
+      nanos += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    }
+    AllocCount after = allocCount();
+    printf("%-16s %10.2f %10.1f %7.3f\n", c.name,
+           (double)(after.allocations - before.allocations) / iterations,
+           (double)(after.bytes - before.bytes) / iterations,
+           (double)nanos / iterations / 1000.0);
+  }
+}
@@ -0,0 +1,18 @@
+/*
+  command_bench.h - per-command cost of the firmware's MQTT callback.
+
+  Boots one board, then hands each dashboard command kind straight to
+  mqttCallback() the way PubSubClient does and reports the heap
+  allocations and host microseconds each command costs, including the
+  status/sensor publish it triggers.
+*/
+
+#ifndef SIM_COMMAND_BENCH_H
+#define SIM_COMMAND_BENCH_H
+
+#include <stdint.h>
+
+// Runs `iterations` callbacks per command kind and prints one line per kind.
+void runCommandBench(uint32_t iterations);
+
+#endif
@@ -0,0 +1,247 @@
+/*
+  device_run.cpp - one simulated board running the firmware's setup()/loop().
+*/
+
+#include "device_run.h"
+
+#include <Arduino.h>
+#include <LoopbackBroker.h>
+#include <NativeSim.h>
+#include <PayloadCodec.h>
+
+#include <chrono>
+#include <string>
+
+// Firmware entry points (src/main_mqtt.cpp).
+void setup();
+void loop();
+
+namespace {
+
+const uint8_t kInputPins[4] = {34, 35, 32, 33};
+const uint8_t kRelayPins[4] = {25, 26, 27, 14};
+const uint32_t kPressHoldMicros = 120000;
+// Room climate: a random walk, one step per kDriftMicros, so readings mostly
+// stay inside the firmware's dead-bands and now and then move out of them
+const uint64_t kDriftMicros = 10000000;
+const float kTemperatureStep = 0.1f;  // °C per step, at most
+const float kHumidityStep = 0.5f;     // %RH per step, at most
+
+const char* const kCommands[] = {
+  "{\"command\":\"relay\",\"value\":{\"pin\":%u,\"state\":\"%s\"}}",
+  "{\"command\":\"relays\",\"value\":{\"relay1\":\"%s\",\"relay2\":\"%s\",\"relay3\":\"%s\",\"relay4\":\"%s\"}}",
+  "{\"command\":\"status\"}",
+  "{\"command\":\"read_sensors\"}",
+};
+
+struct Rng {
+  uint64_t state;
+  uint32_t next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (uint32_t)state;
+  }
+  // Next event for a Poisson-ish stream of perMinute events: uniform in
+  // (0, 2 * mean], or never when the rate is zero.
+  uint64_t after(uint64_t now, uint32_t perMinute) {
+    if (perMinute == 0) return UINT64_MAX;
+    uint64_t mean = 60000000ULL / perMinute;
+    return now + (uint64_t)next() % (2 * mean) + 1;
+  }
+};
+
+PublishKind classify(const char* topic) {
+  // esp32/<id>/<leaf>, or esp32/<id>/<leaf>/msgpack
+  std::string path(topic);
+  if (payloadFormatOf(topic) == PAYLOAD_MSGPACK) path.resize(path.size() - strlen(PAYLOAD_MSGPACK_SUFFIX));
+  size_t slash = path.rfind('/');
+  std::string leaf = slash == std::string::npos ? path : path.substr(slash + 1);
+  if (leaf == "status") return PUBLISH_STATUS;
+  if (leaf == "data") return PUBLISH_SENSOR;
+  if (leaf == "heartbeat") return PUBLISH_HEARTBEAT;
+  return PUBLISH_OTHER;
+}
+
+void formatCommand(Rng& rng, char* buf, size_t size) {
+  uint32_t pick = rng.next() % 10;
+  const char* on = "on";
+  const char* off = "off";
+  if (pick < 5) {
+    snprintf(buf, size, kCommands[0], kRelayPins[rng.next() % 4], rng.next() & 1 ? on : off);
+  } else if (pick < 8) {
+    snprintf(buf, size, kCommands[1], rng.next() & 1 ? on : off, rng.next() & 1 ? on : off,
+             rng.next() & 1 ? on : off, rng.next() & 1 ? on : off);
+  } else if (pick < 9) {
+    snprintf(buf, size, "%s", kCommands[2]);
+  } else {
+    snprintf(buf, size, "%s", kCommands[3]);
+  }
+}
+
+void restartHandler() {
+  fprintf(stderr, "device requested ESP.restart()\n");
+  _Exit(3);
+}
+
+}  // namespace
+
+void runDevice(const RunConfig& config, DeviceResult* result) {
+  memset(result, 0, sizeof(*result));
+
+  uint8_t mac[6] = {0x24, 0x6F, 0x28,
+                    (uint8_t)(config.deviceIndex >> 16),
+                    (uint8_t)(config.deviceIndex >> 8),
+                    (uint8_t)(config.deviceIndex)};
+  nativesim::setMacAddress(mac);
+  nativesim::setSerialEcho(config.verbose);
+  nativesim::setRestartHandler(restartHandler);
+  nativesim::setCpuScale(config.cpuScale);
+  randomSeed(config.seed ^ (config.deviceIndex * 2654435761u));
+
+  Rng rng = {((uint64_t)config.seed << 32) ^ (config.deviceIndex + 1) ^ 0x9E3779B97F4A7C15ULL};
+
+  char deviceId[16];
+  snprintf(deviceId, sizeof(deviceId), "ESP32_%02X%02X%02X", mac[3], mac[4], mac[5]);
+  std::string commandTopic = std::string("esp32/") + deviceId + "/command";
+
+  LoopbackBroker& broker = LoopbackBroker::instance();
+  uint64_t pendingCommandAt = 0;
+  broker.setPublishObserver([&](const char* topic, const uint8_t* payload, size_t length, uint8_t header) {
+    (void)payload;
+    (void)header;
+    PublishKind kind = classify(topic);
+    result->publishes[kind]++;
+    result->publishBytes += length;
+    if (kind == PUBLISH_STATUS && pendingCommandAt) {
+      result->commandToStatusMicros.record(nativesim::nowMicros() - pendingCommandAt);
+      pendingCommandAt = 0;
+    }
+  });
+
+  setup();
+
+  const uint64_t start = nativesim::nowMicros();
+  const uint64_t end = start + (uint64_t)config.seconds * 1000000ULL;
+  const uint64_t bytesAtStart = broker.stats().bytesIn;
+  const uint32_t connectsAtStart = broker.stats().connects;
+  for (int k = 0; k < PUBLISH_KINDS; k++) result->publishes[k] = 0;
+  result->publishBytes = 0;
+
+  uint64_t nextCommand = rng.after(start, config.commandsPerMinute);
+  uint64_t nextPress = rng.after(start, config.pressesPerMinute);
+  uint64_t nextDrift = start + kDriftMicros;
+  float temperature = nativesim::sensorTemperature();
+  float humidity = nativesim::sensorHumidity();
+  int heldPin = -1;
+  uint64_t releaseAt = 0;
+  int watchedRelay = -1;
+  int watchedLevel = LOW;
+  uint64_t pressedAt = 0;
+
+  // Outages hit the whole fleet at the same virtual instant, which is the
+  // case the reconnect backoff has to spread out.
+  const uint64_t outageEvery = (uint64_t)config.outageEverySeconds * 1000000ULL;
+  const uint64_t outageLength = (uint64_t)config.outageSeconds * 1000000ULL;
+  uint64_t nextOutage = outageEvery && outageLength ? start + outageEvery : UINT64_MAX;
+  uint64_t outageEndsAt = UINT64_MAX;
+  uint64_t recoveredAt = 0;
+  uint32_t connectsAtRecovery = 0;
+
+  while (nativesim::nowMicros() < end) {
+    uint64_t now = nativesim::nowMicros();
+
+    if (now >= nextOutage) {
+      broker.setOnline(false);
+      result->outages++;
+      outageEndsAt = now + outageLength;
+      nextOutage += outageEvery;
+      recoveredAt = 0;
+    } else if (now >= outageEndsAt) {
+      broker.setOnline(true);
+      outageEndsAt = UINT64_MAX;
+      recoveredAt = now;
+      connectsAtRecovery = broker.stats().connects;
+    }
+
+    if (now >= nextDrift) {
+      // uniform in [-step, step], in steps of step/10
+      temperature += kTemperatureStep * ((int)(rng.next() % 21) - 10) / 10;
+      humidity += kHumidityStep * ((int)(rng.next() % 21) - 10) / 10;
+      nativesim::setSensorReading(temperature, humidity);
+      nextDrift += kDriftMicros;
+    }
+
+    if (now >= nextCommand) {
+      char payload[192];
+      formatCommand(rng, payload, sizeof(payload));
+      if (broker.inject(commandTopic.c_str(), payload)) {
+        result->commandsInjected++;
+        if (strstr(payload, "\"relay")) {
+          if (!pendingCommandAt) pendingCommandAt = now;
+          if (now >= pressedAt) watchedRelay = -1;  // the command may flip the relay the press is timing
+        }
+      } else {
+        result->commandsDropped++;
+      }
+      nextCommand = rng.after(now, config.commandsPerMinute);
+    }
+
+    // Both edges of a press are queued on the virtual clock, so they land at
+    // their own time even when loop() is inside a blocking call.
+    if (heldPin < 0 && nextPress < end) {
+      uint32_t button = rng.next() % 4;
+      heldPin = kInputPins[button];
+      pressedAt = std::max(now, nextPress);
+      releaseAt = pressedAt + kPressHoldMicros;
+      nativesim::schedulePinLevel(heldPin, LOW, pressedAt);
+      nativesim::schedulePinLevel(heldPin, HIGH, releaseAt);
+      watchedRelay = kRelayPins[button];
+      watchedLevel = nativesim::pinLevel(watchedRelay);
+      result->presses++;
+    } else if (heldPin >= 0 && now >= releaseAt) {
+      heldPin = -1;
+      // Schedule from the release so a new press never lands inside the
+      // firmware's debounce window and gets swallowed.
+      nextPress = rng.after(releaseAt + kPressHoldMicros, config.pressesPerMinute);
+    }
+
+    // The firmware sleeps between tasks; end the sleep at the next harness
+    // event, or right away when the broker has bytes waiting on the socket
+    // (a command, or a PUBACK), as select() on the real socket would.
+    // Button edges end it on their own, through the pin interrupt.
+    uint64_t wakeAt = broker.pendingToDevice() ? now : std::min(end, std::min(nextCommand, heldPin >= 0 ? releaseAt : UINT64_MAX));
+    wakeAt = std::min(wakeAt, std::min(nextOutage, outageEndsAt));
+    nativesim::setWakeAt(wakeAt);
+
+    bool sessionWasOpen = broker.sessionOpen();
+    auto t0 = std::chrono::steady_clock::now();
+    nativesim::beginCpuCharge();
+    loop();
+    nativesim::endCpuCharge();
+    auto t1 = std::chrono::steady_clock::now();
+    uint64_t after = nativesim::nowMicros();
+
+    if (!sessionWasOpen) result->sessionDownMicros += after - now;
+    if (watchedRelay >= 0 && after < pressedAt) {
+      watchedLevel = nativesim::pinLevel(watchedRelay);  // press still queued
+    } else if (watchedRelay >= 0 && nativesim::pinLevel(watchedRelay) != watchedLevel) {
+      result->pressToRelayMicros.record(nativesim::pinChangedAt(watchedRelay) - pressedAt);
+      watchedRelay = -1;
+    }
+    if (recoveredAt && broker.stats().connects != connectsAtRecovery) {
+      result->outageToReconnectMicros.record(after - recoveredAt);
+      recoveredAt = 0;
+    }
+
+    result->loops++;
+    result->loopHostNanos.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+    result->loopVirtualMicros.record(after - now);
+  }
+
+  result->virtualMicros = nativesim::nowMicros() - start;
+  result->bytesOnWire = broker.stats().bytesIn - bytesAtStart;
+  result->connects = broker.stats().connects - connectsAtStart;
+  broker.setOnline(true);
+  broker.setPublishObserver(nullptr);
+}
@@ -0,0 +1,60 @@
+/*
+  device_run.h - one simulated board running the firmware's setup()/loop().
+
+  A run boots the firmware against the host stand-ins, then replays
+  dashboard commands through the loopback broker and wall-switch presses on
+  the input pins for a fixed span of virtual time. Everything measured ends
+  up in a flat DeviceResult so the driver can collect it from a child process.
+*/
+
+#ifndef SIM_DEVICE_RUN_H
+#define SIM_DEVICE_RUN_H
+
+#include <stdint.h>
+
+#include "histogram.h"
+
+struct RunConfig {
+  uint32_t deviceIndex;
+  uint32_t seed;
+  uint32_t seconds;          // virtual run time after setup()
+  uint32_t commandsPerMinute;
+  uint32_t pressesPerMinute;
+  uint32_t outageEverySeconds; // take the broker down this often (0 = never)
+  uint32_t outageSeconds;      // for this long each time
+  uint32_t cpuScale;           // virtual us charged per us of host CPU in loop() (0 = none)
+  bool verbose;
+};
+
+enum PublishKind {
+  PUBLISH_STATUS,
+  PUBLISH_SENSOR,
+  PUBLISH_HEARTBEAT,
+  PUBLISH_OTHER,
+  PUBLISH_KINDS
+};
+
+struct DeviceResult {
+  uint64_t loops;
+  uint64_t virtualMicros;
+  uint64_t publishes[PUBLISH_KINDS];
+  uint64_t publishBytes;
+  uint64_t bytesOnWire;
+  uint64_t commandsInjected;
+  uint64_t commandsDropped;
+  uint64_t presses;
+  uint64_t connects;
+  uint64_t outages;
+  uint64_t sessionDownMicros;  // virtual time without an MQTT session
+  Histogram loopHostNanos;     // wall-clock cost of one loop() call
+  Histogram loopVirtualMicros; // simulated time one loop() call takes
+  Histogram commandToStatusMicros;
+  Histogram pressToRelayMicros;     // input pin LOW until its relay flips
+  Histogram outageToReconnectMicros; // broker back up until CONNECT accepted
+};
+
+// Runs one device to completion. Must be called in a fresh process: the
+// firmware keeps its state in globals.
+void runDevice(const RunConfig& config, DeviceResult* result);
+
+#endif
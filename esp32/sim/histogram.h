@@ -0,0 +1,71 @@
+/*
+  histogram.h - fixed-size log-linear latency histogram for the simulator.
+
+  Four sub-buckets per power of two keep percentile error under ~19% while
+  the whole thing stays a flat POD that can be sent back over a pipe.
+*/
+
+#ifndef SIM_HISTOGRAM_H
+#define SIM_HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+
+struct Histogram {
+  static const int kSubBits = 2;
+  static const int kBuckets = 64 << kSubBits;
+
+  uint64_t counts[kBuckets];
+  uint64_t total;
+  uint64_t sum;
+  uint64_t max;
+
+  void clear() { memset(this, 0, sizeof(*this)); }
+
+  static int bucketOf(uint64_t value) {
+    if (value < (1u << kSubBits)) return (int)value;
+    int msb = 63 - __builtin_clzll(value);
+    int sub = (int)((value >> (msb - kSubBits)) & ((1 << kSubBits) - 1));
+    return ((msb - kSubBits + 1) << kSubBits) + sub;
+  }
+
+  static uint64_t upperBound(int bucket) {
+    if (bucket < (1 << kSubBits)) return (uint64_t)bucket;
+    int msb = (bucket >> kSubBits) + kSubBits - 1;
+    uint64_t sub = (uint64_t)(bucket & ((1 << kSubBits) - 1));
+    return ((((uint64_t)1 << kSubBits) | sub) + 1) << (msb - kSubBits);
+  }
+
+  void record(uint64_t value) {
+    counts[bucketOf(value)]++;
+    total++;
+    sum += value;
+    if (value > max) max = value;
+  }
+
+  void merge(const Histogram& other) {
+    for (int i = 0; i < kBuckets; i++) counts[i] += other.counts[i];
+    total += other.total;
+    sum += other.sum;
+    if (other.max > max) max = other.max;
+  }
+
+  uint64_t percentile(double p) const {
+    if (total == 0) return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)total);
+    if (rank >= total) rank = total - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++) {
+      seen += counts[i];
+      if (seen > rank) {
+        uint64_t bound = upperBound(i);
+        return bound < max ? bound : max;
+      }
+    }
+    return max;
+  }
+
+  double mean() const { return total ? (double)sum / (double)total : 0.0; }
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*
+  json_bench.cpp - deserializeJson() throughput on the firmware's own payloads.
+*/
+
+#include "json_bench.h"
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LoopbackBroker.h>
+#include <PubSubClient.h>
+
+#include <string>
+#include <time.h>
+#include <vector>
+
+// Firmware entry points (src/main_mqtt.cpp).
+void setup();
+void loop();
+void publishStatus();
+void publishSensorSnapshot();
+void readSensors();
+void publishHeartbeat();
+extern PubSubClient mqtt_client;
+
+namespace {
+
+struct Payload {
+  std::string name;
+  std::string json;
+};
+
+// A Stream-like source: one byte per read()
+struct ByteSource {
+  const char* ptr;
+  const char* end;
+
+  int read() {
+    return ptr < end ? (unsigned char)*ptr++ : -1;
+  }
+
+  size_t readBytes(char* buffer, size_t length) {
+    size_t n = 0;
+    while (n < length && ptr < end) buffer[n++] = *ptr++;
+    return n;
+  }
+};
+
+std::string last_payload;
+
+std::string capture(void (*publish)()) {
+  last_payload.clear();
+  publish();
+  mqtt_client.loop();  // take the PUBACK of a QoS 1 status
+  return last_payload;
+}
+
+// Best of kRounds runs, the two parsers taking turns: the host is shared, the
+// fastest run is the one the rest of the machine disturbed least
+const int kRounds = 9;
+
+double cpuSeconds() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+template <typename Parse>
+double timeRound(JsonDocument& doc, const std::string& json, uint32_t iterations, Parse parse) {
+  double t0 = cpuSeconds();
+  for (uint32_t i = 0; i < iterations; i++) {
+    DeserializationError error = parse(doc, json);
+    if (error) {
+      fprintf(stderr, "parse failed: %s\n", error.c_str());
+      return 0;
+    }
+  }
+  return cpuSeconds() - t0;
+}
+
+double megabytesPerSecond(const std::string& json, uint32_t iterations, double seconds) {
+  return seconds > 0 ? json.size() * (double)iterations / seconds / 1e6 : 0.0;
+}
+
+}  // namespace
+
+void runJsonBench(uint32_t iterations) {
+  if (iterations == 0) return;
+  setup();
+  LoopbackBroker& broker = LoopbackBroker::instance();
+  for (int i = 0; i < 100 && broker.stats().subscribes == 0; i++) loop();
+  readSensors();
+  while (broker.pendingToDevice()) mqtt_client.loop();
+  broker.setPublishObserver([](const char*, const uint8_t* payload, size_t length, uint8_t) {
+    last_payload.assign((const char*)payload, length);
+  });
+
+  // Dashboard -> board, as MQTTDashboard.js and mqttService.js send them
+  std::vector<Payload> payloads = {
+    {"cmd relay", "{\"command\":\"relay\",\"value\":{\"pin\":26,\"state\":\"on\"}}"},
+    {"cmd relays", "{\"command\":\"relays\",\"value\":{\"relay1\":\"on\",\"relay2\":\"off\",\"relay3\":\"on\","
+                   "\"relay4\":\"off\"},\"timestamp\":1705314642000}"},
+    {"cmd status", "{\"command\":\"status\",\"value\":null,\"timestamp\":1705314642000}"},
+  };
+  // Board -> dashboard, from the publish functions
+  payloads.push_back({"status", capture(publishStatus)});
+  payloads.push_back({"sensor_batch", capture(publishSensorSnapshot)});
+  payloads.push_back({"heartbeat", capture(publishHeartbeat)});
+  broker.setPublishObserver(nullptr);
+  {
+    // Indented, as a person or a debugging tool writes it
+    JsonDocument doc;
+    deserializeJson(doc, payloads.back().json);
+    std::string pretty;
+    serializeJsonPretty(doc, pretty);
+    payloads.push_back({"heartbeat pretty", pretty});
+  }
+
+  {
+    // A long free-text field (an OTA changelog, a log line): where a bulk copy pays off
+    std::string text;
+    while (text.size() < 1000) text += "Relay 3 switched by schedule; sensor batch flushed after dead-band hold. ";
+    payloads.push_back({"long text", "{\"level\":\"info\",\"message\":\"" + text + "\"}"});
+  }
+
+  printf("payload            bytes  read()_MB/s  contiguous_MB/s  speedup\n");
+  for (const Payload& p : payloads) {
+    JsonDocument doc;
+    double bytewiseBest = 0, contiguousBest = 0;
+    for (int round = 0; round < kRounds; round++) {
+      double bytewiseTime = timeRound(doc, p.json, iterations, [](JsonDocument& d, const std::string& json) {
+        ByteSource source = {json.data(), json.data() + json.size()};
+        return deserializeJson(d, source);
+      });
+      double contiguousTime = timeRound(doc, p.json, iterations, [](JsonDocument& d, const std::string& json) {
+        return deserializeJson(d, json.data(), json.size());
+      });
+      if (round == 0 || bytewiseTime < bytewiseBest) bytewiseBest = bytewiseTime;
+      if (round == 0 || contiguousTime < contiguousBest) contiguousBest = contiguousTime;
+    }
+    double bytewise = megabytesPerSecond(p.json, iterations, bytewiseBest);
+    double contiguous = megabytesPerSecond(p.json, iterations, contiguousBest);
+    printf("%-16s %7u %12.1f %16.1f %8.2fx\n", p.name.c_str(), (unsigned)p.json.size(), bytewise, contiguous,
+           bytewise > 0 ? contiguous / bytewise : 0.0);
+  }
+}
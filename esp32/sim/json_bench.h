@@ -0,0 +1,21 @@
+/*
+  json_bench.h - deserializeJson() throughput on the firmware's own payloads.
+
+  Boots one board and captures the status, sensor batch and heartbeat
+  messages its publish functions produce, next to the dashboard commands
+  the board receives. Each payload is parsed N times from RAM (the
+  contiguous-reader path mqttCallback() takes on PubSubClient's buffer) and
+  N times through a reader that hands out one byte per read() call, the
+  path every input took before RAM readers got their own scanner. Reports
+  MB/s for both and the speedup.
+*/
+
+#ifndef SIM_JSON_BENCH_H
+#define SIM_JSON_BENCH_H
+
+#include <stdint.h>
+
+// Parses every payload `iterations` times per reader, one line per payload.
+void runJsonBench(uint32_t iterations);
+
+#endif
@@ -0,0 +1,49 @@
+/*
+  lookup_bench.cpp - JsonObject key lookups with and without the object index.
+*/
+
+#undef ARDUINOJSON_ENABLE_OBJECT_INDEX
+#define ARDUINOJSON_ENABLE_OBJECT_INDEX 1
+#define LOOKUP_VARIANT indexed
+#include "lookup_bench.h"
+
+#include <stdio.h>
+
+namespace {
+
+// A flat settings object: "relay3_off_delay_ms": 250, "topic_07": "...", ...
+void buildConfig(size_t size, std::string* json, std::vector<std::string>* keys) {
+  static const char* const names[] = {"relay%u_on_delay_ms", "sensor%u_interval_ms", "topic_%02u", "dead_band_%u"};
+  json->assign("{");
+  keys->clear();
+  for (size_t i = 0; i < size; i++) {
+    char key[32];
+    snprintf(key, sizeof(key), names[i % 4], (unsigned)(i / 4));
+    keys->push_back(key);
+    char member[64];
+    snprintf(member, sizeof(member), "%s\"%s\":%u", i ? "," : "", key, (unsigned)(i * 10));
+    json->append(member);
+  }
+  json->append("}");
+}
+
+}  // namespace
+
+void runLookupBench(uint32_t iterations) {
+  if (iterations == 0) return;
+  printf("threshold %d keys\n", ARDUINOJSON_OBJECT_INDEX_THRESHOLD);
+  printf("keys    parse_us linear/indexed    lookup_ns linear/indexed    boot_us linear/indexed\n");
+  static const size_t sizes[] = {8, 16, 32, 64, 128, 256, 1024};
+  for (size_t size : sizes) {
+    std::string json;
+    std::vector<std::string> keys;
+    buildConfig(size, &json, &keys);
+    // Big objects take long enough per iteration with fewer of them
+    uint32_t n = (uint32_t)(iterations * 16 / (size < 16 ? 16 : size));
+    if (n == 0) n = 1;
+    LookupTimes before = linear::measureLookups(json, keys, n);
+    LookupTimes after = indexed::measureLookups(json, keys, n);
+    printf("%4u %10.2f %9.2f %12.1f %9.1f %12.2f %9.2f\n", (unsigned)size, before.parseUs, after.parseUs,
+           before.lookupNs, after.lookupNs, before.bootUs, after.bootUs);
+  }
+}
@@ -0,0 +1,95 @@
+/*
+  lookup_bench.h - JsonObject key lookups with and without the object index.
+
+  Builds flat config objects of 8 to 1024 keys, the shape of the settings
+  documents pushed to boards, and times three workloads on each: parsing
+  the object (the parser looks every key up to catch duplicates), reading
+  every key once by name, and a boot-style parse followed by 40 reads.
+  ArduinoJson puts ARDUINOJSON_ENABLE_OBJECT_INDEX in its namespace, so
+  the workloads are compiled twice, once per setting (lookup_bench.cpp and
+  lookup_bench_linear.cpp), and run side by side.
+*/
+
+#ifndef SIM_LOOKUP_BENCH_H
+#define SIM_LOOKUP_BENCH_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Times each object size `iterations` times per workload, one line per size.
+void runLookupBench(uint32_t iterations);
+
+struct LookupTimes {
+  double parseUs;   // deserializeJson() of the whole object
+  double lookupNs;  // one read by name, averaged over every key
+  double bootUs;    // parse, then 40 reads by name
+};
+
+namespace linear {
+LookupTimes measureLookups(const std::string& json, const std::vector<std::string>& keys, uint32_t iterations);
+}
+namespace indexed {
+LookupTimes measureLookups(const std::string& json, const std::vector<std::string>& keys, uint32_t iterations);
+}
+
+#ifdef LOOKUP_VARIANT
+// The workloads; lookup_bench.cpp and lookup_bench_linear.cpp include this
+// with LOOKUP_VARIANT set to their namespace
+
+#include <ArduinoJson.h>
+#include <time.h>
+
+namespace LOOKUP_VARIANT {
+namespace {
+
+// Best of kRounds: the host is shared, the fastest run is the one the rest
+// of the machine disturbed least
+const int kRounds = 5;
+
+double cpuSeconds() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+template <typename Work>
+double bestSeconds(uint32_t iterations, Work work) {
+  double best = 0;
+  for (int round = 0; round < kRounds; round++) {
+    double t0 = cpuSeconds();
+    for (uint32_t i = 0; i < iterations; i++) work();
+    double seconds = cpuSeconds() - t0;
+    if (round == 0 || seconds < best) best = seconds;
+  }
+  return best / iterations;
+}
+
+}  // namespace
+
+LookupTimes measureLookups(const std::string& json, const std::vector<std::string>& keys, uint32_t iterations) {
+  LookupTimes times;
+  volatile long sink = 0;
+
+  JsonDocument doc;
+  times.parseUs = bestSeconds(iterations, [&] { deserializeJson(doc, json); }) * 1e6;
+
+  JsonObjectConst config = doc.as<JsonObjectConst>();
+  times.lookupNs = bestSeconds(iterations, [&] {
+    for (const std::string& key : keys) sink = sink + config[key.c_str()].as<long>();
+  }) * 1e9 / keys.size();
+
+  times.bootUs = bestSeconds(iterations, [&] {
+    deserializeJson(doc, json);
+    JsonObjectConst settings = doc.as<JsonObjectConst>();
+    for (size_t i = 0; i < 40; i++) sink = sink + settings[keys[(i * 7) % keys.size()].c_str()].as<long>();
+  }) * 1e6;
+
+  return times;
+}
+
+}  // namespace LOOKUP_VARIANT
+#endif
+
+#endif
@@ -0,0 +1,8 @@
+/*
+  lookup_bench_linear.cpp - the lookup workloads without the object index.
+*/
+
+#undef ARDUINOJSON_ENABLE_OBJECT_INDEX
+#define ARDUINOJSON_ENABLE_OBJECT_INDEX 0
+#define LOOKUP_VARIANT linear
+#include "lookup_bench.h"
@@ -0,0 +1,71 @@
+/*
+  publish_bench.cpp - per-message cost of the firmware's publish functions.
+*/
+
+#include "publish_bench.h"
+
+#include <Arduino.h>
+#include <LoopbackBroker.h>
+#include <PubSubClient.h>
+
+#include <chrono>
+
+#include "alloc_count.h"
+
+// Firmware entry points (src/main_mqtt.cpp).
+void setup();
+void loop();
+void publishStatus();
+void publishSensorSnapshot();
+void readSensors();
+void publishHeartbeat();
+extern PubSubClient mqtt_client;
+
+namespace {
+
+struct BenchCase {
+  const char* name;
+  void (*publish)();
+};
+
+const BenchCase kCases[] = {
+  {"status", publishStatus},
+  {"sensor", publishSensorSnapshot},
+  {"heartbeat", publishHeartbeat},
+};
+
+}  // namespace
+
+void runPublishBench(uint32_t iterations) {
+  if (iterations == 0) return;
+  setup();
+  LoopbackBroker& broker = LoopbackBroker::instance();
+  for (int i = 0; i < 100 && broker.stats().subscribes == 0; i++) loop();
+  readSensors();  // a reading for every sensor channel, so snapshots are complete
+  // Take SUBACK and the first status' PUBACK, so one loop() per publish
+  // keeps up with the PUBACKs below
+  while (broker.pendingToDevice()) mqtt_client.loop();
+
+  printf("message          allocs/msg  bytes/msg  writes/msg  payload_B  us/msg\n");
+  for (const BenchCase& c : kCases) {
+    uint32_t writesBefore = broker.stats().writeCalls;
+    uint32_t publishesBefore = broker.stats().publishes;
+    uint32_t payloadBefore = broker.stats().publishBytes;
+    AllocCount before = allocCount();
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+      c.publish();
+      mqtt_client.loop();  // take the PUBACK of a QoS 1 status
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    AllocCount after = allocCount();
+    uint32_t sent = broker.stats().publishes - publishesBefore;
+    if (sent != iterations) fprintf(stderr, "%s: %u of %u publishes reached the broker\n", c.name, sent, iterations);
+    printf("%-16s %10.2f %10.1f %11.2f %10.1f %7.3f\n", c.name,
+           (double)(after.allocations - before.allocations) / iterations,
+           (double)(after.bytes - before.bytes) / iterations,
+           (double)(broker.stats().writeCalls - writesBefore) / iterations,
+           sent ? (double)(broker.stats().publishBytes - payloadBefore) / sent : 0.0,
+           std::chrono::duration<double, std::micro>(t1 - t0).count() / iterations);
+  }
+}
@@ -0,0 +1,19 @@
+/*
+  publish_bench.h - per-message cost of the firmware's publish functions.
+
+  Boots one board and calls publishStatus(), publishSensorSnapshot() (every
+  sensor channel, bypassing the dead-band filter) and publishHeartbeat()
+  directly, each followed by one PubSubClient loop() to take the PUBACK of a
+  QoS 1 status, reporting heap allocations, bytes allocated, socket writes
+  and host microseconds per message.
+*/
+
+#ifndef SIM_PUBLISH_BENCH_H
+#define SIM_PUBLISH_BENCH_H
+
+#include <stdint.h>
+
+// Runs `iterations` publishes per message kind and prints one line per kind.
+void runPublishBench(uint32_t iterations);
+
+#endif
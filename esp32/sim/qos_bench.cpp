@@ -0,0 +1,99 @@
+/*
+  qos_bench.cpp - QoS 0 vs QoS 1 publish throughput through PubSubClient.
+*/
+
+#include "qos_bench.h"
+
+#include <Arduino.h>
+#include <LoopbackBroker.h>
+#include <NativeSim.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+
+#include <chrono>
+
+#include "alloc_count.h"
+
+namespace {
+
+struct BenchMode {
+  const char* name;
+  uint8_t qos;
+  uint32_t pubackLossEvery;
+};
+
+const BenchMode kModes[] = {
+  {"qos0", 0, 0},
+  {"qos1", 1, 0},
+  {"qos1_lossy", 1, 20},  // one PUBACK in 20 never arrives
+};
+
+const uint16_t kRetryMs = 500;
+uint32_t delivered;
+
+void onAck(uint16_t msgId, boolean ok) {
+  (void)msgId;
+  if (ok) delivered++;
+}
+
+}  // namespace
+
+void runQosBench(uint32_t messages) {
+  if (messages == 0) return;
+  LoopbackBroker& broker = LoopbackBroker::instance();
+  broker.setLoopback(false);
+
+  uint8_t payload[200];
+  for (size_t i = 0; i < sizeof(payload); i++) payload[i] = (uint8_t)('a' + i % 26);
+  const char* topic = "esp32/ESP32_BENCH0/status";
+
+  printf("mode         msgs/s  writes/msg  wire_B/msg  allocs/msg  delivered  retransmits  virtual_ms\n");
+  for (const BenchMode& m : kModes) {
+    WiFiClient net;
+    PubSubClient client(net);
+    client.setServer("broker", 1883).setRetryInterval(kRetryMs);
+    client.setBufferSize(512);
+    if (!client.connect("qos_bench")) {
+      fprintf(stderr, "%s: connect failed\n", m.name);
+      continue;
+    }
+    broker.setPubackLoss(m.pubackLossEvery);
+    delivered = 0;
+    uint32_t writesBefore = broker.stats().writeCalls;
+    uint64_t bytesBefore = broker.stats().bytesIn;
+    uint64_t virtualBefore = nativesim::nowMicros();
+    AllocCount before = allocCount();
+    auto t0 = std::chrono::steady_clock::now();
+
+    uint32_t sent = 0;
+    while (sent < messages) {
+      if (client.publish(topic, payload, sizeof(payload), false, m.qos, onAck)) {
+        sent++;
+        if (m.qos == 0) delivered++;
+      } else if (!broker.pendingToDevice()) {
+        // Window full and every PUBACK that is coming is in: wait out the
+        // retry interval so the lost ones are resent
+        nativesim::advanceMillis(kRetryMs);
+      }
+      client.loop();
+    }
+    while (client.inflightCount()) {
+      if (!broker.pendingToDevice()) nativesim::advanceMillis(kRetryMs);
+      client.loop();
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+    AllocCount after = allocCount();
+    double seconds = std::chrono::duration<double>(t1 - t0).count();
+    printf("%-10s %8.0f %11.2f %11.1f %11.3f %10u %12u %11.0f\n", m.name,
+           seconds > 0 ? messages / seconds : 0.0,
+           (double)(broker.stats().writeCalls - writesBefore) / messages,
+           (double)(broker.stats().bytesIn - bytesBefore) / messages,
+           (double)(after.allocations - before.allocations) / messages,
+           delivered, client.qos1Stats().retransmits,
+           (nativesim::nowMicros() - virtualBefore) / 1000.0);
+    client.disconnect();
+  }
+  broker.setPubackLoss(0);
+  broker.setLoopback(true);
+}
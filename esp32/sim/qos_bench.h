@@ -0,0 +1,19 @@
+/*
+  qos_bench.h - QoS 0 vs QoS 1 publish throughput through PubSubClient.
+
+  Drives a bare PubSubClient against the loopback broker (no firmware),
+  publishing fixed-size messages as fast as the QoS 1 in-flight window
+  allows, and reports host messages per second, socket writes, wire bytes
+  and allocations per message. A third run withholds some PUBACKs so the
+  retransmit path is exercised on the virtual clock.
+*/
+
+#ifndef SIM_QOS_BENCH_H
+#define SIM_QOS_BENCH_H
+
+#include <stdint.h>
+
+// Publishes `messages` per mode and prints one line per mode.
+void runQosBench(uint32_t messages);
+
+#endif
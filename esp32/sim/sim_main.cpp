@@ -0,0 +1,326 @@
+/*
+  sim_main.cpp - fleet simulator for the MQTT relay controller.
+
+  Boots N copies of src/main_mqtt.cpp against the host stand-ins, one child
+  process per device (the firmware keeps its state in globals), replays
+  dashboard commands and wall-switch presses through the loopback broker and
+  prints loop-iteration latency and publish-rate numbers for the fleet.
+
+    pio run -e native && .pio/build/native/program --devices 1000 --seconds 60
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+#include "burst_bench.h"
+#include "codec_bench.h"
+#include "command_bench.h"
+#include "device_run.h"
+#include "json_bench.h"
+#include "lookup_bench.h"
+#include "publish_bench.h"
+#include "qos_bench.h"
+#include "strings_bench.h"
+
+namespace {
+
+struct Options {
+  uint32_t devices = 1;
+  uint32_t seconds = 60;
+  uint32_t commandsPerMinute = 30;
+  uint32_t pressesPerMinute = 6;
+  uint32_t seed = 1;
+  uint32_t jobs = 0;
+  uint32_t outageEverySeconds = 0;
+  uint32_t outageSeconds = 0;
+  uint32_t cpuScale = 0;
+  uint32_t benchCommands = 0;
+  uint32_t benchPublishes = 0;
+  uint32_t benchQos = 0;
+  uint32_t benchBursts = 0;
+  uint32_t benchCodec = 0;
+  uint32_t benchJson = 0;
+  uint32_t benchLookup = 0;
+  uint32_t benchStrings = 0;
+  bool verbose = false;
+};
+
+void usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --devices N      simulated boards (default 1)\n"
+          "  --seconds S      virtual seconds per board after setup() (default 60)\n"
+          "  --commands N     dashboard commands per minute per board (default 30)\n"
+          "  --presses N      wall-switch presses per minute per board (default 6)\n"
+          "  --seed N         replay seed (default 1)\n"
+          "  --jobs N         boards simulated in parallel (default: online CPUs)\n"
+          "  --outage-every S take the broker down every S virtual seconds (default never)\n"
+          "  --outage-for S   length of each broker outage (default 0)\n"
+          "  --cpu-scale N    charge N virtual us per us of host CPU loop() uses (default 0: none)\n"
+          "  --bench-commands N  instead of a fleet run, time N callbacks per command kind\n"
+          "  --bench-publish N   instead of a fleet run, time N publishes per message kind\n"
+          "  --bench-qos N       instead of a fleet run, publish N messages at QoS 0 and QoS 1\n"
+          "  --bench-burst N     instead of a fleet run, drain N command bursts per size and loop() budget\n"
+          "  --bench-codec N     instead of a fleet run, N messages per kind as JSON and as MessagePack\n"
+          "  --bench-json N      instead of a fleet run, parse each payload N times per JSON reader\n"
+          "  --bench-lookup N    instead of a fleet run, time config-object key lookups with and without the index\n"
+          "  --bench-strings N   instead of a fleet run, time parsing and building documents of 10 to 10,000 distinct strings\n"
+          "  --verbose        echo firmware Serial output (use with --devices 1)\n",
+          argv0);
+}
+
+bool parseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strcmp(arg, "--verbose") == 0) {
+      options->verbose = true;
+      continue;
+    }
+    if (i + 1 >= argc) return false;
+    uint32_t value = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    if (strcmp(arg, "--devices") == 0) options->devices = value;
+    else if (strcmp(arg, "--seconds") == 0) options->seconds = value;
+    else if (strcmp(arg, "--commands") == 0) options->commandsPerMinute = value;
+    else if (strcmp(arg, "--presses") == 0) options->pressesPerMinute = value;
+    else if (strcmp(arg, "--seed") == 0) options->seed = value;
+    else if (strcmp(arg, "--jobs") == 0) options->jobs = value;
+    else if (strcmp(arg, "--outage-every") == 0) options->outageEverySeconds = value;
+    else if (strcmp(arg, "--outage-for") == 0) options->outageSeconds = value;
+    else if (strcmp(arg, "--cpu-scale") == 0) options->cpuScale = value;
+    else if (strcmp(arg, "--bench-commands") == 0) options->benchCommands = value;
+    else if (strcmp(arg, "--bench-publish") == 0) options->benchPublishes = value;
+    else if (strcmp(arg, "--bench-qos") == 0) options->benchQos = value;
+    else if (strcmp(arg, "--bench-burst") == 0) options->benchBursts = value;
+    else if (strcmp(arg, "--bench-codec") == 0) options->benchCodec = value;
+    else if (strcmp(arg, "--bench-json") == 0) options->benchJson = value;
+    else if (strcmp(arg, "--bench-lookup") == 0) options->benchLookup = value;
+    else if (strcmp(arg, "--bench-strings") == 0) options->benchStrings = value;
+    else return false;
+  }
+  return options->devices > 0;
+}
+
+struct Child {
+  pid_t pid;
+  int fd;
+  uint32_t index;
+};
+
+bool readAll(int fd, void* buf, size_t size) {
+  uint8_t* p = (uint8_t*)buf;
+  while (size) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+bool writeAll(int fd, const void* buf, size_t size) {
+  const uint8_t* p = (const uint8_t*)buf;
+  while (size) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+bool spawn(const Options& options, uint32_t index, Child* child) {
+  int fds[2];
+  if (pipe(fds) != 0) return false;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    RunConfig config = {index, options.seed, options.seconds, options.commandsPerMinute,
+                        options.pressesPerMinute, options.outageEverySeconds, options.outageSeconds,
+                        options.cpuScale, options.verbose};
+    static DeviceResult result;
+    runDevice(config, &result);
+    fflush(stdout);
+    _exit(writeAll(fds[1], &result, sizeof(result)) ? 0 : 2);
+  }
+  close(fds[1]);
+  child->pid = pid;
+  child->fd = fds[0];
+  child->index = index;
+  return true;
+}
+
+bool reap(const Child& child, DeviceResult* result) {
+  bool ok = readAll(child.fd, result, sizeof(*result));
+  close(child.fd);
+  int status = 0;
+  while (waitpid(child.pid, &status, 0) < 0 && errno == EINTR) {
+  }
+  if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "device %u failed (status %d)\n", child.index, status);
+    return false;
+  }
+  return true;
+}
+
+void report(const Options& options, const DeviceResult& total, uint32_t completed, double wallSeconds) {
+  double deviceSeconds = (double)total.virtualMicros / 1e6;
+  uint64_t publishes = 0;
+  for (int k = 0; k < PUBLISH_KINDS; k++) publishes += total.publishes[k];
+
+  printf("devices=%u completed=%u virtual_seconds=%u wall_seconds=%.2f\n",
+         options.devices, completed, options.seconds, wallSeconds);
+  printf("loop_host_ns        p50=%llu p99=%llu p999=%llu max=%llu mean=%.0f\n",
+         (unsigned long long)total.loopHostNanos.percentile(50),
+         (unsigned long long)total.loopHostNanos.percentile(99),
+         (unsigned long long)total.loopHostNanos.percentile(99.9),
+         (unsigned long long)total.loopHostNanos.max, total.loopHostNanos.mean());
+  printf("loop_virtual_us     p50=%llu p99=%llu max=%llu mean=%.0f loops_per_s=%.1f\n",
+         (unsigned long long)total.loopVirtualMicros.percentile(50),
+         (unsigned long long)total.loopVirtualMicros.percentile(99),
+         (unsigned long long)total.loopVirtualMicros.max, total.loopVirtualMicros.mean(),
+         deviceSeconds > 0 ? (double)total.loops / deviceSeconds : 0.0);
+  printf("publish_rate        per_device=%.3f/s fleet=%.1f/s payload_B_per_device=%.1f/s wire_B_per_device=%.1f/s\n",
+         deviceSeconds > 0 ? (double)publishes / deviceSeconds : 0.0,
+         deviceSeconds > 0 ? (double)publishes / deviceSeconds * completed : 0.0,
+         deviceSeconds > 0 ? (double)total.publishBytes / deviceSeconds : 0.0,
+         deviceSeconds > 0 ? (double)total.bytesOnWire / deviceSeconds : 0.0);
+  printf("publishes           status=%llu sensor=%llu heartbeat=%llu other=%llu\n",
+         (unsigned long long)total.publishes[PUBLISH_STATUS],
+         (unsigned long long)total.publishes[PUBLISH_SENSOR],
+         (unsigned long long)total.publishes[PUBLISH_HEARTBEAT],
+         (unsigned long long)total.publishes[PUBLISH_OTHER]);
+  printf("commands            injected=%llu dropped=%llu presses=%llu connects=%llu\n",
+         (unsigned long long)total.commandsInjected, (unsigned long long)total.commandsDropped,
+         (unsigned long long)total.presses, (unsigned long long)total.connects);
+  printf("command_to_status_us p50=%llu p99=%llu max=%llu\n",
+         (unsigned long long)total.commandToStatusMicros.percentile(50),
+         (unsigned long long)total.commandToStatusMicros.percentile(99),
+         (unsigned long long)total.commandToStatusMicros.max);
+  printf("press_to_relay_us   p50=%llu p99=%llu max=%llu n=%llu\n",
+         (unsigned long long)total.pressToRelayMicros.percentile(50),
+         (unsigned long long)total.pressToRelayMicros.percentile(99),
+         (unsigned long long)total.pressToRelayMicros.max,
+         (unsigned long long)total.pressToRelayMicros.total);
+  if (total.outages) {
+    printf("outages             count=%llu session_down_pct=%.2f\n",
+           (unsigned long long)total.outages,
+           total.virtualMicros ? 100.0 * (double)total.sessionDownMicros / (double)total.virtualMicros : 0.0);
+    printf("outage_reconnect_us p50=%llu p99=%llu max=%llu n=%llu\n",
+           (unsigned long long)total.outageToReconnectMicros.percentile(50),
+           (unsigned long long)total.outageToReconnectMicros.percentile(99),
+           (unsigned long long)total.outageToReconnectMicros.max,
+           (unsigned long long)total.outageToReconnectMicros.total);
+  }
+}
+
+void accumulate(DeviceResult* total, const DeviceResult& r) {
+  total->loops += r.loops;
+  total->virtualMicros += r.virtualMicros;
+  for (int k = 0; k < PUBLISH_KINDS; k++) total->publishes[k] += r.publishes[k];
+  total->publishBytes += r.publishBytes;
+  total->bytesOnWire += r.bytesOnWire;
+  total->commandsInjected += r.commandsInjected;
+  total->commandsDropped += r.commandsDropped;
+  total->presses += r.presses;
+  total->connects += r.connects;
+  total->outages += r.outages;
+  total->sessionDownMicros += r.sessionDownMicros;
+  total->loopHostNanos.merge(r.loopHostNanos);
+  total->loopVirtualMicros.merge(r.loopVirtualMicros);
+  total->commandToStatusMicros.merge(r.commandToStatusMicros);
+  total->pressToRelayMicros.merge(r.pressToRelayMicros);
+  total->outageToReconnectMicros.merge(r.outageToReconnectMicros);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, &options)) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (options.benchCommands) {
+    runCommandBench(options.benchCommands);
+    return 0;
+  }
+  if (options.benchPublishes) {
+    runPublishBench(options.benchPublishes);
+    return 0;
+  }
+  if (options.benchQos) {
+    runQosBench(options.benchQos);
+    return 0;
+  }
+  if (options.benchBursts) {
+    runBurstBench(options.benchBursts);
+    return 0;
+  }
+  if (options.benchCodec) {
+    runCodecBench(options.benchCodec);
+    return 0;
+  }
+  if (options.benchJson) {
+    runJsonBench(options.benchJson);
+    return 0;
+  }
+  if (options.benchLookup) {
+    runLookupBench(options.benchLookup);
+    return 0;
+  }
+  if (options.benchStrings) {
+    runStringsBench(options.benchStrings);
+    return 0;
+  }
+  if (options.jobs == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    options.jobs = cpus > 0 ? (uint32_t)cpus : 1;
+  }
+
+  static DeviceResult total;
+  static DeviceResult result;
+  std::vector<Child> running;
+  uint32_t next = 0;
+  uint32_t completed = 0;
+  bool failed = false;
+  auto started = std::chrono::steady_clock::now();
+
+  while (next < options.devices || !running.empty()) {
+    while (next < options.devices && running.size() < options.jobs) {
+      Child child;
+      if (!spawn(options, next, &child)) {
+        perror("fork");
+        return 1;
+      }
+      running.push_back(child);
+      next++;
+    }
+    Child child = running.front();
+    running.erase(running.begin());
+    if (reap(child, &result)) {
+      accumulate(&total, result);
+      completed++;
+    } else {
+      failed = true;
+    }
+  }
+
+  double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  report(options, total, completed, wallSeconds);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+/*
+  strings_bench.cpp - interning cost of distinct strings in a JsonDocument.
+*/
+
+#include "strings_bench.h"
+
+#include <ArduinoJson.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// Best of kRounds: the host is shared, the fastest run is the one the rest
+// of the machine disturbed least
+const int kRounds = 5;
+
+double cpuSeconds() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+template <typename Work>
+double bestSeconds(uint32_t iterations, Work work) {
+  double best = 0;
+  for (int round = 0; round < kRounds; round++) {
+    double t0 = cpuSeconds();
+    for (uint32_t i = 0; i < iterations; i++) work();
+    double seconds = cpuSeconds() - t0;
+    if (round == 0 || seconds < best) best = seconds;
+  }
+  return best / iterations;
+}
+
+// Two distinct strings per record, plus the "name" key shared by all
+void buildRecords(size_t distinct, std::string* json, std::vector<std::string>* strings) {
+  static const char* const rooms[] = {"Kitchen", "Garage", "Bedroom", "Porch"};
+  json->assign("[");
+  strings->clear();
+  for (size_t i = 0; i < distinct / 2; i++) {
+    char name[40];
+    char id[16];
+    snprintf(name, sizeof(name), "%s sensor %04u", rooms[i % 4], (unsigned)i);
+    snprintf(id, sizeof(id), "dev-%08x", (unsigned)(i * 2654435761u));
+    strings->push_back(name);
+    strings->push_back(id);
+    char record[96];
+    snprintf(record, sizeof(record), "%s{\"name\":\"%s\",\"id\":\"%s\"}", i ? "," : "", name, id);
+    json->append(record);
+  }
+  json->append("]");
+}
+
+}  // namespace
+
+void runStringsBench(uint32_t iterations) {
+  if (iterations == 0) return;
+  printf("strings   parse_us  parse_ns/string   build_ns/string\n");
+  static const size_t sizes[] = {10, 30, 100, 300, 1000, 3000, 10000};
+  for (size_t size : sizes) {
+    std::string json;
+    std::vector<std::string> strings;
+    buildRecords(size, &json, &strings);
+    uint32_t n = (uint32_t)(iterations * 10 / size);
+    if (n == 0) n = 1;
+
+    JsonDocument doc;
+    double parse = bestSeconds(n, [&] { deserializeJson(doc, json); });
+    double build = bestSeconds(n, [&] {
+      doc.clear();
+      JsonArray array = doc.to<JsonArray>();
+      for (const std::string& s : strings) array.add(s.c_str());
+    });
+    printf("%7u %10.1f %16.1f %17.1f\n", (unsigned)size, parse * 1e6, parse * 1e9 / size, build * 1e9 / size);
+  }
+}
@@ -0,0 +1,22 @@
+/*
+  strings_bench.h - interning cost of distinct strings in a JsonDocument.
+
+  A document stores each distinct string once, so every new string is
+  looked up among the ones already stored. The bench parses arrays of
+  device records ({"name":"Kitchen sensor 0042","id":"dev-00c8a2f1"})
+  holding 10 to 10,000 distinct strings, and builds the same strings with
+  JsonArray::add(), reporting host time per document and per string. With
+  a linear scan the cost per string grows with the count; with the string
+  pool's hash table it stays flat.
+*/
+
+#ifndef SIM_STRINGS_BENCH_H
+#define SIM_STRINGS_BENCH_H
+
+#include <stdint.h>
+
+// Parses and builds each size about `iterations` * 10 / size times (at
+// least once per round), one line per size.
+void runStringsBench(uint32_t iterations);
+
+#endif
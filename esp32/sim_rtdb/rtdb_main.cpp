@@ -0,0 +1,274 @@
+/*
+  rtdb_main.cpp - host driver for the Firebase variant (src/main.cpp).
+
+  Runs one board against the in-process LoopbackRTDB: the harness plays the
+  web dashboard by writing relay values into /deviceData/<uid>, presses the
+  wall switches, optionally cuts the device's stream or takes the database
+  down, and reports how many HTTPS requests the board made, how long a
+  dashboard toggle or a wall-switch press took to reach the relay pin and
+  what loop() cost. Press edges are queued on the virtual clock, so they can
+  land while the board is blocked in a database round-trip. It exits
+  non-zero if the relay pins and the database disagree at the end of the run.
+
+    pio run -e native_firebase && .pio/build/native_firebase/program --seconds 600
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <LoopbackRTDB.h>
+#include <NativeSim.h>
+
+#include "../sim/histogram.h"
+
+// Firmware entry points and identity (src/main.cpp).
+void setup();
+void loop();
+extern String DEVICE_SN;
+
+namespace {
+
+// Must match USER_UID in src/main.cpp.
+const char* const kUserUid = "nMguPuiD4qbY1wgFBlHChkLL9VU2";
+const uint8_t kInputPins[4] = {34, 35, 32, 33};
+const uint8_t kRelayPins[4] = {25, 26, 27, 14};
+const uint32_t kPressHoldMicros = 120000;
+// Presses are queued this far ahead, so they can land mid-request
+const uint64_t kPressLeadMicros = 1000000;
+const uint32_t kSettleSeconds = 10;
+// A toggle that hasn't reached the pin by then lost to a concurrent local
+// press (both sides changed the relay while the board was offline).
+const uint64_t kToggleGiveUpMicros = 10000000;
+
+struct Options {
+  uint32_t seconds = 120;
+  uint32_t togglesPerMinute = 12;
+  uint32_t pressesPerMinute = 6;
+  uint32_t rttMillis = 80;
+  uint32_t dropEverySeconds = 0;
+  uint32_t dropForSeconds = 0;
+  uint32_t seed = 1;
+  bool verbose = false;
+};
+
+struct Rng {
+  uint64_t state;
+  uint32_t next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (uint32_t)state;
+  }
+  uint64_t after(uint64_t now, uint32_t perMinute) {
+    if (perMinute == 0) return UINT64_MAX;
+    uint64_t mean = 60000000ULL / perMinute;
+    return now + (uint64_t)next() % (2 * mean) + 1;
+  }
+};
+
+void usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --seconds S      virtual seconds after setup() (default 120)\n"
+          "  --toggles N      dashboard relay toggles per minute (default 12)\n"
+          "  --presses N      wall-switch presses per minute (default 6)\n"
+          "  --rtt-ms N       database round-trip time (default 80)\n"
+          "  --drop-every S   cut the device's stream every S virtual seconds (default never)\n"
+          "  --drop-for S     keep the database down for S seconds after each cut (default 0)\n"
+          "  --seed N         replay seed (default 1)\n"
+          "  --verbose        echo firmware Serial output\n",
+          argv0);
+}
+
+bool parseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strcmp(arg, "--verbose") == 0) {
+      options->verbose = true;
+      continue;
+    }
+    if (i + 1 >= argc) return false;
+    uint32_t value = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    if (strcmp(arg, "--seconds") == 0) options->seconds = value;
+    else if (strcmp(arg, "--toggles") == 0) options->togglesPerMinute = value;
+    else if (strcmp(arg, "--presses") == 0) options->pressesPerMinute = value;
+    else if (strcmp(arg, "--rtt-ms") == 0) options->rttMillis = value;
+    else if (strcmp(arg, "--drop-every") == 0) options->dropEverySeconds = value;
+    else if (strcmp(arg, "--drop-for") == 0) options->dropForSeconds = value;
+    else if (strcmp(arg, "--seed") == 0) options->seed = value;
+    else return false;
+  }
+  return true;
+}
+
+String relayValuePath(int relay) {
+  return "/deviceData/" + String(kUserUid) + "/" + DEVICE_SN + "_relay" + String(relay + 1) + "/value";
+}
+
+void printHistogram(const char* name, const Histogram& h) {
+  printf("%-20s p50=%llu p99=%llu max=%llu n=%llu\n", name,
+         (unsigned long long)h.percentile(50), (unsigned long long)h.percentile(99),
+         (unsigned long long)h.max, (unsigned long long)h.total);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, &options)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  const uint8_t mac[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+  nativesim::setMacAddress(mac);
+  nativesim::setSerialEcho(options.verbose);
+  randomSeed(options.seed);
+  Rng rng = {((uint64_t)options.seed << 32) ^ 0x9E3779B97F4A7C15ULL};
+
+  LoopbackRTDB& rtdb = LoopbackRTDB::instance();
+  rtdb.setLatencyMicros(options.rttMillis * 1000);
+
+  setup();
+  rtdb.resetStats();
+
+  const uint64_t start = nativesim::nowMicros();
+  const uint64_t end = start + (uint64_t)options.seconds * 1000000ULL;
+  const uint64_t settleEnd = end + (uint64_t)kSettleSeconds * 1000000ULL;
+
+  Histogram loopMicros;
+  Histogram toggleToRelayMicros;
+  Histogram pressToRelayMicros;
+  loopMicros.clear();
+  toggleToRelayMicros.clear();
+  pressToRelayMicros.clear();
+  uint64_t loops = 0;
+  uint32_t toggles = 0;
+  uint32_t presses = 0;
+  uint32_t drops = 0;
+  uint32_t unapplied = 0;
+
+  uint64_t nextToggle = rng.after(start, options.togglesPerMinute);
+  uint64_t nextPress = rng.after(start, options.pressesPerMinute);
+  int heldPin = -1;
+  uint64_t releaseAt = 0;
+  uint64_t pressedAt = 0;
+  int pressedRelay = -1;
+  int pressedLevel = LOW;
+  uint32_t missedPresses = 0;
+  int watchedRelay = -1;
+  int watchedLevel = LOW;
+  uint64_t toggledAt = 0;
+
+  const uint64_t dropEvery = (uint64_t)options.dropEverySeconds * 1000000ULL;
+  uint64_t nextDrop = dropEvery ? start + dropEvery : UINT64_MAX;
+  uint64_t backOnlineAt = UINT64_MAX;
+
+  while (nativesim::nowMicros() < settleEnd) {
+    uint64_t now = nativesim::nowMicros();
+    bool driving = now < end;
+
+    if (now >= backOnlineAt) {
+      rtdb.setOnline(true);
+      backOnlineAt = UINT64_MAX;
+    }
+    if (driving && now >= nextDrop) {
+      drops++;
+      if (options.dropForSeconds) {
+        rtdb.setOnline(false);
+        backOnlineAt = now + (uint64_t)options.dropForSeconds * 1000000ULL;
+      } else {
+        rtdb.dropStreams();
+      }
+      nextDrop += dropEvery;
+    }
+
+    // Dashboard toggle: flip a relay the device isn't already busy with.
+    if (driving && watchedRelay < 0 && heldPin < 0 && now >= nextToggle && rtdb.online()) {
+      int relay = (int)(rng.next() % 4);
+      int level = nativesim::pinLevel(kRelayPins[relay]);
+      JsonDocument value;
+      value.set(level == LOW);
+      rtdb.dashboardSet(relayValuePath(relay).c_str(), value.as<JsonVariantConst>());
+      watchedRelay = relay;
+      watchedLevel = level;
+      toggledAt = now;
+      toggles++;
+      nextToggle = rng.after(now, options.togglesPerMinute);
+    }
+
+    if (driving && heldPin < 0 && watchedRelay < 0 && nextPress <= now + kPressLeadMicros) {
+      int button = (int)(rng.next() % 4);
+      heldPin = kInputPins[button];
+      pressedAt = std::max(now, nextPress);
+      releaseAt = pressedAt + kPressHoldMicros;
+      nativesim::schedulePinLevel(heldPin, LOW, pressedAt);
+      nativesim::schedulePinLevel(heldPin, HIGH, releaseAt);
+      pressedRelay = button;
+      pressedLevel = nativesim::pinLevel(kRelayPins[button]);
+      presses++;
+    } else if (heldPin >= 0 && now >= releaseAt && pressedRelay < 0) {
+      heldPin = -1;
+      nextPress = rng.after(releaseAt + kPressHoldMicros, options.pressesPerMinute);
+    }
+
+    // The firmware sleeps between tasks; end the sleep at the next harness
+    // event. A toggle or press that is due but held back waits for a loop()
+    // to finish anyway, so only future events count.
+    uint64_t wakeAt = std::min(heldPin >= 0 ? releaseAt : nextPress - kPressLeadMicros, std::min(nextToggle, backOnlineAt));
+    wakeAt = std::min(wakeAt, std::min(nextDrop, driving ? end : settleEnd));
+    nativesim::setWakeAt(wakeAt > now ? wakeAt : UINT64_MAX);
+
+    loop();
+    uint64_t after = nativesim::nowMicros();
+    loops++;
+    if (driving) loopMicros.record(after - now);
+
+    if (pressedRelay >= 0 && after >= pressedAt &&
+        nativesim::pinLevel(kRelayPins[pressedRelay]) != pressedLevel) {
+      pressToRelayMicros.record(nativesim::pinChangedAt(kRelayPins[pressedRelay]) - pressedAt);
+      pressedRelay = -1;
+    } else if (pressedRelay >= 0 && after >= releaseAt + kToggleGiveUpMicros) {
+      missedPresses++;
+      pressedRelay = -1;
+    }
+
+    if (watchedRelay >= 0 && nativesim::pinLevel(kRelayPins[watchedRelay]) != watchedLevel) {
+      toggleToRelayMicros.record(after - toggledAt);
+      watchedRelay = -1;
+    } else if (watchedRelay >= 0 && after - toggledAt > kToggleGiveUpMicros) {
+      unapplied++;
+      watchedRelay = -1;
+    }
+  }
+
+  const LoopbackRTDB::Stats& stats = rtdb.stats();
+  double seconds = (double)(nativesim::nowMicros() - start) / 1e6;
+  printf("virtual_seconds=%.0f loops=%llu toggles=%u presses=%u drops=%u rtt_ms=%u\n",
+         seconds, (unsigned long long)loops, toggles, presses, drops, options.rttMillis);
+  printf("requests            total=%u per_s=%.2f reads=%u writes=%u stream_opens=%u refused=%u\n",
+         stats.requests, stats.requests / seconds, stats.reads, stats.writes, stats.streamOpens, stats.refused);
+  printf("stream_events       %u\n", stats.streamEvents);
+  printf("bytes               up_per_s=%.0f down_per_s=%.0f\n",
+         stats.bytesUp / seconds, stats.bytesDown / seconds);
+  printHistogram("toggle_to_relay_us", toggleToRelayMicros);
+  printHistogram("press_to_relay_us", pressToRelayMicros);
+  if (missedPresses) printf("missed_presses      %u\n", missedPresses);
+  printf("%-20s p50=%llu p99=%llu max=%llu mean=%.0f\n", "loop_virtual_us",
+         (unsigned long long)loopMicros.percentile(50), (unsigned long long)loopMicros.percentile(99),
+         (unsigned long long)loopMicros.max, loopMicros.mean());
+
+  int mismatches = 0;
+  for (int relay = 0; relay < 4; relay++) {
+    JsonVariantConst stored = rtdb.peek(relayValuePath(relay).c_str());
+    bool pin = nativesim::pinLevel(kRelayPins[relay]) == HIGH;
+    if (!stored.isNull() && stored.as<bool>() != pin) {
+      printf("MISMATCH relay %d: pin=%d rtdb=%d\n", relay + 1, pin, stored.as<bool>());
+      mismatches++;
+    }
+  }
+  if (unapplied) printf("unapplied_toggles   %u (overridden by a local press)\n", unapplied);
+  return mismatches ? 1 : 0;
+}
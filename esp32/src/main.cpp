@@ -6,7 +6,7 @@
   - WiFiManager for easy WiFi setup
   - 4 Digital Inputs to toggle 4 Relays (offline operation)
   - DHT22 temperature & humidity sensor
-  - Firebase real-time communication
+  - Firebase real-time communication (streamed relay commands)
   - Serial commands for testing
   - Real-time status monitoring
 */
@@ -17,6 +17,8 @@
 #include <DHT.h>
 #include <esp_task_wdt.h>
 #include <esp_system.h>
+#include <TaskWheel.h>
+#include <EdgeInput.h>
 #include "addons/TokenHelper.h"
 #include "addons/RTDBHelper.h"
 
@@ -57,28 +59,24 @@ bool relay2_State = LOW;
 bool relay3_State = LOW;
 bool relay4_State = LOW;
 
-// Button debouncing variables
-long last_debounce_time1 = 0;
-long last_debounce_time2 = 0;
-long last_debounce_time3 = 0;
-long last_debounce_time4 = 0;
-bool last_button_state1 = HIGH;
-bool last_button_state2 = HIGH;
-bool last_button_state3 = HIGH;
-bool last_button_state4 = HIGH;
-bool button1_state_debounced = HIGH;
-bool button2_state_debounced = HIGH;
-bool button3_state_debounced = HIGH;
-bool button4_state_debounced = HIGH;
+// Inputs are interrupt-driven: edges are timestamped in the ISR and
+// debounced from those timestamps, so presses made during a slow Firebase
+// call are still seen
+EdgeInput inputs;
+const uint8_t input_pins[4] = {INPUT_PIN_1, INPUT_PIN_2, INPUT_PIN_3, INPUT_PIN_4};
 long debounce_delay = 50;
 
-// Timing variables
-unsigned long last_status_update_time = 0;
-unsigned long last_sensor_update_time = 0;
-unsigned long dataMillis = 0;
-unsigned long statusMillis = 0;
+// Timing variables - every periodic job is a scheduler task; loop() sleeps
+// until the next one is due
+TaskWheel scheduler;
+int flush_task = -1;
+int inputs_task = -1;
+const long firebase_service_interval = 10;   // stream + reconnect checks
 const long status_update_interval = 1000;
 const long sensor_update_interval = 5000;
+const long input_status_interval = 10000;    // Serial summary
+const long online_status_interval = 30000;
+const long serial_poll_interval = 100;       // Serial commands (STATUS, ON1, ...)
 
 // Sensor data
 float temperature = 25.0;
@@ -91,6 +89,45 @@ FirebaseConfig config;
 bool signupOK = false;
 bool wifiConnected = false;
 
+// Relay commands arrive over one streamed subscription on /deviceData/<uid>
+// (its own FirebaseData: a stream can't share a connection with set/get).
+// While the stream is down the relays are polled instead, at most once per
+// relay_poll_interval, until beginStream() succeeds again.
+FirebaseData stream;
+bool relay_stream_open = false;
+unsigned long relay_stream_retry_at = 0;
+unsigned long relay_stream_backoff = 0;
+const unsigned long relay_stream_backoff_min = 5000;
+const unsigned long relay_stream_backoff_max = 60000;
+unsigned long last_relay_poll = 0;
+const unsigned long relay_poll_interval = 2000;
+uint32_t relay_stream_events = 0;
+uint32_t relay_stream_drops = 0;
+
+// Write-behind queue. Setters only record the latest value for a path;
+// the first one arms flush_task, which sends everything dirty as one
+// multi-path update at the database root write_flush_interval later, so
+// button handling never waits on a write it caused. A failed flush keeps the
+// entries (newer values still overwrite them) and re-arms with backoff.
+enum WriteKind { WRITE_BOOL, WRITE_INT, WRITE_FLOAT, WRITE_TIMESTAMP };
+struct PendingWrite {
+  String path;
+  WriteKind kind;
+  bool boolValue;
+  int intValue;
+  float floatValue;
+};
+const int max_pending_writes = 24;  // 4 sensor + 8 relay + 8 online-status paths
+PendingWrite pending_writes[max_pending_writes];
+int pending_write_count = 0;
+const unsigned long write_flush_interval = 250;
+unsigned long write_backoff = 0;
+const unsigned long write_backoff_min = 1000;
+const unsigned long write_backoff_max = 30000;
+uint32_t write_flushes = 0;
+uint32_t write_flush_failures = 0;
+uint32_t writes_coalesced = 0;
+
 // WiFiManager
 WiFiManager wm;
 
@@ -101,9 +138,16 @@ void setupWiFiManager();
 void setupFirebase();
 void generateDeviceSN();
 void handlePhysicalInputs();
+void onInputPress(int index);
+void onInputEdge();
 void handleSerialCommands();
-void handlePeriodicTasks();
+void setupTasks();
+void printInputStatus();
+void serviceFirebase();
 void handleFirebaseOperations();
+bool firebaseReady();
+void uploadSensorData();
+void uploadOnlineStatus();
 void readSensorData();
 void setRelayState(int relayNum, bool state);
 void sendSensorDataToFirebase();
@@ -112,6 +156,18 @@ void updateOnlineStatus();
 void setAllDevicesOffline();
 void registerDeviceInFirebase();
 void checkFirebaseRelayControls();
+void beginRelayStream();
+void serviceRelayStream();
+void applyRelayData(FirebaseData& data, const String& eventPath, bool snapshot);
+void applyRemoteRelay(const String& path, bool state, bool snapshot);
+bool getRelayState(int relayNum);
+PendingWrite* queueWrite(const String& path, WriteKind kind);
+void queueBool(const String& path, bool value);
+void queueInt(const String& path, int value);
+void queueFloat(const String& path, float value);
+void queueTimestamp(const String& path);
+bool isWritePending(const String& path);
+void flushRTDBWrites();
 void resetWiFiSettings();
 void printStatus();
 void testAllPins();
@@ -157,6 +213,7 @@ void setup() {
   
   setupPins();
   setupSensors();
+  setupTasks();
   setupWiFiManager();
   
   if (wifiConnected) {
@@ -181,13 +238,30 @@ void setup() {
 void loop() {
   // **STANDALONE OPERATION - No Serial dependency**
   
-  // Handle physical inputs immediately (no delay)
-  handlePhysicalInputs();
-  
-  // Handle periodic tasks (sensor readings, status updates)
-  handlePeriodicTasks();
+  // Inputs, Firebase, sensors and status all run as scheduler tasks
+  scheduler.runDue();
   
-  // **PRIORITY: Firebase operations for web control - check every cycle**
+  // Sleep until the next task is due instead of a fixed delay(10); an input
+  // interrupt ends the sleep early
+  if (scheduler.idle() && inputs.pending()) {
+    scheduler.runNow(inputs_task);
+  }
+}
+
+void setupTasks() {
+  scheduler.begin();
+  inputs_task = scheduler.once("inputs", handlePhysicalInputs);  // armed by input interrupts
+  // **PRIORITY: Firebase operations for web control**
+  scheduler.every("firebase", firebase_service_interval, serviceFirebase);
+  scheduler.every("sensors", sensor_update_interval, readSensorData, sensor_update_interval);
+  scheduler.every("upload", sensor_update_interval, uploadSensorData);
+  scheduler.every("online", online_status_interval, uploadOnlineStatus);
+  scheduler.every("console", input_status_interval, printInputStatus, input_status_interval);
+  scheduler.every("serial", serial_poll_interval, handleSerialCommands);
+  flush_task = scheduler.once("flush", flushRTDBWrites);  // armed by queueWrite()
+}
+
+void serviceFirebase() {
   static unsigned long lastWiFiRetry = 0;
   static bool tryingWiFi = false;
   if (wifiConnected && signupOK) {
@@ -205,9 +279,6 @@ void loop() {
       setupFirebase();
     }
   }
-  
-  // **Minimal delay for stability - no Serial blocking**
-  delay(10); // Reduced from 50ms for faster response
 }
 
 void setupPins() {
@@ -222,6 +293,8 @@ void setupPins() {
   pinMode(INPUT_PIN_2, INPUT);
   pinMode(INPUT_PIN_3, INPUT);
   pinMode(INPUT_PIN_4, INPUT);
+  inputs.begin(input_pins, 4, debounce_delay, onInputPress);
+  inputs.setWakeHook(onInputEdge);
   
   // Status LED
   pinMode(STATUS_LED, OUTPUT);
@@ -322,73 +395,21 @@ void setupFirebase() {
 }
 
 void handlePhysicalInputs() {
-  // Handle Input 1
-  bool reading1 = digitalRead(INPUT_PIN_1);
-  if (reading1 != last_button_state1) {
-    last_debounce_time1 = millis();
-  }
-  if ((millis() - last_debounce_time1) > debounce_delay) {
-    if (reading1 != button1_state_debounced) {
-      button1_state_debounced = reading1;
-      if (button1_state_debounced == LOW) {
-        relay1_State = !relay1_State;
-        setRelayState(1, relay1_State);
-        Serial.printf("Input 1 Toggled! Relay 1 is now: %s\n", relay1_State ? "ON" : "OFF");
-      }
-    }
-  }
-  last_button_state1 = reading1;
-
-  // Handle Input 2
-  bool reading2 = digitalRead(INPUT_PIN_2);
-  if (reading2 != last_button_state2) {
-    last_debounce_time2 = millis();
-  }
-  if ((millis() - last_debounce_time2) > debounce_delay) {
-    if (reading2 != button2_state_debounced) {
-      button2_state_debounced = reading2;
-      if (button2_state_debounced == LOW) {
-        relay2_State = !relay2_State;
-        setRelayState(2, relay2_State);
-        Serial.printf("Input 2 Toggled! Relay 2 is now: %s\n", relay2_State ? "ON" : "OFF");
-      }
-    }
-  }
-  last_button_state2 = reading2;
+  // Handle queued edges; poll again when a debounce window closes
+  uint32_t wait = inputs.poll();
+  if (wait) scheduler.runIn(inputs_task, wait);
+}
 
-  // Handle Input 3
-  bool reading3 = digitalRead(INPUT_PIN_3);
-  if (reading3 != last_button_state3) {
-    last_debounce_time3 = millis();
-  }
-  if ((millis() - last_debounce_time3) > debounce_delay) {
-    if (reading3 != button3_state_debounced) {
-      button3_state_debounced = reading3;
-      if (button3_state_debounced == LOW) {
-        relay3_State = !relay3_State;
-        setRelayState(3, relay3_State);
-        Serial.printf("Input 3 Toggled! Relay 3 is now: %s\n", relay3_State ? "ON" : "OFF");
-      }
-    }
-  }
-  last_button_state3 = reading3;
+void onInputPress(int index) {
+  int relayNum = index + 1;
+  bool state = !getRelayState(relayNum);
+  setRelayState(relayNum, state);
+  Serial.printf("Input %d Toggled! Relay %d is now: %s\n", relayNum, relayNum, state ? "ON" : "OFF");
+}
 
-  // Handle Input 4
-  bool reading4 = digitalRead(INPUT_PIN_4);
-  if (reading4 != last_button_state4) {
-    last_debounce_time4 = millis();
-  }
-  if ((millis() - last_debounce_time4) > debounce_delay) {
-    if (reading4 != button4_state_debounced) {
-      button4_state_debounced = reading4;
-      if (button4_state_debounced == LOW) {
-        relay4_State = !relay4_State;
-        setRelayState(4, relay4_State);
-        Serial.printf("Input 4 Toggled! Relay 4 is now: %s\n", relay4_State ? "ON" : "OFF");
-      }
-    }
-  }
-  last_button_state4 = reading4;
+// ISR context: only end the idle sleep
+void IRAM_ATTR onInputEdge() {
+  scheduler.wakeFromISR();
 }
 
 void handleSerialCommands() {
@@ -417,30 +438,19 @@ void handleSerialCommands() {
   }
 }
 
-void handlePeriodicTasks() {
-  unsigned long current_time = millis();
-
-  // Update input status every 10 seconds with WiFi signal strength
-  if (current_time - last_status_update_time >= 10000) {
-    last_status_update_time = current_time;
-    if (wifiConnected) {
-      int rssi = WiFi.RSSI();
-      Serial.printf("Inputs: 1:%d, 2:%d, 3:%d, 4:%d | WiFi:%ddBm | Firebase:%s\n",
-                    digitalRead(INPUT_PIN_1),
-                    digitalRead(INPUT_PIN_2),
-                    digitalRead(INPUT_PIN_3),
-                    digitalRead(INPUT_PIN_4),
-                    rssi,
-                    signupOK ? "OK" : "FAIL");
-    } else {
-      Serial.println("Inputs: 1:1, 2:1, 3:1, 4:1 | WiFi:OFFLINE");
-    }
-  }
-
-  // Update sensor data
-  if (current_time - last_sensor_update_time >= sensor_update_interval) {
-    last_sensor_update_time = current_time;
-    readSensorData();
+// Input status every 10 seconds with WiFi signal strength
+void printInputStatus() {
+  if (wifiConnected) {
+    int rssi = WiFi.RSSI();
+    Serial.printf("Inputs: 1:%d, 2:%d, 3:%d, 4:%d | WiFi:%ddBm | Firebase:%s\n",
+                  digitalRead(INPUT_PIN_1),
+                  digitalRead(INPUT_PIN_2),
+                  digitalRead(INPUT_PIN_3),
+                  digitalRead(INPUT_PIN_4),
+                  rssi,
+                  signupOK ? "OK" : "FAIL");
+  } else {
+    Serial.println("Inputs: 1:1, 2:1, 3:1, 4:1 | WiFi:OFFLINE");
   }
 }
 
@@ -459,31 +469,22 @@ void handleFirebaseOperations() {
   // Register device first time
   registerDeviceInFirebase();
 
-  // **CRITICAL: Check for remote commands every 25ms for instant response**
-  static unsigned long lastCommandCheck = 0;
-  if (millis() - lastCommandCheck >= 25) {
-    lastCommandCheck = millis();
-    checkFirebaseRelayControls();
-  }
+  // **CRITICAL: Remote commands are pushed over the stream - no polling**
+  serviceRelayStream();
+}
 
-  // Send sensor data every 5 seconds
-  if (millis() - dataMillis > 5000 || dataMillis == 0) {
-    dataMillis = millis();
-    sendSensorDataToFirebase();
-  }
-  
-  // Update online status every 30 seconds
-  if (millis() - statusMillis > 30000 || statusMillis == 0) {
-    statusMillis = millis();
-    updateOnlineStatus();
-  }
-  
-  // Check for relay control commands every 50ms (faster response without Serial Monitor)
-  static unsigned long lastRelayCheck = 0;
-  if (millis() - lastRelayCheck > 50 || lastRelayCheck == 0) {
-    lastRelayCheck = millis();
-    checkFirebaseRelayControls();
-  }
+bool firebaseReady() {
+  return wifiConnected && signupOK && Firebase.ready();
+}
+
+// Send sensor data every 5 seconds
+void uploadSensorData() {
+  if (firebaseReady()) sendSensorDataToFirebase();
+}
+
+// Update online status every 30 seconds
+void uploadOnlineStatus() {
+  if (firebaseReady()) updateOnlineStatus();
 }
 
 void readSensorData() {
@@ -536,47 +537,44 @@ void sendSensorDataToFirebase() {
   String tempPath = "/deviceData/" + String(USER_UID) + "/" + DEVICE_SN + "_temp";
   String humPath = "/deviceData/" + String(USER_UID) + "/" + DEVICE_SN + "_humidity";
   
-  if (Firebase.RTDB.setFloat(&fbdo, tempPath + "/value", temperature)) {
-    Firebase.RTDB.setInt(&fbdo, tempPath + "/timestamp", millis());
-    Serial.printf("📊 Temperature sent: %.2f°C\n", temperature);
-  }
-  
-  if (Firebase.RTDB.setFloat(&fbdo, humPath + "/value", humidity)) {
-    Firebase.RTDB.setInt(&fbdo, humPath + "/timestamp", millis());
-    Serial.printf("📊 Humidity sent: %.2f%%\n", humidity);
-  }
+  // Epoch ms from the server, like the relay paths: set when the batched
+  // write lands, normally write_flush_interval after the reading
+  queueFloat(tempPath + "/value", temperature);
+  queueTimestamp(tempPath + "/timestamp");
+  queueFloat(humPath + "/value", humidity);
+  queueTimestamp(humPath + "/timestamp");
+  Serial.printf("📊 Sensor data queued: %.2f°C, %.2f%%\n", temperature, humidity);
 }
 
 void sendRelayStateToFirebase(int relayNum, bool state) {
   String deviceKey = DEVICE_SN + "_relay" + String(relayNum);
   String relayPath = "/deviceData/" + String(USER_UID) + "/" + deviceKey;
   
-  if (Firebase.RTDB.setBool(&fbdo, relayPath + "/value", state)) {
-    // Use Firebase server timestamp for accurate time
-    Firebase.RTDB.setTimestamp(&fbdo, relayPath + "/timestamp");
-    Serial.printf("🔄 Relay %d state sent to Firebase: %s\n", relayNum, state ? "ON" : "OFF");
-  }
+  queueBool(relayPath + "/value", state);
+  // Use Firebase server timestamp for accurate time
+  queueTimestamp(relayPath + "/timestamp");
+  Serial.printf("🔄 Relay %d state queued for Firebase: %s\n", relayNum, state ? "ON" : "OFF");
 }
 
 void updateOnlineStatus() {
+  // Set online status based on WiFi connection
+  bool isOnline = WiFi.status() == WL_CONNECTED && Firebase.ready();
+  
   // Update online status and last seen timestamp for each relay device
   for (int i = 1; i <= 4; i++) {
     String deviceKey = DEVICE_SN + "_relay" + String(i);
-    String statusPath = "/devices/" + String(USER_UID) + "/" + deviceKey + "/online";
-    String lastSeenPath = "/devices/" + String(USER_UID) + "/" + deviceKey + "/lastSeen";
+    String devicePath = "/devices/" + String(USER_UID) + "/" + deviceKey;
     
-    // Set online status based on WiFi connection
-    bool isOnline = WiFi.status() == WL_CONNECTED && Firebase.ready();
-    Firebase.RTDB.setBool(&fbdo, statusPath, isOnline);
+    queueBool(devicePath + "/online", isOnline);
     
     // Update timestamp only if online
     if (isOnline) {
-      Firebase.RTDB.setTimestamp(&fbdo, lastSeenPath);
+      queueTimestamp(devicePath + "/lastSeen");
     }
   }
   
-  if (WiFi.status() == WL_CONNECTED && Firebase.ready()) {
-    Serial.println("💚 Online status updated for all relays");
+  if (isOnline) {
+    Serial.println("💚 Online status queued for all relays");
   } else {
     Serial.println("❌ Offline - status not updated");
   }
@@ -584,14 +582,95 @@ void updateOnlineStatus() {
 
 void setAllDevicesOffline() {
   // Set all devices to offline status when WiFi disconnects
+  if (!Firebase.ready()) return;
+  
   for (int i = 1; i <= 4; i++) {
     String deviceKey = DEVICE_SN + "_relay" + String(i);
-    String statusPath = "/devices/" + String(USER_UID) + "/" + deviceKey + "/online";
-    
-    if (Firebase.ready()) {
-      Firebase.RTDB.setBool(&fbdo, statusPath, false);
+    queueBool("/devices/" + String(USER_UID) + "/" + deviceKey + "/online", false);
+  }
+}
+
+PendingWrite* queueWrite(const String& path, WriteKind kind) {
+  // Coalesce: a newer value for a queued path replaces the old one
+  for (int i = 0; i < pending_write_count; i++) {
+    if (pending_writes[i].path == path) {
+      pending_writes[i].kind = kind;
+      writes_coalesced++;
+      return &pending_writes[i];
     }
   }
+  if (pending_write_count >= max_pending_writes) {
+    Serial.printf("⚠️ Write queue full - dropping %s\n", path.c_str());
+    return nullptr;
+  }
+  PendingWrite* write = &pending_writes[pending_write_count++];
+  write->path = path;  // reuses the slot's buffer once it has grown
+  write->kind = kind;
+  // Everything queued within the window goes out in one request
+  if (!scheduler.armed(flush_task)) scheduler.runIn(flush_task, write_flush_interval);
+  return write;
+}
+
+void queueBool(const String& path, bool value) {
+  PendingWrite* write = queueWrite(path, WRITE_BOOL);
+  if (write) write->boolValue = value;
+}
+
+void queueInt(const String& path, int value) {
+  PendingWrite* write = queueWrite(path, WRITE_INT);
+  if (write) write->intValue = value;
+}
+
+void queueFloat(const String& path, float value) {
+  PendingWrite* write = queueWrite(path, WRITE_FLOAT);
+  if (write) write->floatValue = value;
+}
+
+void queueTimestamp(const String& path) {
+  queueWrite(path, WRITE_TIMESTAMP);
+}
+
+bool isWritePending(const String& path) {
+  for (int i = 0; i < pending_write_count; i++) {
+    if (pending_writes[i].path == path) return true;
+  }
+  return false;
+}
+
+void flushRTDBWrites() {
+  if (pending_write_count == 0) return;
+  if (!firebaseReady()) {
+    scheduler.runIn(flush_task, write_backoff_min);
+    return;
+  }
+  
+  // Multi-path update: keys are full paths (without the leading '/'), so
+  // each location is set on its own and its siblings are left alone
+  FirebaseJson batch;
+  FirebaseJson serverTimestamp;
+  serverTimestamp.set(".sv", "timestamp");
+  for (int i = 0; i < pending_write_count; i++) {
+    const PendingWrite& write = pending_writes[i];
+    String key = write.path.substring(1);
+    switch (write.kind) {
+      case WRITE_BOOL: batch.add(key, write.boolValue); break;
+      case WRITE_INT: batch.add(key, write.intValue); break;
+      case WRITE_FLOAT: batch.add(key, write.floatValue); break;
+      case WRITE_TIMESTAMP: batch.add(key, serverTimestamp); break;
+    }
+  }
+  
+  if (Firebase.RTDB.updateNodeSilent(&fbdo, "/", &batch)) {
+    write_flushes++;
+    pending_write_count = 0;
+    write_backoff = 0;
+  } else {
+    write_flush_failures++;
+    write_backoff = write_backoff ? min(write_backoff * 2, write_backoff_max) : write_backoff_min;
+    scheduler.runIn(flush_task, write_backoff);
+    Serial.printf("✗ Firebase write failed (%s) - %d paths kept, retry in %lums\n",
+                  fbdo.errorReason().c_str(), pending_write_count, write_backoff);
+  }
 }
 
 void registerDeviceInFirebase() {
@@ -616,35 +695,126 @@ void checkFirebaseRelayControls() {
     return;
   }
   
-  // Throttle Firebase checks to reduce latency (check every 50ms for faster response)
-  static unsigned long lastFirebaseCheck = 0;
-  if (millis() - lastFirebaseCheck < 50) {
+  // One read of the whole subtree instead of a getBool per relay; the result
+  // looks like the stream's initial put, so it goes through the same path.
+  String devicePath = "/deviceData/" + String(USER_UID);
+  if (Firebase.RTDB.getJSON(&fbdo, devicePath)) {
+    if (pending_write_count) scheduler.runNow(flush_task);  // server is reachable again - flush queued writes now
+    applyRelayData(fbdo, "/", true);
+  }
+}
+
+void beginRelayStream() {
+  String devicePath = "/deviceData/" + String(USER_UID);
+  
+  if (Firebase.RTDB.beginStream(&stream, devicePath)) {
+    relay_stream_open = true;
+    relay_stream_backoff = relay_stream_backoff_min;
+    if (pending_write_count) scheduler.runNow(flush_task);  // server is reachable again - flush queued writes now
+    Serial.printf("📡 Relay stream open: %s\n", devicePath.c_str());
+  } else {
+    relay_stream_backoff = relay_stream_backoff ? min(relay_stream_backoff * 2, relay_stream_backoff_max) : relay_stream_backoff_min;
+    relay_stream_retry_at = millis() + relay_stream_backoff;
+    Serial.printf("✗ Relay stream failed (%s) - retry in %lus\n",
+                  stream.errorReason().c_str(), relay_stream_backoff / 1000);
+  }
+}
+
+void serviceRelayStream() {
+  if (!relay_stream_open) {
+    if ((long)(millis() - relay_stream_retry_at) >= 0) {
+      beginRelayStream();
+    }
+    // Bounded fallback polling while the stream is down
+    if (!relay_stream_open && millis() - last_relay_poll >= relay_poll_interval) {
+      last_relay_poll = millis();
+      checkFirebaseRelayControls();
+    }
     return;
   }
-  lastFirebaseCheck = millis();
   
-  // Check for remote relay commands from web dashboard
-  for (int i = 1; i <= 4; i++) {
-    String deviceKey = DEVICE_SN + "_relay" + String(i);
-    String relayPath = "/deviceData/" + String(USER_UID) + "/" + deviceKey + "/value";
+  // readStream() only checks the already open connection - it doesn't block
+  if (!Firebase.RTDB.readStream(&stream) || stream.streamTimeout()) {
+    relay_stream_open = false;
+    relay_stream_drops++;
+    relay_stream_retry_at = millis() + relay_stream_backoff;
+    last_relay_poll = millis() - relay_poll_interval;  // poll right away, then every interval
+    Serial.printf("⚠️ Relay stream lost (%s) - polling every %lums\n",
+                  stream.errorReason().c_str(), relay_poll_interval);
+    return;
+  }
+  
+  if (stream.streamAvailable()) {
+    relay_stream_events++;
+    // A put at "/" is the whole subtree: the first event after (re)connecting
+    bool snapshot = stream.eventType() == "put" && stream.dataPath() == "/";
+    applyRelayData(stream, stream.dataPath(), snapshot);
+  }
+}
+
+void applyRelayData(FirebaseData& data, const String& eventPath, bool snapshot) {
+  // Event path is relative to /deviceData/<uid>: "/" for the initial put or a
+  // patch, "/<SN>_relayN" or "/<SN>_relayN/value" for a single write
+  String basePath = eventPath;
+  if (basePath.endsWith("/")) basePath.remove(basePath.length() - 1);
+  
+  String type = data.dataType();
+  if (type == "boolean") {
+    applyRemoteRelay(basePath, data.boolData(), snapshot);
+    return;
+  }
+  if (type != "json") return;
+  
+  // Walk the tree once and rebuild each leaf's full path from the keys above
+  // it. Patch keys may already contain '/', which joins the same way.
+  const int max_depth = 4;
+  String keys[max_depth];
+  FirebaseJson* json = data.jsonObjectPtr();
+  size_t count = json->iteratorBegin();
+  for (size_t i = 0; i < count; i++) {
+    FirebaseJson::IteratorValue item = json->valueAt(i);
+    if (item.depth >= max_depth) continue;
+    keys[item.depth] = item.key;
+    if (item.type != FirebaseJson::JSON_BOOL) continue;
     
-    if (Firebase.RTDB.getBool(&fbdo, relayPath)) {
-      bool remoteState = fbdo.boolData();
-      bool currentState = false;
-      
-      switch (i) {
-        case 1: currentState = relay1_State; break;
-        case 2: currentState = relay2_State; break;
-        case 3: currentState = relay3_State; break;
-        case 4: currentState = relay4_State; break;
-      }
-      
-      if (remoteState != currentState) {
-        setRelayState(i, remoteState);
-        Serial.printf("🌐 Remote command: Relay %d -> %s\n", i, remoteState ? "ON" : "OFF");
-      }
+    String path = basePath;
+    for (int d = 0; d <= item.depth; d++) {
+      path += "/";
+      path += keys[d];
     }
+    applyRemoteRelay(path, item.value == "true", snapshot);
+  }
+  json->iteratorEnd();
+}
+
+void applyRemoteRelay(const String& path, bool state, bool snapshot) {
+  // Only "/<SN>_relayN/value" with N in 1..4 controls a relay
+  String prefix = "/" + DEVICE_SN + "_relay";
+  if (path.length() != prefix.length() + 7) return;
+  if (!path.startsWith(prefix) || !path.endsWith("/value")) return;
+  
+  int relayNum = path[prefix.length()] - '0';
+  if (relayNum < 1 || relayNum > 4) return;
+  
+  // A snapshot can predate a local change that is still queued (a press
+  // while offline); the queued value wins and overwrites it on the next flush
+  if (snapshot && isWritePending("/deviceData/" + String(USER_UID) + path)) return;
+  
+  // Echoes of our own writes match the current state and are ignored
+  if (state != getRelayState(relayNum)) {
+    setRelayState(relayNum, state);
+    Serial.printf("🌐 Remote command: Relay %d -> %s\n", relayNum, state ? "ON" : "OFF");
+  }
+}
+
+bool getRelayState(int relayNum) {
+  switch (relayNum) {
+    case 1: return relay1_State;
+    case 2: return relay2_State;
+    case 3: return relay3_State;
+    case 4: return relay4_State;
   }
+  return false;
 }
 
 void resetWiFiSettings() {
@@ -662,6 +832,10 @@ void printStatus() {
   }
   Serial.println();
   Serial.printf("Firebase: %s\n", signupOK ? "Connected" : "Disconnected");
+  Serial.printf("Relay stream: %s (events=%u, drops=%u)\n",
+                relay_stream_open ? "Open" : "Polling", relay_stream_events, relay_stream_drops);
+  Serial.printf("Write queue: %d pending (flushes=%u, failed=%u, coalesced=%u)\n",
+                pending_write_count, write_flushes, write_flush_failures, writes_coalesced);
   Serial.printf("Relays: 1:%s, 2:%s, 3:%s, 4:%s\n",
                 relay1_State ? "ON" : "OFF",
                 relay2_State ? "ON" : "OFF",
@@ -673,6 +847,8 @@ void printStatus() {
                 digitalRead(INPUT_PIN_3) ? "HIGH" : "LOW",
                 digitalRead(INPUT_PIN_4) ? "HIGH" : "LOW");
   Serial.printf("Sensors: Temp=%.1f°C, Humidity=%.1f%%\n", temperature, humidity);
+  inputs.printStats(Serial);
+  scheduler.printStats(Serial);
   Serial.println("=====================");
 }
 
@@ -12,11 +12,21 @@
 */
 
 #include <WiFi.h>
+#include <WiFiUdp.h>
 #include <WiFiManager.h>
 #include <PubSubClient.h>
 #include <DHT.h>
 #include <ArduinoJson.h>
 #include <esp_task_wdt.h>
+#include <lwip/sockets.h>
+#include <TaskWheel.h>
+#include <EdgeInput.h>
+#include <Outbox.h>
+#include <DeadBand.h>
+#include <SampleBatch.h>
+#include <PayloadCodec.h>
+#include <WallClock.h>
+#include <JsonArena.h>
 
 // --- MQTT Configuration ---
 const char* mqtt_server = "192.168.1.28";  // แก้เป็น IP ของคอมพิวเตอร์
@@ -24,6 +34,9 @@ const int mqtt_port = 1883;
 const char* mqtt_user = "";                 // ว่างไว้ หาก Broker ไม่ต้องการ auth
 const char* mqtt_pass = "";                 // ว่างไว้ หาก Broker ไม่ต้องการ auth
 
+// --- Time Configuration ---
+const char* ntp_server = "pool.ntp.org";    // หรือ IP ของ NTP server ในวง LAN
+
 // Device ID will be auto-generated from MAC Address
 String DEVICE_ID = "";
 String DEVICE_NAME = "s";
@@ -56,53 +69,207 @@ bool relay2_State = LOW;
 bool relay3_State = LOW;
 bool relay4_State = LOW;
 
-// Button debouncing
-long last_debounce_time[4] = {0, 0, 0, 0};
-bool last_button_state[4] = {HIGH, HIGH, HIGH, HIGH};
-bool button_state_debounced[4] = {HIGH, HIGH, HIGH, HIGH};
+// Buttons: edges are timestamped by interrupt and debounced in task context
+EdgeInput buttons;
+const uint8_t input_pins[4] = {INPUT_PIN_1, INPUT_PIN_2, INPUT_PIN_3, INPUT_PIN_4};
 const long debounce_delay = 50;
 
-// Timing variables
-unsigned long last_status_update = 0;
-unsigned long last_sensor_update = 0;
-unsigned long last_heartbeat = 0;
-const long status_interval = 2000;      // ส่งสถานะทุก 2 วินาที
-const long sensor_interval = 5000;      // ส่งข้อมูล sensor ทุก 5 วินาที
+// Timing variables (งานทั้งหมดรันผ่าน scheduler แทนการเช็ค millis() ใน loop)
+TaskWheel scheduler;
+int buttons_task = -1;
+int mqtt_task = -1;
+int status_task = -1;
+int sensor_task = -1;
+int heartbeat_task = -1;
+int outbox_task = -1;
+int clock_task = -1;
+int console_task = -1;
+const long mqtt_service_interval = 1000;      // PubSubClient keep-alive; ข้อมูลเข้าปลุก loop เอง
+const uint16_t mqtt_loop_budget = 16;         // packets ต่อการเรียก loop() หนึ่งครั้ง (burst ของคำสั่ง)
+const long status_coalesce_window = 100;     // รวมการเปลี่ยนแปลงภายใน 100 ms เป็นข้อความเดียว
+const long status_keepalive_interval = 30000; // ส่งสถานะซ้ำทุก 30 วินาทีถ้าไม่มีอะไรเปลี่ยน
+const long sensor_interval = 2000;      // อ่าน sensor ทุก 2 วินาที (DHT22 อ่านได้เร็วสุด 0.5 Hz)
 const long heartbeat_interval = 30000;  // ส่ง heartbeat ทุก 30 วินาที
+const long console_poll_interval = 500;  // อ่านคำสั่งจาก Serial (STATS)
+
+// Sensor dead-bands: a reading goes out only when it moved past its band
+// since the value last sent, or after sensor_max_silence without one.
+// Each message carries just the channels that are due.
+DeadBand sensor_filter;
+int temperature_channel = -1;
+int humidity_channel = -1;
+int heat_index_channel = -1;
+const float temperature_band = 0.2;  // °C, DHT22 อ่านละเอียด 0.1 และแกว่ง ±0.1
+const float humidity_band = 1.0;     // %RH
+const float heat_index_band = 0.3;   // °C
+const uint32_t sensor_max_silence = 60000;  // ทุก channel ส่งอย่างน้อยนาทีละครั้ง
+
+// Sensor batches: samples that pass the dead-bands are collected with their
+// time and go out together once a channel holds sensor_batch_size samples
+// or the oldest is sensor_batch_age old. Six samples of each channel still
+// fit the body buffer and an outbox record.
+SampleBatch sensor_batch;
+const uint8_t sensor_batch_size = 6;
+const uint32_t sensor_batch_age = 30000;
+
+// MQTT 5: a reading the broker still holds for a subscriber after a minute
+// is stale, so it expires there instead of being delivered late
+const MqttProperties sensor_properties = {60, nullptr, 0};
+
+// Offline queue: publishes made while the broker is unreachable wait here
+// (RAM first, then sectors of the unused spiffs partition) and go out in
+// order after the reconnect, at most outbox_drain_rate per second
+Outbox outbox;
+const uint16_t outbox_drain_rate = 20;
+const uint16_t outbox_flash_sectors = 16;  // 64 KB ~ 6 ชั่วโมงของ sensor data
+
+// Outcome of publishPayload()
+enum PublishResult {
+  PUBLISH_SENT,
+  PUBLISH_QUEUED,  // offline or behind a backlog: held in the outbox
+  PUBLISH_FAILED
+};
+
+// Change-driven relay status: changes mark the status pending and one
+// message goes out once the coalescing window closes
+bool status_pending = false;
+unsigned long status_sent = 0;        // status messages published
+unsigned long status_keepalives = 0;  // of which were keep-alive snapshots
+unsigned long status_suppressed = 0;  // changes folded into a pending message
+unsigned long status_acked = 0;       // confirmed by the broker (QoS 1 PUBACK)
+unsigned long status_expired = 0;     // never acknowledged; a fresh snapshot was queued
+unsigned long mqtt_oversized = 0;     // messages larger than the MQTT buffer (streamed, not parsed)
+
+// MQTT reconnect state (loop() never waits on the broker)
+enum MqttLinkState {
+  MQTT_LINK_DOWN,  // not connected, next attempt at mqtt_retry_at
+  MQTT_LINK_UP     // connected and subscribed
+};
+MqttLinkState mqtt_link_state = MQTT_LINK_DOWN;
+unsigned long mqtt_retry_at = 0;
+unsigned long mqtt_backoff_ms = 0;
+const unsigned long mqtt_backoff_min = 1000;   // retry ครั้งแรกหลัง ~1 วินาที
+const unsigned long mqtt_backoff_max = 60000;  // รอไม่เกิน 60 วินาที
+unsigned long mqtt_down_since = 0;
+unsigned long last_led_toggle = 0;
+const long led_blink_interval = 100;           // กระพริบ LED ระหว่าง offline
+
+// MQTT connection statistics (reported in heartbeat)
+unsigned long mqtt_connect_attempts = 0;
+unsigned long mqtt_connect_failures = 0;
+unsigned long mqtt_disconnects = 0;
+unsigned long mqtt_offline_ms = 0;             // total time spent disconnected
+unsigned long mqtt_longest_offline_ms = 0;
 
 // Sensor data
 float temperature = 0.0;
 float humidity = 0.0;
 float heat_index = 0.0;
 
+// One fixed arena serves every ArduinoJson document, so after boot no
+// command, sensor batch or template touches the heap. Each document is
+// cleared as soon as its message is handled, and the arena is empty again
+// (an O(1) reset) between messages. A command that publishes a batch holds
+// both at once: room for two variant pools (slots are two pointers wide)
+// plus strings.
+const size_t json_arena_size = 2 * ARDUINOJSON_POOL_CAPACITY * 2 * sizeof(void*) + 1024;
+
+StaticJsonArena<json_arena_size> json_arena;
+JsonDocument command_doc(&json_arena);
+JsonDocument batch_doc(&json_arena);
+
 // Network objects
 WiFiClient espClient;
 PubSubClient mqtt_client(espClient);
 WiFiManager wm;
+WiFiUDP ntp_udp;
+
+// Payload timestamps are epoch milliseconds from the SNTP-synced clock, so
+// queued and batched messages keep the time they were taken. Until the
+// first reply arrives (the first status after boot) they are millis()
+// uptime instead; anything below 10^12 is that and gets stamped on arrival.
+WallClock wall_clock;
+bool wall_clock_logged = false;
+
+// Payload codec: JSON by default, MessagePack when built with
+// -DPAYLOAD_FORMAT_MSGPACK. MessagePack telemetry goes to the same topics with
+// PAYLOAD_MSGPACK_SUFFIX appended; commands are accepted in either format.
+#ifdef PAYLOAD_FORMAT_MSGPACK
+PayloadFormat payload_format = PAYLOAD_MSGPACK;
+#else
+PayloadFormat payload_format = PAYLOAD_JSON;
+#endif
 
 // MQTT Topics
-String topic_command;    // esp32/{DEVICE_ID}/command
-String topic_status;     // esp32/{DEVICE_ID}/status
-String topic_data;       // esp32/{DEVICE_ID}/data
-String topic_heartbeat;  // esp32/{DEVICE_ID}/heartbeat
+String topic_command;          // esp32/{DEVICE_ID}/command
+String topic_command_msgpack;  // esp32/{DEVICE_ID}/command/msgpack
+String topic_status;           // esp32/{DEVICE_ID}/status[/msgpack]
+String topic_data;             // esp32/{DEVICE_ID}/data[/msgpack]
+String topic_heartbeat;        // esp32/{DEVICE_ID}/heartbeat[/msgpack]
+
+// Pre-rendered payloads: the fields that never change after setup() are
+// serialized once, and each publish only formats the changing middle part
+struct PayloadTemplate {
+  char head[128];  // {"type":...,"device_id":...,"device_name":... (MessagePack: map header, same fields)
+  size_t head_len;  // 0 = did not fit, publishPayload() refuses the template
+  char tail[96];   // static fields after the changing ones, closing brace (MessagePack: no brace)
+  size_t tail_len;
+};
+PayloadTemplate status_template;
+PayloadTemplate sensor_template;
+PayloadTemplate heartbeat_template;
 
 // Function declarations
 void setupPins();
 void setupSensors();
 void setupWiFiManager();
 void setupMQTT();
-void connectMQTT();
+void setupTopics();
+void setupPayloadTemplates();
+void setupTasks();
+bool buildPayloadTemplate(PayloadTemplate& tpl, const char* type, JsonDocument& trailer, uint8_t body_fields);
+template <size_t N>
+PublishResult publishPayload(const String& topic, const PayloadTemplate& tpl, const char (&body)[N], int body_len,
+                             bool supersede, uint8_t qos = 0, void (*on_ack)(uint16_t, boolean) = nullptr,
+                             const MqttProperties* properties = nullptr);
+void setupClock();
+void serviceClock();
+void setupOutbox();
+void serviceOutbox();
+bool sendQueued(const OutboxMessage& message);
+size_t mqttWritev(const MqttIovec* parts, uint8_t count);
+void serviceMQTT();
+bool attemptMQTTConnect();
+void onMQTTConnectFailed();
+void onMQTTConnected();
+void onMQTTDisconnected();
+unsigned long mqttOfflineMillis();
 void mqttCallback(char* topic, byte* payload, unsigned int length);
+void mqttChunkCallback(char* topic, byte* chunk, unsigned int length, uint32_t offset, uint32_t total);
 void publishStatus();
+void onStatusAck(uint16_t msg_id, boolean delivered);
+void queueStatus();
+void serviceStatus();
 void publishSensorData();
+void publishSensorSnapshot();
+void batchSensorChannels(uint32_t channels, uint32_t now);
+void publishSensorBatch();
 void publishHeartbeat();
-void handleRelayCommand(JsonObject& command);
-void handleSensorRequest();
+void sensorTask();
+void handleRelayCommand(JsonObject command);
+void handleRelaysCommand(JsonObject command);
+void handleStatusRequest(JsonObject command);
+void handleRestartCommand(JsonObject command);
+void handleSensorRequest(JsonObject command);
+bool parseRelayState(JsonVariant state);
 void readButtons();
+void onButtonPress(int index);
+void onButtonEdge();
 void updateRelays();
 void readSensors();
 void blinkStatusLED(int times, int delayMs = 200);
 void printSystemInfo();
+void serviceConsole();
 
 void setup() {
   Serial.begin(115200);
@@ -119,19 +286,20 @@ void setup() {
   Serial.println("   MAC: " + WiFi.macAddress());
   
   // Setup MQTT Topics
-  topic_command = "esp32/" + DEVICE_ID + "/command";
-  topic_status = "esp32/" + DEVICE_ID + "/status";
-  topic_data = "esp32/" + DEVICE_ID + "/data";
-  topic_heartbeat = "esp32/" + DEVICE_ID + "/heartbeat";
+  setupTopics();
   
   // Initialize components
   setupPins();
   setupSensors();
+  setupTasks();
   setupWiFiManager();
+  setupClock();
   setupMQTT();
+  setupOutbox();
+  setupPayloadTemplates();
   
   Serial.println("✅ ESP32 Setup Complete!");
-  Serial.println("📡 MQTT Topics:");
+  Serial.println("📡 MQTT Topics (" + String(payloadFormatName(payload_format)) + "):");
   Serial.println("   Command: " + topic_command);
   Serial.println("   Status: " + topic_status);
   Serial.println("   Data: " + topic_data);
@@ -141,40 +309,30 @@ void setup() {
 }
 
 void loop() {
-  // รักษาการเชื่อมต่อ MQTT
-  if (!mqtt_client.connected()) {
-    connectMQTT();
-  }
-  mqtt_client.loop();
-  
-  // อ่านปุ่มกด (Manual Control)
-  readButtons();
-  
-  // อัปเดต Relays
-  updateRelays();
-  
-  // ส่งสถานะ Relay
-  if (millis() - last_status_update > status_interval) {
-    publishStatus();
-    last_status_update = millis();
-  }
-  
-  // อ่านและส่งข้อมูล Sensor
-  if (millis() - last_sensor_update > sensor_interval) {
-    readSensors();
-    publishSensorData();
-    last_sensor_update = millis();
-  }
-  
-  // ส่ง Heartbeat
-  if (millis() - last_heartbeat > heartbeat_interval) {
-    publishHeartbeat();
-    last_heartbeat = millis();
-  }
+  // รันงานที่ถึงกำหนด: ปุ่ม, MQTT, สถานะ Relay, Sensor, Heartbeat
+  scheduler.runDue();
   
   // ป้องกัน Watchdog Reset
   esp_task_wdt_reset();
-  delay(10);
+  
+  // หลับจนกว่างานถัดไปถึงกำหนด หรือมีข้อมูลเข้ามาจาก broker
+  if (scheduler.idle(espClient.fd())) {
+    if (buttons.pending()) scheduler.runNow(buttons_task);
+    scheduler.runNow(mqtt_task);
+  }
+}
+
+void setupTasks() {
+  scheduler.begin();
+  buttons_task = scheduler.once("buttons", readButtons);  // armed by button interrupts
+  mqtt_task = scheduler.every("mqtt", led_blink_interval, serviceMQTT);
+  status_task = scheduler.once("status", serviceStatus);  // armed by queueStatus()/publishStatus()
+  sensor_task = scheduler.every("sensors", sensor_interval, sensorTask, sensor_interval);
+  heartbeat_task = scheduler.every("heartbeat", heartbeat_interval, publishHeartbeat, heartbeat_interval);
+  outbox_task = scheduler.once("outbox", serviceOutbox);  // armed on reconnect and while a backlog drains
+  clock_task = scheduler.once("clock", serviceClock);     // re-armed with whatever wait poll() asks for
+  console_task = scheduler.every("console", console_poll_interval, serviceConsole);
+  Serial.println("✅ Scheduler ready (" + String(scheduler.taskCount()) + " tasks)");
 }
 
 void setupPins() {
@@ -191,6 +349,8 @@ void setupPins() {
   pinMode(INPUT_PIN_2, INPUT_PULLUP);
   pinMode(INPUT_PIN_3, INPUT_PULLUP);
   pinMode(INPUT_PIN_4, INPUT_PULLUP);
+  buttons.begin(input_pins, 4, debounce_delay, onButtonPress);
+  buttons.setWakeHook(onButtonEdge);
   
   // Setup Status LED
   pinMode(STATUS_LED, OUTPUT);
@@ -206,8 +366,18 @@ void setupPins() {
 
 void setupSensors() {
   Serial.println("🌡️ Initializing DHT22 sensor...");
+  // No settle delay: on the ESP32 the driver captures frames with the RMT
+  // receiver in the background, and the first sensor task runs after
+  // sensor_interval, well past the DHT22's 1-2 s power-up.
   dht.begin();
-  delay(2000); // DHT22 needs time to stabilize
+  temperature_channel = sensor_filter.addChannel("temperature", temperature_band);
+  humidity_channel = sensor_filter.addChannel("humidity", humidity_band);
+  heat_index_channel = sensor_filter.addChannel("heat_index", heat_index_band);
+  sensor_filter.setMaxSilence(sensor_max_silence);
+  for (int i = 0; i < sensor_filter.channelCount(); i++) {
+    sensor_batch.addChannel(sensor_filter.name(i));  // same indices as the filter
+  }
+  sensor_batch.setLimits(sensor_batch_size, sensor_batch_age);
   Serial.println("✅ DHT22 sensor ready");
 }
 
@@ -234,168 +404,337 @@ void setupMQTT() {
   Serial.println("📡 Setting up MQTT...");
   mqtt_client.setServer(mqtt_server, mqtt_port);
   mqtt_client.setCallback(mqttCallback);
+  mqtt_client.setChunkCallback(mqttChunkCallback);
   mqtt_client.setKeepAlive(60);
-  mqtt_client.setSocketTimeout(30);
+  // The reconnect never waits for CONNACK (beginConnect()/pollConnect()), but
+  // the TCP connect and a packet cut off mid-read still block the loop; keep
+  // both to about a second so a half-up broker cannot freeze the wall switches.
+  espClient.setTimeout(1);
+  mqtt_client.setSocketTimeout(1);
+  // relay_status goes out at QoS 1 and is resent until the broker confirms it
+  mqtt_client.setRetryInterval(2000);
+  mqtt_client.setLoopBudget(mqtt_loop_budget);
+  // header, topic และ payload ออกไปใน writev ครั้งเดียว ไม่ต้อง copy รวมกันก่อน
+  mqtt_client.setWritev(mqttWritev);
+  // MQTT 5: topics go by alias after the first publish on each connection;
+  // attemptMQTTConnect() falls back to 3.1.1 for an older broker
+  mqtt_client.setProtocolVersion(MQTT_VERSION_5);
+  mqtt_down_since = millis();
   
   Serial.println("✅ MQTT configured");
   Serial.println("   Server: " + String(mqtt_server));
   Serial.println("   Port: " + String(mqtt_port));
 }
 
-void connectMQTT() {
-  while (!mqtt_client.connected()) {
-    Serial.println("🔗 Connecting to MQTT Broker...");
-    
-    String clientId = DEVICE_ID + "_" + String(random(0xffff), HEX);
-    
-    if (mqtt_client.connect(clientId.c_str(), mqtt_user, mqtt_pass)) {
-      Serial.println("✅ MQTT Connected! Client ID: " + clientId);
-      
-      // Subscribe to command topic
-      mqtt_client.subscribe(topic_command.c_str());
-      Serial.println("📨 Subscribed to: " + topic_command);
-      
-      // Publish initial status
-      publishHeartbeat();
-      publishStatus();
-      
-      digitalWrite(STATUS_LED, HIGH);
-    } else {
-      Serial.print("❌ MQTT Connection failed, rc=");
-      Serial.print(mqtt_client.state());
-      Serial.println(" retrying in 5 seconds");
-      
-      blinkStatusLED(5, 100);
-      delay(5000);
+// Telemetry topics carry the payload format marker
+void setupTopics() {
+  const char* suffix = payloadTopicSuffix(payload_format);
+  topic_command = "esp32/" + DEVICE_ID + "/command";
+  topic_command_msgpack = topic_command + PAYLOAD_MSGPACK_SUFFIX;
+  topic_status = "esp32/" + DEVICE_ID + "/status" + suffix;
+  topic_data = "esp32/" + DEVICE_ID + "/data" + suffix;
+  topic_heartbeat = "esp32/" + DEVICE_ID + "/heartbeat" + suffix;
+}
+
+void serviceMQTT() {
+  unsigned long now = millis();
+
+  if (mqtt_client.connected()) {
+    mqtt_client.loop();  // drains up to mqtt_loop_budget buffered packets
+    if (mqtt_client.lastLoopPackets() >= mqtt_loop_budget) {
+      scheduler.runNow(mqtt_task);  // more waiting: come back after the other due tasks
     }
+    return;
+  }
+
+  if (mqtt_link_state == MQTT_LINK_UP) {
+    onMQTTDisconnected();
+  }
+
+  // กระพริบ LED ระหว่างรอเชื่อมต่อ (ไม่ block)
+  if (now - last_led_toggle >= led_blink_interval) {
+    last_led_toggle = now;
+    digitalWrite(STATUS_LED, !digitalRead(STATUS_LED));
+  }
+
+  if (!mqtt_client.connecting()) {
+    if ((long)(now - mqtt_retry_at) < 0) {
+      return;
+    }
+    if (!attemptMQTTConnect()) {
+      onMQTTConnectFailed();
+      return;
+    }
+  }
+
+  // CONNECT is out; the CONNACK wakes this task through the socket, so this
+  // only checks and never waits on the broker
+  if (mqtt_client.pollConnect()) {
+    Serial.println("✅ MQTT Connected! (MQTT " +
+                   String(mqtt_client.getProtocolVersion() == MQTT_VERSION_5 ? "5" : "3.1.1") + ")");
+    onMQTTConnected();
+    return;
+  }
+  if (!mqtt_client.connecting()) {
+    onMQTTConnectFailed();
+  }
+}
+
+// Opens the socket and sends CONNECT; serviceMQTT() picks up the answer
+bool attemptMQTTConnect() {
+  Serial.println("🔗 Connecting to MQTT Broker...");
+  mqtt_connect_attempts++;
+
+  String clientId = DEVICE_ID + "_" + String(random(0xffff), HEX);
+  Serial.println("   Client ID: " + clientId);
+  return mqtt_client.beginConnect(clientId.c_str(), mqtt_user, mqtt_pass);
+}
+
+void onMQTTConnectFailed() {
+  mqtt_connect_failures++;
+  if (mqtt_client.state() == MQTT_CONNECT_BAD_PROTOCOL && mqtt_client.getProtocolVersion() == MQTT_VERSION_5) {
+    Serial.println("⚠️ Broker does not speak MQTT 5, using 3.1.1");
+    mqtt_client.setProtocolVersion(MQTT_VERSION_3_1_1);
+  }
+
+  // Exponential backoff with equal jitter: wait between half and all of the
+  // current window so a fleet that lost the broker together does not come
+  // back in lock-step.
+  mqtt_backoff_ms = mqtt_backoff_ms ? min(mqtt_backoff_ms * 2, mqtt_backoff_max) : mqtt_backoff_min;
+  unsigned long wait = mqtt_backoff_ms / 2 + random(mqtt_backoff_ms / 2 + 1);
+  mqtt_retry_at = millis() + wait;
+
+  Serial.print("❌ MQTT Connection failed, rc=");
+  Serial.print(mqtt_client.state());
+  Serial.println(" retrying in " + String(wait) + " ms");
+}
+
+void onMQTTConnected() {
+  unsigned long offline = millis() - mqtt_down_since;
+  mqtt_offline_ms += offline;
+  if (offline > mqtt_longest_offline_ms) {
+    mqtt_longest_offline_ms = offline;
   }
+  mqtt_link_state = MQTT_LINK_UP;
+  mqtt_backoff_ms = 0;
+  scheduler.setPeriod(mqtt_task, mqtt_service_interval);
+
+  // Subscribe to command topics (JSON and MessagePack)
+  mqtt_client.subscribe(topic_command.c_str());
+  mqtt_client.subscribe(topic_command_msgpack.c_str());
+  Serial.println("📨 Subscribed to: " + topic_command + " (+" + PAYLOAD_MSGPACK_SUFFIX + ")");
+
+  // The network is back: a clock still waiting out its retry backoff tries now
+  if (!wall_clock.synced()) {
+    wall_clock.resync();
+    scheduler.runNow(clock_task);
+  }
+
+  // Publish initial status
+  publishHeartbeat();
+  publishStatus();
+  if (!outbox.empty()) {
+    Serial.println("📤 Sending " + String(outbox.size()) + " queued messages");
+    scheduler.runNow(outbox_task);
+  }
+
+  digitalWrite(STATUS_LED, HIGH);
 }
 
+void onMQTTDisconnected() {
+  Serial.print("⚠️ MQTT connection lost, rc=");
+  Serial.println(mqtt_client.state());
+
+  mqtt_link_state = MQTT_LINK_DOWN;
+  mqtt_disconnects++;
+  mqtt_down_since = millis();
+  mqtt_retry_at = mqtt_down_since;  // first retry right away
+  mqtt_backoff_ms = 0;
+  scheduler.setPeriod(mqtt_task, led_blink_interval);  // blink LED, check retry time
+}
+
+// Time spent disconnected since boot, including the current outage
+unsigned long mqttOfflineMillis() {
+  if (mqtt_link_state == MQTT_LINK_UP) {
+    return mqtt_offline_ms;
+  }
+  return mqtt_offline_ms + (millis() - mqtt_down_since);
+}
+
+// Dashboard commands, matched against the "command" field of the payload
+// Handlers read the command before they publish anything: its strings live in
+// PubSubClient's buffer, which the next packet overwrites
+struct CommandHandler {
+  const char* name;
+  void (*handle)(JsonObject command);
+};
+
+constexpr CommandHandler command_handlers[] = {
+  {"relay", handleRelayCommand},
+  {"relays", handleRelaysCommand},
+  {"status", handleStatusRequest},
+  {"read_sensors", handleSensorRequest},
+  {"restart", handleRestartCommand},
+};
+
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
   Serial.println("📩 MQTT Message received:");
-  Serial.println("   Topic: " + String(topic));
-  
-  // Convert payload to string
-  String message = "";
-  for (int i = 0; i < length; i++) {
-    message += (char)payload[i];
+  Serial.print("   Topic: ");
+  Serial.println(topic);
+  Serial.print("   Message: ");
+  PayloadFormat format = payloadFormatOf(topic);
+  if (format == PAYLOAD_MSGPACK) {
+    Serial.println("(" + String(length) + " bytes MessagePack)");
+  } else {
+    Serial.write(payload, length);
+    Serial.println();
   }
-  Serial.println("   Message: " + message);
   
-  // Parse JSON command
-  DynamicJsonDocument doc(1024);
-  DeserializationError error = deserializeJson(doc, message);
+  // Parse the command straight from PubSubClient's buffer into the fixed arena.
+  // JSON is parsed in place: strings are unescaped where they arrived and the
+  // document points at them, so only the variants take arena space
+  DeserializationError error = format == PAYLOAD_MSGPACK
+                                   ? deserializeMsgPack(command_doc, (const char*)payload, length)
+                                   : deserializeJson(command_doc, (char*)payload, length, DeserializationOption::InSitu());
   
   if (error) {
-    Serial.println("❌ JSON parsing failed: " + String(error.c_str()));
+    Serial.print(format == PAYLOAD_MSGPACK ? "❌ MessagePack parsing failed: " : "❌ JSON parsing failed: ");
+    Serial.println(error.c_str());
+    command_doc.clear();
     return;
   }
   
-  JsonObject command = doc.as<JsonObject>();
-  String cmd = command["command"].as<String>();
+  JsonObject command = command_doc.as<JsonObject>();
+  const char* cmd = command["command"] | "";
   
-  if (cmd == "relay" || cmd == "relays") {
-    handleRelayCommand(command);
-  } else if (cmd == "read_sensors") {
-    handleSensorRequest();
-  } else if (cmd == "status") {
-    publishStatus();
-  } else if (cmd == "restart") {
-    Serial.println("🔄 Restart command received");
-    ESP.restart();
+  const CommandHandler* match = nullptr;
+  for (const CommandHandler& handler : command_handlers) {
+    if (strcmp(cmd, handler.name) == 0) {
+      match = &handler;
+      break;
+    }
+  }
+  if (match) {
+    match->handle(command);
   } else {
-    Serial.println("❓ Unknown command: " + cmd);
+    Serial.print("❓ Unknown command: ");
+    Serial.println(cmd);
+  }
+  
+  // Done with the command: its blocks go back and the arena is empty again
+  command_doc.clear();
+}
+
+// ข้อความที่ใหญ่กว่า buffer มาเป็นชิ้นๆ แทนที่จะหายไปเงียบๆ; commands are
+// small JSON, so these are only counted and reported once the last chunk is in
+void mqttChunkCallback(char* topic, byte* chunk, unsigned int length, uint32_t offset, uint32_t total) {
+  (void)chunk;
+  if (offset + length < total) return;
+  mqtt_oversized++;
+  Serial.println("⚠️ Oversized MQTT message ignored: " + String(total) + " bytes on " + String(topic));
+}
+
+// "on", "1", "true", true or a non-zero number switch a relay on
+bool parseRelayState(JsonVariant state) {
+  if (state.is<const char*>()) {
+    const char* text = state.as<const char*>();
+    return strcmp(text, "on") == 0 || strcmp(text, "1") == 0 || strcmp(text, "true") == 0;
   }
+  return state.as<bool>();
 }
 
-void handleRelayCommand(JsonObject& command) {
-  String cmd = command["command"].as<String>();
+void handleRelayCommand(JsonObject command) {
+  // Single relay control
+  JsonObject value = command["value"];
+  int pin = value["pin"];
+  bool newState = parseRelayState(value["state"]);
   
-  if (cmd == "relay") {
-    // Single relay control
-    JsonObject value = command["value"];
-    int pin = value["pin"];
-    String state = value["state"].as<String>();
-    
-    bool newState = (state == "on" || state == "1" || state == "true");
-    
-    Serial.println("🎛️ Relay Command - Pin: " + String(pin) + ", State: " + state);
-    
-    switch (pin) {
-      case RELAY_PIN_1:
-        relay1_State = newState;
-        break;
-      case RELAY_PIN_2:
-        relay2_State = newState;
-        break;
-      case RELAY_PIN_3:
-        relay3_State = newState;
-        break;
-      case RELAY_PIN_4:
-        relay4_State = newState;
-        break;
-      default:
-        Serial.println("❌ Invalid relay pin: " + String(pin));
-        return;
-    }
-    
-  } else if (cmd == "relays") {
-    // Multiple relay control
-    JsonObject value = command["value"];
-    
-    if (value.containsKey("relay1")) {
-      relay1_State = value["relay1"].as<String>() == "on";
-    }
-    if (value.containsKey("relay2")) {
-      relay2_State = value["relay2"].as<String>() == "on";
-    }
-    if (value.containsKey("relay3")) {
-      relay3_State = value["relay3"].as<String>() == "on";
-    }
-    if (value.containsKey("relay4")) {
-      relay4_State = value["relay4"].as<String>() == "on";
+  Serial.print("🎛️ Relay Command - Pin: ");
+  Serial.print(pin);
+  Serial.print(", State: ");
+  Serial.println(newState ? "on" : "off");
+  
+  switch (pin) {
+    case RELAY_PIN_1:
+      relay1_State = newState;
+      break;
+    case RELAY_PIN_2:
+      relay2_State = newState;
+      break;
+    case RELAY_PIN_3:
+      relay3_State = newState;
+      break;
+    case RELAY_PIN_4:
+      relay4_State = newState;
+      break;
+    default:
+      Serial.print("❌ Invalid relay pin: ");
+      Serial.println(pin);
+      return;
+  }
+  
+  // Apply changes and send status
+  updateRelays();
+  queueStatus();
+}
+
+void handleRelaysCommand(JsonObject command) {
+  // Multiple relay control
+  static const char* const keys[] = {"relay1", "relay2", "relay3", "relay4"};
+  bool* states[] = {&relay1_State, &relay2_State, &relay3_State, &relay4_State};
+  JsonObject value = command["value"];
+  
+  for (int i = 0; i < 4; i++) {
+    JsonVariant state = value[keys[i]];
+    if (!state.isNull()) {
+      *states[i] = strcmp(state | "", "on") == 0;
     }
-    
-    Serial.println("🎛️ Multiple Relay Command received");
   }
   
+  Serial.println("🎛️ Multiple Relay Command received");
+  
   // Apply changes and send status
   updateRelays();
-  publishStatus();
+  queueStatus();
+}
+
+void handleStatusRequest(JsonObject command) {
+  (void)command;
+  queueStatus();
 }
 
-void handleSensorRequest() {
+void handleRestartCommand(JsonObject command) {
+  (void)command;
+  Serial.println("🔄 Restart command received");
+  outbox.spillAll();  // queued messages survive the restart in flash
+  ESP.restart();
+}
+
+void handleSensorRequest(JsonObject command) {
+  (void)command;
   Serial.println("🌡️ Sensor data requested");
   readSensors();
-  publishSensorData();
+  publishSensorSnapshot();  // every channel, changed or not
 }
 
+// Runs when a button interrupt woke loop(), and again when a debounce
+// window closes
 void readButtons() {
-  int pins[] = {INPUT_PIN_1, INPUT_PIN_2, INPUT_PIN_3, INPUT_PIN_4};
+  uint32_t wait = buttons.poll();
+  if (wait) scheduler.runIn(buttons_task, wait);
+}
+
+void onButtonPress(int index) {
   bool* states[] = {&relay1_State, &relay2_State, &relay3_State, &relay4_State};
-  
-  for (int i = 0; i < 4; i++) {
-    bool currentReading = digitalRead(pins[i]);
-    
-    if (currentReading != last_button_state[i]) {
-      last_debounce_time[i] = millis();
-    }
-    
-    if ((millis() - last_debounce_time[i]) > debounce_delay) {
-      if (currentReading != button_state_debounced[i]) {
-        button_state_debounced[i] = currentReading;
-        
-        if (currentReading == LOW) { // Button pressed (active low)
-          *states[i] = !(*states[i]); // Toggle relay state
-          Serial.println("🔘 Button " + String(i+1) + " pressed - Relay " + String(i+1) + ": " + (*states[i] ? "ON" : "OFF"));
-          updateRelays();
-          publishStatus();
-        }
-      }
-    }
-    
-    last_button_state[i] = currentReading;
-  }
+  *states[index] = !(*states[index]); // Toggle relay state
+  updateRelays();
+  Serial.println("🔘 Button " + String(index+1) + " pressed - Relay " + String(index+1) + ": " + (*states[index] ? "ON" : "OFF"));
+  queueStatus();
+}
+
+// ISR context: only end the idle sleep
+void IRAM_ATTR onButtonEdge() {
+  scheduler.wakeFromISR();
 }
 
 void updateRelays() {
@@ -405,6 +744,11 @@ void updateRelays() {
   digitalWrite(RELAY_PIN_4, relay4_State ? HIGH : LOW);
 }
 
+void sensorTask() {
+  readSensors();
+  publishSensorData();
+}
+
 void readSensors() {
   float h = dht.readHumidity();
   float t = dht.readTemperature();
@@ -413,6 +757,9 @@ void readSensors() {
     humidity = h;
     temperature = t;
     heat_index = dht.computeHeatIndex(t, h, false);
+    sensor_filter.update(temperature_channel, temperature);
+    sensor_filter.update(humidity_channel, humidity);
+    sensor_filter.update(heat_index_channel, heat_index);
     
     Serial.println("🌡️ Sensor readings - Temp: " + String(temperature) + "°C, Humidity: " + String(humidity) + "%");
   } else {
@@ -420,76 +767,372 @@ void readSensors() {
   }
 }
 
+// Ask for a status message; requests within the coalescing window share one
+void queueStatus() {
+  if (status_pending) {
+    status_suppressed++;
+    return;
+  }
+  status_pending = true;
+  scheduler.runIn(status_task, status_coalesce_window);
+}
+
+// Runs when the coalescing window closes, or keep-alive time after the last
+// status message
+void serviceStatus() {
+  if (!mqtt_client.connected()) {
+    return;  // onMQTTConnected() publishes a fresh snapshot
+  }
+  if (!status_pending) {
+    status_keepalives++;
+  }
+  publishStatus();
+}
+
 void publishStatus() {
-  DynamicJsonDocument doc(512);
-  doc["type"] = "relay_status";
-  doc["device_id"] = DEVICE_ID;
-  doc["device_name"] = DEVICE_NAME;
-  doc["timestamp"] = millis();
+  status_pending = false;
+  scheduler.runIn(status_task, status_keepalive_interval);
   
-  JsonObject data = doc.createNestedObject("data");
-  data["relay1"] = relay1_State;
-  data["relay2"] = relay2_State;
-  data["relay3"] = relay3_State;
-  data["relay4"] = relay4_State;
-  
-  JsonObject pins = doc.createNestedObject("pins");
-  pins["relay1"] = RELAY_PIN_1;
-  pins["relay2"] = RELAY_PIN_2;
-  pins["relay3"] = RELAY_PIN_3;
-  pins["relay4"] = RELAY_PIN_4;
-  
-  String message;
-  serializeJson(doc, message);
+  char body[128];
+  int len;
+  if (payload_format == PAYLOAD_MSGPACK) {
+    MsgPackWriter w(body, sizeof(body));
+    w.str("timestamp").uint64(wall_clock.stamp(millis()));
+    w.str("data").map(4);
+    w.str("relay1").boolean(relay1_State).str("relay2").boolean(relay2_State);
+    w.str("relay3").boolean(relay3_State).str("relay4").boolean(relay4_State);
+    len = w.length();
+  } else {
+    len = snprintf(body, sizeof(body),
+                   ",\"timestamp\":%llu,\"data\":{\"relay1\":%s,\"relay2\":%s,\"relay3\":%s,\"relay4\":%s}",
+                   (unsigned long long)wall_clock.stamp(millis()),
+                   relay1_State ? "true" : "false", relay2_State ? "true" : "false",
+                   relay3_State ? "true" : "false", relay4_State ? "true" : "false");
+  }
   
-  if (mqtt_client.publish(topic_status.c_str(), message.c_str())) {
+  // Only the newest snapshot is worth sending late: it replaces a queued one
+  PublishResult result = publishPayload(topic_status, status_template, body, len, true, 1, onStatusAck);
+  if (result == PUBLISH_SENT) {
+    status_sent++;
     Serial.println("📤 Status published");
+  } else if (result == PUBLISH_QUEUED) {
+    Serial.println("📥 Status queued");
   } else {
     Serial.println("❌ Failed to publish status");
   }
 }
 
+// PubSubClient gave up resending after MQTT_MAX_RETRIES: rather than replay
+// an old snapshot, send the current relay states
+void onStatusAck(uint16_t msg_id, boolean delivered) {
+  if (delivered) {
+    status_acked++;
+    return;
+  }
+  status_expired++;
+  Serial.println("⚠️ Status " + String(msg_id) + " not acknowledged, queueing a fresh one");
+  queueStatus();
+}
+
+// Channels outside their dead-band or silent for too long join the batch;
+// the batch goes out once it is full or old enough
 void publishSensorData() {
-  DynamicJsonDocument doc(512);
-  doc["type"] = "sensor_data";
-  doc["device_id"] = DEVICE_ID;
-  doc["device_name"] = DEVICE_NAME;
-  doc["timestamp"] = millis();
-  
-  JsonObject data = doc.createNestedObject("data");
-  data["temperature"] = round(temperature * 10) / 10.0;  // 1 decimal place
-  data["humidity"] = round(humidity * 10) / 10.0;
-  data["heat_index"] = round(heat_index * 10) / 10.0;
+  uint32_t now = millis();
+  batchSensorChannels(sensor_filter.due(now), now);
+  if (sensor_batch.due(now)) {
+    publishSensorBatch();
+  }
+}
+
+// Every channel, changed or not, and the batch goes out right away
+void publishSensorSnapshot() {
+  batchSensorChannels(sensor_filter.all(), millis());
+  publishSensorBatch();
+}
+
+void batchSensorChannels(uint32_t channels, uint32_t now) {
+  for (int i = 0; i < sensor_filter.channelCount(); i++) {
+    if (!(channels & (1u << i))) continue;
+    if (sensor_batch.full(i)) {
+      publishSensorBatch();
+    }
+    // 1 decimal place, as the DHT22 reads
+    sensor_batch.add(i, now, roundf(sensor_filter.value(i) * 10) / 10);
+  }
+  sensor_filter.commit(channels, now);
+}
+
+// {"timestamp":<oldest sample>,"data":{"temperature":{"t":[0,2000],"v":[25.1,25.3]},...}}
+// A queued batch counts as sent, the outbox keeps every sensor message; one
+// that does not even fit the outbox is dropped.
+void publishSensorBatch() {
+  if (sensor_batch.empty()) {
+    return;
+  }
+  sensor_batch.serialize(batch_doc.to<JsonObject>());
   
-  String message;
-  serializeJson(doc, message);
+  char body[384];
+  int len;
+  if (payload_format == PAYLOAD_MSGPACK) {
+    MsgPackWriter w(body, sizeof(body));
+    w.str("timestamp").uint64(wall_clock.stamp(sensor_batch.base())).str("data");
+    len = w.length();
+    if (len >= 0 && measureMsgPack(batch_doc) <= sizeof(body) - len) {
+      len += serializeMsgPack(batch_doc, body + len, sizeof(body) - len);
+    } else {
+      len = -1;
+    }
+  } else {
+    len = snprintf(body, sizeof(body), ",\"timestamp\":%llu,\"data\":",
+                   (unsigned long long)wall_clock.stamp(sensor_batch.base()));
+    if (len >= 0 && measureJson(batch_doc) < sizeof(body) - len) {
+      len += serializeJson(batch_doc, body + len, sizeof(body) - len);
+    } else {
+      len = -1;
+    }
+  }
+  batch_doc.clear();  // serialized; give the arena back
+  size_t samples = sensor_batch.size();
+  sensor_batch.clear();
   
-  if (mqtt_client.publish(topic_data.c_str(), message.c_str())) {
-    Serial.println("📤 Sensor data published");
+  PublishResult result = publishPayload(topic_data, sensor_template, body, len, false, 0, nullptr, &sensor_properties);
+  if (result == PUBLISH_SENT) {
+    Serial.printf("📤 Sensor batch published (%u samples)\n", (unsigned)samples);
+  } else if (result == PUBLISH_QUEUED) {
+    Serial.println("📥 Sensor batch queued (" + String(outbox.size()) + " waiting)");
   } else {
-    Serial.println("❌ Failed to publish sensor data");
+    Serial.printf("❌ Failed to publish sensor batch, %u samples dropped\n", (unsigned)samples);
   }
 }
 
 void publishHeartbeat() {
-  DynamicJsonDocument doc(256);
-  doc["type"] = "heartbeat";
+  IPAddress ip = WiFi.localIP();
+  char body[480];
+  int len;
+  if (payload_format == PAYLOAD_MSGPACK) {
+    char ip_text[16];
+    snprintf(ip_text, sizeof(ip_text), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    MsgPackWriter w(body, sizeof(body));
+    w.str("timestamp").uint64(wall_clock.stamp(millis())).str("uptime").uint32(millis() / 1000);
+    w.str("free_heap").uint32(ESP.getFreeHeap()).str("wifi_rssi").int32(WiFi.RSSI());
+    w.str("ip_address").str(ip_text);
+    w.str("mqtt_disconnects").uint32(mqtt_disconnects).str("mqtt_connect_failures").uint32(mqtt_connect_failures);
+    w.str("mqtt_offline_ms").uint32(mqttOfflineMillis()).str("mqtt_longest_offline_ms").uint32(mqtt_longest_offline_ms);
+    w.str("status_sent").uint32(status_sent).str("status_suppressed").uint32(status_suppressed);
+    w.str("sensor_readings").uint32(sensor_filter.stats().readings).str("sensor_sent").uint32(sensor_filter.stats().sent);
+    w.str("press_p50_us").uint32(buttons.latencyPercentile(50)).str("press_p99_us").uint32(buttons.latencyPercentile(99));
+    w.str("press_max_us").uint32(buttons.latencyMax());
+    len = w.length();
+  } else {
+    len = snprintf(body, sizeof(body),
+                   ",\"timestamp\":%llu,\"uptime\":%lu,\"free_heap\":%lu,\"wifi_rssi\":%d"
+                   ",\"ip_address\":\"%u.%u.%u.%u\""
+                   ",\"mqtt_disconnects\":%lu,\"mqtt_connect_failures\":%lu"
+                   ",\"mqtt_offline_ms\":%lu,\"mqtt_longest_offline_ms\":%lu"
+                   ",\"status_sent\":%lu,\"status_suppressed\":%lu"
+                   ",\"sensor_readings\":%lu,\"sensor_sent\":%lu"
+                   ",\"press_p50_us\":%lu,\"press_p99_us\":%lu,\"press_max_us\":%lu",
+                   (unsigned long long)wall_clock.stamp(millis()), millis() / 1000, (unsigned long)ESP.getFreeHeap(), (int)WiFi.RSSI(),
+                   ip[0], ip[1], ip[2], ip[3],
+                   mqtt_disconnects, mqtt_connect_failures,
+                   mqttOfflineMillis(), mqtt_longest_offline_ms,
+                   status_sent, status_suppressed,
+                   (unsigned long)sensor_filter.stats().readings, (unsigned long)sensor_filter.stats().sent,
+                   (unsigned long)buttons.latencyPercentile(50), (unsigned long)buttons.latencyPercentile(99),
+                   (unsigned long)buttons.latencyMax());
+  }
+  
+  PublishResult result = publishPayload(topic_heartbeat, heartbeat_template, body, len, true);
+  if (result == PUBLISH_SENT) {
+    Serial.println("💓 Heartbeat sent");
+  } else if (result == PUBLISH_QUEUED) {
+    Serial.println("📥 Heartbeat queued");
+  } else {
+    Serial.println("❌ Failed to send heartbeat");
+  }
+}
+
+void setupPayloadTemplates() {
+  JsonDocument pins(&json_arena);
+  pins["pins"]["relay1"] = RELAY_PIN_1;
+  pins["pins"]["relay2"] = RELAY_PIN_2;
+  pins["pins"]["relay3"] = RELAY_PIN_3;
+  pins["pins"]["relay4"] = RELAY_PIN_4;
+  bool ok = buildPayloadTemplate(status_template, "relay_status", pins, 2);  // timestamp, data
+  
+  JsonDocument none(&json_arena);
+  ok &= buildPayloadTemplate(sensor_template, "sensor_batch", none, 2);  // timestamp, data
+  ok &= buildPayloadTemplate(heartbeat_template, "heartbeat", none, 16);
+  if (!ok) {
+    // A cut-off head or tail would go out as broken JSON/MessagePack on
+    // every publish; those templates stay empty and publishes using them fail
+    Serial.println("❌ Payload templates do not fit (DEVICE_ID/DEVICE_NAME too long?), publishing disabled for those messages");
+  }
+}
+
+// Serializes the identity fields once; ArduinoJson takes care of escaping.
+// body_fields is the number of fields the publish function adds, which the
+// MessagePack map header has to count up front. Returns false, leaving
+// head_len 0, if the head or the tail does not fit.
+bool buildPayloadTemplate(PayloadTemplate& tpl, const char* type, JsonDocument& trailer, uint8_t body_fields) {
+  tpl.head_len = 0;
+  tpl.tail_len = 0;
+  if (payload_format == PAYLOAD_MSGPACK) {
+    MsgPackWriter w(tpl.head, sizeof(tpl.head));
+    w.map(3 + body_fields + trailer.size());
+    w.str("type").str(type);
+    w.str("device_id").str(DEVICE_ID.c_str()).str("device_name").str(DEVICE_NAME.c_str());
+    if (w.length() <= 0) {
+      Serial.println("❌ " + String(type) + " template: head over " + String(sizeof(tpl.head)) + " bytes");
+      return false;
+    }
+    
+    // {"pins":{...}} without its map header: the entries follow the body
+    if (!trailer.isNull()) {
+      size_t length = serializeMsgPack(trailer, tpl.tail, sizeof(tpl.tail));
+      if (length == 0 || measureMsgPack(trailer) > sizeof(tpl.tail)) {
+        Serial.println("❌ " + String(type) + " template: tail over " + String(sizeof(tpl.tail)) + " bytes");
+        return false;
+      }
+      size_t header = msgPackMapHeaderSize((const uint8_t*)tpl.tail, length);
+      tpl.tail_len = length - header;
+      memmove(tpl.tail, tpl.tail + header, tpl.tail_len);
+    }
+    tpl.head_len = w.length();
+    return true;
+  }
+  
+  JsonDocument doc(&json_arena);
+  doc["type"] = type;
   doc["device_id"] = DEVICE_ID;
   doc["device_name"] = DEVICE_NAME;
-  doc["timestamp"] = millis();
-  doc["uptime"] = millis() / 1000;
-  doc["free_heap"] = ESP.getFreeHeap();
-  doc["wifi_rssi"] = WiFi.RSSI();
-  doc["ip_address"] = WiFi.localIP().toString();
   
-  String message;
-  serializeJson(doc, message);
+  // serializeJson() stops at the end of the buffer, so a result that
+  // reaches it may have been cut off
+  size_t head = serializeJson(doc, tpl.head, sizeof(tpl.head));
+  if (head == 0 || head >= sizeof(tpl.head)) {
+    Serial.println("❌ " + String(type) + " template: head over " + String(sizeof(tpl.head)) + " bytes");
+    return false;
+  }
   
-  if (mqtt_client.publish(topic_heartbeat.c_str(), message.c_str())) {
-    Serial.println("💓 Heartbeat sent");
+  if (trailer.isNull()) {
+    strcpy(tpl.tail, "}");
+    tpl.tail_len = 1;
   } else {
-    Serial.println("❌ Failed to send heartbeat");
+    // {"pins":{...}} -> ,"pins":{...}}
+    size_t tail = serializeJson(trailer, tpl.tail, sizeof(tpl.tail));
+    if (tail == 0 || tail >= sizeof(tpl.tail)) {
+      Serial.println("❌ " + String(type) + " template: tail over " + String(sizeof(tpl.tail)) + " bytes");
+      return false;
+    }
+    tpl.tail_len = tail;
+    tpl.tail[0] = ',';
+  }
+  // Drop the closing brace so the changing fields can follow
+  tpl.head_len = head - 1;
+  return true;
+}
+
+// Streams head + body + tail straight to the socket, no intermediate copy
+// (at QoS 1 PubSubClient keeps one in the in-flight slot for resending).
+// Offline, behind queued messages or with the QoS 1 window full the joined
+// payload goes to the outbox instead; supersede replaces a queued message
+// on the same topic. body_len is snprintf()'s result, so a truncated body
+// is refused, as is a template that did not fit at setup.
+template <size_t N>
+PublishResult publishPayload(const String& topic, const PayloadTemplate& tpl, const char (&body)[N], int body_len,
+                             bool supersede, uint8_t qos, void (*on_ack)(uint16_t, boolean),
+                             const MqttProperties* properties) {
+  if (body_len < 0 || (size_t)body_len >= N || tpl.head_len == 0) {
+    return PUBLISH_FAILED;
+  }
+  const MqttIovec parts[3] = {
+    {(const uint8_t*)tpl.head, tpl.head_len},
+    {(const uint8_t*)body, (size_t)body_len},
+    {(const uint8_t*)tpl.tail, tpl.tail_len},
+  };
+  if (mqtt_client.connected() && outbox.empty() &&
+      mqtt_client.publishParts(topic.c_str(), parts, 3, false, qos, on_ack, properties)) {
+    return PUBLISH_SENT;
+  }
+
+  uint8_t joined[OUTBOX_MAX_RECORD];
+  size_t length = 0;
+  for (const MqttIovec& part : parts) {
+    if (length + part.length > sizeof(joined)) {
+      return PUBLISH_FAILED;
+    }
+    memcpy(joined + length, part.base, part.length);
+    length += part.length;
   }
+  if (!outbox.push(topic.c_str(), joined, length, qos, false, supersede)) {
+    return PUBLISH_FAILED;
+  }
+  if (mqtt_client.connected() && !scheduler.armed(outbox_task)) {
+    scheduler.runIn(outbox_task, Outbox::kRetryMs);
+  }
+  return PUBLISH_QUEUED;
+}
+
+void setupClock() {
+  wall_clock.begin(ntp_udp, ntp_server);
+  scheduler.runNow(clock_task);
+  Serial.println("🕒 Wall clock syncing with " + String(ntp_server));
+}
+
+// SNTP request/reply; keeps the offset through WiFi and broker reconnects
+void serviceClock() {
+  scheduler.runIn(clock_task, wall_clock.poll());
+  if (wall_clock.synced() && !wall_clock_logged) {
+    wall_clock_logged = true;
+    Serial.printf("✅ Wall clock synced: %llu (rtt %lu ms)\n", (unsigned long long)wall_clock.now(),
+                  (unsigned long)wall_clock.stats().rttMs);
+  }
+}
+
+void setupOutbox() {
+  outbox.setDrainRate(outbox_drain_rate);
+  if (outbox.attachFlash("spiffs", outbox_flash_sectors)) {
+    Serial.println("✅ Outbox ready, " + String(outbox.size()) + " messages restored from flash");
+  } else {
+    Serial.println("⚠️ No spiffs partition: outbox is RAM-only");
+  }
+}
+
+// Sends queued messages after a reconnect, paced by the drain rate
+void serviceOutbox() {
+  if (!mqtt_client.connected()) {
+    return;  // onMQTTConnected() starts again
+  }
+  uint32_t wait = outbox.drain(millis(), sendQueued);
+  if (wait) {
+    scheduler.runIn(outbox_task, wait);
+  } else {
+    Serial.println("✅ Outbox drained");
+  }
+}
+
+// Only the relay status is queued at QoS 1
+bool sendQueued(const OutboxMessage& message) {
+  if (!mqtt_client.publish(message.topic, message.payload, message.length, message.retained, message.qos,
+                           message.qos ? onStatusAck : nullptr)) {
+    return false;
+  }
+  if (message.qos) {
+    status_sent++;
+  }
+  return true;
+}
+
+// Hands PubSubClient's packet pieces to the socket as one lwIP writev
+size_t mqttWritev(const MqttIovec* parts, uint8_t count) {
+  struct iovec iov[MQTT_MAX_IOVEC];
+  for (uint8_t i = 0; i < count; i++) {
+    iov[i].iov_base = (void*)parts[i].base;
+    iov[i].iov_len = parts[i].length;
+  }
+  ssize_t sent = lwip_writev(espClient.fd(), iov, count);
+  return sent < 0 ? 0 : (size_t)sent;
 }
 
 void blinkStatusLED(int times, int delayMs) {
@@ -501,6 +1144,27 @@ void blinkStatusLED(int times, int delayMs) {
   }
 }
 
+// Serial console. "STATS" prints printSystemInfo(); characters are taken as
+// they arrive, so a half-typed line never holds up the loop.
+void serviceConsole() {
+  static char line[16];
+  static size_t length = 0;
+  while (Serial.available() > 0) {
+    char c = Serial.read();
+    if (c != '\r' && c != '\n') {
+      if (length < sizeof(line) - 1) line[length++] = toupper(c);
+      continue;
+    }
+    line[length] = '\0';
+    if (strcmp(line, "STATS") == 0) {
+      printSystemInfo();
+    } else if (length > 0) {
+      Serial.println("Unknown command. Try STATS");
+    }
+    length = 0;
+  }
+}
+
 void printSystemInfo() {
   Serial.println("\n📊 System Information:");
   Serial.println("   Chip Model: " + String(ESP.getChipModel()));
@@ -509,4 +1173,26 @@ void printSystemInfo() {
   Serial.println("   Flash Size: " + String(ESP.getFlashChipSize() / 1024 / 1024) + " MB");
   Serial.println("   Free Heap: " + String(ESP.getFreeHeap()) + " bytes");
   Serial.println("   Uptime: " + String(millis() / 1000) + " seconds");
+  Serial.println("   MQTT disconnects: " + String(mqtt_disconnects));
+  Serial.println("   MQTT connect attempts/failures: " + String(mqtt_connect_attempts) + "/" + String(mqtt_connect_failures));
+  Serial.println("   MQTT offline: " + String(mqttOfflineMillis()) + " ms (longest " + String(mqtt_longest_offline_ms) + " ms)");
+  Serial.println("   Status sent/suppressed: " + String(status_sent) + "/" + String(status_suppressed) + " (" + String(status_keepalives) + " keep-alive)");
+  const MqttQos1Stats& qos1 = mqtt_client.qos1Stats();
+  Serial.println("   Status acked/expired: " + String(status_acked) + "/" + String(status_expired) +
+                 " (QoS 1 in flight " + String(mqtt_client.inflightCount()) + ", retransmits " + String(qos1.retransmits) + ")");
+  Serial.println("   MQTT oversized messages: " + String(mqtt_oversized));
+  Serial.println("   Sensor dead-band:");
+  sensor_filter.printStats(Serial);
+  Serial.println("   Sensor batches:");
+  sensor_batch.printStats(Serial);
+  Serial.println("   Outbox:");
+  outbox.printStats(Serial);
+  Serial.println("   Wall clock:");
+  wall_clock.printStats(Serial);
+  Serial.println("   Buttons:");
+  buttons.printStats(Serial);
+  Serial.println("   Scheduler:");
+  scheduler.printStats(Serial);
+  Serial.println("   JSON arena:");
+  json_arena.printStats(Serial);
 }
@@ -0,0 +1,157 @@
+/*
+  test_main.cpp - host tests for lib/DeadBand.
+
+    pio test -e native -f test_dead_band
+*/
+
+#include <Arduino.h>
+#include <DeadBand.h>
+#include <unity.h>
+
+namespace {
+
+DeadBand* filter;
+int temperature;
+int humidity;
+
+const uint32_t kSilenceMs = 60000;
+
+void read(float t, float h) {
+  filter->update(temperature, t);
+  filter->update(humidity, h);
+}
+
+}  // namespace
+
+void setUp() {
+  filter = new DeadBand();
+  temperature = filter->addChannel("temperature", 0.2f);
+  humidity = filter->addChannel("humidity", 1.0f);
+  filter->setMaxSilence(kSilenceMs);
+}
+
+void tearDown() { delete filter; }
+
+void test_first_reading_is_due() {
+  TEST_ASSERT_EQUAL_UINT32(0, filter->due(0));  // nothing read yet
+  read(25.0f, 60.0f);
+  TEST_ASSERT_EQUAL_UINT32(0x3, filter->due(0));
+}
+
+void test_readings_inside_band_are_suppressed() {
+  read(25.0f, 60.0f);
+  filter->commit(filter->due(0), 0);
+  read(25.1f, 60.9f);
+  TEST_ASSERT_EQUAL_UINT32(0, filter->due(5000));
+  read(24.85f, 59.2f);
+  TEST_ASSERT_EQUAL_UINT32(0, filter->due(10000));
+}
+
+void test_only_changed_channel_is_due() {
+  read(25.0f, 60.0f);
+  filter->commit(filter->due(0), 0);
+  read(25.3f, 60.5f);
+  TEST_ASSERT_EQUAL_UINT32(1u << temperature, filter->due(5000));
+  read(25.3f, 58.5f);
+  TEST_ASSERT_EQUAL_UINT32((1u << temperature) | (1u << humidity), filter->due(10000));
+}
+
+// The reference is the value sent, not the previous reading, so a slow
+// drift is sent once it adds up to more than the band
+void test_slow_drift_accumulates() {
+  read(25.0f, 60.0f);
+  filter->commit(filter->due(0), 0);
+  read(25.1f, 60.0f);
+  TEST_ASSERT_EQUAL_UINT32(0, filter->due(5000));
+  read(25.15f, 60.0f);
+  TEST_ASSERT_EQUAL_UINT32(0, filter->due(10000));
+  read(25.25f, 60.0f);
+  TEST_ASSERT_EQUAL_UINT32(1u << temperature, filter->due(15000));
+}
+
+void test_uncommitted_change_stays_due() {
+  read(25.0f, 60.0f);
+  filter->commit(filter->due(0), 0);
+  read(26.0f, 60.0f);
+  TEST_ASSERT_EQUAL_UINT32(1u << temperature, filter->due(5000));  // publish failed: no commit
+  TEST_ASSERT_EQUAL_UINT32(1u << temperature, filter->due(10000));
+  filter->commit(1u << temperature, 10000);
+  TEST_ASSERT_EQUAL_UINT32(0, filter->due(15000));
+}
+
+void test_max_silence_forces_channel() {
+  read(25.0f, 60.0f);
+  filter->commit(filter->due(0), 0);
+  read(25.5f, 60.0f);
+  filter->commit(filter->due(30000), 30000);  // temperature only
+  TEST_ASSERT_EQUAL_UINT32(0, filter->due(kSilenceMs - 1));
+  TEST_ASSERT_EQUAL_UINT32(1u << humidity, filter->due(kSilenceMs));
+  filter->commit(1u << humidity, kSilenceMs);
+  TEST_ASSERT_EQUAL_UINT32(1, filter->stats().forced);
+  TEST_ASSERT_EQUAL_UINT32(1u << temperature, filter->due(30000 + kSilenceMs));
+}
+
+void test_no_max_silence_never_forces() {
+  filter->setMaxSilence(0);
+  read(25.0f, 60.0f);
+  filter->commit(filter->due(0), 0);
+  TEST_ASSERT_EQUAL_UINT32(0, filter->due(10 * kSilenceMs));
+}
+
+void test_nan_reading_is_ignored() {
+  read(25.0f, 60.0f);
+  filter->commit(filter->due(0), 0);
+  read(NAN, NAN);
+  TEST_ASSERT_EQUAL_UINT32(0, filter->due(5000));
+  TEST_ASSERT_EQUAL_FLOAT(25.0f, filter->value(temperature));
+  TEST_ASSERT_EQUAL_UINT32(2, filter->stats().readings);
+}
+
+void test_all_is_every_channel_with_a_reading() {
+  filter->update(temperature, 25.0f);
+  TEST_ASSERT_EQUAL_UINT32(1u << temperature, filter->all());
+  filter->update(humidity, 60.0f);
+  filter->commit(filter->due(0), 0);
+  TEST_ASSERT_EQUAL_UINT32(0x3, filter->all());
+}
+
+void test_suppression_ratio() {
+  uint32_t now = 0;
+  read(25.0f, 60.0f);
+  filter->commit(filter->due(now), now);  // 2 sent
+  for (int i = 0; i < 9; i++) {           // 18 readings inside the bands
+    now += 5000;
+    read(25.0f, 60.0f);
+    filter->commit(filter->due(now), now);
+  }
+  TEST_ASSERT_EQUAL_UINT32(20, filter->stats().readings);
+  TEST_ASSERT_EQUAL_UINT32(2, filter->stats().sent);
+  TEST_ASSERT_EQUAL_UINT32(1, filter->stats().messages);
+  TEST_ASSERT_EQUAL_UINT32(9, filter->stats().empty);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.9f, filter->suppressionRatio());
+}
+
+void test_channel_table_is_bounded() {
+  for (int i = filter->channelCount(); i < DeadBand::kMaxChannels; i++) {
+    TEST_ASSERT_EQUAL_INT(i, filter->addChannel("extra", 1.0f));
+  }
+  TEST_ASSERT_EQUAL_INT(-1, filter->addChannel("one too many", 1.0f));
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_first_reading_is_due);
+  RUN_TEST(test_readings_inside_band_are_suppressed);
+  RUN_TEST(test_only_changed_channel_is_due);
+  RUN_TEST(test_slow_drift_accumulates);
+  RUN_TEST(test_uncommitted_change_stays_due);
+  RUN_TEST(test_max_silence_forces_channel);
+  RUN_TEST(test_no_max_silence_never_forces);
+  RUN_TEST(test_nan_reading_is_ignored);
+  RUN_TEST(test_all_is_every_channel_with_a_reading);
+  RUN_TEST(test_suppression_ratio);
+  RUN_TEST(test_channel_table_is_bounded);
+  return UNITY_END();
+}
@@ -0,0 +1,152 @@
+/*
+  test_main.cpp - host tests for lib/DHTFrame.
+
+    pio test -e native -f test_dht_frame
+
+  kCapture has the shape the RMT receiver produces for a DHT22 answering
+  65.3 %RH / 23.1 C: a short HIGH while the pull-up takes over from the start
+  signal, the 80us response, 40 bits with the few-us jitter of the sensor's
+  oscillator, and a zero-length idle entry that ends the capture.
+*/
+
+#include <Arduino.h>
+#include <DHT.h>
+#include <DHTFrame.h>
+#include <NativeSim.h>
+#include <unity.h>
+
+namespace {
+
+const DHTPulse kCapture[] = {
+    {1, 23}, {0, 82}, {1, 86}, {0, 53}, {1, 24}, {0, 54},
+    {1, 28}, {0, 48}, {1, 23}, {0, 56}, {1, 23}, {0, 53},
+    {1, 27}, {0, 48}, {1, 27}, {0, 51}, {1, 68}, {0, 49},
+    {1, 26}, {0, 54}, {1, 68}, {0, 51}, {1, 23}, {0, 56},
+    {1, 26}, {0, 48}, {1, 29}, {0, 49}, {1, 69}, {0, 48},
+    {1, 72}, {0, 54}, {1, 23}, {0, 51}, {1, 68}, {0, 56},
+    {1, 29}, {0, 50}, {1, 25}, {0, 54}, {1, 24}, {0, 56},
+    {1, 23}, {0, 52}, {1, 27}, {0, 50}, {1, 23}, {0, 51},
+    {1, 25}, {0, 49}, {1, 27}, {0, 49}, {1, 72}, {0, 48},
+    {1, 72}, {0, 51}, {1, 71}, {0, 56}, {1, 26}, {0, 53},
+    {1, 26}, {0, 55}, {1, 70}, {0, 52}, {1, 69}, {0, 50},
+    {1, 73}, {0, 51}, {1, 23}, {0, 52}, {1, 72}, {0, 55},
+    {1, 70}, {0, 55}, {1, 70}, {0, 49}, {1, 23}, {0, 56},
+    {1, 71}, {0, 50}, {1, 74}, {0, 53}, {1, 24}, {0, 53},
+    {1, 0},
+};
+const size_t kCaptureLen = sizeof(kCapture) / sizeof(kCapture[0]);
+const uint8_t kCaptureBytes[5] = {0x02, 0x8D, 0x00, 0xE7, 0x76};
+
+DHTPulse pulses[DHT_FRAME_MAX_PULSES + 8];
+
+size_t copyCapture() {
+  memcpy(pulses, kCapture, sizeof(kCapture));
+  return kCaptureLen;
+}
+
+}  // namespace
+
+void setUp() {
+  nativesim::resetClock();
+  nativesim::setSensorFailed(false);
+}
+
+void tearDown() {}
+
+void test_decodes_captured_frame() {
+  uint8_t data[5];
+  TEST_ASSERT_EQUAL(DHT_FRAME_OK, dhtDecodeFrame(kCapture, kCaptureLen, data));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(kCaptureBytes, data, 5);
+}
+
+void test_split_pulse_is_merged() {
+  // The receiver may end an item mid-level; the halves add back up
+  size_t n = copyCapture();
+  memmove(&pulses[5], &pulses[4], (n - 4) * sizeof(DHTPulse));
+  pulses[4] = DHTPulse{1, 10};
+  pulses[5] = DHTPulse{1, 14};
+  uint8_t data[5];
+  TEST_ASSERT_EQUAL(DHT_FRAME_OK, dhtDecodeFrame(pulses, n + 1, data));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(kCaptureBytes, data, 5);
+}
+
+void test_leading_start_signal_tail_is_skipped() {
+  // Receiver armed a little early: it sees the end of the start LOW
+  pulses[0] = DHTPulse{0, 400};
+  memcpy(&pulses[1], kCapture, sizeof(kCapture));
+  uint8_t data[5];
+  TEST_ASSERT_EQUAL(DHT_FRAME_OK, dhtDecodeFrame(pulses, kCaptureLen + 1, data));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(kCaptureBytes, data, 5);
+}
+
+void test_missing_sensor_is_no_response() {
+  const DHTPulse idle[] = {{1, 0}};
+  uint8_t data[5];
+  TEST_ASSERT_EQUAL(DHT_FRAME_NO_RESPONSE, dhtDecodeFrame(idle, 1, data));
+  TEST_ASSERT_EQUAL(DHT_FRAME_NO_RESPONSE, dhtDecodeFrame(idle, 0, data));
+}
+
+void test_truncated_frame() {
+  uint8_t data[5];
+  TEST_ASSERT_EQUAL(DHT_FRAME_TRUNCATED, dhtDecodeFrame(kCapture, 60, data));
+}
+
+void test_out_of_spec_pulse() {
+  size_t n = copyCapture();
+  pulses[41].micros = 300;  // a LOW stretched by noise on the line
+  uint8_t data[5];
+  TEST_ASSERT_EQUAL(DHT_FRAME_BAD_PULSE, dhtDecodeFrame(pulses, n, data));
+}
+
+void test_flipped_bit_fails_checksum() {
+  size_t n = copyCapture();
+  pulses[4].micros = 70;  // first bit read as a 1
+  uint8_t data[5];
+  TEST_ASSERT_EQUAL(DHT_FRAME_CHECKSUM, dhtDecodeFrame(pulses, n, data));
+  TEST_ASSERT_EQUAL_HEX8(0x82, data[0]);
+}
+
+void test_encode_decode_round_trip() {
+  const uint8_t frames[][5] = {
+      {0x00, 0x00, 0x00, 0x00, 0x00},
+      {0x03, 0xE8, 0x80, 0x2D, 0x98},  // 100.0 %RH, -4.5 C
+      {0xFF, 0xFF, 0xFF, 0xFF, 0xFC},
+  };
+  for (const auto& frame : frames) {
+    size_t n = dhtEncodeFrame(frame, pulses, DHT_FRAME_MAX_PULSES);
+    TEST_ASSERT_TRUE(n <= DHT_FRAME_MAX_PULSES);
+    uint8_t data[5];
+    TEST_ASSERT_EQUAL(DHT_FRAME_OK, dhtDecodeFrame(pulses, n, data));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(frame, data, 5);
+  }
+}
+
+void test_dht_stand_in_reads_through_decoder() {
+  DHT dht(4, DHT22);
+  dht.begin();
+  nativesim::setSensorReading(-4.5f, 55.5f);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, -4.5f, dht.readTemperature());
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 55.5f, dht.readHumidity());
+
+  // Cached for the 2 s minimum interval, like the real driver
+  nativesim::setSensorFailed(true);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 55.5f, dht.readHumidity());
+  nativesim::advanceMillis(2000);
+  TEST_ASSERT_TRUE(isnan(dht.readHumidity()));
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_decodes_captured_frame);
+  RUN_TEST(test_split_pulse_is_merged);
+  RUN_TEST(test_leading_start_signal_tail_is_skipped);
+  RUN_TEST(test_missing_sensor_is_no_response);
+  RUN_TEST(test_truncated_frame);
+  RUN_TEST(test_out_of_spec_pulse);
+  RUN_TEST(test_flipped_bit_fails_checksum);
+  RUN_TEST(test_encode_decode_round_trip);
+  RUN_TEST(test_dht_stand_in_reads_through_decoder);
+  return UNITY_END();
+}
@@ -0,0 +1,236 @@
+/*
+  test_main.cpp - host tests for lib/EdgeInput.
+
+    pio test -e native -f test_edge_input
+
+  setPinLevel()/schedulePinLevel() run the attached interrupt handler at the
+  edge's virtual time, like the GPIO interrupt on the board. The handler
+  below takes handler_micros of virtual time, or burns handler_cpu_micros
+  of host CPU that nativesim charges to the clock.
+*/
+
+#include <Arduino.h>
+#include <EdgeInput.h>
+#include <NativeSim.h>
+#include <unity.h>
+
+#include <time.h>
+
+namespace {
+
+const uint8_t kPins[2] = {34, 35};
+const uint32_t kDebounceMs = 50;
+
+EdgeInput* input;
+int presses[2];
+int wakes;
+uint32_t handler_micros;
+uint32_t handler_cpu_micros;
+
+uint64_t threadCpuMicros() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void onPress(int index) {
+  presses[index]++;
+  nativesim::advanceMicros(handler_micros);
+  uint64_t until = threadCpuMicros() + handler_cpu_micros;
+  while (threadCpuMicros() < until) {
+  }
+}
+
+void onWake() { wakes++; }
+
+void press(int index) { nativesim::setPinLevel(kPins[index], LOW); }
+void release(int index) { nativesim::setPinLevel(kPins[index], HIGH); }
+
+// A full press and release of button 0, polled at once, then quiet
+void pressAndRelease() {
+  press(0);
+  input->poll();
+  nativesim::advanceMillis(100);
+  release(0);
+  input->poll();
+  nativesim::advanceMillis(100);
+}
+
+}  // namespace
+
+void setUp() {
+  nativesim::resetClock();
+  nativesim::advanceMillis(1000);
+  for (int i = 0; i < 2; i++) {
+    detachInterrupt(kPins[i]);
+    nativesim::setPinLevel(kPins[i], HIGH);
+    presses[i] = 0;
+  }
+  wakes = 0;
+  handler_micros = 0;
+  handler_cpu_micros = 0;
+  input = new EdgeInput();
+  input->begin(kPins, 2, kDebounceMs, onPress);
+  input->setWakeHook(onWake);
+}
+
+void tearDown() {
+  nativesim::endCpuCharge();
+  nativesim::setCpuScale(0);
+  for (int i = 0; i < 2; i++) detachInterrupt(kPins[i]);
+  delete input;
+}
+
+void test_press_acts_on_first_edge() {
+  press(0);
+  TEST_ASSERT_TRUE(input->pending());
+  TEST_ASSERT_EQUAL(1, wakes);
+  TEST_ASSERT_EQUAL_UINT32(0, input->poll());
+  TEST_ASSERT_EQUAL(1, presses[0]);
+  TEST_ASSERT_EQUAL(0, presses[1]);
+  TEST_ASSERT_TRUE(input->pressed(0));
+  TEST_ASSERT_FALSE(input->pending());
+}
+
+void test_bounces_inside_window_are_ignored() {
+  press(0);
+  nativesim::advanceMicros(800);
+  release(0);
+  nativesim::advanceMicros(700);
+  press(0);
+  nativesim::advanceMicros(900);
+  release(0);
+  nativesim::advanceMicros(600);
+  press(0);
+  input->poll();
+  TEST_ASSERT_EQUAL(1, presses[0]);
+  TEST_ASSERT_EQUAL_UINT32(4, input->stats().bounces);
+
+  nativesim::advanceMillis(120);
+  release(0);
+  input->poll();
+  TEST_ASSERT_EQUAL_UINT32(1, input->stats().releases);
+  TEST_ASSERT_FALSE(input->pressed(0));
+}
+
+void test_press_during_blocking_call_is_not_lost() {
+  uint64_t now = nativesim::nowMicros();
+  nativesim::schedulePinLevel(kPins[1], LOW, now + 5000);
+  nativesim::schedulePinLevel(kPins[1], HIGH, now + 30000);
+  delay(200);  // loop() stuck in a network call, nothing polls
+  TEST_ASSERT_EQUAL(2, wakes);
+  input->poll();
+  TEST_ASSERT_EQUAL(1, presses[1]);
+  // The release came inside the window; the line is HIGH now, so it counts
+  TEST_ASSERT_EQUAL_UINT32(1, input->stats().releases);
+  TEST_ASSERT_FALSE(input->pending());
+}
+
+void test_poll_reports_when_window_closes() {
+  press(0);
+  input->poll();
+  nativesim::advanceMillis(10);
+  release(0);  // released inside the window
+  TEST_ASSERT_EQUAL_UINT32(40, input->poll());
+  TEST_ASSERT_TRUE(input->pending());
+  TEST_ASSERT_TRUE(input->pressed(0));
+
+  nativesim::advanceMillis(40);
+  TEST_ASSERT_EQUAL_UINT32(0, input->poll());
+  TEST_ASSERT_FALSE(input->pressed(0));
+  TEST_ASSERT_FALSE(input->pending());
+}
+
+void test_quiet_line_allows_next_press() {
+  press(0);
+  input->poll();
+  nativesim::advanceMillis(100);
+  release(0);
+  input->poll();
+  nativesim::advanceMillis(100);
+  press(0);
+  input->poll();
+  TEST_ASSERT_EQUAL(2, presses[0]);
+}
+
+void test_ring_overflow_resyncs_from_pins() {
+  for (int i = 0; i < EdgeInput::kRingSize + 3; i++) {
+    nativesim::advanceMicros(100);
+    if (i % 2 == 0) press(1); else release(1);
+  }
+  // Odd count of edges: the line ends LOW
+  nativesim::advanceMillis(100);
+  input->poll();
+  TEST_ASSERT_EQUAL_UINT32(1, input->stats().overflows);
+  TEST_ASSERT_TRUE(input->pressed(1));
+  TEST_ASSERT_EQUAL(1, presses[1]);
+}
+
+void test_press_latency_histogram() {
+  handler_micros = 300;
+  press(0);
+  nativesim::advanceMicros(700);  // waiting for loop() to wake
+  input->poll();
+  TEST_ASSERT_EQUAL_UINT32(1000, input->latencyMax());
+  TEST_ASSERT_EQUAL_UINT32(1000, input->latencyPercentile(50));
+
+  nativesim::advanceMillis(100);
+  release(0);
+  input->poll();
+  nativesim::advanceMillis(100);
+  handler_micros = 20;
+  press(0);
+  input->poll();
+  TEST_ASSERT_EQUAL_UINT32(31, input->latencyPercentile(10));  // bucket [16, 32)
+  TEST_ASSERT_EQUAL_UINT32(1000, input->latencyPercentile(99));
+}
+
+void test_latency_buckets() {
+  // [2^k, 2^(k+1)) us per bucket, 0 and 1 in the first
+  const uint32_t latencies[] = {0, 1, 2, 3, 4, 1023, 1024, 40000000};
+  const int buckets[] = {0, 0, 1, 1, 2, 9, 10, EdgeInput::kLatencyBuckets - 1};
+  for (uint32_t latency : latencies) {
+    handler_micros = latency;
+    pressAndRelease();
+  }
+  for (int bucket = 0; bucket < EdgeInput::kLatencyBuckets; bucket++) {
+    uint32_t expected = 0;
+    for (int b : buckets) expected += b == bucket;
+    TEST_ASSERT_EQUAL_UINT32(expected, input->latencyCount(bucket));
+  }
+  TEST_ASSERT_EQUAL_UINT32(40000000, input->latencyMax());
+}
+
+void test_charged_handler_time_is_latency() {
+  // With the sim charging host CPU time, the work done between the edge
+  // and the relay write shows up instead of 0
+  nativesim::setCpuScale(1);
+  nativesim::beginCpuCharge();
+  handler_cpu_micros = 300;
+  pressAndRelease();
+  nativesim::endCpuCharge();
+
+  uint32_t latency = input->latencyMax();
+  TEST_ASSERT_TRUE(latency >= 300);
+  int bucket = 0;
+  while ((latency >> (bucket + 1)) != 0) bucket++;
+  TEST_ASSERT_TRUE(bucket >= 8);  // 256 us and up
+  TEST_ASSERT_EQUAL_UINT32(1, input->latencyCount(bucket));
+  TEST_ASSERT_EQUAL_UINT32(1, input->stats().presses);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_press_acts_on_first_edge);
+  RUN_TEST(test_bounces_inside_window_are_ignored);
+  RUN_TEST(test_press_during_blocking_call_is_not_lost);
+  RUN_TEST(test_poll_reports_when_window_closes);
+  RUN_TEST(test_quiet_line_allows_next_press);
+  RUN_TEST(test_ring_overflow_resyncs_from_pins);
+  RUN_TEST(test_press_latency_histogram);
+  RUN_TEST(test_latency_buckets);
+  RUN_TEST(test_charged_handler_time_is_latency);
+  return UNITY_END();
+}
@@ -0,0 +1,302 @@
+/*
+  test_main.cpp - host tests for lib/JsonArena.
+
+    pio test -e native -f test_json_arena -v
+
+  Block bookkeeping is checked directly, then through JsonDocuments shaped
+  like the firmware's: a command parsed, a status and a sensor batch built
+  and serialized, everything cleared, message after message, and the
+  sketches' local documents nested in calls. The last test
+  prints the arena's high water and stranded bytes over that run and host
+  ns per message on the arena and on the heap (-v shows it).
+*/
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <JsonArena.h>
+#include <unity.h>
+
+#include <stdio.h>
+#include <time.h>
+
+#include <string>
+
+namespace {
+
+// Two documents' variant pools (slots are two pointers wide) plus strings,
+// as main_mqtt.cpp sizes its arena
+const size_t kArenaSize = 2 * ARDUINOJSON_POOL_CAPACITY * 2 * sizeof(void*) + 1024;
+
+// Counts what reaches the heap
+class HeapAllocator : public ArduinoJson::Allocator {
+public:
+  void* allocate(size_t size) override {
+    calls++;
+    return malloc(size);
+  }
+
+  void deallocate(void* ptr) override {
+    if (ptr) calls++;
+    free(ptr);
+  }
+
+  void* reallocate(void* ptr, size_t new_size) override {
+    calls++;
+    return realloc(ptr, new_size);
+  }
+
+  uint32_t calls = 0;
+};
+
+const char* const kCommands[] = {
+    "{\"command\":\"relay\",\"value\":{\"pin\":26,\"state\":\"on\"},\"timestamp\":1705314642000}",
+    "{\"command\":\"relays\",\"value\":{\"relay1\":\"on\",\"relay2\":\"off\",\"relay3\":\"on\",\"relay4\":\"off\"}}",
+    "{\"command\":\"status\",\"device_id\":\"ESP32_A1B2C3\",\"request_id\":\"f3c1a7e2-5d4b-4c11-9e0a-2b7d6c8e1f90\"}",
+};
+
+// One message the way main_mqtt.cpp handles it; returns the bytes written
+size_t handleMessage(JsonDocument& command, JsonDocument& reply, int n) {
+  std::string payload = kCommands[n % 3];
+  if (deserializeJson(command, &payload[0], payload.size(), DeserializationOption::InSitu()) !=
+      DeserializationError::Ok) {
+    return 0;
+  }
+  reply["type"] = "relay_status";
+  reply["device_id"] = command["device_id"] | "ESP32_A1B2C3";
+  reply["request"] = command["command"];
+  JsonObject data = reply["data"].to<JsonObject>();
+  for (int i = 1; i <= 4; i++) data["relay" + std::to_string(i)] = (n + i) % 2 ? "on" : "off";
+  JsonArray samples = reply["temperature"]["v"].to<JsonArray>();
+  for (int i = 0; i < 8; i++) samples.add(25.0 + (n + i) % 10 / 10.0);
+
+  char out[512];
+  size_t written = serializeJson(reply, out, sizeof(out));
+  reply.clear();
+  command.clear();
+  return written;
+}
+
+double cpuSeconds() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Best of 5 rounds of `messages`, ns per message
+double nsPerMessage(JsonDocument& command, JsonDocument& reply, int messages) {
+  double best = 0;
+  for (int round = 0; round < 5; round++) {
+    double t0 = cpuSeconds();
+    for (int n = 0; n < messages; n++) handleMessage(command, reply, n);
+    double seconds = cpuSeconds() - t0;
+    if (round == 0 || seconds < best) best = seconds;
+  }
+  return best * 1e9 / messages;
+}
+
+// The sketches' shape: a local status document built inside the handler
+// of a local command document, each freed as its scope ends
+void publishStatusFrom(JsonArena& arena, const char* state) {
+  JsonDocument status(&arena);
+  status["device_id"] = "lights_hr_dept";
+  status["status"] = state;
+  status["sensor_readings"] = 42;
+  char out[256];
+  serializeJson(status, out, sizeof(out));
+}
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_blocks_come_off_the_top() {
+  StaticJsonArena<256> arena;
+  void* a = arena.allocate(10);
+  void* b = arena.allocate(24);
+  TEST_ASSERT_NOT_NULL(a);
+  TEST_ASSERT_EQUAL(8 + 16, (uint8_t*)b - (uint8_t*)a);  // header + 10 rounded up
+  TEST_ASSERT_EQUAL(0, (uintptr_t)b % 8);
+  TEST_ASSERT_EQUAL(8 + 16 + 8 + 24, arena.used());
+
+  arena.deallocate(b);  // the top comes back
+  TEST_ASSERT_EQUAL(8 + 16, arena.used());
+  void* c = arena.allocate(8);
+  TEST_ASSERT_EQUAL_PTR(b, c);
+
+  arena.deallocate(a);  // below the top: stranded
+  TEST_ASSERT_EQUAL(8 + 16, arena.stranded());
+  arena.deallocate(c);  // last block: empty again
+  TEST_ASSERT_EQUAL(0, arena.used());
+  TEST_ASSERT_EQUAL(0, arena.stranded());
+  TEST_ASSERT_EQUAL(1, arena.stats().resets);
+}
+
+void test_freed_blocks_under_the_top_come_back_with_it() {
+  StaticJsonArena<256> arena;
+  void* a = arena.allocate(8);
+  void* b = arena.allocate(8);
+  void* c = arena.allocate(8);
+  void* d = arena.allocate(8);
+  arena.deallocate(b);
+  arena.deallocate(c);
+  TEST_ASSERT_EQUAL(32, arena.stranded());
+  arena.deallocate(d);  // d, c and b
+  TEST_ASSERT_EQUAL(16, arena.used());
+  TEST_ASSERT_EQUAL(0, arena.stranded());
+  TEST_ASSERT_EQUAL(32, arena.stats().mostStranded);
+  TEST_ASSERT_EQUAL(1, arena.liveBlocks());
+  TEST_ASSERT_EQUAL_PTR(b, arena.allocate(8));
+  (void)a;
+}
+
+void test_reallocate() {
+  StaticJsonArena<128> arena;
+  char* a = (char*)arena.allocate(8);
+  memcpy(a, "abcdefg", 8);
+  TEST_ASSERT_EQUAL_PTR(a, arena.reallocate(a, 40));  // the top grows in place
+  TEST_ASSERT_EQUAL(48, arena.used());
+  TEST_ASSERT_EQUAL_PTR(a, arena.reallocate(a, 16));  // and shrinks
+  TEST_ASSERT_EQUAL(24, arena.used());
+
+  void* b = arena.allocate(8);
+  char* moved = (char*)arena.reallocate(a, 32);  // no longer the top: moved
+  TEST_ASSERT_TRUE(moved > (char*)b);
+  TEST_ASSERT_EQUAL_STRING("abcdefg", moved);
+  TEST_ASSERT_EQUAL(24, arena.stranded());
+
+  TEST_ASSERT_NULL(arena.reallocate(moved, 200));  // no room: the block stays
+  TEST_ASSERT_EQUAL_STRING("abcdefg", moved);
+  TEST_ASSERT_NULL(arena.allocate(1000));
+  TEST_ASSERT_NULL(arena.allocate((size_t)-1));
+  TEST_ASSERT_EQUAL(3, arena.stats().failures);
+}
+
+void test_unaligned_buffer() {
+  alignas(8) uint8_t buffer[100];
+  JsonArena arena(buffer + 3, sizeof(buffer) - 3);
+  TEST_ASSERT_EQUAL(88, arena.capacity());  // 5 bytes to the boundary, rounded down
+  void* a = arena.allocate(1);
+  TEST_ASSERT_EQUAL_PTR(buffer + 16, a);
+}
+
+void test_document_on_the_arena() {
+  StaticJsonArena<kArenaSize> arena;
+  JsonDocument doc(&arena);
+  std::string payload = kCommands[1];
+  TEST_ASSERT_TRUE(deserializeJson(doc, payload) == DeserializationError::Ok);
+  TEST_ASSERT_EQUAL_STRING("off", doc["value"]["relay2"]);
+  TEST_ASSERT_TRUE(arena.used() > 0);
+
+  doc.clear();
+  TEST_ASSERT_EQUAL(0, arena.used());
+  TEST_ASSERT_EQUAL(0, arena.liveBlocks());
+}
+
+void test_out_of_room_is_no_memory() {
+  StaticJsonArena<256> arena;
+  JsonDocument doc(&arena);
+  TEST_ASSERT_TRUE(deserializeJson(doc, kCommands[2]) == DeserializationError::NoMemory);
+  doc.clear();
+  TEST_ASSERT_EQUAL(0, arena.used());
+
+  for (int i = 0; i < 100; i++) doc.add(i);
+  TEST_ASSERT_TRUE(doc.overflowed());
+  TEST_ASSERT_TRUE(arena.stats().failures > 0);
+}
+
+void test_documents_share_one_arena() {
+  StaticJsonArena<kArenaSize> arena;
+  JsonDocument command(&arena);
+  JsonDocument reply(&arena);
+  for (int n = 0; n < 1000; n++) {
+    TEST_ASSERT_TRUE(handleMessage(command, reply, n) > 0);
+    TEST_ASSERT_EQUAL(0, arena.used());
+  }
+  TEST_ASSERT_EQUAL(0, arena.stats().failures);
+  TEST_ASSERT_EQUAL(1000, arena.stats().resets);
+
+  // Cleared in the order they were filled this time: the first one's blocks
+  // are stranded under the second's until that goes too
+  deserializeJson(command, kCommands[0]);
+  reply["status"] = "ok";
+  command.clear();
+  TEST_ASSERT_TRUE(arena.stranded() > 0);
+  reply.clear();
+  TEST_ASSERT_EQUAL(0, arena.used());
+}
+
+void test_scoped_documents_unwind() {
+  StaticJsonArena<kArenaSize> arena;
+  for (int n = 0; n < 100; n++) {
+    {
+      JsonDocument command(&arena);
+      std::string payload = kCommands[n % 3];
+      TEST_ASSERT_TRUE(deserializeJson(command, payload) == DeserializationError::Ok);
+      publishStatusFrom(arena, command["value"]["state"] | "on");
+      TEST_ASSERT_TRUE(arena.liveBlocks() > 0);  // the command is still held
+      TEST_ASSERT_EQUAL(0, arena.stranded());    // the status came off the top
+    }
+    TEST_ASSERT_EQUAL(0, arena.used());
+  }
+  TEST_ASSERT_EQUAL(0, arena.stats().failures);
+  // Only inside a destructor, as in clear()
+  TEST_ASSERT_TRUE(arena.stats().mostStranded <= ARDUINOJSON_POOL_CAPACITY * 2 * sizeof(void*) + 8);
+}
+
+void test_reset() {
+  StaticJsonArena<1024> arena;
+  {
+    JsonDocument doc(&arena);
+    doc["a"] = "some text";
+  }
+  TEST_ASSERT_EQUAL(0, arena.used());  // the destructor gave it all back
+
+  arena.allocate(100);
+  arena.allocate(100);
+  arena.reset();
+  TEST_ASSERT_EQUAL(0, arena.used());
+  TEST_ASSERT_EQUAL(0, arena.liveBlocks());
+  TEST_ASSERT_NOT_NULL(arena.allocate(1000));
+}
+
+void test_message_loop_report() {
+  const int kMessages = 20000;
+  StaticJsonArena<kArenaSize> arena;
+  JsonDocument command(&arena);
+  JsonDocument reply(&arena);
+  double arenaNs = nsPerMessage(command, reply, kMessages);
+
+  HeapAllocator heap;
+  JsonDocument heapCommand(&heap);
+  JsonDocument heapReply(&heap);
+  double heapNs = nsPerMessage(heapCommand, heapReply, kMessages);
+
+  TEST_ASSERT_EQUAL(0, arena.stats().failures);
+  TEST_ASSERT_EQUAL(0, arena.used());
+  // Only ever inside clear(), which frees a document's pool before the
+  // strings above it
+  TEST_ASSERT_TRUE(arena.stats().mostStranded <= ARDUINOJSON_POOL_CAPACITY * 2 * sizeof(void*) + 8);
+  printf("arena: high water %u of %u bytes, most stranded %u bytes (0 between messages), "
+         "%.1f blocks and %.0f ns per message\n",
+         (unsigned)arena.stats().highWater, (unsigned)arena.capacity(), (unsigned)arena.stats().mostStranded,
+         (double)arena.stats().allocations / (5 * kMessages), arenaNs);
+  printf("heap:  %.1f malloc/realloc/free calls and %.0f ns per message (%.2fx the arena)\n",
+         (double)heap.calls / (5 * kMessages), heapNs, heapNs / arenaNs);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_blocks_come_off_the_top);
+  RUN_TEST(test_freed_blocks_under_the_top_come_back_with_it);
+  RUN_TEST(test_reallocate);
+  RUN_TEST(test_unaligned_buffer);
+  RUN_TEST(test_document_on_the_arena);
+  RUN_TEST(test_out_of_room_is_no_memory);
+  RUN_TEST(test_documents_share_one_arena);
+  RUN_TEST(test_scoped_documents_unwind);
+  RUN_TEST(test_reset);
+  RUN_TEST(test_message_loop_report);
+  return UNITY_END();
+}
@@ -0,0 +1,236 @@
+/*
+  test_main.cpp - host tests for DeserializationOption::InSitu.
+
+    pio test -e native -f test_json_insitu
+
+  An in-situ parse unescapes quoted strings inside the input buffer and links
+  the document to them. Results are checked against a normal (copying) parse
+  of the same text, and the lifetime rules against the buffer itself.
+*/
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include <string>
+
+namespace {
+
+class CountingAllocator : public ArduinoJson::Allocator {
+ public:
+  void* allocate(size_t size) override {
+    allocations++;
+    return malloc(size);
+  }
+
+  void deallocate(void* ptr) override {
+    free(ptr);
+  }
+
+  void* reallocate(void* ptr, size_t new_size) override {
+    if (!ptr) allocations++;
+    return realloc(ptr, new_size);
+  }
+
+  int allocations = 0;
+};
+
+bool inBuffer(const char* p, const std::string& buffer) {
+  return p >= buffer.data() && p < buffer.data() + buffer.size();
+}
+
+std::string serialize(JsonDocument& doc) {
+  std::string json;
+  serializeJson(doc, json);
+  return json;
+}
+
+// In place and by copy must give the same document and error
+void checkSameAsCopy(const std::string& input) {
+  JsonDocument copied;
+  DeserializationError expected = deserializeJson(copied, input.data(), input.size());
+
+  std::string buffer = input;
+  JsonDocument linked;
+  DeserializationError actual = deserializeJson(linked, &buffer[0], buffer.size(), DeserializationOption::InSitu());
+
+  TEST_ASSERT_EQUAL_STRING(expected.c_str(), actual.c_str());
+  TEST_ASSERT_EQUAL_STRING(serialize(copied).c_str(), serialize(linked).c_str());
+}
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_strings_point_into_the_buffer() {
+  std::string buffer = "{\"command\":\"relay\",\"value\":{\"pin\":26,\"state\":\"on\"}}";
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(deserializeJson(doc, &buffer[0], buffer.size(), DeserializationOption::InSitu()) ==
+                   DeserializationError::Ok);
+
+  TEST_ASSERT_EQUAL_STRING("relay", doc["command"].as<const char*>());
+  TEST_ASSERT_EQUAL(26, doc["value"]["pin"].as<int>());
+  TEST_ASSERT_TRUE(inBuffer(doc["command"].as<const char*>(), buffer));
+  TEST_ASSERT_TRUE(inBuffer(doc["value"]["state"].as<const char*>(), buffer));  // short strings too
+  for (JsonPair pair : doc.as<JsonObject>()) TEST_ASSERT_TRUE(inBuffer(pair.key().c_str(), buffer));
+  TEST_ASSERT_TRUE(doc["command"].as<JsonString>().isStatic());
+}
+
+void test_only_the_variant_pool_is_allocated() {
+  const char* json = "{\"command\":\"relays\",\"value\":{\"relay1\":\"on\",\"relay2\":\"off\",\"relay3\":\"on\"}}";
+
+  CountingAllocator copying;
+  JsonDocument copied(&copying);
+  deserializeJson(copied, json);
+
+  CountingAllocator linking;
+  JsonDocument linked(&linking);
+  std::string buffer = json;
+  deserializeJson(linked, &buffer[0], buffer.size(), DeserializationOption::InSitu());
+
+  TEST_ASSERT_EQUAL(1, linking.allocations);
+  TEST_ASSERT_TRUE(copying.allocations > linking.allocations);
+}
+
+void test_escapes_are_unescaped_in_place() {
+  std::string buffer = "[\"a\\\"b\",\"tab\\there\",\"\\\\\\/\",\"caf\\u00e9\",\"\\ud83d\\ude00!\",\"\\n\"]";
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(deserializeJson(doc, &buffer[0], buffer.size(), DeserializationOption::InSitu()) ==
+                   DeserializationError::Ok);
+
+  TEST_ASSERT_EQUAL_STRING("a\"b", doc[0].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("tab\there", doc[1].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("\\/", doc[2].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("caf\xC3\xA9", doc[3].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("\xF0\x9F\x98\x80!", doc[4].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("\n", doc[5].as<const char*>());
+  for (JsonVariant item : doc.as<JsonArray>()) TEST_ASSERT_TRUE(inBuffer(item.as<const char*>(), buffer));
+}
+
+void test_same_result_as_a_copy() {
+  const char* inputs[] = {
+      "{\"command\":\"status\",\"value\":null,\"timestamp\":1705314642000}",
+      "{'single':'quotes','mixed':\"it's\"}",
+      "{\"k\\u00e9y\":\"v\\u00e0lue\",\"k\\u00e9y\":\"again\"}",  // duplicate key, escaped
+      "[\"\",\"\\\"\",\"x\\\\\",\"\\\\\\\\\\\\\\\\\"]",
+      "{\"a\":[\"1\",{\"b\":\"2\\t\"}],\"c\":\"3\"}",
+      "[\"abcdefghijklmnopqrstuvwxyz\\nabcdefghijklmnopqrstuvwxyz\\nabcdefghijklmnopqrstuvwxyz\"]",
+      "\"just a string\"",
+      "{\"a\":\"b\",\"c\"",
+      "[\"unterminated",
+      "[\"bad \\x escape\"]",
+      "[\"\\ud83d\"]",
+  };
+  for (const char* input : inputs) checkSameAsCopy(input);
+}
+
+void test_nul_escape_is_copied() {
+  // A linked string ends at its first NUL, so one with \u0000 is copied
+  std::string buffer = "{\"k\":\"a\\u0000b\",\"n\":\"plain\"}";
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(deserializeJson(doc, &buffer[0], buffer.size(), DeserializationOption::InSitu()) ==
+                   DeserializationError::Ok);
+
+  JsonString k = doc["k"].as<JsonString>();
+  TEST_ASSERT_EQUAL(3, k.size());
+  TEST_ASSERT_EQUAL_MEMORY("a\0b", k.c_str(), 3);
+  TEST_ASSERT_FALSE(inBuffer(k.c_str(), buffer));
+  TEST_ASSERT_TRUE(inBuffer(doc["n"].as<const char*>(), buffer));
+}
+
+void test_unquoted_keys_are_copied() {
+  std::string buffer = "{relay1:\"on\",\"relay2\":\"off\"}";
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(deserializeJson(doc, &buffer[0], buffer.size(), DeserializationOption::InSitu()) ==
+                   DeserializationError::Ok);
+
+  JsonObject object = doc.as<JsonObject>();
+  JsonObject::iterator it = object.begin();
+  TEST_ASSERT_EQUAL_STRING("relay1", it->key().c_str());
+  TEST_ASSERT_FALSE(inBuffer(it->key().c_str(), buffer));
+  ++it;
+  TEST_ASSERT_EQUAL_STRING("relay2", it->key().c_str());
+  TEST_ASSERT_TRUE(inBuffer(it->key().c_str(), buffer));
+  TEST_ASSERT_EQUAL_STRING("on", doc["relay1"].as<const char*>());
+}
+
+void test_nothing_past_the_length_is_written() {
+  std::string buffer = "[\"a\\nb\"]\"tail\"";
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(deserializeJson(doc, &buffer[0], 8, DeserializationOption::InSitu()) == DeserializationError::Ok);
+  TEST_ASSERT_EQUAL_STRING("a\nb", doc[0].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("\"tail\"", buffer.c_str() + 8);
+}
+
+void test_nul_terminated_input() {
+  char buffer[] = "{\"command\":\"read_sensors\"}";
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(deserializeJson(doc, buffer, DeserializationOption::InSitu()) == DeserializationError::Ok);
+  TEST_ASSERT_EQUAL_STRING("read_sensors", doc["command"].as<const char*>());
+  TEST_ASSERT_TRUE(doc["command"].as<const char*>() > buffer);
+
+  byte payload[] = "{\"command\":\"status\"}";  // as PubSubClient hands it over
+  TEST_ASSERT_TRUE(deserializeJson(doc, payload, sizeof(payload) - 1, DeserializationOption::InSitu()) ==
+                   DeserializationError::Ok);
+  TEST_ASSERT_EQUAL_STRING("status", doc["command"].as<const char*>());
+}
+
+void test_filter_and_nesting_limit() {
+  std::string buffer = "{\"skip\":\"x\\ny\",\"keep\":{\"a\":\"b\\tc\"}}";
+  JsonDocument filter;
+  filter["keep"] = true;
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(deserializeJson(doc, &buffer[0], buffer.size(), DeserializationOption::InSitu(),
+                                   DeserializationOption::Filter(filter)) == DeserializationError::Ok);
+  TEST_ASSERT_EQUAL_STRING("{\"keep\":{\"a\":\"b\\tc\"}}", serialize(doc).c_str());
+
+  buffer = "{\"a\":{\"b\":\"c\"}}";
+  TEST_ASSERT_TRUE(deserializeJson(doc, &buffer[0], buffer.size(), DeserializationOption::InSitu(),
+                                   DeserializationOption::NestingLimit(1)) == DeserializationError::TooDeep);
+}
+
+void test_document_follows_the_buffer() {
+  std::string buffer = "{\"command\":\"relay\"}";
+  JsonDocument doc;
+  deserializeJson(doc, &buffer[0], buffer.size(), DeserializationOption::InSitu());
+
+  String kept = doc["command"].as<String>();  // a copy outlives the buffer
+  JsonDocument assigned;
+  assigned.set(doc);  // links to the same characters
+
+  char* value = const_cast<char*>(doc["command"].as<const char*>());
+  memcpy(value, "RELAY", 5);  // PubSubClient reusing its buffer
+  TEST_ASSERT_EQUAL_STRING("RELAY", doc["command"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("RELAY", assigned["command"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("relay", kept.c_str());
+}
+
+void test_buffer_is_consumed() {
+  // The parse is destructive: strings are terminated in place, so the same
+  // buffer does not parse to the same document a second time
+  std::string buffer = "{\"a\":\"b\"}";
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(deserializeJson(doc, &buffer[0], buffer.size(), DeserializationOption::InSitu()) ==
+                   DeserializationError::Ok);
+  TEST_ASSERT_EQUAL_MEMORY("{\"a\0:\"b\0}", buffer.data(), buffer.size());
+  TEST_ASSERT_TRUE(deserializeJson(doc, &buffer[0], buffer.size(), DeserializationOption::InSitu()) !=
+                   DeserializationError::Ok);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_strings_point_into_the_buffer);
+  RUN_TEST(test_only_the_variant_pool_is_allocated);
+  RUN_TEST(test_escapes_are_unescaped_in_place);
+  RUN_TEST(test_same_result_as_a_copy);
+  RUN_TEST(test_nul_escape_is_copied);
+  RUN_TEST(test_unquoted_keys_are_copied);
+  RUN_TEST(test_nothing_past_the_length_is_written);
+  RUN_TEST(test_nul_terminated_input);
+  RUN_TEST(test_filter_and_nesting_limit);
+  RUN_TEST(test_document_follows_the_buffer);
+  RUN_TEST(test_buffer_is_consumed);
+  return UNITY_END();
+}
@@ -0,0 +1,208 @@
+/*
+  test_main.cpp - host tests for deserializeJson()'s contiguous-input path.
+
+    pio test -e native -f test_json_scan
+
+  Input already in RAM (char*, char* + size, String) is scanned a machine
+  word at a time; a Stream-like source still goes through read() one byte at
+  a time. Every case is parsed both ways and must give the same error and the
+  same document.
+*/
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include <string>
+
+namespace {
+
+// A Stream-like source: one byte per read()
+struct ByteSource {
+  const char* ptr;
+  const char* end;
+
+  int read() {
+    return ptr < end ? (unsigned char)*ptr++ : -1;
+  }
+
+  size_t readBytes(char* buffer, size_t length) {
+    size_t n = 0;
+    while (n < length && ptr < end) buffer[n++] = *ptr++;
+    return n;
+  }
+};
+
+struct Parsed {
+  DeserializationError error;
+  std::string json;
+};
+
+Parsed parseBytewise(const std::string& input) {
+  JsonDocument doc;
+  ByteSource source = {input.data(), input.data() + input.size()};
+  Parsed parsed = {deserializeJson(doc, source), ""};
+  serializeJson(doc, parsed.json);
+  return parsed;
+}
+
+Parsed parseSized(const std::string& input) {
+  JsonDocument doc;
+  Parsed parsed = {deserializeJson(doc, input.data(), input.size()), ""};
+  serializeJson(doc, parsed.json);
+  return parsed;
+}
+
+Parsed parseTerminated(const std::string& input) {
+  JsonDocument doc;
+  Parsed parsed = {deserializeJson(doc, input.c_str()), ""};
+  serializeJson(doc, parsed.json);
+  return parsed;
+}
+
+Parsed parseString(const std::string& input) {
+  JsonDocument doc;
+  Parsed parsed = {deserializeJson(doc, String(input.c_str())), ""};
+  serializeJson(doc, parsed.json);
+  return parsed;
+}
+
+void checkSame(const Parsed& expected, const Parsed& actual, const char* path) {
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(expected.error.c_str(), actual.error.c_str(), path);
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(expected.json.c_str(), actual.json.c_str(), path);
+}
+
+// Same result from every reader; returns it for further checks
+Parsed checkAllReaders(const std::string& input) {
+  Parsed expected = parseBytewise(input);
+  checkSame(expected, parseSized(input), "char* + size");
+  if (input.find('\0') == std::string::npos) {
+    checkSame(expected, parseTerminated(input), "char*");
+    checkSame(expected, parseString(input), "String");
+  }
+  return expected;
+}
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_dashboard_command() {
+  Parsed parsed = checkAllReaders(
+      "{\"command\":\"relays\",\"value\":{\"relay1\":\"on\",\"relay2\":\"off\"},\"timestamp\":1705314642000}");
+  TEST_ASSERT_TRUE(parsed.error == DeserializationError::Ok);
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"command\":\"relays\",\"value\":{\"relay1\":\"on\",\"relay2\":\"off\"},\"timestamp\":1705314642000}",
+      parsed.json.c_str());
+}
+
+void test_strings_of_every_length_around_a_word() {
+  // The word loop stops and the byte loop takes over at every offset
+  for (size_t length = 0; length <= 40; length++) {
+    std::string text;
+    for (size_t i = 0; i < length; i++) text += char('a' + i % 26);
+    Parsed parsed = checkAllReaders("[\"" + text + "\",'" + text + "',\"" + text + "\\n\"]");
+    TEST_ASSERT_EQUAL_STRING(("[\"" + text + "\",\"" + text + "\",\"" + text + "\\n\"]").c_str(), parsed.json.c_str());
+  }
+}
+
+void test_escapes_at_every_offset() {
+  const char* escapes[] = {"\\\"", "\\\\", "\\/", "\\b", "\\f", "\\n", "\\r", "\\t", "\\u00e9", "\\ud83d\\ude00"};
+  for (const char* escape : escapes) {
+    for (size_t offset = 0; offset <= 17; offset++) {
+      std::string before(offset, 'x');
+      Parsed parsed = checkAllReaders("{\"k" + before + escape + "\":\"" + before + escape + "y\"}");
+      TEST_ASSERT_TRUE(parsed.error == DeserializationError::Ok);
+    }
+  }
+}
+
+void test_quote_of_the_other_kind_is_plain_text() {
+  Parsed parsed = checkAllReaders("['it\"s',\"don't\"]");
+  TEST_ASSERT_EQUAL_STRING("[\"it\\\"s\",\"don't\"]", parsed.json.c_str());
+}
+
+void test_whitespace_runs() {
+  std::string pretty = "{\r\n";
+  for (int i = 0; i < 12; i++) pretty += (i % 2 ? "\t" : "  ");
+  pretty += "\"a\" :\n\n\n                   [ 1 ,\t\t\t\t\t\t\t\t\t2 ]\r\n}   \t\n";
+  Parsed parsed = checkAllReaders(pretty);
+  TEST_ASSERT_EQUAL_STRING("{\"a\":[1,2]}", parsed.json.c_str());
+}
+
+void test_unquoted_keys_between_runs() {
+  Parsed parsed = checkAllReaders("{        relay1:   \"on\"  ,\n  relay2  :'off' }");
+  TEST_ASSERT_EQUAL_STRING("{\"relay1\":\"on\",\"relay2\":\"off\"}", parsed.json.c_str());
+
+#if ARDUINOJSON_ENABLE_COMMENTS
+  parsed = checkAllReaders("{        // relay map\n  \"r1\"/* first */:   \"on\" }");
+  TEST_ASSERT_EQUAL_STRING("{\"r1\":\"on\"}", parsed.json.c_str());
+#else
+  parsed = checkAllReaders("{        // relay map\n  \"r1\":   \"on\" }");
+  TEST_ASSERT_TRUE(parsed.error == DeserializationError::InvalidInput);
+#endif
+}
+
+void test_truncated_inside_a_run() {
+  std::string full = "{\"message\":\"relay 3 switched by schedule at dawn\",   \"n\":   1}";
+  for (size_t length = 0; length < full.size(); length++) {
+    Parsed parsed = checkAllReaders(full.substr(0, length));
+    TEST_ASSERT_TRUE(parsed.error != DeserializationError::Ok);
+  }
+}
+
+void test_embedded_nul_ends_the_input() {
+  std::string input("[\"abcdefghijk", 13);
+  input += '\0';
+  input += "lmnop\"]";
+  Parsed parsed = checkAllReaders(input);
+  TEST_ASSERT_TRUE(parsed.error == DeserializationError::IncompleteInput);
+
+  std::string spaces("[1,        ", 11);
+  spaces += '\0';
+  spaces += "2]";
+  parsed = checkAllReaders(spaces);
+  TEST_ASSERT_TRUE(parsed.error == DeserializationError::IncompleteInput);
+}
+
+void test_filter_skips_long_strings() {
+  std::string text(300, 'z');
+  std::string input = "{\"skip\":\"" + text + "\\\"" + text + "\",\"keep\":\"" + text + "\"}";
+  JsonDocument filter;
+  filter["keep"] = true;
+
+  JsonDocument bytewise, sized;
+  ByteSource source = {input.data(), input.data() + input.size()};
+  TEST_ASSERT_TRUE(deserializeJson(bytewise, source, DeserializationOption::Filter(filter)) ==
+                   DeserializationError::Ok);
+  TEST_ASSERT_TRUE(deserializeJson(sized, input.data(), input.size(), DeserializationOption::Filter(filter)) ==
+                   DeserializationError::Ok);
+  TEST_ASSERT_FALSE(sized["skip"].is<const char*>());
+  TEST_ASSERT_EQUAL_STRING(text.c_str(), sized["keep"].as<const char*>());
+  TEST_ASSERT_TRUE(bytewise == sized);
+}
+
+void test_trailing_text_is_ignored() {
+  // Parsing stops after the first value, as it does with read()
+  const char* input = "{\"a\":\"b\"}    garbage";
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(deserializeJson(doc, input) == DeserializationError::Ok);
+  TEST_ASSERT_EQUAL_STRING("b", doc["a"].as<const char*>());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_dashboard_command);
+  RUN_TEST(test_strings_of_every_length_around_a_word);
+  RUN_TEST(test_escapes_at_every_offset);
+  RUN_TEST(test_quote_of_the_other_kind_is_plain_text);
+  RUN_TEST(test_whitespace_runs);
+  RUN_TEST(test_unquoted_keys_between_runs);
+  RUN_TEST(test_truncated_inside_a_run);
+  RUN_TEST(test_embedded_nul_ends_the_input);
+  RUN_TEST(test_filter_skips_long_strings);
+  RUN_TEST(test_trailing_text_is_ignored);
+  return UNITY_END();
+}
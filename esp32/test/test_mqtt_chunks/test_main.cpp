@@ -0,0 +1,166 @@
+/*
+  test_main.cpp - host tests for streaming receive of messages larger than
+  the PubSubClient buffer.
+
+    pio test -e native -f test_mqtt_chunks
+
+  The LoopbackBroker injects PUBLISH packets of any size; with a chunk
+  callback set, the ones that do not fit arrive in pieces no larger than
+  the buffer instead of being dropped.
+*/
+
+#include <Arduino.h>
+#include <LoopbackBroker.h>
+#include <NativeSim.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <unity.h>
+
+namespace {
+
+const char* kTopic = "esp32/ESP32_TEST01/control";
+const uint16_t kBufferSize = 128;
+const size_t kLarge = 5000;
+
+WiFiClient* net;
+PubSubClient* client;
+uint8_t received[kLarge];
+size_t receivedLength;
+uint32_t expectedOffset;
+uint32_t totalSeen;
+unsigned int largestChunk;
+int chunks;
+int messages;
+bool outOfOrder;
+char chunkTopic[64];
+
+void onMessage(char*, uint8_t*, unsigned int) { messages++; }
+
+void onChunk(char* topic, uint8_t* chunk, unsigned int length, uint32_t offset, uint32_t total) {
+  if (offset != expectedOffset) outOfOrder = true;
+  strncpy(chunkTopic, topic, sizeof(chunkTopic) - 1);
+  memcpy(received + offset, chunk, length);
+  receivedLength += length;
+  expectedOffset = offset + length;
+  totalSeen = total;
+  if (length > largestChunk) largestChunk = length;
+  chunks++;
+}
+
+LoopbackBroker& broker() { return LoopbackBroker::instance(); }
+
+void drain() {
+  while (broker().pendingToDevice()) client->loop();
+}
+
+void fill(uint8_t* payload, size_t length) {
+  for (size_t i = 0; i < length; i++) payload[i] = (uint8_t)(i * 7 + 3);
+}
+
+}  // namespace
+
+void setUp() {
+  nativesim::resetClock();
+  broker().setOnline(true);
+  broker().resetStats();
+  memset(received, 0, sizeof(received));
+  memset(chunkTopic, 0, sizeof(chunkTopic));
+  receivedLength = expectedOffset = totalSeen = largestChunk = 0;
+  chunks = messages = 0;
+  outOfOrder = false;
+  net = new WiFiClient();
+  client = new PubSubClient(*net);
+  client->setServer("broker", 1883).setCallback(onMessage).setChunkCallback(onChunk);
+  client->setBufferSize(kBufferSize);
+  TEST_ASSERT_TRUE(client->connect("chunk_test"));
+  TEST_ASSERT_TRUE(client->subscribe("#"));
+  drain();
+}
+
+void tearDown() {
+  client->disconnect();
+  delete client;
+  delete net;
+}
+
+void test_large_message_arrives_in_order() {
+  static uint8_t payload[kLarge];
+  fill(payload, kLarge);
+  TEST_ASSERT_TRUE(broker().inject(kTopic, payload, kLarge));
+  drain();
+  TEST_ASSERT_EQUAL(0, messages);
+  TEST_ASSERT_FALSE(outOfOrder);
+  TEST_ASSERT_EQUAL(kLarge, receivedLength);
+  TEST_ASSERT_EQUAL_UINT32(kLarge, totalSeen);
+  TEST_ASSERT_EQUAL_MEMORY(payload, received, kLarge);
+  TEST_ASSERT_EQUAL_STRING(kTopic, chunkTopic);
+  // Every chunk fits in the buffer after the topic
+  TEST_ASSERT_TRUE(largestChunk <= kBufferSize - strlen(kTopic) - 1);
+  TEST_ASSERT_TRUE(chunks > 1);
+  TEST_ASSERT_TRUE(client->connected());
+}
+
+void test_small_message_uses_regular_callback() {
+  TEST_ASSERT_TRUE(broker().inject(kTopic, "{\"command\":\"get_status\"}"));
+  drain();
+  TEST_ASSERT_EQUAL(1, messages);
+  TEST_ASSERT_EQUAL(0, chunks);
+}
+
+void test_large_qos1_message_is_acknowledged() {
+  static uint8_t payload[1000];
+  fill(payload, sizeof(payload));
+  TEST_ASSERT_TRUE(broker().inject(kTopic, payload, sizeof(payload), 1));
+  drain();
+  TEST_ASSERT_EQUAL(sizeof(payload), receivedLength);
+  TEST_ASSERT_EQUAL_MEMORY(payload, received, sizeof(payload));
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().pubacksReceived);
+}
+
+void test_next_packet_follows_streamed_message() {
+  static uint8_t payload[600];
+  fill(payload, sizeof(payload));
+  TEST_ASSERT_TRUE(broker().inject(kTopic, payload, sizeof(payload)));
+  TEST_ASSERT_TRUE(broker().inject(kTopic, "{\"command\":\"get_status\"}"));
+  drain();
+  TEST_ASSERT_EQUAL(sizeof(payload), receivedLength);
+  TEST_ASSERT_EQUAL(1, messages);
+}
+
+void test_topic_too_long_for_buffer_is_skipped() {
+  char topic[kBufferSize];
+  memset(topic, 'x', sizeof(topic) - 1);
+  topic[sizeof(topic) - 1] = 0;
+  static uint8_t payload[400];
+  fill(payload, sizeof(payload));
+  TEST_ASSERT_TRUE(broker().inject(topic, payload, sizeof(payload)));
+  TEST_ASSERT_TRUE(broker().inject(kTopic, "{\"command\":\"get_status\"}"));
+  drain();
+  TEST_ASSERT_EQUAL(0, chunks);
+  TEST_ASSERT_EQUAL(1, messages);
+  TEST_ASSERT_TRUE(client->connected());
+}
+
+void test_without_chunk_callback_large_message_is_dropped() {
+  client->setChunkCallback(NULL);
+  static uint8_t payload[600];
+  fill(payload, sizeof(payload));
+  TEST_ASSERT_TRUE(broker().inject(kTopic, payload, sizeof(payload)));
+  drain();
+  TEST_ASSERT_EQUAL(0, chunks);
+  TEST_ASSERT_EQUAL(0, messages);
+  TEST_ASSERT_TRUE(client->connected());
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_large_message_arrives_in_order);
+  RUN_TEST(test_small_message_uses_regular_callback);
+  RUN_TEST(test_large_qos1_message_is_acknowledged);
+  RUN_TEST(test_next_packet_follows_streamed_message);
+  RUN_TEST(test_topic_too_long_for_buffer_is_skipped);
+  RUN_TEST(test_without_chunk_callback_large_message_is_dropped);
+  return UNITY_END();
+}
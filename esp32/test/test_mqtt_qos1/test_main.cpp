@@ -0,0 +1,212 @@
+/*
+  test_main.cpp - host tests for QoS 1 publishing in PubSubClient.
+
+    pio test -e native -f test_mqtt_qos1
+
+  The client talks to the in-process LoopbackBroker, which answers every
+  QoS 1 PUBLISH with a PUBACK unless setPubackLoss() withholds it.
+*/
+
+#include <Arduino.h>
+#include <LoopbackBroker.h>
+#include <NativeSim.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <unity.h>
+
+namespace {
+
+const char* kTopic = "esp32/ESP32_TEST01/status";
+const uint8_t kPayload[] = "{\"relay1\":true}";
+const uint16_t kRetryMs = 1000;
+
+WiFiClient* net;
+PubSubClient* client;
+int acks;
+int failures;
+uint16_t lastAcked;
+uint8_t lastHeader;
+int seen;
+
+void onAck(uint16_t msgId, boolean delivered) {
+  if (delivered) acks++; else failures++;
+  lastAcked = msgId;
+}
+
+LoopbackBroker& broker() { return LoopbackBroker::instance(); }
+
+bool publish() {
+  return client->publish(kTopic, kPayload, sizeof(kPayload) - 1, false, 1, onAck);
+}
+
+// Lets the client take everything the broker has sent
+void drain() {
+  while (broker().pendingToDevice()) client->loop();
+}
+
+}  // namespace
+
+void setUp() {
+  nativesim::resetClock();
+  broker().setOnline(true);
+  broker().setPubackLoss(0);
+  broker().resetStats();
+  broker().setPublishObserver([](const char*, const uint8_t*, size_t, uint8_t header) {
+    lastHeader = header;
+    seen++;
+  });
+  acks = failures = seen = 0;
+  lastAcked = 0;
+  net = new WiFiClient();
+  client = new PubSubClient(*net);
+  client->setServer("broker", 1883).setRetryInterval(kRetryMs);
+  TEST_ASSERT_TRUE(client->connect("qos1_test"));
+}
+
+void tearDown() {
+  client->disconnect();
+  delete client;
+  delete net;
+  broker().setPublishObserver(nullptr);
+}
+
+void test_puback_completes_publish() {
+  TEST_ASSERT_TRUE(publish());
+  uint16_t id = client->lastPublishId();
+  TEST_ASSERT_EQUAL_UINT8(0x32, lastHeader);  // PUBLISH, QoS 1
+  TEST_ASSERT_EQUAL(1, client->inflightCount());
+  drain();
+  TEST_ASSERT_EQUAL(1, acks);
+  TEST_ASSERT_EQUAL_UINT16(id, lastAcked);
+  TEST_ASSERT_EQUAL(0, client->inflightCount());
+  TEST_ASSERT_EQUAL_UINT32(1, client->qos1Stats().acked);
+}
+
+void test_full_window_refuses_publish() {
+  for (int i = 0; i < MQTT_MAX_INFLIGHT; i++) TEST_ASSERT_TRUE(publish());
+  TEST_ASSERT_FALSE(publish());
+  TEST_ASSERT_EQUAL_UINT32(1, client->qos1Stats().windowFull);
+  drain();
+  TEST_ASSERT_EQUAL(MQTT_MAX_INFLIGHT, acks);
+  TEST_ASSERT_TRUE(publish());
+}
+
+void test_one_loop_takes_buffered_pubacks_up_to_budget() {
+  for (int i = 0; i < MQTT_MAX_INFLIGHT; i++) TEST_ASSERT_TRUE(publish());
+  client->setLoopBudget(5);
+  client->loop();
+  TEST_ASSERT_EQUAL_UINT16(5, client->lastLoopPackets());
+  TEST_ASSERT_EQUAL(5, acks);
+  client->loop();
+  TEST_ASSERT_EQUAL_UINT16(MQTT_MAX_INFLIGHT - 5, client->lastLoopPackets());
+  TEST_ASSERT_EQUAL(MQTT_MAX_INFLIGHT, acks);
+  client->loop();
+  TEST_ASSERT_EQUAL_UINT16(0, client->lastLoopPackets());
+}
+
+void test_packet_ids_are_distinct() {
+  TEST_ASSERT_TRUE(publish());
+  uint16_t first = client->lastPublishId();
+  TEST_ASSERT_TRUE(publish());
+  TEST_ASSERT_TRUE(client->lastPublishId() != first);
+  TEST_ASSERT_TRUE(client->lastPublishId() != 0);
+}
+
+void test_lost_puback_is_retransmitted_with_dup() {
+  broker().setPubackLoss(1);
+  TEST_ASSERT_TRUE(publish());
+  client->loop();
+  TEST_ASSERT_EQUAL(1, seen);
+
+  nativesim::advanceMillis(kRetryMs - 1);
+  client->loop();
+  TEST_ASSERT_EQUAL(1, seen);  // not yet due
+
+  broker().setPubackLoss(0);
+  nativesim::advanceMillis(1);
+  client->loop();
+  TEST_ASSERT_EQUAL(2, seen);
+  TEST_ASSERT_EQUAL_UINT8(0x3A, lastHeader);  // PUBLISH, DUP, QoS 1
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().duplicates);
+  drain();
+  TEST_ASSERT_EQUAL(1, acks);
+  TEST_ASSERT_EQUAL_UINT32(1, client->qos1Stats().retransmits);
+}
+
+void test_gives_up_after_max_retries() {
+  broker().setPubackLoss(1);
+  TEST_ASSERT_TRUE(publish());
+  for (int i = 0; i <= MQTT_MAX_RETRIES; i++) {
+    nativesim::advanceMillis(kRetryMs);
+    client->loop();
+  }
+  TEST_ASSERT_EQUAL(0, acks);
+  TEST_ASSERT_EQUAL(1, failures);
+  TEST_ASSERT_EQUAL(0, client->inflightCount());
+  TEST_ASSERT_EQUAL(1 + MQTT_MAX_RETRIES, seen);
+  TEST_ASSERT_EQUAL_UINT32(1, client->qos1Stats().expired);
+}
+
+void test_reconnect_resends_unacknowledged() {
+  broker().setPubackLoss(1);
+  TEST_ASSERT_TRUE(publish());
+  uint16_t id = client->lastPublishId();
+  broker().dropSession();
+  TEST_ASSERT_FALSE(client->connected());
+
+  broker().setPubackLoss(0);
+  TEST_ASSERT_TRUE(client->connect("qos1_test"));
+  TEST_ASSERT_EQUAL(2, seen);  // sent again before connect() returns
+  TEST_ASSERT_EQUAL_UINT8(0x3A, lastHeader);
+  drain();
+  TEST_ASSERT_EQUAL(1, acks);
+  TEST_ASSERT_EQUAL_UINT16(id, lastAcked);
+}
+
+void test_streamed_qos1_publish_is_kept_for_retransmit() {
+  broker().setPubackLoss(1);
+  const char* parts[] = {"{\"relay1\":", "true", "}"};
+  TEST_ASSERT_TRUE(client->beginPublish(kTopic, 15, false, 1, onAck));
+  for (const char* part : parts) client->write((const uint8_t*)part, strlen(part));
+  TEST_ASSERT_EQUAL(1, client->endPublish());
+
+  static uint8_t resent[32];
+  static size_t resentLength;
+  broker().setPublishObserver([](const char*, const uint8_t* payload, size_t length, uint8_t header) {
+    lastHeader = header;
+    memcpy(resent, payload, length);
+    resentLength = length;
+  });
+  broker().setPubackLoss(0);
+  nativesim::advanceMillis(kRetryMs);
+  client->loop();
+  TEST_ASSERT_EQUAL_UINT8(0x3A, lastHeader);
+  TEST_ASSERT_EQUAL(15, resentLength);
+  TEST_ASSERT_EQUAL_MEMORY("{\"relay1\":true}", resent, 15);
+  drain();
+  TEST_ASSERT_EQUAL(1, acks);
+}
+
+void test_qos0_is_unchanged() {
+  TEST_ASSERT_TRUE(client->publish(kTopic, kPayload, sizeof(kPayload) - 1, false, 0, onAck));
+  TEST_ASSERT_EQUAL_UINT8(0x30, lastHeader);
+  TEST_ASSERT_EQUAL(0, client->inflightCount());
+  drain();
+  TEST_ASSERT_EQUAL(0, acks);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_puback_completes_publish);
+  RUN_TEST(test_full_window_refuses_publish);
+  RUN_TEST(test_one_loop_takes_buffered_pubacks_up_to_budget);
+  RUN_TEST(test_packet_ids_are_distinct);
+  RUN_TEST(test_lost_puback_is_retransmitted_with_dup);
+  RUN_TEST(test_gives_up_after_max_retries);
+  RUN_TEST(test_reconnect_resends_unacknowledged);
+  RUN_TEST(test_streamed_qos1_publish_is_kept_for_retransmit);
+  RUN_TEST(test_qos0_is_unchanged);
+  return UNITY_END();
+}
@@ -0,0 +1,358 @@
+/*
+  test_main.cpp - host tests for MQTT 5 in PubSubClient.
+
+    pio test -e native -f test_mqtt_v5
+
+  The LoopbackBroker speaks MQTT 5 unless setMqtt5(false): it hands out
+  topic aliases up to setTopicAliasMaximum(), decodes publish properties
+  into lastProperties() and holds QoS 1 messages back while the device's
+  Receive Maximum is used up.
+*/
+
+#include <Arduino.h>
+#include <LoopbackBroker.h>
+#include <NativeSim.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <unity.h>
+
+#include <string>
+
+namespace {
+
+const char* kStatus = "esp32/ESP32_TEST01/status";
+const char* kData = "esp32/ESP32_TEST01/data";
+const char* kCommand = "esp32/ESP32_TEST01/command";
+const uint8_t kPayload[] = "{\"relay1\":true}";
+const uint16_t kBufferSize = 256;
+const uint16_t kRetryMs = 1000;
+
+WiFiClient* net;
+PubSubClient* client;
+std::string lastTopic;
+uint8_t lastHeader;
+int seen;
+int acks;
+int received;
+std::string receivedPayload;
+
+void onAck(uint16_t, boolean delivered) {
+  if (delivered) acks++;
+}
+
+void onMessage(char* topic, uint8_t* payload, unsigned int length) {
+  (void)topic;
+  received++;
+  receivedPayload.assign((const char*)payload, length);
+}
+
+LoopbackBroker& broker() { return LoopbackBroker::instance(); }
+
+bool publish(const char* topic, uint8_t qos = 0, const MqttProperties* properties = nullptr) {
+  return client->publish(topic, kPayload, sizeof(kPayload) - 1, false, qos, onAck, properties);
+}
+
+void drain() {
+  while (broker().pendingToDevice()) client->loop();
+}
+
+bool connect() {
+  return client->connect("v5_test");
+}
+
+}  // namespace
+
+void setUp() {
+  nativesim::resetClock();
+  broker().setOnline(true);
+  broker().setMqtt5(true);
+  broker().setTopicAliasMaximum(10);
+  broker().setReceiveMaximum(0);
+  broker().setPubackLoss(0);
+  broker().setConnackHeld(false);
+  broker().resetStats();
+  broker().setPublishObserver([](const char* topic, const uint8_t*, size_t, uint8_t header) {
+    lastTopic = topic;
+    lastHeader = header;
+    seen++;
+  });
+  seen = acks = received = 0;
+  lastTopic.clear();
+  receivedPayload.clear();
+  net = new WiFiClient();
+  client = new PubSubClient(*net);
+  client->setServer("broker", 1883).setRetryInterval(kRetryMs).setBufferSize(kBufferSize);
+  client->setCallback(onMessage);
+  client->setProtocolVersion(MQTT_VERSION_5);
+}
+
+void tearDown() {
+  client->disconnect();
+  delete client;
+  delete net;
+  broker().setPublishObserver(nullptr);
+}
+
+void test_connect_sends_receive_maximum_and_packet_size() {
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_TRUE(broker().sessionV5());
+  TEST_ASSERT_EQUAL_UINT16(MQTT_RECEIVE_MAXIMUM, broker().deviceReceiveMaximum());
+  TEST_ASSERT_EQUAL_UINT32(kBufferSize, broker().deviceMaximumPacket());
+}
+
+void test_topic_goes_by_alias_after_first_publish() {
+  TEST_ASSERT_TRUE(connect());
+  uint64_t before = broker().stats().bytesIn;
+  TEST_ASSERT_TRUE(publish(kStatus));
+  uint64_t first = broker().stats().bytesIn - before;
+  TEST_ASSERT_EQUAL_UINT16(1, broker().lastProperties().topicAlias);
+  TEST_ASSERT_EQUAL_UINT32(0, broker().stats().aliased);
+
+  TEST_ASSERT_TRUE(publish(kStatus));
+  uint64_t second = broker().stats().bytesIn - before - first;
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().aliased);
+  TEST_ASSERT_EQUAL_STRING(kStatus, lastTopic.c_str());
+  // The topic string is left out; the alias property was there both times
+  TEST_ASSERT_EQUAL_UINT64(first - strlen(kStatus), second);
+
+  TEST_ASSERT_TRUE(publish(kData));
+  TEST_ASSERT_EQUAL_UINT16(2, broker().lastProperties().topicAlias);
+  TEST_ASSERT_EQUAL_STRING(kData, lastTopic.c_str());
+}
+
+void test_aliases_are_announced_again_after_reconnect() {
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_TRUE(publish(kStatus));
+  TEST_ASSERT_TRUE(publish(kStatus));
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().aliased);
+
+  broker().dropSession();
+  TEST_ASSERT_FALSE(client->connected());
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_TRUE(publish(kStatus));  // the new session does not know it
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().aliased);
+  TEST_ASSERT_EQUAL_UINT32(0, broker().stats().malformed);
+  TEST_ASSERT_TRUE(publish(kStatus));
+  TEST_ASSERT_EQUAL_UINT32(2, broker().stats().aliased);
+}
+
+void test_broker_alias_maximum_limits_aliases() {
+  broker().setTopicAliasMaximum(1);
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_TRUE(publish(kStatus));
+  TEST_ASSERT_TRUE(publish(kData));
+  TEST_ASSERT_EQUAL_UINT16(0, broker().lastProperties().topicAlias);
+  TEST_ASSERT_TRUE(publish(kData));
+  TEST_ASSERT_EQUAL_STRING(kData, lastTopic.c_str());
+  TEST_ASSERT_EQUAL_UINT32(0, broker().stats().aliased);
+
+  broker().setTopicAliasMaximum(0);
+  broker().dropSession();
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_TRUE(publish(kStatus));
+  TEST_ASSERT_TRUE(publish(kStatus));
+  TEST_ASSERT_EQUAL_UINT16(0, broker().lastProperties().topicAlias);
+  TEST_ASSERT_EQUAL_UINT32(0, broker().stats().aliased);
+  TEST_ASSERT_EQUAL_UINT32(0, broker().stats().malformed);
+}
+
+void test_message_expiry_and_user_properties() {
+  TEST_ASSERT_TRUE(connect());
+  const MqttUserProperty user[] = {{"fw", "1.4.0"}, {"dept", "hr_dept"}};
+  MqttProperties properties = {60, user, 2};
+  TEST_ASSERT_TRUE(publish(kData, 0, &properties));
+  const LoopbackBroker::PublishProperties& got = broker().lastProperties();
+  TEST_ASSERT_EQUAL_UINT32(60, got.messageExpiry);
+  TEST_ASSERT_EQUAL(2, got.user.size());
+  TEST_ASSERT_EQUAL_STRING("fw", got.user[0].first.c_str());
+  TEST_ASSERT_EQUAL_STRING("1.4.0", got.user[0].second.c_str());
+  TEST_ASSERT_EQUAL_STRING("hr_dept", got.user[1].second.c_str());
+
+  // And at QoS 1, kept with the message for retransmission
+  broker().setPubackLoss(1);
+  TEST_ASSERT_TRUE(publish(kData, 1, &properties));
+  broker().setPubackLoss(0);
+  nativesim::advanceMillis(kRetryMs);
+  client->loop();
+  TEST_ASSERT_EQUAL_UINT8(0x3A, lastHeader);
+  TEST_ASSERT_EQUAL_UINT32(60, broker().lastProperties().messageExpiry);
+  TEST_ASSERT_EQUAL(2, broker().lastProperties().user.size());
+  TEST_ASSERT_EQUAL_UINT32(2, broker().stats().aliased);  // both QoS 1 sends
+  drain();
+  TEST_ASSERT_EQUAL(1, acks);
+}
+
+void test_qos1_retransmit_after_reconnect_names_the_topic() {
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_TRUE(publish(kStatus, 1));
+  drain();
+  broker().setPubackLoss(1);
+  TEST_ASSERT_TRUE(publish(kStatus, 1));  // by alias
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().aliased);
+
+  broker().dropSession();
+  broker().setPubackLoss(0);
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_EQUAL_UINT8(0x3A, lastHeader);
+  TEST_ASSERT_EQUAL_STRING(kStatus, lastTopic.c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().aliased);  // full topic again
+  TEST_ASSERT_EQUAL_UINT32(0, broker().stats().malformed);
+  drain();
+  TEST_ASSERT_EQUAL(2, acks);
+}
+
+void test_streamed_qos1_publish_uses_alias() {
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_TRUE(publish(kStatus));
+  TEST_ASSERT_TRUE(client->beginPublish(kStatus, sizeof(kPayload) - 1, false, 1, onAck));
+  client->write(kPayload, sizeof(kPayload) - 1);
+  TEST_ASSERT_EQUAL(1, client->endPublish());
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().aliased);
+  TEST_ASSERT_EQUAL_STRING(kStatus, lastTopic.c_str());
+  drain();
+  TEST_ASSERT_EQUAL(1, acks);
+}
+
+void test_broker_receive_maximum_caps_window() {
+  broker().setReceiveMaximum(2);
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_TRUE(publish(kStatus, 1));
+  TEST_ASSERT_TRUE(publish(kStatus, 1));
+  TEST_ASSERT_FALSE(publish(kStatus, 1));
+  TEST_ASSERT_EQUAL_UINT32(1, client->qos1Stats().windowFull);
+  drain();
+  TEST_ASSERT_EQUAL(2, acks);
+  TEST_ASSERT_TRUE(publish(kStatus, 1));
+}
+
+void test_refused_by_broker_without_mqtt5() {
+  broker().setMqtt5(false);
+  TEST_ASSERT_FALSE(connect());
+  TEST_ASSERT_EQUAL(MQTT_CONNECT_BAD_PROTOCOL, client->state());
+  client->setProtocolVersion(MQTT_VERSION_3_1_1);
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_FALSE(broker().sessionV5());
+  TEST_ASSERT_TRUE(publish(kStatus));
+  TEST_ASSERT_TRUE(publish(kStatus));
+  TEST_ASSERT_EQUAL_UINT32(0, broker().stats().aliased);
+  TEST_ASSERT_EQUAL_STRING(kStatus, lastTopic.c_str());
+}
+
+void test_begin_connect_does_not_wait_for_connack() {
+  client->setSocketTimeout(1);
+  broker().setConnackHeld(true);
+  TEST_ASSERT_TRUE(client->beginConnect("v5_test", nullptr, nullptr));
+  TEST_ASSERT_TRUE(client->connecting());
+  TEST_ASSERT_FALSE(client->pollConnect());
+  TEST_ASSERT_TRUE(client->connecting());
+  TEST_ASSERT_FALSE(client->connected());
+  nativesim::advanceMillis(1000);
+  TEST_ASSERT_FALSE(client->pollConnect());
+  TEST_ASSERT_FALSE(client->connecting());
+  TEST_ASSERT_EQUAL(MQTT_CONNECTION_TIMEOUT, client->state());
+
+  broker().setConnackHeld(false);
+  TEST_ASSERT_TRUE(client->beginConnect("v5_test", nullptr, nullptr));
+  TEST_ASSERT_TRUE(client->pollConnect());
+  TEST_ASSERT_FALSE(client->connecting());
+  TEST_ASSERT_TRUE(client->connected());
+  TEST_ASSERT_TRUE(publish(kStatus));
+}
+
+void test_received_publish_skips_properties() {
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_TRUE(client->subscribe(kCommand, 1));
+  drain();
+  TEST_ASSERT_TRUE(broker().inject(kCommand, "{\"command\":\"status\"}"));
+  drain();
+  TEST_ASSERT_EQUAL(1, received);
+  TEST_ASSERT_EQUAL_STRING("{\"command\":\"status\"}", receivedPayload.c_str());
+
+  const char* relay = "{\"command\":\"relay\",\"relay\":1}";
+  TEST_ASSERT_TRUE(broker().inject(kCommand, (const uint8_t*)relay, strlen(relay), 1));
+  drain();
+  TEST_ASSERT_EQUAL(2, received);
+  TEST_ASSERT_EQUAL_STRING(relay, receivedPayload.c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().pubacksReceived);
+}
+
+void test_receive_maximum_holds_back_qos1_messages() {
+  client->setReceiveMaximum(1);
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_TRUE(client->subscribe(kCommand, 1));
+  drain();
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_TRUE(broker().inject(kCommand, kPayload, sizeof(kPayload) - 1, 1));
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, broker().stats().held);
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().delivered);
+  drain();
+  TEST_ASSERT_EQUAL(3, received);
+  TEST_ASSERT_EQUAL_UINT32(3, broker().stats().pubacksReceived);
+}
+
+void test_broker_drops_messages_over_maximum_packet_size() {
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_TRUE(client->subscribe(kCommand));
+  drain();
+  uint8_t big[kBufferSize];
+  memset(big, 'x', sizeof(big));
+  broker().inject(kCommand, big, sizeof(big));
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().oversized);
+  TEST_ASSERT_EQUAL(0, broker().pendingToDevice());
+  TEST_ASSERT_TRUE(broker().inject(kCommand, "{}"));
+  drain();
+  TEST_ASSERT_EQUAL(1, received);
+}
+
+void test_chunked_receive_skips_properties() {
+  static std::string chunked;
+  client->setChunkCallback([](char*, uint8_t* chunk, unsigned int length, uint32_t, uint32_t) {
+    chunked.append((const char*)chunk, length);
+  });
+  chunked.clear();
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_EQUAL_UINT32(0, broker().deviceMaximumPacket());  // chunks take anything
+  TEST_ASSERT_TRUE(client->subscribe(kCommand));
+  drain();
+  std::string big(kBufferSize * 2, 'y');
+  TEST_ASSERT_TRUE(broker().inject(kCommand, (const uint8_t*)big.data(), big.size()));
+  drain();
+  TEST_ASSERT_EQUAL(big.size(), chunked.size());
+  TEST_ASSERT_TRUE(chunked == big);
+}
+
+void test_shared_subscription() {
+  TEST_ASSERT_TRUE(connect());
+  TEST_ASSERT_FALSE(client->subscribe("$share/lights/esp32/+/command", 1, MQTT_SUB_NO_LOCAL));
+  TEST_ASSERT_TRUE(client->subscribe("$share/lights/esp32/+/command", 1));
+  drain();
+  TEST_ASSERT_TRUE(broker().inject(kCommand, "{\"command\":\"status\"}"));
+  drain();
+  TEST_ASSERT_EQUAL(1, received);
+  TEST_ASSERT_TRUE(client->unsubscribe("lights/esp32/+/command"));
+  drain();
+  TEST_ASSERT_EQUAL_UINT32(0, broker().stats().malformed);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_connect_sends_receive_maximum_and_packet_size);
+  RUN_TEST(test_topic_goes_by_alias_after_first_publish);
+  RUN_TEST(test_aliases_are_announced_again_after_reconnect);
+  RUN_TEST(test_broker_alias_maximum_limits_aliases);
+  RUN_TEST(test_message_expiry_and_user_properties);
+  RUN_TEST(test_qos1_retransmit_after_reconnect_names_the_topic);
+  RUN_TEST(test_streamed_qos1_publish_uses_alias);
+  RUN_TEST(test_broker_receive_maximum_caps_window);
+  RUN_TEST(test_refused_by_broker_without_mqtt5);
+  RUN_TEST(test_begin_connect_does_not_wait_for_connack);
+  RUN_TEST(test_received_publish_skips_properties);
+  RUN_TEST(test_receive_maximum_holds_back_qos1_messages);
+  RUN_TEST(test_broker_drops_messages_over_maximum_packet_size);
+  RUN_TEST(test_chunked_receive_skips_properties);
+  RUN_TEST(test_shared_subscription);
+  return UNITY_END();
+}
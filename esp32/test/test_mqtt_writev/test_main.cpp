@@ -0,0 +1,208 @@
+/*
+  test_main.cpp - host tests for vectored publishing in PubSubClient.
+
+    pio test -e native -f test_mqtt_writev
+
+  The writev hook forwards to the lwip_writev stand-in, which hands the
+  whole gather list to the LoopbackBroker as one write call.
+*/
+
+#include <Arduino.h>
+#include <LoopbackBroker.h>
+#include <NativeSim.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include <unity.h>
+
+namespace {
+
+const char* kTopic = "esp32/ESP32_TEST01/sensors";
+const uint16_t kBufferSize = 128;
+
+WiFiClient* net;
+PubSubClient* client;
+int submissions;
+uint8_t lastCount;
+const uint8_t* lastBases[MQTT_MAX_IOVEC];
+size_t takeAtMost;
+uint8_t published[1024];
+size_t publishedLength;
+uint8_t publishedHeader;
+int acks;
+
+size_t forward(const MqttIovec* parts, uint8_t count) {
+  submissions++;
+  lastCount = count;
+  struct iovec iov[MQTT_MAX_IOVEC];
+  size_t room = takeAtMost;
+  int used = 0;
+  for (uint8_t i = 0; i < count && room > 0; i++) {
+    lastBases[i] = parts[i].base;
+    size_t n = parts[i].length < room ? parts[i].length : room;
+    iov[used].iov_base = (void*)parts[i].base;
+    iov[used].iov_len = n;
+    used++;
+    room -= n;
+  }
+  ssize_t sent = lwip_writev(net->fd(), iov, used);
+  return sent < 0 ? 0 : (size_t)sent;
+}
+
+void onAck(uint16_t, boolean delivered) {
+  if (delivered) acks++;
+}
+
+LoopbackBroker& broker() { return LoopbackBroker::instance(); }
+
+void drain() {
+  while (broker().pendingToDevice()) client->loop();
+}
+
+void fill(uint8_t* payload, size_t length) {
+  for (size_t i = 0; i < length; i++) payload[i] = (uint8_t)('a' + i % 26);
+}
+
+}  // namespace
+
+void setUp() {
+  nativesim::resetClock();
+  broker().setOnline(true);
+  broker().setPubackLoss(0);
+  broker().setPublishObserver([](const char*, const uint8_t* payload, size_t length, uint8_t header) {
+    memcpy(published, payload, length);
+    publishedLength = length;
+    publishedHeader = header;
+  });
+  submissions = acks = 0;
+  lastCount = 0;
+  publishedLength = 0;
+  takeAtMost = (size_t)-1;
+  net = new WiFiClient();
+  client = new PubSubClient(*net);
+  client->setServer("broker", 1883).setWritev(forward);
+  client->setBufferSize(kBufferSize);
+  TEST_ASSERT_TRUE(client->connect("writev_test"));
+  broker().resetStats();
+}
+
+void tearDown() {
+  client->disconnect();
+  delete client;
+  delete net;
+  broker().setPublishObserver(nullptr);
+}
+
+void test_publish_is_one_submission_without_copy() {
+  const uint8_t payload[] = "{\"temperature\":23.1}";
+  TEST_ASSERT_TRUE(client->publish(kTopic, payload, sizeof(payload) - 1));
+  TEST_ASSERT_EQUAL(1, submissions);
+  TEST_ASSERT_EQUAL_UINT8(2, lastCount);
+  TEST_ASSERT_TRUE(lastBases[1] == payload);
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().writeCalls);
+  TEST_ASSERT_EQUAL(sizeof(payload) - 1, publishedLength);
+  TEST_ASSERT_EQUAL_MEMORY(payload, published, publishedLength);
+}
+
+void test_parts_go_back_to_back() {
+  const char* head = "{\"type\":\"sensor_data\",";
+  const char* body = "\"temperature\":23.1";
+  const char* tail = "}";
+  const MqttIovec parts[3] = {
+    {(const uint8_t*)head, strlen(head)},
+    {(const uint8_t*)body, strlen(body)},
+    {(const uint8_t*)tail, strlen(tail)},
+  };
+  TEST_ASSERT_TRUE(client->publishParts(kTopic, parts, 3, false));
+  TEST_ASSERT_EQUAL(1, submissions);
+  TEST_ASSERT_EQUAL_UINT8(4, lastCount);
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().writeCalls);
+  const char* whole = "{\"type\":\"sensor_data\",\"temperature\":23.1}";
+  TEST_ASSERT_EQUAL(strlen(whole), publishedLength);
+  TEST_ASSERT_EQUAL_MEMORY(whole, published, publishedLength);
+}
+
+void test_short_vectored_write_is_finished_by_client() {
+  static uint8_t payload[300];
+  fill(payload, sizeof(payload));
+  takeAtMost = 40;  // ends inside the payload
+  TEST_ASSERT_TRUE(client->publish(kTopic, payload, sizeof(payload)));
+  TEST_ASSERT_EQUAL(1, submissions);
+  TEST_ASSERT_EQUAL(sizeof(payload), publishedLength);
+  TEST_ASSERT_EQUAL_MEMORY(payload, published, sizeof(payload));
+}
+
+void test_without_hook_small_publish_is_gathered() {
+  client->setWritev(NULL);
+  const char* head = "{\"uptime\":";
+  const char* body = "42}";
+  const MqttIovec parts[2] = {
+    {(const uint8_t*)head, strlen(head)},
+    {(const uint8_t*)body, strlen(body)},
+  };
+  TEST_ASSERT_TRUE(client->publishParts(kTopic, parts, 2, false));
+  TEST_ASSERT_EQUAL_UINT32(1, broker().stats().writeCalls);
+  TEST_ASSERT_EQUAL_MEMORY("{\"uptime\":42}", published, publishedLength);
+}
+
+void test_payload_larger_than_buffer_is_sent() {
+  static uint8_t payload[600];
+  fill(payload, sizeof(payload));
+  TEST_ASSERT_TRUE(client->publish(kTopic, payload, sizeof(payload)));
+  TEST_ASSERT_EQUAL(sizeof(payload), publishedLength);
+  TEST_ASSERT_EQUAL_MEMORY(payload, published, sizeof(payload));
+
+  client->setWritev(NULL);
+  TEST_ASSERT_TRUE(client->publish(kTopic, payload, sizeof(payload)));
+  TEST_ASSERT_EQUAL(sizeof(payload), publishedLength);
+}
+
+void test_publish_p_copies_a_buffer_at_a_time() {
+  client->setWritev(NULL);
+  static uint8_t payload[300];
+  fill(payload, sizeof(payload));
+  TEST_ASSERT_TRUE(client->publish_P(kTopic, payload, sizeof(payload), false));
+  // Header and topic, then 128 + 128 + 44 payload bytes
+  TEST_ASSERT_EQUAL_UINT32(4, broker().stats().writeCalls);
+  TEST_ASSERT_EQUAL(sizeof(payload), publishedLength);
+  TEST_ASSERT_EQUAL_MEMORY(payload, published, sizeof(payload));
+}
+
+void test_qos1_parts_are_kept_for_retransmit() {
+  const char* head = "{\"relay1\":";
+  const char* body = "true}";
+  const MqttIovec parts[2] = {
+    {(const uint8_t*)head, strlen(head)},
+    {(const uint8_t*)body, strlen(body)},
+  };
+  TEST_ASSERT_TRUE(client->publishParts(kTopic, parts, 2, false, 1, onAck));
+  TEST_ASSERT_EQUAL(1, submissions);
+  TEST_ASSERT_EQUAL_UINT8(0x32, publishedHeader);
+  TEST_ASSERT_EQUAL_MEMORY("{\"relay1\":true}", published, publishedLength);
+  drain();
+  TEST_ASSERT_EQUAL(1, acks);
+  TEST_ASSERT_EQUAL(0, client->inflightCount());
+}
+
+void test_too_many_parts_is_refused() {
+  MqttIovec parts[MQTT_MAX_IOVEC];
+  for (int i = 0; i < MQTT_MAX_IOVEC; i++) parts[i] = MqttIovec{(const uint8_t*)"x", 1};
+  TEST_ASSERT_FALSE(client->publishParts(kTopic, parts, MQTT_MAX_IOVEC, false));
+  TEST_ASSERT_TRUE(client->publishParts(kTopic, parts, MQTT_MAX_IOVEC - 1, false));
+  TEST_ASSERT_EQUAL(MQTT_MAX_IOVEC - 1, publishedLength);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_publish_is_one_submission_without_copy);
+  RUN_TEST(test_parts_go_back_to_back);
+  RUN_TEST(test_short_vectored_write_is_finished_by_client);
+  RUN_TEST(test_without_hook_small_publish_is_gathered);
+  RUN_TEST(test_payload_larger_than_buffer_is_sent);
+  RUN_TEST(test_publish_p_copies_a_buffer_at_a_time);
+  RUN_TEST(test_qos1_parts_are_kept_for_retransmit);
+  RUN_TEST(test_too_many_parts_is_refused);
+  return UNITY_END();
+}
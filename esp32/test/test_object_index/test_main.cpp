@@ -0,0 +1,214 @@
+/*
+  test_main.cpp - host tests for ArduinoJson's object index.
+
+    pio test -e native -f test_object_index
+
+  With ARDUINOJSON_ENABLE_OBJECT_INDEX an object of 16 keys or more gets a
+  hash table of its keys on the first lookup that compared that many. The
+  table lives in the document's allocator, catches up with appended members
+  and is dropped when a member is removed or the object goes away.
+*/
+
+#define ARDUINOJSON_ENABLE_OBJECT_INDEX 1
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include <stdlib.h>
+
+#include <string>
+
+namespace {
+
+class CountingAllocator : public ArduinoJson::Allocator {
+ public:
+  void* allocate(size_t size) override {
+    if (limit >= 0 && allocations >= limit) return nullptr;
+    allocations++;
+    live++;
+    return malloc(size);
+  }
+
+  void deallocate(void* ptr) override {
+    if (ptr) live--;
+    free(ptr);
+  }
+
+  void* reallocate(void* ptr, size_t new_size) override {
+    if (!ptr) return allocate(new_size);
+    return realloc(ptr, new_size);
+  }
+
+  int allocations = 0;
+  int live = 0;
+  int limit = -1;  // refuse allocations past this count
+};
+
+std::string key(int i) {
+  return "setting_" + std::to_string(i);
+}
+
+void fill(JsonObject object, int from, int to) {
+  for (int i = from; i < to; i++) object[key(i)] = i;
+}
+
+void checkAll(JsonObjectConst object, int from, int to) {
+  for (int i = from; i < to; i++) {
+    TEST_ASSERT_TRUE(object[key(i)].is<int>());
+    TEST_ASSERT_EQUAL(i, object[key(i)].as<int>());
+  }
+  TEST_ASSERT_TRUE(object["missing"].isNull());
+  TEST_ASSERT_TRUE(object[key(to)].isNull());
+}
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_small_objects_get_no_index() {
+  CountingAllocator allocator;
+  JsonDocument doc(&allocator);
+  fill(doc.to<JsonObject>(), 0, ARDUINOJSON_OBJECT_INDEX_THRESHOLD - 1);
+  int before = allocator.allocations;
+
+  checkAll(doc.as<JsonObject>(), 0, ARDUINOJSON_OBJECT_INDEX_THRESHOLD - 1);
+  TEST_ASSERT_EQUAL(before, allocator.allocations);
+}
+
+void test_index_is_built_once_on_a_long_lookup() {
+  CountingAllocator allocator;
+  JsonDocument doc(&allocator);
+  JsonObject object = doc.to<JsonObject>();
+  fill(object, 0, ARDUINOJSON_OBJECT_INDEX_THRESHOLD);  // the last insert compared one key less
+  int before = allocator.allocations;
+
+  TEST_ASSERT_TRUE(object["missing"].isNull());  // compares them all, builds the index
+  TEST_ASSERT_EQUAL(before + 1, allocator.allocations);
+  checkAll(object, 0, ARDUINOJSON_OBJECT_INDEX_THRESHOLD);
+  TEST_ASSERT_EQUAL(before + 1, allocator.allocations);
+
+  fill(object, ARDUINOJSON_OBJECT_INDEX_THRESHOLD, 100);  // appends catch up, growing the table
+  checkAll(object, 0, 100);
+}
+
+void test_appended_members_are_found() {
+  JsonDocument doc;
+  JsonObject object = doc.to<JsonObject>();
+  fill(object, 0, 40);
+  checkAll(object, 0, 40);
+
+  // Past the table's load factor several times over: it grows and rehashes
+  for (int end = 50; end <= 400; end += 50) {
+    fill(object, end - 50 >= 40 ? end - 50 : 40, end);
+    checkAll(object, 0, end);
+  }
+  TEST_ASSERT_EQUAL(400, object.size());
+}
+
+void test_removal_drops_the_index() {
+  CountingAllocator allocator;
+  JsonDocument doc(&allocator);
+  JsonObject object = doc.to<JsonObject>();
+  fill(object, 0, 64);
+  checkAll(object, 0, 64);
+  int before = allocator.allocations;
+
+  object.remove(key(10));
+  TEST_ASSERT_TRUE(object[key(10)].isNull());  // a full scan builds a new index
+  TEST_ASSERT_EQUAL(before + 1, allocator.allocations);
+  TEST_ASSERT_EQUAL(11, object[key(11)].as<int>());
+
+  object.remove(key(0));  // the first key, which identified the index
+  TEST_ASSERT_TRUE(object[key(0)].isNull());
+  for (int i = 1; i < 64; i++) {
+    if (i != 10) TEST_ASSERT_EQUAL(i, object[key(i)].as<int>());
+  }
+
+  for (int i = 1; i < 64; i += 2) object.remove(key(i));
+  for (int i = 1; i < 64; i++) {
+    if (i != 10) TEST_ASSERT_EQUAL(i % 2 ? 0 : 1, object[key(i)].is<int>() ? 1 : 0);
+  }
+}
+
+void test_replaced_object_does_not_inherit_the_index() {
+  // The second object reuses the first one's slots, first key included
+  JsonDocument doc;
+  fill(doc["config"].to<JsonObject>(), 0, 50);
+  checkAll(doc["config"], 0, 50);
+
+  JsonObject replaced = doc["config"].to<JsonObject>();
+  for (int i = 0; i < 50; i++) replaced["other_" + std::to_string(i)] = -i;
+  TEST_ASSERT_TRUE(replaced[key(30)].isNull());
+  for (int i = 0; i < 50; i++) TEST_ASSERT_EQUAL(-i, replaced["other_" + std::to_string(i)].as<int>());
+}
+
+void test_parsed_duplicates_keep_the_last_value() {
+  std::string json = "{";
+  for (int i = 0; i < 60; i++) json += "\"" + key(i) + "\":" + std::to_string(i) + ",";
+  json += "\"" + key(5) + "\":500,\"" + key(55) + "\":5500}";
+
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(deserializeJson(doc, json) == DeserializationError::Ok);
+  TEST_ASSERT_EQUAL(60, doc.size());
+  TEST_ASSERT_EQUAL(500, doc[key(5)].as<int>());
+  TEST_ASSERT_EQUAL(5500, doc[key(55)].as<int>());
+  TEST_ASSERT_EQUAL(54, doc[key(54)].as<int>());
+}
+
+void test_const_documents_are_indexed() {
+  CountingAllocator allocator;
+  JsonDocument doc(&allocator);
+  fill(doc.to<JsonObject>(), 0, ARDUINOJSON_OBJECT_INDEX_THRESHOLD);
+  const JsonDocument& config = doc;
+  int before = allocator.allocations;
+
+  checkAll(config.as<JsonObjectConst>(), 0, ARDUINOJSON_OBJECT_INDEX_THRESHOLD);
+  TEST_ASSERT_EQUAL(before + 1, allocator.allocations);
+}
+
+void test_out_of_memory_falls_back_to_a_scan() {
+  CountingAllocator allocator;
+  JsonDocument doc(&allocator);
+  fill(doc.to<JsonObject>(), 0, 80);
+  allocator.limit = allocator.allocations;  // no room for an index
+
+  checkAll(doc.as<JsonObject>(), 0, 80);
+  TEST_ASSERT_FALSE(doc.overflowed());
+}
+
+void test_indexes_are_freed_with_the_document() {
+  CountingAllocator allocator;
+  {
+    JsonDocument doc(&allocator);
+    fill(doc["a"].to<JsonObject>(), 0, 40);
+    fill(doc["b"].to<JsonObject>(), 0, 40);
+    checkAll(doc["a"], 0, 40);
+    checkAll(doc["b"], 0, 40);
+
+    JsonDocument moved(std::move(doc));
+    checkAll(moved["a"], 0, 40);
+    moved.clear();
+    TEST_ASSERT_EQUAL(0, allocator.live);
+
+    fill(moved["c"].to<JsonObject>(), 0, 40);
+    checkAll(moved["c"], 0, 40);
+  }
+  TEST_ASSERT_EQUAL(0, allocator.live);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_small_objects_get_no_index);
+  RUN_TEST(test_index_is_built_once_on_a_long_lookup);
+  RUN_TEST(test_appended_members_are_found);
+  RUN_TEST(test_removal_drops_the_index);
+  RUN_TEST(test_replaced_object_does_not_inherit_the_index);
+  RUN_TEST(test_parsed_duplicates_keep_the_last_value);
+  RUN_TEST(test_const_documents_are_indexed);
+  RUN_TEST(test_out_of_memory_falls_back_to_a_scan);
+  RUN_TEST(test_indexes_are_freed_with_the_document);
+  return UNITY_END();
+}
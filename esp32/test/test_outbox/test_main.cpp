@@ -0,0 +1,220 @@
+/*
+  test_main.cpp - host tests for lib/Outbox.
+
+    pio test -e native -f test_outbox
+
+  The flash ring runs on the esp_partition stand-in, which keeps its bytes
+  across Outbox instances the way the chip keeps them across a restart.
+*/
+
+#include <Arduino.h>
+#include <NativeSim.h>
+#include <Outbox.h>
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* kData = "esp32/ESP32_TEST01/data";
+const char* kStatus = "esp32/ESP32_TEST01/status";
+
+Outbox* outbox;
+std::vector<std::string> sent;  // "topic payload"
+uint8_t lastQos;
+bool refuse;
+
+bool send(const OutboxMessage& message) {
+  if (refuse) return false;
+  sent.push_back(std::string(message.topic) + " " + std::string((const char*)message.payload, message.length));
+  lastQos = message.qos;
+  return true;
+}
+
+void push(const char* topic, const std::string& payload, bool supersede = false, uint8_t qos = 0) {
+  TEST_ASSERT_TRUE(outbox->push(topic, (const uint8_t*)payload.data(), payload.size(), qos, false, supersede));
+}
+
+std::string sample(int i) { return "{\"seq\":" + std::to_string(i) + ",\"pad\":\"" + std::string(100, 'x') + "\"}"; }
+
+void drainAll() {
+  while (outbox->drain(millis(), send)) nativesim::advanceMillis(1);
+}
+
+}  // namespace
+
+void setUp() {
+  nativesim::resetClock();
+  nativesim::eraseFlash();
+  sent.clear();
+  refuse = false;
+  lastQos = 0xFF;
+  outbox = new Outbox();
+}
+
+void tearDown() { delete outbox; }
+
+void test_drains_in_order() {
+  for (int i = 0; i < 5; i++) push(kData, sample(i));
+  TEST_ASSERT_EQUAL_UINT32(5, outbox->size());
+  TEST_ASSERT_EQUAL_UINT32(0, outbox->drain(millis(), send));
+  TEST_ASSERT_EQUAL(5, (int)sent.size());
+  for (int i = 0; i < 5; i++) TEST_ASSERT_EQUAL_STRING((std::string(kData) + " " + sample(i)).c_str(), sent[i].c_str());
+  TEST_ASSERT_TRUE(outbox->empty());
+}
+
+void test_drain_rate_spaces_messages() {
+  outbox->setDrainRate(20);  // one per 50 ms
+  for (int i = 0; i < 3; i++) push(kData, sample(i));
+  TEST_ASSERT_EQUAL_UINT32(50, outbox->drain(millis(), send));
+  TEST_ASSERT_EQUAL(1, (int)sent.size());
+  nativesim::advanceMillis(20);
+  TEST_ASSERT_EQUAL_UINT32(30, outbox->drain(millis(), send));
+  TEST_ASSERT_EQUAL(1, (int)sent.size());
+  nativesim::advanceMillis(30);
+  outbox->drain(millis(), send);
+  TEST_ASSERT_EQUAL(2, (int)sent.size());
+}
+
+void test_refused_send_stays_queued() {
+  push(kStatus, "{\"relay1\":true}", true, 1);
+  refuse = true;
+  TEST_ASSERT_EQUAL_UINT32(Outbox::kRetryMs, outbox->drain(millis(), send));
+  TEST_ASSERT_EQUAL_UINT32(1, outbox->stats().refused);
+  refuse = false;
+  TEST_ASSERT_EQUAL_UINT32(0, outbox->drain(millis(), send));
+  TEST_ASSERT_EQUAL(1, (int)sent.size());
+  TEST_ASSERT_EQUAL_UINT8(1, lastQos);
+}
+
+void test_superseding_message_replaces_queued_one() {
+  push(kStatus, "{\"relay1\":true}", true);
+  push(kData, sample(0));
+  push(kStatus, "{\"relay1\":false}", true);
+  push(kData, sample(1));
+  TEST_ASSERT_EQUAL_UINT32(3, outbox->size());
+  drainAll();
+  TEST_ASSERT_EQUAL(3, (int)sent.size());
+  TEST_ASSERT_EQUAL_STRING((std::string(kData) + " " + sample(0)).c_str(), sent[0].c_str());
+  TEST_ASSERT_EQUAL_STRING((std::string(kStatus) + " {\"relay1\":false}").c_str(), sent[1].c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, outbox->stats().superseded);
+}
+
+void test_full_ram_drops_oldest_without_flash() {
+  int n = 0;
+  while (outbox->stats().dropped == 0) push(kData, sample(n++));
+  uint32_t kept = outbox->size();
+  TEST_ASSERT_TRUE(kept > 10);
+  drainAll();
+  TEST_ASSERT_EQUAL((int)kept, (int)sent.size());
+  TEST_ASSERT_EQUAL_STRING((std::string(kData) + " " + sample(n - 1)).c_str(), sent.back().c_str());
+  TEST_ASSERT_EQUAL_STRING((std::string(kData) + " " + sample(n - (int)kept)).c_str(), sent.front().c_str());
+}
+
+void test_full_ram_spills_to_flash_in_order() {
+  TEST_ASSERT_TRUE(outbox->attachFlash("spiffs", 4));
+  for (int i = 0; i < 100; i++) push(kData, sample(i));
+  TEST_ASSERT_TRUE(outbox->flashSize() > 0);
+  TEST_ASSERT_EQUAL_UINT32(0, outbox->stats().dropped);
+  TEST_ASSERT_EQUAL_UINT32(100, outbox->size());
+  drainAll();
+  TEST_ASSERT_EQUAL(100, (int)sent.size());
+  for (int i = 0; i < 100; i++) TEST_ASSERT_EQUAL_STRING((std::string(kData) + " " + sample(i)).c_str(), sent[i].c_str());
+}
+
+void test_flash_survives_restart() {
+  TEST_ASSERT_TRUE(outbox->attachFlash("spiffs", 4));
+  for (int i = 0; i < 6; i++) push(kData, sample(i));
+  push(kStatus, "{\"relay1\":true}", true, 1);
+  outbox->spillAll();
+  // Two go out before the restart and are not sent again
+  outbox->setDrainRate(1);
+  outbox->drain(millis(), send);
+  nativesim::advanceMillis(1000);
+  outbox->drain(millis(), send);
+  TEST_ASSERT_EQUAL(2, (int)sent.size());
+  delete outbox;
+
+  outbox = new Outbox();
+  TEST_ASSERT_TRUE(outbox->attachFlash("spiffs", 4));
+  TEST_ASSERT_EQUAL_UINT32(5, outbox->size());
+  TEST_ASSERT_EQUAL_UINT32(5, outbox->stats().restored);
+  // The restored status is still superseded by a newer one
+  push(kStatus, "{\"relay1\":false}", true, 1);
+  TEST_ASSERT_EQUAL_UINT32(5, outbox->size());
+  drainAll();
+  TEST_ASSERT_EQUAL(7, (int)sent.size());
+  TEST_ASSERT_EQUAL_STRING((std::string(kData) + " " + sample(2)).c_str(), sent[2].c_str());
+  TEST_ASSERT_EQUAL_STRING((std::string(kStatus) + " {\"relay1\":false}").c_str(), sent.back().c_str());
+}
+
+void test_torn_record_is_not_replayed() {
+  TEST_ASSERT_TRUE(outbox->attachFlash("spiffs", 2));
+  push(kData, sample(0));
+  push(kData, sample(1));
+  outbox->spillAll();
+  delete outbox;
+
+  // A reset between writing a record and committing it: state byte still erased
+  const esp_partition_t* part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "spiffs");
+  uint8_t record[64];
+  memset(record, 0xFF, sizeof(record));
+  record[1] = 0;   // flags
+  record[2] = 2;   // topic "x"
+  record[4] = 40;  // payload length
+  record[5] = 0;
+  uint32_t end = 8;
+  for (;;) {
+    uint8_t h[6];
+    esp_partition_read(part, end, h, sizeof(h));
+    if (h[2] == 0xFF) break;
+    end += (6 + h[2] + (h[4] | (h[5] << 8)) + 3) & ~3u;
+  }
+  esp_partition_write(part, end + 1, record + 1, 5);
+
+  outbox = new Outbox();
+  TEST_ASSERT_TRUE(outbox->attachFlash("spiffs", 2));
+  TEST_ASSERT_EQUAL_UINT32(2, outbox->size());
+  push(kData, sample(2));
+  outbox->spillAll();
+  drainAll();
+  TEST_ASSERT_EQUAL(3, (int)sent.size());
+  TEST_ASSERT_EQUAL_STRING((std::string(kData) + " " + sample(2)).c_str(), sent[2].c_str());
+}
+
+void test_flash_ring_wrap_drops_oldest_sector() {
+  TEST_ASSERT_TRUE(outbox->attachFlash("spiffs", 2));
+  for (int i = 0; i < 200; i++) push(kData, sample(i));
+  outbox->spillAll();
+  TEST_ASSERT_TRUE(outbox->stats().dropped > 0);
+  uint32_t kept = outbox->size();
+  TEST_ASSERT_EQUAL_UINT32(200 - outbox->stats().dropped, kept);
+  drainAll();
+  TEST_ASSERT_EQUAL((int)kept, (int)sent.size());
+  TEST_ASSERT_EQUAL_STRING((std::string(kData) + " " + sample(199)).c_str(), sent.back().c_str());
+  TEST_ASSERT_EQUAL_STRING((std::string(kData) + " " + sample(200 - (int)kept)).c_str(), sent.front().c_str());
+}
+
+void test_oversized_message_is_refused() {
+  std::string big(OUTBOX_MAX_RECORD, 'x');
+  TEST_ASSERT_FALSE(outbox->push(kData, (const uint8_t*)big.data(), big.size()));
+  TEST_ASSERT_TRUE(outbox->empty());
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_drains_in_order);
+  RUN_TEST(test_drain_rate_spaces_messages);
+  RUN_TEST(test_refused_send_stays_queued);
+  RUN_TEST(test_superseding_message_replaces_queued_one);
+  RUN_TEST(test_full_ram_drops_oldest_without_flash);
+  RUN_TEST(test_full_ram_spills_to_flash_in_order);
+  RUN_TEST(test_flash_survives_restart);
+  RUN_TEST(test_torn_record_is_not_replayed);
+  RUN_TEST(test_flash_ring_wrap_drops_oldest_sector);
+  RUN_TEST(test_oversized_message_is_refused);
+  return UNITY_END();
+}
@@ -0,0 +1,225 @@
+/*
+  test_main.cpp - host tests for lib/PayloadCodec.
+
+    pio test -e native -f test_payload_codec
+
+  MsgPackWriter output is checked against ArduinoJson's own MessagePack
+  serializer and parser, which is what a subscriber decodes it with.
+*/
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LoopbackBroker.h>
+#include <NativeSim.h>
+#include <PayloadCodec.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <unity.h>
+
+#include <string>
+
+namespace {
+
+WiFiClient* net;
+PubSubClient* client;
+std::string received;
+PayloadFormat receivedFormat;
+
+void callback(char* topic, byte* payload, unsigned int length) {
+  receivedFormat = payloadFormatOf(topic);
+  received.assign((const char*)payload, length);
+}
+
+// Same bytes as serializeMsgPack() of the value on its own
+void assertSameAsArduinoJson(const char* encoded, int length, JsonVariantConst value) {
+  char expected[64];
+  size_t expectedLength = serializeMsgPack(value, expected, sizeof(expected));
+  TEST_ASSERT_EQUAL_INT((int)expectedLength, length);
+  TEST_ASSERT_EQUAL_MEMORY(expected, encoded, expectedLength);
+}
+
+}  // namespace
+
+void setUp() {
+  nativesim::resetClock();
+  LoopbackBroker::instance().setOnline(true);
+  LoopbackBroker::instance().resetStats();
+  received.clear();
+  net = new WiFiClient();
+  client = new PubSubClient(*net);
+  client->setServer("broker", 1883);
+  client->setCallback(callback);
+}
+
+void tearDown() {
+  client->disconnect();
+  delete client;
+  delete net;
+}
+
+void test_topic_marker() {
+  TEST_ASSERT_EQUAL(PAYLOAD_MSGPACK, payloadFormatOf("esp32/ESP32_TEST01/status/msgpack"));
+  TEST_ASSERT_EQUAL(PAYLOAD_JSON, payloadFormatOf("esp32/ESP32_TEST01/status"));
+  TEST_ASSERT_EQUAL(PAYLOAD_JSON, payloadFormatOf("msgpack"));
+  TEST_ASSERT_EQUAL(PAYLOAD_JSON, payloadFormatOf("esp32/ESP32_TEST01/msgpack/data"));
+  TEST_ASSERT_EQUAL_STRING("", payloadTopicSuffix(PAYLOAD_JSON));
+  TEST_ASSERT_EQUAL_STRING("/msgpack", payloadTopicSuffix(PAYLOAD_MSGPACK));
+}
+
+void test_integers_match_arduinojson() {
+  const uint32_t unsignedValues[] = {0, 127, 128, 255, 256, 65535, 65536, 4294967295u};
+  for (uint32_t value : unsignedValues) {
+    char buf[8];
+    MsgPackWriter w(buf, sizeof(buf));
+    w.uint32(value);
+    JsonDocument doc;
+    doc.set(value);
+    assertSameAsArduinoJson(buf, w.length(), doc.as<JsonVariantConst>());
+  }
+  const int32_t signedValues[] = {-1, -32, -33, -128, -129, -32768, -32769, -2147483647 - 1, 42};
+  for (int32_t value : signedValues) {
+    char buf[8];
+    MsgPackWriter w(buf, sizeof(buf));
+    w.int32(value);
+    JsonDocument doc;
+    doc.set(value);
+    assertSameAsArduinoJson(buf, w.length(), doc.as<JsonVariantConst>());
+  }
+  const uint64_t wideValues[] = {42, 4294967295u, 4294967296ull, 1700000000000ull};
+  for (uint64_t value : wideValues) {
+    char buf[16];
+    MsgPackWriter w(buf, sizeof(buf));
+    w.uint64(value);
+    JsonDocument doc;
+    doc.set(value);
+    assertSameAsArduinoJson(buf, w.length(), doc.as<JsonVariantConst>());
+  }
+}
+
+void test_strings_match_arduinojson() {
+  const size_t lengths[] = {0, 31, 32, 40};
+  for (size_t length : lengths) {
+    std::string s(length, 'k');
+    char buf[64];
+    MsgPackWriter w(buf, sizeof(buf));
+    w.str(s.c_str());
+    JsonDocument doc;
+    doc.set(s.c_str());
+    assertSameAsArduinoJson(buf, w.length(), doc.as<JsonVariantConst>());
+  }
+}
+
+void test_map_round_trips() {
+  char buf[128];
+  MsgPackWriter w(buf, sizeof(buf));
+  w.map(5);
+  w.str("type").str("sensor_data");
+  w.str("ok").boolean(true);
+  w.str("none").nil();
+  w.str("temperature").float32(23.5f);
+  w.str("data").map(2).str("relay1").boolean(false).str("rssi").int32(-67);
+  TEST_ASSERT_TRUE(w.length() > 0);
+
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeMsgPack(doc, buf, (size_t)w.length()));
+  TEST_ASSERT_EQUAL_STRING("sensor_data", doc["type"]);
+  TEST_ASSERT_TRUE(doc["ok"].as<bool>());
+  TEST_ASSERT_TRUE(doc["none"].isNull());
+  TEST_ASSERT_EQUAL_FLOAT(23.5f, doc["temperature"].as<float>());
+  TEST_ASSERT_FALSE(doc["data"]["relay1"].as<bool>());
+  TEST_ASSERT_EQUAL_INT(-67, doc["data"]["rssi"].as<int>());
+}
+
+// The firmware's templates: head (map header + identity), body, tail
+// (trailer entries without their own map header) decode as one map
+void test_template_parts_decode_as_one_map() {
+  JsonDocument trailer;
+  trailer["pins"]["relay1"] = 25;
+  char tail[64];
+  size_t tailLength = serializeMsgPack(trailer, tail, sizeof(tail));
+  size_t header = msgPackMapHeaderSize((const uint8_t*)tail, tailLength);
+  TEST_ASSERT_EQUAL_UINT32(1, header);
+
+  char message[128];
+  MsgPackWriter head(message, sizeof(message));
+  head.map(1 + 1 + trailer.size()).str("type").str("relay_status");
+  int headLength = head.length();
+  MsgPackWriter body(message + headLength, sizeof(message) - headLength);
+  body.str("timestamp").uint32(123456);
+  int bodyLength = body.length();
+  memcpy(message + headLength + bodyLength, tail + header, tailLength - header);
+
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeMsgPack(doc, message, headLength + bodyLength + tailLength - header));
+  TEST_ASSERT_EQUAL_UINT32(3, doc.size());
+  TEST_ASSERT_EQUAL_STRING("relay_status", doc["type"]);
+  TEST_ASSERT_EQUAL_UINT32(123456, doc["timestamp"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_INT(25, doc["pins"]["relay1"].as<int>());
+}
+
+void test_overflow_reports_minus_one() {
+  char buf[8];
+  MsgPackWriter w(buf, sizeof(buf));
+  w.str("timestamp");
+  TEST_ASSERT_EQUAL_INT(-1, w.length());
+  w.uint32(1);  // nothing more is written once full
+  TEST_ASSERT_EQUAL_INT(-1, w.length());
+
+  MsgPackWriter exact(buf, 5);
+  exact.uint32(70000);
+  TEST_ASSERT_EQUAL_INT(5, exact.length());
+}
+
+void test_map_header_size() {
+  const uint8_t fixmap[] = {0x81};
+  const uint8_t map16[] = {0xDE, 0x00, 0x10};
+  const uint8_t array[] = {0x91};
+  TEST_ASSERT_EQUAL_UINT32(1, msgPackMapHeaderSize(fixmap, sizeof(fixmap)));
+  TEST_ASSERT_EQUAL_UINT32(3, msgPackMapHeaderSize(map16, sizeof(map16)));
+  TEST_ASSERT_EQUAL_UINT32(0, msgPackMapHeaderSize(map16, 2));
+  TEST_ASSERT_EQUAL_UINT32(0, msgPackMapHeaderSize(array, sizeof(array)));
+}
+
+// A MessagePack command reaches the callback on the marked topic, binary
+// payload intact
+void test_marked_command_through_broker() {
+  TEST_ASSERT_TRUE(client->connect("ESP32_TEST01"));
+  TEST_ASSERT_TRUE(client->subscribe("esp32/ESP32_TEST01/command"));
+  TEST_ASSERT_TRUE(client->subscribe("esp32/ESP32_TEST01/command" PAYLOAD_MSGPACK_SUFFIX));
+  client->loop();
+
+  JsonDocument command;
+  command["command"] = "relay";
+  command["value"]["pin"] = 26;
+  command["value"]["state"] = "on";
+  uint8_t encoded[64];
+  size_t length = serializeMsgPack(command, encoded, sizeof(encoded));
+  TEST_ASSERT_TRUE(LoopbackBroker::instance().inject("esp32/ESP32_TEST01/command/msgpack", encoded, length));
+  client->loop();
+
+  TEST_ASSERT_EQUAL(PAYLOAD_MSGPACK, receivedFormat);
+  TEST_ASSERT_EQUAL_UINT32(length, received.size());
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeMsgPack(doc, received.data(), received.size()));
+  TEST_ASSERT_EQUAL_STRING("relay", doc["command"]);
+  TEST_ASSERT_EQUAL_INT(26, doc["value"]["pin"].as<int>());
+
+  TEST_ASSERT_TRUE(LoopbackBroker::instance().inject("esp32/ESP32_TEST01/command", "{\"command\":\"status\"}"));
+  client->loop();
+  TEST_ASSERT_EQUAL(PAYLOAD_JSON, receivedFormat);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_topic_marker);
+  RUN_TEST(test_integers_match_arduinojson);
+  RUN_TEST(test_strings_match_arduinojson);
+  RUN_TEST(test_map_round_trips);
+  RUN_TEST(test_template_parts_decode_as_one_map);
+  RUN_TEST(test_overflow_reports_minus_one);
+  RUN_TEST(test_map_header_size);
+  RUN_TEST(test_marked_command_through_broker);
+  return UNITY_END();
+}
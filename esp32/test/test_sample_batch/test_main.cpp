@@ -0,0 +1,156 @@
+/*
+  test_main.cpp - host tests for lib/SampleBatch.
+
+    pio test -e native -f test_sample_batch
+
+  Batches are checked through what a subscriber sees: the serialized JSON.
+*/
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <SampleBatch.h>
+#include <unity.h>
+
+#include <string>
+
+namespace {
+
+SampleBatch* batch;
+int temperature;
+int humidity;
+
+const uint8_t kSize = 4;
+const uint32_t kAgeMs = 30000;
+
+std::string json() {
+  JsonDocument doc;
+  batch->serialize(doc.to<JsonObject>());
+  std::string out;
+  serializeJson(doc, out);
+  return out;
+}
+
+}  // namespace
+
+void setUp() {
+  batch = new SampleBatch();
+  temperature = batch->addChannel("temperature");
+  humidity = batch->addChannel("humidity");
+  batch->setLimits(kSize, kAgeMs);
+}
+
+void tearDown() { delete batch; }
+
+void test_samples_keep_order_relative_to_base() {
+  TEST_ASSERT_TRUE(batch->add(temperature, 10000, 25.0f));
+  TEST_ASSERT_TRUE(batch->add(temperature, 12000, 25.5f));
+  TEST_ASSERT_TRUE(batch->add(temperature, 16000, 26.0f));
+  TEST_ASSERT_EQUAL_UINT32(10000, batch->base());
+  TEST_ASSERT_EQUAL_STRING("{\"temperature\":{\"t\":[0,2000,6000],\"v\":[25,25.5,26]}}", json().c_str());
+}
+
+// Channels appear in channel order, each with its own samples, all relative
+// to the oldest sample of the batch
+void test_channels_share_the_batch_base() {
+  batch->add(humidity, 5000, 60.0f);
+  batch->add(temperature, 7000, 25.0f);
+  batch->add(humidity, 9000, 61.0f);
+  TEST_ASSERT_EQUAL_UINT32(5000, batch->base());
+  TEST_ASSERT_EQUAL_UINT32(3, batch->size());
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"temperature\":{\"t\":[2000],\"v\":[25]},\"humidity\":{\"t\":[0,4000],\"v\":[60,61]}}", json().c_str());
+}
+
+void test_channel_without_samples_is_left_out() {
+  batch->add(humidity, 0, 60.0f);
+  TEST_ASSERT_EQUAL_STRING("{\"humidity\":{\"t\":[0],\"v\":[60]}}", json().c_str());
+}
+
+void test_full_channel_makes_batch_due() {
+  for (uint8_t i = 0; i < kSize - 1; i++) batch->add(temperature, i * 1000, 25.0f);
+  TEST_ASSERT_FALSE(batch->due(3000));
+  batch->add(temperature, 3000, 25.0f);
+  TEST_ASSERT_TRUE(batch->full(temperature));
+  TEST_ASSERT_FALSE(batch->full(humidity));
+  TEST_ASSERT_TRUE(batch->due(3000));
+}
+
+void test_full_channel_refuses_samples() {
+  for (uint8_t i = 0; i < kSize; i++) TEST_ASSERT_TRUE(batch->add(temperature, i * 1000, 25.0f));
+  TEST_ASSERT_FALSE(batch->add(temperature, 9000, 26.0f));
+  TEST_ASSERT_TRUE(batch->add(humidity, 9000, 60.0f));  // other channels still take samples
+  TEST_ASSERT_EQUAL_UINT32(1, batch->stats().refused);
+  TEST_ASSERT_EQUAL_UINT32(kSize + 1, batch->size());
+}
+
+void test_old_sample_makes_batch_due() {
+  batch->add(temperature, 1000, 25.0f);
+  batch->add(humidity, 20000, 60.0f);
+  TEST_ASSERT_FALSE(batch->due(1000 + kAgeMs - 1));
+  TEST_ASSERT_TRUE(batch->due(1000 + kAgeMs));  // the oldest sample counts
+}
+
+void test_empty_batch_is_never_due() {
+  TEST_ASSERT_FALSE(batch->due(0));
+  TEST_ASSERT_FALSE(batch->due(10 * kAgeMs));
+  TEST_ASSERT_TRUE(batch->empty());
+}
+
+void test_no_age_limit() {
+  batch->setLimits(kSize, 0);
+  batch->add(temperature, 0, 25.0f);
+  TEST_ASSERT_FALSE(batch->due(100 * kAgeMs));
+}
+
+void test_clear_starts_a_new_batch() {
+  batch->add(temperature, 1000, 25.0f);
+  batch->add(temperature, 2000, 25.1f);
+  batch->clear();
+  TEST_ASSERT_TRUE(batch->empty());
+  TEST_ASSERT_FALSE(batch->due(1000 + kAgeMs));
+  batch->add(temperature, 50000, 25.2f);
+  TEST_ASSERT_EQUAL_UINT32(50000, batch->base());
+  TEST_ASSERT_EQUAL_STRING("{\"temperature\":{\"t\":[0],\"v\":[25.2]}}", json().c_str());
+  batch->clear();
+  batch->clear();  // an empty batch is not counted
+  TEST_ASSERT_EQUAL_UINT32(2, batch->stats().batches);
+  TEST_ASSERT_EQUAL_UINT32(3, batch->stats().samples);
+}
+
+void test_offsets_survive_millis_wrap() {
+  batch->add(temperature, 0xFFFFF000u, 25.0f);
+  batch->add(temperature, 0x00000800u, 25.1f);
+  TEST_ASSERT_EQUAL_STRING("{\"temperature\":{\"t\":[0,6144],\"v\":[25,25.1]}}", json().c_str());
+  TEST_ASSERT_FALSE(batch->due(0x00000800u));
+}
+
+void test_msgpack_round_trip() {
+  batch->add(temperature, 100, 25.0f);
+  batch->add(humidity, 300, 60.5f);
+  JsonDocument doc;
+  batch->serialize(doc.to<JsonObject>());
+  uint8_t packed[128];
+  size_t length = serializeMsgPack(doc, packed, sizeof(packed));
+  JsonDocument back;
+  TEST_ASSERT_FALSE(deserializeMsgPack(back, packed, length));
+  TEST_ASSERT_EQUAL_UINT32(200, back["humidity"]["t"][0].as<uint32_t>());
+  TEST_ASSERT_EQUAL_FLOAT(60.5f, back["humidity"]["v"][0].as<float>());
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_samples_keep_order_relative_to_base);
+  RUN_TEST(test_channels_share_the_batch_base);
+  RUN_TEST(test_channel_without_samples_is_left_out);
+  RUN_TEST(test_full_channel_makes_batch_due);
+  RUN_TEST(test_full_channel_refuses_samples);
+  RUN_TEST(test_old_sample_makes_batch_due);
+  RUN_TEST(test_empty_batch_is_never_due);
+  RUN_TEST(test_no_age_limit);
+  RUN_TEST(test_clear_starts_a_new_batch);
+  RUN_TEST(test_offsets_survive_millis_wrap);
+  RUN_TEST(test_msgpack_round_trip);
+  return UNITY_END();
+}
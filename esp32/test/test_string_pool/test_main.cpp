@@ -0,0 +1,216 @@
+/*
+  test_main.cpp - host tests for ArduinoJson's string pool.
+
+    pio test -e native -f test_string_pool
+
+  A document stores each distinct string once and counts its references.
+  Past a few strings the pool looks them up in a hash table instead of
+  comparing them all; these tests churn strings through it and check that
+  every one is still found, stored once, and freed with its last reference.
+*/
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include <stdlib.h>
+
+#include <map>
+#include <string>
+
+namespace {
+
+class CountingAllocator : public ArduinoJson::Allocator {
+ public:
+  void* allocate(size_t size) override {
+    if (size >= refuseFrom) return nullptr;
+    void* ptr = malloc(size);
+    blocks[ptr] = size;
+    return ptr;
+  }
+
+  void deallocate(void* ptr) override {
+    blocks.erase(ptr);
+    free(ptr);
+  }
+
+  void* reallocate(void* ptr, size_t new_size) override {
+    if (!ptr) return allocate(new_size);
+    blocks.erase(ptr);
+    ptr = realloc(ptr, new_size);
+    blocks[ptr] = new_size;
+    return ptr;
+  }
+
+  // String nodes held; variant pools and tables are bigger blocks
+  size_t strings() const {
+    size_t count = 0;
+    for (const auto& block : blocks) count += block.second < 64;
+    return count;
+  }
+
+  std::map<void*, size_t> blocks;
+  size_t refuseFrom = (size_t)-1;  // refuse allocations of this size or more
+};
+
+std::string name(int i) {
+  return "device-" + std::to_string(i);
+}
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_each_string_is_stored_once() {
+  CountingAllocator allocator;
+  JsonDocument doc(&allocator);
+  JsonArray array = doc.to<JsonArray>();
+  for (int copy = 0; copy < 3; copy++) {
+    for (int i = 0; i < 500; i++) array.add(name(i));
+  }
+
+  TEST_ASSERT_EQUAL(500, allocator.strings());
+  for (int i = 0; i < 500; i++) {
+    TEST_ASSERT_EQUAL_STRING(name(i).c_str(), array[i].as<const char*>());
+    TEST_ASSERT_TRUE(array[i].as<const char*>() == array[1000 + i].as<const char*>());
+  }
+}
+
+void test_parsed_strings_are_shared() {
+  std::string json = "[";
+  for (int i = 0; i < 300; i++) json += "{\"name\":\"" + name(i % 100) + "\",\"room\":\"kitchen\"},";
+  json.back() = ']';
+
+  CountingAllocator allocator;
+  JsonDocument doc(&allocator);
+  TEST_ASSERT_TRUE(deserializeJson(doc, json) == DeserializationError::Ok);
+  TEST_ASSERT_EQUAL(100 + 3, allocator.strings());  // the names, "name", "room" and "kitchen"
+  TEST_ASSERT_TRUE(doc[7]["name"].as<const char*>() == doc[207]["name"].as<const char*>());
+}
+
+void test_last_reference_frees_the_string() {
+  CountingAllocator allocator;
+  JsonDocument doc(&allocator);
+  JsonArray array = doc.to<JsonArray>();
+  for (int i = 0; i < 100; i++) array.add(name(i % 50));  // twice each
+  TEST_ASSERT_EQUAL(50, allocator.strings());
+
+  array[10].set(42);  // name(10) is still at 60
+  TEST_ASSERT_EQUAL(50, allocator.strings());
+  TEST_ASSERT_EQUAL_STRING(name(10).c_str(), array[60].as<const char*>());
+
+  array[60].set(43);
+  TEST_ASSERT_EQUAL(49, allocator.strings());
+
+  array.add(name(10));  // stored again
+  TEST_ASSERT_EQUAL(50, allocator.strings());
+  TEST_ASSERT_EQUAL_STRING(name(10).c_str(), array[100].as<const char*>());
+}
+
+void test_churn_against_a_model() {
+  // Replacing values at random removes strings from all over the table,
+  // shifting its probe runs; every string must stay reachable
+  const int kSlots = 200;
+  const int kNames = 400;
+  CountingAllocator allocator;
+  JsonDocument doc(&allocator);
+  JsonArray array = doc.to<JsonArray>();
+  std::string values[kSlots];
+  std::map<std::string, int> references;
+  srand(12345);
+  for (int i = 0; i < kSlots; i++) {
+    values[i] = name(rand() % kNames);
+    array.add(values[i]);
+    references[values[i]]++;
+  }
+
+  for (int step = 0; step < 20000; step++) {
+    int slot = rand() % kSlots;
+    std::string value = name(rand() % kNames);
+    if (--references[values[slot]] == 0) references.erase(values[slot]);
+    values[slot] = value;
+    references[value]++;
+    array[slot].set(value);
+
+    if (step % 1000 == 0) {
+      for (int i = 0; i < kSlots; i++) TEST_ASSERT_EQUAL_STRING(values[i].c_str(), array[i].as<const char*>());
+      TEST_ASSERT_EQUAL(references.size(), allocator.strings());
+    }
+  }
+
+  // Equal strings share one copy
+  for (int i = 0; i < kSlots; i++) {
+    for (int j = i + 1; j < kSlots; j++) {
+      if (values[i] == values[j]) TEST_ASSERT_TRUE(array[i].as<const char*>() == array[j].as<const char*>());
+    }
+  }
+}
+
+void test_similar_strings_are_distinct() {
+  JsonDocument doc;
+  JsonArray array = doc.to<JsonArray>();
+  const char* strings[] = {"abcd", "abcde", "abce", "dcba", "ABCD", "abcd ", " abcd", "abcdabcd"};
+  for (int round = 0; round < 4; round++) {
+    for (const char* s : strings) array.add(std::string(s) + std::to_string(round));
+  }
+  array.add(std::string("abcd\0x0", 7));
+  array.add(std::string("abcd\0y0", 7));
+
+  TEST_ASSERT_EQUAL(34, array.size());
+  for (int round = 0; round < 4; round++) {
+    for (int i = 0; i < 8; i++)
+      TEST_ASSERT_EQUAL_STRING((std::string(strings[i]) + std::to_string(round)).c_str(),
+                               array[round * 8 + i].as<const char*>());
+  }
+  TEST_ASSERT_EQUAL(7, array[32].as<JsonString>().size());
+  TEST_ASSERT_EQUAL_MEMORY("abcd\0y0", array[33].as<JsonString>().c_str(), 7);
+}
+
+void test_no_memory_for_the_table() {
+  CountingAllocator allocator;
+  JsonDocument doc(&allocator);
+  JsonArray array = doc.to<JsonArray>();
+  array.add(0);                               // the variant pool
+  allocator.refuseFrom = 32 * sizeof(void*);  // but no table
+  for (int i = 0; i < 100; i++) array.add(name(i % 60));
+  TEST_ASSERT_FALSE(doc.overflowed());
+  TEST_ASSERT_EQUAL(60, allocator.strings());
+  TEST_ASSERT_TRUE(array[1].as<const char*>() == array[61].as<const char*>());
+
+  allocator.refuseFrom = (size_t)-1;  // the table takes them all in
+  for (int i = 0; i < 60; i++) array.add(name(i));
+  for (int i = 0; i < 60; i++) TEST_ASSERT_TRUE(array[1 + i].as<const char*>() == array[101 + i].as<const char*>());
+  TEST_ASSERT_EQUAL(60, allocator.strings());
+}
+
+void test_everything_is_freed() {
+  CountingAllocator allocator;
+  {
+    JsonDocument doc(&allocator);
+    for (int i = 0; i < 200; i++) doc.add(name(i));
+
+    JsonDocument moved(std::move(doc));
+    TEST_ASSERT_EQUAL_STRING(name(150).c_str(), moved[150].as<const char*>());
+    moved.clear();
+    TEST_ASSERT_EQUAL(0, allocator.blocks.size());
+
+    for (int i = 0; i < 200; i++) moved.add(name(i));
+    moved.shrinkToFit();
+    TEST_ASSERT_EQUAL_STRING(name(199).c_str(), moved[199].as<const char*>());
+  }
+  TEST_ASSERT_EQUAL(0, allocator.blocks.size());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_each_string_is_stored_once);
+  RUN_TEST(test_parsed_strings_are_shared);
+  RUN_TEST(test_last_reference_frees_the_string);
+  RUN_TEST(test_churn_against_a_model);
+  RUN_TEST(test_similar_strings_are_distinct);
+  RUN_TEST(test_no_memory_for_the_table);
+  RUN_TEST(test_everything_is_freed);
+  return UNITY_END();
+}
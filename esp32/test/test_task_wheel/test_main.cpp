@@ -0,0 +1,224 @@
+/*
+  test_main.cpp - host tests for lib/TaskWheel.
+
+    pio test -e native -f test_task_wheel
+
+  Runs on the ArduinoNative virtual clock: tasks advance it to stand in for
+  work, and idle() jumps it to the next deadline.
+*/
+
+#include <Arduino.h>
+#include <NativeSim.h>
+#include <TaskWheel.h>
+#include <unity.h>
+
+namespace {
+
+TaskWheel* wheel;
+int runs_a;
+int runs_b;
+int order[8];
+int order_count;
+uint32_t work_micros;
+int self_rearm_id;
+
+void taskA() {
+  runs_a++;
+  if (order_count < 8) order[order_count++] = 1;
+  nativesim::advanceMicros(work_micros);
+}
+
+void taskB() {
+  runs_b++;
+  if (order_count < 8) order[order_count++] = 2;
+}
+
+void taskRearm() {
+  runs_b++;
+  wheel->runIn(self_rearm_id, 7);
+}
+
+// Drives the wheel like loop() does, running everything due up to `ms` and
+// leaving the virtual clock there.
+void runUntil(uint32_t ms) {
+  for (;;) {
+    wheel->runDue();
+    uint32_t next = wheel->msUntilNext();
+    if (next == UINT32_MAX || millis() + next > ms) break;
+    wheel->idle();
+  }
+  if (millis() < ms) nativesim::advanceMillis(ms - millis());
+}
+
+}  // namespace
+
+void setUp() {
+  nativesim::resetClock();
+  nativesim::setWakeAt(UINT64_MAX);
+  wheel = new TaskWheel();
+  wheel->begin();
+  runs_a = runs_b = 0;
+  order_count = 0;
+  work_micros = 0;
+}
+
+void tearDown() {
+  delete wheel;
+}
+
+void test_periodic_task_runs_once_per_period() {
+  wheel->every("a", 10, taskA);
+  runUntil(1000);
+  TEST_ASSERT_EQUAL(101, runs_a);  // t=0, 10, ..., 1000
+  TEST_ASSERT_EQUAL_UINT32(101, wheel->stats(0).runs);
+  TEST_ASSERT_EQUAL_UINT32(0, wheel->stats(0).skipped);
+}
+
+void test_idle_sleeps_exactly_until_next_deadline() {
+  wheel->every("a", 250, taskA, 250);
+  wheel->runDue();
+  TEST_ASSERT_EQUAL_UINT32(250, wheel->msUntilNext());
+  TEST_ASSERT_FALSE(wheel->idle());
+  TEST_ASSERT_EQUAL_UINT64(250000, nativesim::nowMicros());
+  wheel->runDue();
+  TEST_ASSERT_EQUAL(1, runs_a);
+  TEST_ASSERT_EQUAL_UINT32(0, wheel->stats(0).maxLateMicros);
+}
+
+void test_idle_is_capped() {
+  wheel->every("a", 5000, taskA, 5000);
+  wheel->idle();
+  TEST_ASSERT_EQUAL_UINT64((uint64_t)TaskWheel::kMaxIdleMs * 1000, nativesim::nowMicros());
+}
+
+void test_deadlines_beyond_one_rotation() {
+  wheel->every("slow", 30000, taskA, 30000);
+  wheel->every("fast", 100, taskB, 100);
+  runUntil(29999);
+  TEST_ASSERT_EQUAL(0, runs_a);
+  runUntil(30000);
+  TEST_ASSERT_EQUAL(1, runs_a);
+  TEST_ASSERT_EQUAL(300, runs_b);
+}
+
+void test_long_gap_sweeps_whole_wheel() {
+  wheel->every("a", 300, taskA, 300);
+  wheel->every("b", 700, taskB, 700);
+  nativesim::advanceMillis(5000);  // one blocking call, far longer than a rotation
+  wheel->runDue();
+  TEST_ASSERT_EQUAL(1, runs_a);
+  TEST_ASSERT_EQUAL(1, runs_b);
+  // Missed periods are skipped, not replayed
+  TEST_ASSERT_EQUAL_UINT32(15, wheel->stats(0).skipped);
+  TEST_ASSERT_EQUAL_UINT32(6, wheel->stats(1).skipped);
+  TEST_ASSERT_EQUAL_UINT32(100, wheel->msUntilNext());  // a: phase kept at 5100
+}
+
+void test_one_shot_runs_once_when_armed() {
+  int id = wheel->once("shot", taskA);
+  runUntil(100);
+  TEST_ASSERT_EQUAL(0, runs_a);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, wheel->msUntilNext());
+  wheel->runIn(id, 40);
+  TEST_ASSERT_TRUE(wheel->armed(id));
+  runUntil(139);
+  TEST_ASSERT_EQUAL(0, runs_a);
+  runUntil(500);
+  TEST_ASSERT_EQUAL(1, runs_a);
+  TEST_ASSERT_FALSE(wheel->armed(id));
+}
+
+void test_run_now_runs_on_next_pass_in_same_tick() {
+  int id = wheel->once("shot", taskA);
+  wheel->runDue();
+  wheel->runNow(id);
+  TEST_ASSERT_EQUAL_UINT32(0, wheel->msUntilNext());
+  wheel->runDue();
+  TEST_ASSERT_EQUAL(1, runs_a);
+  TEST_ASSERT_EQUAL_UINT64(0, nativesim::nowMicros());
+}
+
+void test_cancel_stops_periodic_task() {
+  int id = wheel->every("a", 10, taskA);
+  runUntil(50);
+  wheel->cancel(id);
+  runUntil(200);
+  TEST_ASSERT_EQUAL(6, runs_a);
+  wheel->runIn(id, 0);
+  runUntil(230);
+  TEST_ASSERT_EQUAL(10, runs_a);
+}
+
+void test_task_can_rearm_itself() {
+  self_rearm_id = wheel->once("rearm", taskRearm);
+  wheel->runIn(self_rearm_id, 7);
+  runUntil(70);
+  TEST_ASSERT_EQUAL(10, runs_b);
+}
+
+void test_due_tasks_run_earliest_first() {
+  wheel->every("a", 1000, taskA, 20);
+  wheel->every("b", 1000, taskB, 10);
+  nativesim::advanceMillis(30);
+  wheel->runDue();
+  TEST_ASSERT_EQUAL(2, order_count);
+  TEST_ASSERT_EQUAL(2, order[0]);
+  TEST_ASSERT_EQUAL(1, order[1]);
+}
+
+void test_overrun_and_lateness_are_recorded() {
+  work_micros = 15000;  // a 10 ms task that takes 15 ms
+  wheel->every("a", 10, taskA);
+  wheel->every("b", 10, taskB, 5);
+  runUntil(100);
+  const TaskWheel::TaskStats& a = wheel->stats(0);
+  TEST_ASSERT_EQUAL_UINT32(a.runs, a.overruns);
+  TEST_ASSERT_TRUE(a.skipped > 0);
+  TEST_ASSERT_TRUE(a.maxRunMicros >= 15000);
+  TEST_ASSERT_TRUE(wheel->stats(1).maxLateMicros >= 10000);
+}
+
+void test_wake_ends_idle_immediately() {
+  wheel->every("a", 500, taskA, 500);
+  wheel->wake();
+  TEST_ASSERT_TRUE(wheel->idle());
+  TEST_ASSERT_EQUAL_UINT64(0, nativesim::nowMicros());
+  TEST_ASSERT_EQUAL_UINT32(1, wheel->earlyWakes());
+}
+
+void test_external_event_ends_idle_early() {
+  wheel->every("a", 500, taskA, 500);
+  nativesim::setWakeAt(120000);
+  TEST_ASSERT_TRUE(wheel->idle());
+  TEST_ASSERT_EQUAL_UINT64(120000, nativesim::nowMicros());
+  TEST_ASSERT_FALSE(wheel->idle());
+  TEST_ASSERT_EQUAL_UINT64(500000, nativesim::nowMicros());
+}
+
+void test_table_full_returns_minus_one() {
+  for (int i = 0; i < TaskWheel::kMaxTasks; i++) {
+    TEST_ASSERT_EQUAL(i, wheel->once("t", taskB));
+  }
+  TEST_ASSERT_EQUAL(-1, wheel->once("t", taskB));
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_periodic_task_runs_once_per_period);
+  RUN_TEST(test_idle_sleeps_exactly_until_next_deadline);
+  RUN_TEST(test_idle_is_capped);
+  RUN_TEST(test_deadlines_beyond_one_rotation);
+  RUN_TEST(test_long_gap_sweeps_whole_wheel);
+  RUN_TEST(test_one_shot_runs_once_when_armed);
+  RUN_TEST(test_run_now_runs_on_next_pass_in_same_tick);
+  RUN_TEST(test_cancel_stops_periodic_task);
+  RUN_TEST(test_task_can_rearm_itself);
+  RUN_TEST(test_due_tasks_run_earliest_first);
+  RUN_TEST(test_overrun_and_lateness_are_recorded);
+  RUN_TEST(test_wake_ends_idle_immediately);
+  RUN_TEST(test_external_event_ends_idle_early);
+  RUN_TEST(test_table_full_returns_minus_one);
+  return UNITY_END();
+}
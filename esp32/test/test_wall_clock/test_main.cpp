@@ -0,0 +1,182 @@
+/*
+  test_main.cpp - host tests for lib/WallClock.
+
+    pio test -e native -f test_wall_clock
+
+  The clock syncs over the WiFiUDP stand-in against LoopbackNTP, whose
+  server time follows the virtual clock from a fixed epoch.
+*/
+
+#include <Arduino.h>
+#include <LoopbackNTP.h>
+#include <NativeSim.h>
+#include <WallClock.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <unity.h>
+
+namespace {
+
+WiFiUDP* udp;
+WallClock* wallClock;
+
+// Runs poll() the way the scheduler does for ms of virtual time
+void run(uint32_t ms) {
+  uint64_t until = nativesim::nowMicros() + ms * 1000ULL;
+  while (nativesim::nowMicros() < until) {
+    uint64_t wait = wallClock->poll() * 1000ULL;
+    uint64_t left = until - nativesim::nowMicros();
+    nativesim::advanceMicros(wait < left ? wait : left);
+  }
+  wallClock->poll();
+}
+
+int64_t error() {
+  return (int64_t)(wallClock->now() - LoopbackNTP::instance().serverTime());
+}
+
+}  // namespace
+
+void setUp() {
+  nativesim::resetClock();
+  nativesim::advanceMillis(1234);  // boots some time after the epoch the server counts from
+  WiFi.setStatus(WL_CONNECTED);
+  LoopbackNTP::instance().reset();
+  udp = new WiFiUDP();
+  wallClock = new WallClock();
+  wallClock->begin(*udp, "pool.ntp.org");
+}
+
+void tearDown() {
+  delete wallClock;
+  delete udp;
+}
+
+void test_uptime_stamps_until_first_reply() {
+  wallClock->poll();
+  TEST_ASSERT_EQUAL_UINT32(1, LoopbackNTP::instance().stats().requests);
+  TEST_ASSERT_FALSE(wallClock->synced());
+  TEST_ASSERT_TRUE(wallClock->now() == 0);
+  TEST_ASSERT_TRUE(wallClock->stamp(millis()) == millis());
+}
+
+void test_sync_matches_server_time() {
+  run(100);
+  TEST_ASSERT_TRUE(wallClock->synced());
+  TEST_ASSERT_EQUAL_UINT32(1, wallClock->stats().syncs);
+  TEST_ASSERT_TRUE(wallClock->now() > 1700000000000ULL);
+  TEST_ASSERT_INT_WITHIN(5, 0, (int)error());
+  run(600000);  // keeps counting from millis() between syncs
+  TEST_ASSERT_INT_WITHIN(5, 0, (int)error());
+}
+
+void test_network_delay_cancels_out() {
+  LoopbackNTP::instance().setDelayMicros(400000);
+  run(1000);
+  TEST_ASSERT_TRUE(wallClock->synced());
+  TEST_ASSERT_INT_WITHIN(5, 0, (int)error());  // picked up at most one kReplyPollMs late
+  TEST_ASSERT_INT_WITHIN(10, 400, (int)wallClock->stats().rttMs);
+}
+
+void test_earlier_reading_gets_wall_time() {
+  uint32_t taken = millis();
+  uint64_t server_then = LoopbackNTP::instance().serverTime();
+  run(30000);
+  TEST_ASSERT_TRUE(wallClock->synced());
+  TEST_ASSERT_INT_WITHIN(5, 0, (int)(wallClock->toEpoch(taken) - server_then));
+  TEST_ASSERT_TRUE(wallClock->stamp(taken) == wallClock->toEpoch(taken));
+}
+
+void test_timeouts_back_off() {
+  LoopbackNTP::instance().setOnline(false);
+  // each request times out after 2 s, then waits 2, 4, 8 s before the next
+  run(2000 + 2000 + 2000 + 4000 + 2000 + 8000 + 2000 + 100);
+  TEST_ASSERT_FALSE(wallClock->synced());
+  TEST_ASSERT_EQUAL_UINT32(4, LoopbackNTP::instance().stats().requests);
+  TEST_ASSERT_EQUAL_UINT32(4, wallClock->stats().timeouts);
+
+  LoopbackNTP::instance().setOnline(true);
+  run(WallClock::kRetryMaxMs);
+  TEST_ASSERT_TRUE(wallClock->synced());
+}
+
+void test_late_reply_is_not_used() {
+  LoopbackNTP::instance().setDelayMicros(WallClock::kTimeoutMs * 1000 + 500000);
+  run(WallClock::kTimeoutMs + WallClock::kRetryMinMs + 600);
+  // the first reply turned up after its request had timed out
+  TEST_ASSERT_FALSE(wallClock->synced());
+  TEST_ASSERT_EQUAL_UINT32(1, wallClock->stats().rejected);
+}
+
+void test_unsynchronized_server_is_rejected() {
+  LoopbackNTP::instance().setUnsynchronized(true);
+  run(1000);
+  TEST_ASSERT_FALSE(wallClock->synced());
+  TEST_ASSERT_EQUAL_UINT32(1, wallClock->stats().rejected);
+}
+
+void test_resyncs_after_the_interval() {
+  wallClock->setSyncInterval(60000);
+  run(100);
+  run(60000);
+  TEST_ASSERT_EQUAL_UINT32(2, wallClock->stats().syncs);
+}
+
+void test_forward_correction_applies_at_once() {
+  run(100);
+  LoopbackNTP::instance().step(5000);
+  wallClock->resync();
+  run(100);
+  TEST_ASSERT_EQUAL_INT32(5000, wallClock->stats().lastStepMs);
+  TEST_ASSERT_INT_WITHIN(5, 0, (int)error());
+}
+
+void test_backward_correction_never_runs_back() {
+  run(100);
+  LoopbackNTP::instance().step(-3000);
+  wallClock->resync();
+  uint64_t last = wallClock->now();
+  for (int i = 0; i < 100; i++) {
+    run(50);
+    uint64_t t = wallClock->now();
+    TEST_ASSERT_TRUE(t >= last);
+    last = t;
+  }
+  TEST_ASSERT_EQUAL_INT32(-3000, wallClock->stats().lastStepMs);
+  TEST_ASSERT_EQUAL_UINT32(3000, wallClock->stats().heldMs);
+  // held for the 3 s, then it runs with the server again
+  TEST_ASSERT_INT_WITHIN(5, 0, (int)error());
+}
+
+void test_offset_survives_reconnect() {
+  run(100);
+  WiFi.setStatus(WL_DISCONNECTED);
+  run(WallClock::kSyncIntervalMs + 10000);
+  TEST_ASSERT_TRUE(wallClock->synced());
+  TEST_ASSERT_TRUE(wallClock->stats().sendErrors > 0);
+  TEST_ASSERT_INT_WITHIN(5, 0, (int)error());
+
+  WiFi.setStatus(WL_CONNECTED);
+  wallClock->resync();
+  run(100);
+  TEST_ASSERT_EQUAL_UINT32(2, wallClock->stats().syncs);
+  TEST_ASSERT_INT_WITHIN(5, 0, (int)wallClock->stats().lastStepMs);
+}
+
+int main(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  UNITY_BEGIN();
+  RUN_TEST(test_uptime_stamps_until_first_reply);
+  RUN_TEST(test_sync_matches_server_time);
+  RUN_TEST(test_network_delay_cancels_out);
+  RUN_TEST(test_earlier_reading_gets_wall_time);
+  RUN_TEST(test_timeouts_back_off);
+  RUN_TEST(test_late_reply_is_not_used);
+  RUN_TEST(test_unsynchronized_server_is_rejected);
+  RUN_TEST(test_resyncs_after_the_interval);
+  RUN_TEST(test_forward_correction_applies_at_once);
+  RUN_TEST(test_backward_correction_never_runs_back);
+  RUN_TEST(test_offset_survives_reconnect);
+  return UNITY_END();
+}
@@ -132,22 +132,31 @@ const MQTTDashboard = ({ currentUser, showToast }) => {
                 updatedDevice.lastUpdate = Date.now();
                 break;
                 
-              case 'sensor_data':
+              case 'sensor_batch':
+              case 'sensor_data': {
+                // A batch carries {"t":[...],"v":[...]} per channel; show the
+                // newest sample. Only channels that moved past their
+                // dead-band are sent; the others keep their last value
+                const latest = {};
+                Object.entries(data.data || {}).forEach(([channel, value]) => {
+                  latest[channel] = Array.isArray(value?.v) ? value.v[value.v.length - 1] : value;
+                });
                 if (data.data && updatedDevice.sensors) {
                   updatedDevice.sensors = updatedDevice.sensors.map(sensor => {
                     switch (sensor.id) {
                       case 'temp':
-                        return { ...sensor, value: data.data.temperature || '--' };
+                        return { ...sensor, value: latest.temperature ?? sensor.value };
                       case 'humidity':
-                        return { ...sensor, value: data.data.humidity || '--' };
+                        return { ...sensor, value: latest.humidity ?? sensor.value };
                       case 'heat_index':
-                        return { ...sensor, value: data.data.heat_index || '--' };
+                        return { ...sensor, value: latest.heat_index ?? sensor.value };
                       default:
                         return sensor;
                     }
                   });
                 }
                 break;
+              }
                 
               case 'heartbeat':
                 updatedDevice.status = 'online';